@@ -4,6 +4,12 @@ import time
 import socket
 import re
 import io
+import random
+
+from AxisProtocol import (
+    REQUEST_HISTORY, MessageTypes, with_request_id, split_request_id, parse_ack_message,
+    parse_message_header
+)
 
 
 class Axis:
@@ -108,6 +114,9 @@ class AxisUDP(Axis):
         self.remote_ip = remote_ip
         self.remote_port = remote_port
         self.sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        # Random start, ids a previous client used may still be in the
+        # device's retry history
+        self.next_request_id = random.randrange(0x10000)
 
     def listen(self):
         while True:
@@ -135,4 +144,60 @@ class AxisUDP(Axis):
             return None
         except socket.error as e:
             print(f"Socket error: {e}")
-            return None
\ No newline at end of file
+            return None
+
+    def send_requests(self, msgs, timeout=1, retries=3):
+        """
+        Sends `msgs` with request ids, up to REQUEST_HISTORY at a time without
+        waiting for each reply, and returns the replies in the same order,
+        request ids removed. None for a request that never got one. Requests
+        or replies that went missing are sent again, the device answers a
+        retry from its recent replies instead of running the command twice.
+        """
+        ids = []
+        for _ in msgs:
+            ids.append(self.next_request_id)
+            self.next_request_id = (self.next_request_id + 1) & 0xFFFF
+        index = {request_id: i for i, request_id in enumerate(ids)}
+        replies = [None] * len(msgs)
+        for start in range(0, len(msgs), REQUEST_HISTORY):
+            window = range(start, min(start + REQUEST_HISTORY, len(msgs)))
+            for _ in range(retries):
+                missing = [i for i in window if replies[i] is None]
+                if not missing:
+                    break
+                for i in missing:
+                    self.send_message(with_request_id(msgs[i], ids[i]))
+                deadline = time.time() + timeout
+                while any(replies[i] is None for i in window) and time.time() < deadline:
+                    data = self.wait_message(max(deadline - time.time(), 0.001))
+                    if data is None:
+                        break
+                    try:
+                        request_id, reply = split_request_id(data)
+                    except ValueError:
+                        continue
+                    # Replies to other requests, or a second one to a retry
+                    i = index.get(request_id)
+                    if i is not None and replies[i] is None:
+                        replies[i] = reply
+        return replies
+
+    def request(self, msg, expected_type, retries=3):
+        """
+        Sends `msg` and returns the reply of `expected_type`. Raises
+        RuntimeError when the device answers with an ACK carrying an error and
+        TimeoutError when no reply came after `retries` tries.
+        """
+        for _ in range(retries):
+            self.send_message(msg)
+            data = self.wait_message(timeout=1)
+            if data is None:
+                continue
+            message_type, _ = parse_message_header(data)
+            if message_type == expected_type:
+                return data
+            if message_type == MessageTypes.ACK_ID:
+                ack_type, status = parse_ack_message(data)
+                raise RuntimeError(f"Request 0x{ack_type:04X} failed: {status.name}")
+        raise TimeoutError(f"No reply to 0x{expected_type:04X}")
@@ -9,8 +9,8 @@ Protocol Version: 1.0.0.0
 """
 
 import struct
-from enum import IntEnum
-from typing import List, Tuple
+from enum import IntEnum, IntFlag
+from typing import Dict, List, Optional, Tuple
 
 # Message Type Constants
 class MessageTypes(IntEnum):
@@ -50,6 +50,47 @@ class MessageTypes(IntEnum):
     SET_RELATIVE_TARGET_POSITION_ID = 0x0401
     SET_VELOCITY_ID = 0x0313
     GET_VELOCITY_ID = 0x0314
+    GET_MOTION_QUEUE_STATUS_ID = 0x0315
+    SET_MOTION_PROFILE_ID = 0x0316
+    GET_MOTION_PROFILE_ID = 0x0317
+    SET_JERK_ID = 0x0318
+    GET_JERK_ID = 0x0319
+    SET_PLANNER_DEPTH_ID = 0x031A
+    GET_PLANNER_DEPTH_ID = 0x031B
+    ADD_PVT_POINT_ID = 0x031C
+    SET_PVT_DELAY_ID = 0x031D
+    GET_PVT_DELAY_ID = 0x031E
+    GET_PVT_STATUS_ID = 0x031F
+    SET_CLOSED_LOOP_ID = 0x0320
+    GET_CLOSED_LOOP_ID = 0x0321
+    SET_CLOSED_LOOP_GAINS_ID = 0x0322
+    GET_CLOSED_LOOP_GAINS_ID = 0x0323
+    GET_CLOSED_LOOP_STATUS_ID = 0x0324
+    SET_STALL_WINDOW_ID = 0x0325
+    GET_STALL_WINDOW_ID = 0x0326
+    SET_STALL_ACTION_ID = 0x0327
+    GET_STALL_ACTION_ID = 0x0328
+    GET_FOLLOWING_ERROR_ID = 0x0329
+    GET_MOTOR_ERRORS_ID = 0x032A
+    CLEAR_MOTOR_ERRORS_ID = 0x032B
+    GET_PROFILE_ID = 0x032C
+    RESET_PROFILE_ID = 0x032D
+    GET_ENCODER_BUS_STATS_ID = 0x032E
+    SET_ENCODER_OBSERVER_ID = 0x032F
+    GET_ENCODER_OBSERVER_ID = 0x0330
+    CALIBRATE_ENCODER_ID = 0x0331
+    GET_ENCODER_CALIBRATION_ID = 0x0332
+    CLEAR_ENCODER_CALIBRATION_ID = 0x0333
+    ARM_SCOPE_ID = 0x0334
+    STOP_SCOPE_ID = 0x0335
+    GET_SCOPE_STATUS_ID = 0x0336
+    GET_SCOPE_DATA_ID = 0x0337
+    SUBSCRIBE_TELEMETRY_ID = 0x0338
+    TELEMETRY_ID = 0x0339
+    SET_CHECKSUM_MODE_ID = 0x033A
+    GET_CHECKSUM_MODE_ID = 0x033B
+    GET_REJECTED_FRAMES_ID = 0x033C
+    BATCH_ID = 0x033D
     SET_VELOCITY_AND_STEPS_ID = 0x0402
     START_PATH_ID = 0x0403
 
@@ -76,6 +117,8 @@ class MotorStates(IntEnum):
     VELOCITY_STEP = 0x3
     IDLE_ON = 0x4
     HOME = 0x5
+    PVT = 0x6
+    CALIBRATE = 0x7
 
 # Motor Brake Modes
 class MotorBrake(IntEnum):
@@ -94,6 +137,87 @@ class PositionMode(IntEnum):
     ABSOLUTE = 0x0
     RELATIVE = 0x1
 
+# Motion Profile
+class MotionProfile(IntEnum):
+    TRAPEZOIDAL = 0x0
+    S_CURVE = 0x1
+
+# Stall Action
+class StallAction(IntEnum):
+    REPORT = 0x0
+    STOP = 0x1
+    RESYNC = 0x2
+
+# Telemetry frame fields, values follow in bit order
+class TelemetryFields(IntFlag):
+    POSITION = 0x001
+    TARGET_POSITION = 0x002
+    VELOCITY = 0x004
+    MOTOR_STATE = 0x008
+    HOMED = 0x010
+    ENCODER_POSITION = 0x020
+    ENCODER_VELOCITY = 0x040
+    FOLLOWING_ERROR = 0x080
+    ERRORS = 0x100
+    ALL = 0x1FF
+
+# struct format of each telemetry field, in bit order
+TELEMETRY_FIELD_FORMATS = [
+    (TelemetryFields.POSITION, 'f'),
+    (TelemetryFields.TARGET_POSITION, 'f'),
+    (TelemetryFields.VELOCITY, 'f'),
+    (TelemetryFields.MOTOR_STATE, 'B'),
+    (TelemetryFields.HOMED, 'B'),
+    (TelemetryFields.ENCODER_POSITION, 'f'),
+    (TelemetryFields.ENCODER_VELOCITY, 'f'),
+    (TelemetryFields.FOLLOWING_ERROR, 'f'),
+    (TelemetryFields.ERRORS, 'I'),
+]
+
+# Footer checksum, negotiated per interface with SetChecksumModeMessage
+class ChecksumMode(IntEnum):
+    SUM = 0x0
+    CRC16 = 0x1
+
+# Scope capture trigger
+class ScopeTrigger(IntEnum):
+    IMMEDIATE = 0x0
+    MOVE_START = 0x1
+    ERROR = 0x2
+    RISING = 0x3
+    FALLING = 0x4
+
+# Scope channel, for the RISING and FALLING triggers
+class ScopeChannel(IntEnum):
+    COMMANDED_POSITION = 0x0
+    ENCODER_POSITION = 0x1
+    FOLLOWING_ERROR = 0x2
+    COMMANDED_VELOCITY = 0x3
+    ENCODER_VELOCITY = 0x4
+
+# Scope capture state
+class ScopeState(IntEnum):
+    IDLE = 0x0
+    ARMED = 0x1
+    TRIGGERED = 0x2
+    DONE = 0x3
+
+# Motor Error bits
+class MotorErrors(IntFlag):
+    LOST_POWER = 0x1
+    TMC_LOST_COMMS = 0x2
+    STALL = 0x4
+
+# Profiler probes, tasks follow TASK_0 in the order they were added
+class ProfileProbe(IntEnum):
+    STEP_ISR = 0
+    ETHERNET_ISR = 1
+    MESSAGE = 2
+    TASK_0 = 3
+    ENCODER_ANGLE = 11
+    CHECKSUM = 12
+    STEP_LATENCY = 13
+
 # Message length definitions (in bytes)
 MESSAGE_LENGTHS = {
     MessageTypes.ACK_ID: 9,
@@ -134,15 +258,94 @@ MESSAGE_LENGTHS = {
     MessageTypes.GET_VELOCITY_ID: 14,
     MessageTypes.SET_VELOCITY_AND_STEPS_ID: 15,
     MessageTypes.START_PATH_ID: 7,
+    MessageTypes.GET_MOTION_QUEUE_STATUS_ID: 16,
+    MessageTypes.SET_MOTION_PROFILE_ID: 7,
+    MessageTypes.GET_MOTION_PROFILE_ID: 7,
+    MessageTypes.SET_JERK_ID: 10,
+    MessageTypes.GET_JERK_ID: 10,
+    MessageTypes.SET_PLANNER_DEPTH_ID: 7,
+    MessageTypes.GET_PLANNER_DEPTH_ID: 7,
+    MessageTypes.ADD_PVT_POINT_ID: 18,
+    MessageTypes.SET_PVT_DELAY_ID: 10,
+    MessageTypes.GET_PVT_DELAY_ID: 10,
+    MessageTypes.GET_PVT_STATUS_ID: 18,
+    MessageTypes.SET_CLOSED_LOOP_ID: 7,
+    MessageTypes.GET_CLOSED_LOOP_ID: 7,
+    MessageTypes.SET_CLOSED_LOOP_GAINS_ID: 22,
+    MessageTypes.GET_CLOSED_LOOP_GAINS_ID: 22,
+    MessageTypes.GET_CLOSED_LOOP_STATUS_ID: 18,
+    MessageTypes.SET_STALL_WINDOW_ID: 10,
+    MessageTypes.GET_STALL_WINDOW_ID: 10,
+    MessageTypes.SET_STALL_ACTION_ID: 7,
+    MessageTypes.GET_STALL_ACTION_ID: 7,
+    MessageTypes.GET_FOLLOWING_ERROR_ID: 18,
+    MessageTypes.GET_MOTOR_ERRORS_ID: 10,
+    MessageTypes.CLEAR_MOTOR_ERRORS_ID: 6,
+    MessageTypes.GET_PROFILE_ID: 91,
+    MessageTypes.RESET_PROFILE_ID: 6,
+    MessageTypes.GET_ENCODER_BUS_STATS_ID: 26,
+    MessageTypes.SET_ENCODER_OBSERVER_ID: 15,
+    MessageTypes.GET_ENCODER_OBSERVER_ID: 15,
+    MessageTypes.CALIBRATE_ENCODER_ID: 6,
+    MessageTypes.GET_ENCODER_CALIBRATION_ID: 27,
+    MessageTypes.CLEAR_ENCODER_CALIBRATION_ID: 6,
+    MessageTypes.ARM_SCOPE_ID: 18,
+    MessageTypes.STOP_SCOPE_ID: 6,
+    MessageTypes.GET_SCOPE_STATUS_ID: 15,
+    MessageTypes.GET_SCOPE_DATA_ID: 713,
+    MessageTypes.SUBSCRIBE_TELEMETRY_ID: 10,
+    MessageTypes.SET_CHECKSUM_MODE_ID: 7,
+    MessageTypes.GET_CHECKSUM_MODE_ID: 7,
+    MessageTypes.GET_REJECTED_FRAMES_ID: 22,
+    MessageTypes.BATCH_ID: 23,
 }
 
-def calculate_checksum(data: bytes) -> int:
+def _crc16_table() -> List[int]:
+    table = []
+    for byte in range(256):
+        crc = byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else crc << 1
+        table.append(crc & 0xFFFF)
+    return table
+
+CRC16_TABLE = _crc16_table()
+
+# Footer used by create_message() and verify_checksum()
+_checksum_mode = ChecksumMode.SUM
+
+def set_checksum_mode(mode: ChecksumMode):
     """
-    Calculate a simple 16-bit checksum for the given data.
-    This is a basic implementation - the actual firmware implementation may differ.
+    Switch the footer of the messages built and checked from now on. Call it
+    once the device has acknowledged SetChecksumModeMessage(mode).
     """
-    checksum = sum(data) & 0xFFFF
-    return checksum
+    global _checksum_mode
+    _checksum_mode = ChecksumMode(mode)
+
+def get_checksum_mode() -> ChecksumMode:
+    """Footer currently in use."""
+    return _checksum_mode
+
+def crc16_ccitt(data: bytes) -> int:
+    """CRC-16/CCITT-FALSE: polynomial 0x1021, initial value 0xFFFF, no reflection or final XOR."""
+    crc = 0xFFFF
+    for b in data:
+        crc = ((crc << 8) & 0xFFFF) ^ CRC16_TABLE[(crc >> 8) ^ b]
+    return crc
+
+def calculate_checksum(data: bytes, mode: ChecksumMode = None) -> int:
+    """
+    Calculate the footer checksum of header + body.
+    
+    Args:
+        data: Header and body bytes
+        mode: Footer to compute, the current one by default
+    """
+    if mode is None:
+        mode = _checksum_mode
+    if mode == ChecksumMode.CRC16:
+        return crc16_ccitt(data)
+    return sum(data) & 0xFFFF
 
 def create_message(message_type: int, body: bytes) -> bytes:
     """
@@ -166,6 +369,46 @@ def create_message(message_type: int, body: bytes) -> bytes:
     
     return header + body + footer
 
+# Set in message_type when a request id follows the body
+REQUEST_ID_FLAG = 0x8000
+
+# Replies the device keeps for retries, more requests in flight than this
+# may run twice when retried
+REQUEST_HISTORY = 8
+
+def with_request_id(msg: bytes, request_id: int) -> bytes:
+    """
+    Add a request id to a message built with the functions below. Replies
+    to it carry the same id, and a retry with the same id answered from
+    the device's recent replies doesn't run the command again.
+    
+    Args:
+        msg: Complete message without a request id
+        request_id: 0 to 0xFFFF
+    """
+    message_type, body_size = struct.unpack_from('<HH', msg)
+    body = msg[4:-2] + struct.pack('<H', request_id)
+    return create_message(message_type | REQUEST_ID_FLAG, body)
+
+def split_request_id(data: bytes) -> Tuple[Optional[int], bytes]:
+    """
+    Separate the request id from a reply, for the parsers below.
+    
+    Args:
+        data: Raw message bytes
+        
+    Returns:
+        Tuple of (request_id, message without it), request_id is None for a
+        message without one
+    """
+    message_type, body_size = parse_message_header(data)
+    if not message_type & REQUEST_ID_FLAG:
+        return None, data
+    if not verify_checksum(data) or body_size < 2 or len(data) != 4 + body_size + 2:
+        raise ValueError("Invalid message with a request id")
+    request_id, = struct.unpack_from('<H', data, len(data) - 4)
+    return request_id, create_message(message_type & ~REQUEST_ID_FLAG, data[4:-4])
+
 # Request messages (typically have empty or minimal bodies for "get" operations)
 
 def GetVersionMessage() -> bytes:
@@ -489,6 +732,288 @@ def StartPathMessage(path_id: int) -> bytes:
     body = struct.pack('<B', path_id)
     return create_message(MessageTypes.START_PATH_ID, body)
 
+def GetMotionQueueStatusMessage() -> bytes:
+    """Create a Get Motion Queue Status request message."""
+    return create_message(MessageTypes.GET_MOTION_QUEUE_STATUS_ID, b'')
+
+def SetMotionProfileMessage(profile: MotionProfile) -> bytes:
+    """
+    Create a Set Motion Profile message.
+    
+    Args:
+        profile: Profile from MotionProfile enum
+    """
+    body = struct.pack('<B', profile)
+    return create_message(MessageTypes.SET_MOTION_PROFILE_ID, body)
+
+def GetMotionProfileMessage() -> bytes:
+    """Create a Get Motion Profile request message."""
+    return create_message(MessageTypes.GET_MOTION_PROFILE_ID, b'')
+
+def SetJerkMessage(jerk: int) -> bytes:
+    """
+    Create a Set Jerk message.
+    
+    Args:
+        jerk: S-curve jerk limit in steps/s^3 as uint32_t
+    """
+    body = struct.pack('<I', jerk)
+    return create_message(MessageTypes.SET_JERK_ID, body)
+
+def GetJerkMessage() -> bytes:
+    """Create a Get Jerk request message."""
+    return create_message(MessageTypes.GET_JERK_ID, b'')
+
+def SetPlannerDepthMessage(depth: int) -> bytes:
+    """
+    Create a Set Planner Depth message.
+    
+    Args:
+        depth: Velocity segments replanned per added segment (1-64)
+    """
+    body = struct.pack('<B', depth)
+    return create_message(MessageTypes.SET_PLANNER_DEPTH_ID, body)
+
+def GetPlannerDepthMessage() -> bytes:
+    """Create a Get Planner Depth request message."""
+    return create_message(MessageTypes.GET_PLANNER_DEPTH_ID, b'')
+
+def AddPvtPointMessage(time_us: int, position: int, velocity: int) -> bytes:
+    """
+    Create an Add PVT Point message.
+    
+    Args:
+        time_us: Point time in microseconds on the host clock, wraps at 32 bits
+        position: Position in steps as int32_t
+        velocity: Velocity at the point in steps/s as int32_t
+    """
+    body = struct.pack('<Iii', time_us & 0xFFFFFFFF, position, velocity)
+    return create_message(MessageTypes.ADD_PVT_POINT_ID, body)
+
+def SetPvtDelayMessage(delay_us: int) -> bytes:
+    """
+    Create a Set PVT Delay message.
+    
+    Args:
+        delay_us: Jitter buffer delay in microseconds as uint32_t
+    """
+    body = struct.pack('<I', delay_us)
+    return create_message(MessageTypes.SET_PVT_DELAY_ID, body)
+
+def GetPvtDelayMessage() -> bytes:
+    """Create a Get PVT Delay request message."""
+    return create_message(MessageTypes.GET_PVT_DELAY_ID, b'')
+
+def GetPvtStatusMessage() -> bytes:
+    """Create a Get PVT Status request message."""
+    return create_message(MessageTypes.GET_PVT_STATUS_ID, b'')
+
+def SetClosedLoopMessage(enabled: bool) -> bytes:
+    """
+    Create a Set Closed Loop message.
+    
+    Args:
+        enabled: True to correct the position from the encoder
+    """
+    body = struct.pack('<B', 1 if enabled else 0)
+    return create_message(MessageTypes.SET_CLOSED_LOOP_ID, body)
+
+def GetClosedLoopMessage() -> bytes:
+    """Create a Get Closed Loop request message."""
+    return create_message(MessageTypes.GET_CLOSED_LOOP_ID, b'')
+
+def SetClosedLoopGainsMessage(p: float, i: float, d: float, limit: float) -> bytes:
+    """
+    Create a Set Closed Loop Gains message.
+    
+    Args:
+        p: Proportional gain, steps/s per step of error
+        i: Integral gain
+        d: Derivative gain
+        limit: Maximum correction speed in steps/s
+    """
+    body = struct.pack('<ffff', p, i, d, limit)
+    return create_message(MessageTypes.SET_CLOSED_LOOP_GAINS_ID, body)
+
+def GetClosedLoopGainsMessage() -> bytes:
+    """Create a Get Closed Loop Gains request message."""
+    return create_message(MessageTypes.GET_CLOSED_LOOP_GAINS_ID, b'')
+
+def GetClosedLoopStatusMessage() -> bytes:
+    """Create a Get Closed Loop Status request message."""
+    return create_message(MessageTypes.GET_CLOSED_LOOP_STATUS_ID, b'')
+
+def SetStallWindowMessage(window: int) -> bytes:
+    """
+    Create a Set Stall Window message.
+    
+    Args:
+        window: Largest allowed following error in steps, 0 turns stall detection off
+    """
+    body = struct.pack('<I', window)
+    return create_message(MessageTypes.SET_STALL_WINDOW_ID, body)
+
+def GetStallWindowMessage() -> bytes:
+    """Create a Get Stall Window request message."""
+    return create_message(MessageTypes.GET_STALL_WINDOW_ID, b'')
+
+def SetStallActionMessage(action: StallAction) -> bytes:
+    """
+    Create a Set Stall Action message.
+    
+    Args:
+        action: What the motor does on a stall
+    """
+    body = struct.pack('<B', action)
+    return create_message(MessageTypes.SET_STALL_ACTION_ID, body)
+
+def GetStallActionMessage() -> bytes:
+    """Create a Get Stall Action request message."""
+    return create_message(MessageTypes.GET_STALL_ACTION_ID, b'')
+
+def GetFollowingErrorMessage() -> bytes:
+    """Create a Get Following Error request message."""
+    return create_message(MessageTypes.GET_FOLLOWING_ERROR_ID, b'')
+
+def GetMotorErrorsMessage() -> bytes:
+    """Create a Get Motor Errors request message."""
+    return create_message(MessageTypes.GET_MOTOR_ERRORS_ID, b'')
+
+def ClearMotorErrorsMessage() -> bytes:
+    """Create a Clear Motor Errors message."""
+    return create_message(MessageTypes.CLEAR_MOTOR_ERRORS_ID, b'')
+
+def GetProfileMessage(probe: int) -> bytes:
+    """
+    Create a Get Profile request message.
+    
+    Args:
+        probe: ProfileProbe, or TASK_0 plus the task index
+    """
+    body = struct.pack('<B', probe)
+    return create_message(MessageTypes.GET_PROFILE_ID, body)
+
+def ResetProfileMessage() -> bytes:
+    """Create a Reset Profile message."""
+    return create_message(MessageTypes.RESET_PROFILE_ID, b'')
+
+def GetEncoderBusStatsMessage() -> bytes:
+    """Create a Get Encoder Bus Stats request message."""
+    return create_message(MessageTypes.GET_ENCODER_BUS_STATS_ID, b'')
+
+def SetEncoderObserverMessage(alpha: float, beta: float, feed_forward: bool) -> bytes:
+    """
+    Create a Set Encoder Observer message.
+    
+    Args:
+        alpha: Position gain, per sample
+        beta: Velocity gain, per sample
+        feed_forward: Use the commanded step rate in the prediction
+    """
+    body = struct.pack('<ffB', alpha, beta, 1 if feed_forward else 0)
+    return create_message(MessageTypes.SET_ENCODER_OBSERVER_ID, body)
+
+def GetEncoderObserverMessage() -> bytes:
+    """Create a Get Encoder Observer request message."""
+    return create_message(MessageTypes.GET_ENCODER_OBSERVER_ID, b'')
+
+def CalibrateEncoderMessage() -> bytes:
+    """Create a Calibrate Encoder message."""
+    return create_message(MessageTypes.CALIBRATE_ENCODER_ID, b'')
+
+def GetEncoderCalibrationMessage() -> bytes:
+    """Create a Get Encoder Calibration request message."""
+    return create_message(MessageTypes.GET_ENCODER_CALIBRATION_ID, b'')
+
+def ClearEncoderCalibrationMessage() -> bytes:
+    """Create a Clear Encoder Calibration message."""
+    return create_message(MessageTypes.CLEAR_ENCODER_CALIBRATION_ID, b'')
+
+def ArmScopeMessage(period_us: int, trigger: ScopeTrigger, channel: ScopeChannel = ScopeChannel.COMMANDED_POSITION,
+                    level: float = 0.0, pre_trigger: int = 0) -> bytes:
+    """
+    Create an Arm Scope message.
+    
+    Args:
+        period_us: Sample period in microseconds, at least 50
+        trigger: What starts the capture
+        channel: Channel compared with level by the RISING and FALLING triggers
+        level: Threshold in steps or steps/s
+        pre_trigger: Samples to keep from before the trigger, under 512
+    """
+    body = struct.pack('<IBBfH', period_us, trigger, channel, level, pre_trigger)
+    return create_message(MessageTypes.ARM_SCOPE_ID, body)
+
+def StopScopeMessage() -> bytes:
+    """Create a Stop Scope message."""
+    return create_message(MessageTypes.STOP_SCOPE_ID, b'')
+
+def GetScopeStatusMessage() -> bytes:
+    """Create a Get Scope Status request message."""
+    return create_message(MessageTypes.GET_SCOPE_STATUS_ID, b'')
+
+def GetScopeDataMessage(first: int) -> bytes:
+    """
+    Create a Get Scope Data request message.
+    
+    Args:
+        first: Index of the first sample to download
+    """
+    body = struct.pack('<H', first)
+    return create_message(MessageTypes.GET_SCOPE_DATA_ID, body)
+
+def SubscribeTelemetryMessage(fields: TelemetryFields, period_ms: int) -> bytes:
+    """
+    Create a Subscribe Telemetry message.
+    
+    Args:
+        fields: Values to push, 0 ends the subscription
+        period_ms: Push period in milliseconds, at least 2, 0 ends the subscription
+    """
+    body = struct.pack('<HH', fields, period_ms)
+    return create_message(MessageTypes.SUBSCRIBE_TELEMETRY_ID, body)
+
+def SetChecksumModeMessage(mode: ChecksumMode) -> bytes:
+    """
+    Create a Set Checksum Mode message. It is built with the current footer
+    and acknowledged with it, switch with set_checksum_mode() after the ACK.
+    
+    Args:
+        mode: Footer for the following messages both ways
+    """
+    body = struct.pack('<B', mode)
+    return create_message(MessageTypes.SET_CHECKSUM_MODE_ID, body)
+
+def GetChecksumModeMessage() -> bytes:
+    """Create a Get Checksum Mode request message."""
+    return create_message(MessageTypes.GET_CHECKSUM_MODE_ID, b'')
+
+def GetRejectedFramesMessage() -> bytes:
+    """Create a Get Rejected Frames request message."""
+    return create_message(MessageTypes.GET_REJECTED_FRAMES_ID, b'')
+
+# Commands in one Batch message
+BATCH_MAX_COMMANDS = 16
+
+def BatchMessage(messages: List[bytes]) -> bytes:
+    """
+    Create a Batch message running several commands with one response.
+    
+    Args:
+        messages: Commands built with the functions above, run in order. Only
+            ones the device answers with an ACK, at most BATCH_MAX_COMMANDS.
+    """
+    if not 0 < len(messages) <= BATCH_MAX_COMMANDS:
+        raise ValueError(f"A batch holds 1 to {BATCH_MAX_COMMANDS} commands, got {len(messages)}")
+    body = b''
+    for msg in messages:
+        message_type, body_size = struct.unpack_from('<HH', msg)
+        if len(msg) != 4 + body_size + 2:
+            raise ValueError(f"Command 0x{message_type:04X} isn't a whole message")
+        # The batch footer covers the commands
+        body += msg[:-2]
+    return create_message(MessageTypes.BATCH_ID, body)
+
 # Parsing functions for response messages
 
 def parse_ack_message(data: bytes) -> Tuple[int, StatusCodes]:
@@ -511,6 +1036,27 @@ def parse_ack_message(data: bytes) -> Tuple[int, StatusCodes]:
         raise ValueError("Invalid ACK message format")
     return ack_message_type, StatusCodes(status)
 
+def parse_batch_response(data: bytes) -> List[StatusCodes]:
+    """
+    Parse a Batch response message.
+    
+    Args:
+        data: Raw message bytes
+        
+    Returns:
+        Status of each command run, in order. Commands past the end of the
+        list didn't run, the last one failed if it isn't SUCCESS.
+    """
+    expected_length = 23
+    if len(data) != expected_length:
+        raise ValueError(f"Invalid Batch response length: expected {expected_length}, got {len(data)}")
+    if not verify_checksum(data):
+        raise ValueError("Invalid checksum")
+    message_type, body_size, count = struct.unpack_from('<HHB', data)
+    if message_type != MessageTypes.BATCH_ID or body_size != 17 or count > BATCH_MAX_COMMANDS:
+        raise ValueError("Invalid Batch response format")
+    return [StatusCodes(s) for s in data[5:5 + count]]
+
 def parse_get_version_response(data: bytes) -> int:
     """
     Parse a Get Version response message.
@@ -854,6 +1400,463 @@ def parse_get_velocity_response(data: bytes) -> float:
         raise ValueError("Invalid Get Velocity response format")
     return velocity
 
+def parse_get_motion_queue_status_response(data: bytes) -> Tuple[int, int, int, int]:
+    """
+    Parse a Get Motion Queue Status response message.
+    
+    Args:
+        data: Raw message bytes
+        
+    Returns:
+        Tuple of (depth, capacity, high_water, overflows)
+    """
+    expected_length = 16
+    if len(data) != expected_length:
+        raise ValueError(f"Invalid Get Motion Queue Status response length: expected {expected_length}, got {len(data)}")
+    if not verify_checksum(data):
+        raise ValueError("Invalid checksum")
+    message_type, body_size, depth, capacity, high_water, overflows, checksum = struct.unpack('<HHHHHIH', data)
+    if message_type != MessageTypes.GET_MOTION_QUEUE_STATUS_ID or body_size != 10:
+        raise ValueError("Invalid Get Motion Queue Status response format")
+    return depth, capacity, high_water, overflows
+
+def parse_get_motion_profile_response(data: bytes) -> MotionProfile:
+    """
+    Parse a Get Motion Profile response message.
+    
+    Args:
+        data: Raw message bytes
+        
+    Returns:
+        Motion profile
+    """
+    expected_length = 7
+    if len(data) != expected_length:
+        raise ValueError(f"Invalid Get Motion Profile response length: expected {expected_length}, got {len(data)}")
+    if not verify_checksum(data):
+        raise ValueError("Invalid checksum")
+    message_type, body_size, profile, checksum = struct.unpack('<HHBH', data)
+    if message_type != MessageTypes.GET_MOTION_PROFILE_ID or body_size != 1:
+        raise ValueError("Invalid Get Motion Profile response format")
+    return MotionProfile(profile)
+
+def parse_get_jerk_response(data: bytes) -> int:
+    """
+    Parse a Get Jerk response message.
+    
+    Args:
+        data: Raw message bytes
+        
+    Returns:
+        Jerk limit in steps/s^3 as uint32_t
+    """
+    expected_length = 10
+    if len(data) != expected_length:
+        raise ValueError(f"Invalid Get Jerk response length: expected {expected_length}, got {len(data)}")
+    if not verify_checksum(data):
+        raise ValueError("Invalid checksum")
+    message_type, body_size, jerk, checksum = struct.unpack('<HHIH', data)
+    if message_type != MessageTypes.GET_JERK_ID or body_size != 4:
+        raise ValueError("Invalid Get Jerk response format")
+    return jerk
+
+def parse_get_planner_depth_response(data: bytes) -> int:
+    """
+    Parse a Get Planner Depth response message.
+    
+    Args:
+        data: Raw message bytes
+        
+    Returns:
+        Velocity segments replanned per added segment
+    """
+    expected_length = 7
+    if len(data) != expected_length:
+        raise ValueError(f"Invalid Get Planner Depth response length: expected {expected_length}, got {len(data)}")
+    if not verify_checksum(data):
+        raise ValueError("Invalid checksum")
+    message_type, body_size, depth, checksum = struct.unpack('<HHBH', data)
+    if message_type != MessageTypes.GET_PLANNER_DEPTH_ID or body_size != 1:
+        raise ValueError("Invalid Get Planner Depth response format")
+    return depth
+
+def parse_get_pvt_delay_response(data: bytes) -> int:
+    """
+    Parse a Get PVT Delay response message.
+    
+    Args:
+        data: Raw message bytes
+        
+    Returns:
+        Jitter buffer delay in microseconds as uint32_t
+    """
+    expected_length = 10
+    if len(data) != expected_length:
+        raise ValueError(f"Invalid Get PVT Delay response length: expected {expected_length}, got {len(data)}")
+    if not verify_checksum(data):
+        raise ValueError("Invalid checksum")
+    message_type, body_size, delay_us, checksum = struct.unpack('<HHIH', data)
+    if message_type != MessageTypes.GET_PVT_DELAY_ID or body_size != 4:
+        raise ValueError("Invalid Get PVT Delay response format")
+    return delay_us
+
+def parse_get_pvt_status_response(data: bytes) -> Tuple[int, int, int, int]:
+    """
+    Parse a Get PVT Status response message.
+    
+    Args:
+        data: Raw message bytes
+        
+    Returns:
+        Tuple of (buffered, capacity, underruns, overflows)
+    """
+    expected_length = 18
+    if len(data) != expected_length:
+        raise ValueError(f"Invalid Get PVT Status response length: expected {expected_length}, got {len(data)}")
+    if not verify_checksum(data):
+        raise ValueError("Invalid checksum")
+    message_type, body_size, buffered, capacity, underruns, overflows, checksum = struct.unpack('<HHHHIIH', data)
+    if message_type != MessageTypes.GET_PVT_STATUS_ID or body_size != 12:
+        raise ValueError("Invalid Get PVT Status response format")
+    return buffered, capacity, underruns, overflows
+
+def parse_get_closed_loop_response(data: bytes) -> bool:
+    """
+    Parse a Get Closed Loop response message.
+    
+    Args:
+        data: Raw message bytes
+        
+    Returns:
+        True when closed-loop correction is enabled
+    """
+    expected_length = 7
+    if len(data) != expected_length:
+        raise ValueError(f"Invalid Get Closed Loop response length: expected {expected_length}, got {len(data)}")
+    if not verify_checksum(data):
+        raise ValueError("Invalid checksum")
+    message_type, body_size, enabled, checksum = struct.unpack('<HHBH', data)
+    if message_type != MessageTypes.GET_CLOSED_LOOP_ID or body_size != 1:
+        raise ValueError("Invalid Get Closed Loop response format")
+    return enabled != 0
+
+def parse_get_closed_loop_gains_response(data: bytes) -> Tuple[float, float, float, float]:
+    """
+    Parse a Get Closed Loop Gains response message.
+    
+    Args:
+        data: Raw message bytes
+        
+    Returns:
+        Tuple of (p, i, d, limit)
+    """
+    expected_length = 22
+    if len(data) != expected_length:
+        raise ValueError(f"Invalid Get Closed Loop Gains response length: expected {expected_length}, got {len(data)}")
+    if not verify_checksum(data):
+        raise ValueError("Invalid checksum")
+    message_type, body_size, p, i, d, limit, checksum = struct.unpack('<HHffffH', data)
+    if message_type != MessageTypes.GET_CLOSED_LOOP_GAINS_ID or body_size != 16:
+        raise ValueError("Invalid Get Closed Loop Gains response format")
+    return p, i, d, limit
+
+def parse_get_closed_loop_status_response(data: bytes) -> Tuple[float, float, int]:
+    """
+    Parse a Get Closed Loop Status response message.
+    
+    Args:
+        data: Raw message bytes
+        
+    Returns:
+        Tuple of (error in steps, correction in steps/s, offset in steps)
+    """
+    expected_length = 18
+    if len(data) != expected_length:
+        raise ValueError(f"Invalid Get Closed Loop Status response length: expected {expected_length}, got {len(data)}")
+    if not verify_checksum(data):
+        raise ValueError("Invalid checksum")
+    message_type, body_size, error, correction, offset, checksum = struct.unpack('<HHffiH', data)
+    if message_type != MessageTypes.GET_CLOSED_LOOP_STATUS_ID or body_size != 12:
+        raise ValueError("Invalid Get Closed Loop Status response format")
+    return error, correction, offset
+
+def parse_get_stall_window_response(data: bytes) -> int:
+    """
+    Parse a Get Stall Window response message.
+    
+    Args:
+        data: Raw message bytes
+        
+    Returns:
+        Stall window in steps as uint32_t
+    """
+    expected_length = 10
+    if len(data) != expected_length:
+        raise ValueError(f"Invalid Get Stall Window response length: expected {expected_length}, got {len(data)}")
+    if not verify_checksum(data):
+        raise ValueError("Invalid checksum")
+    message_type, body_size, window, checksum = struct.unpack('<HHIH', data)
+    if message_type != MessageTypes.GET_STALL_WINDOW_ID or body_size != 4:
+        raise ValueError("Invalid Get Stall Window response format")
+    return window
+
+def parse_get_stall_action_response(data: bytes) -> StallAction:
+    """
+    Parse a Get Stall Action response message.
+    
+    Args:
+        data: Raw message bytes
+        
+    Returns:
+        StallAction enum value
+    """
+    expected_length = 7
+    if len(data) != expected_length:
+        raise ValueError(f"Invalid Get Stall Action response length: expected {expected_length}, got {len(data)}")
+    if not verify_checksum(data):
+        raise ValueError("Invalid checksum")
+    message_type, body_size, action, checksum = struct.unpack('<HHBH', data)
+    if message_type != MessageTypes.GET_STALL_ACTION_ID or body_size != 1:
+        raise ValueError("Invalid Get Stall Action response format")
+    return StallAction(action)
+
+def parse_get_following_error_response(data: bytes) -> Tuple[float, float, int]:
+    """
+    Parse a Get Following Error response message.
+    
+    Args:
+        data: Raw message bytes
+        
+    Returns:
+        Tuple of (error in steps, peak error in steps, stalls)
+    """
+    expected_length = 18
+    if len(data) != expected_length:
+        raise ValueError(f"Invalid Get Following Error response length: expected {expected_length}, got {len(data)}")
+    if not verify_checksum(data):
+        raise ValueError("Invalid checksum")
+    message_type, body_size, error, peak, stalls, checksum = struct.unpack('<HHffIH', data)
+    if message_type != MessageTypes.GET_FOLLOWING_ERROR_ID or body_size != 12:
+        raise ValueError("Invalid Get Following Error response format")
+    return error, peak, stalls
+
+def parse_get_motor_errors_response(data: bytes) -> int:
+    """
+    Parse a Get Motor Errors response message.
+    
+    Args:
+        data: Raw message bytes
+        
+    Returns:
+        Error bits as uint32_t, see MotorErrors
+    """
+    expected_length = 10
+    if len(data) != expected_length:
+        raise ValueError(f"Invalid Get Motor Errors response length: expected {expected_length}, got {len(data)}")
+    if not verify_checksum(data):
+        raise ValueError("Invalid checksum")
+    message_type, body_size, errors, checksum = struct.unpack('<HHIH', data)
+    if message_type != MessageTypes.GET_MOTOR_ERRORS_ID or body_size != 4:
+        raise ValueError("Invalid Get Motor Errors response format")
+    return errors
+
+def parse_get_profile_response(data: bytes) -> Tuple[int, int, int, int, int, int, List[int]]:
+    """
+    Parse a Get Profile response message.
+    
+    Args:
+        data: Raw message bytes
+        
+    Returns:
+        Tuple of (probe, clock_hz, count, min, max, mean, histogram), times in CPU cycles
+    """
+    expected_length = 91
+    if len(data) != expected_length:
+        raise ValueError(f"Invalid Get Profile response length: expected {expected_length}, got {len(data)}")
+    if not verify_checksum(data):
+        raise ValueError("Invalid checksum")
+    fields = struct.unpack('<HHBIIIII16IH', data)
+    message_type, body_size, probe, clock_hz, count, min_cycles, max_cycles, mean_cycles = fields[:8]
+    if message_type != MessageTypes.GET_PROFILE_ID or body_size != 85:
+        raise ValueError("Invalid Get Profile response format")
+    return probe, clock_hz, count, min_cycles, max_cycles, mean_cycles, list(fields[8:24])
+
+def parse_get_encoder_bus_stats_response(data: bytes) -> Tuple[int, int, int, int, int]:
+    """
+    Parse a Get Encoder Bus Stats response message.
+    
+    Args:
+        data: Raw message bytes
+        
+    Returns:
+        Tuple of (reads, errors, transfer_mean_us, transfer_max_us, foreground_mean_us)
+    """
+    expected_length = 26
+    if len(data) != expected_length:
+        raise ValueError(f"Invalid Get Encoder Bus Stats response length: expected {expected_length}, got {len(data)}")
+    if not verify_checksum(data):
+        raise ValueError("Invalid checksum")
+    message_type, body_size, reads, errors, transfer_mean_us, transfer_max_us, foreground_mean_us, checksum = struct.unpack('<HHIIIIIH', data)
+    if message_type != MessageTypes.GET_ENCODER_BUS_STATS_ID or body_size != 20:
+        raise ValueError("Invalid Get Encoder Bus Stats response format")
+    return reads, errors, transfer_mean_us, transfer_max_us, foreground_mean_us
+
+def parse_get_encoder_observer_response(data: bytes) -> Tuple[float, float, bool]:
+    """
+    Parse a Get Encoder Observer response message.
+    
+    Args:
+        data: Raw message bytes
+        
+    Returns:
+        Tuple of (alpha, beta, feed_forward)
+    """
+    expected_length = 15
+    if len(data) != expected_length:
+        raise ValueError(f"Invalid Get Encoder Observer response length: expected {expected_length}, got {len(data)}")
+    if not verify_checksum(data):
+        raise ValueError("Invalid checksum")
+    message_type, body_size, alpha, beta, feed_forward, checksum = struct.unpack('<HHffBH', data)
+    if message_type != MessageTypes.GET_ENCODER_OBSERVER_ID or body_size != 9:
+        raise ValueError("Invalid Get Encoder Observer response format")
+    return alpha, beta, feed_forward != 0
+
+def parse_get_encoder_calibration_response(data: bytes) -> Tuple[int, List[Tuple[int, int]], float]:
+    """
+    Parse a Get Encoder Calibration response message.
+    
+    Args:
+        data: Raw message bytes
+        
+    Returns:
+        Tuple of (state, [(cos_n, sin_n) for harmonics 1 to 4] in 1/65536 turn, residual in degrees)
+    """
+    expected_length = 27
+    if len(data) != expected_length:
+        raise ValueError(f"Invalid Get Encoder Calibration response length: expected {expected_length}, got {len(data)}")
+    if not verify_checksum(data):
+        raise ValueError("Invalid checksum")
+    fields = struct.unpack('<HHB8hfH', data)
+    message_type, body_size, state = fields[:3]
+    if message_type != MessageTypes.GET_ENCODER_CALIBRATION_ID or body_size != 21:
+        raise ValueError("Invalid Get Encoder Calibration response format")
+    coefficients = [(fields[3 + 2 * n], fields[4 + 2 * n]) for n in range(4)]
+    return state, coefficients, fields[11]
+
+def parse_get_scope_status_response(data: bytes) -> Tuple[int, int, int, int]:
+    """
+    Parse a Get Scope Status response message.
+    
+    Args:
+        data: Raw message bytes
+        
+    Returns:
+        Tuple of (state, count, trigger_index, period_us)
+    """
+    expected_length = 15
+    if len(data) != expected_length:
+        raise ValueError(f"Invalid Get Scope Status response length: expected {expected_length}, got {len(data)}")
+    if not verify_checksum(data):
+        raise ValueError("Invalid checksum")
+    message_type, body_size, state, count, trigger_index, period_us, checksum = struct.unpack('<HHBHHIH', data)
+    if message_type != MessageTypes.GET_SCOPE_STATUS_ID or body_size != 9:
+        raise ValueError("Invalid Get Scope Status response format")
+    return state, count, trigger_index, period_us
+
+def telemetry_frame_length(fields: TelemetryFields) -> int:
+    """Length of a Telemetry frame carrying `fields`, in bytes."""
+    values = ''.join(fmt for field, fmt in TELEMETRY_FIELD_FORMATS if fields & field)
+    return 16 + struct.calcsize('<' + values)
+
+def parse_telemetry_frame(data: bytes) -> Tuple[int, int, Dict[str, float]]:
+    """
+    Parse a Telemetry frame pushed for a subscription.
+    
+    Args:
+        data: Raw message bytes
+        
+    Returns:
+        Tuple of (sequence, time_ms, values), values keyed by TelemetryFields name
+    """
+    if len(data) < 16 or not verify_checksum(data):
+        raise ValueError("Invalid Telemetry frame")
+    message_type, body_size, sequence, time_ms, fields = struct.unpack('<HHIIH', data[:14])
+    if message_type != MessageTypes.TELEMETRY_ID or len(data) != telemetry_frame_length(fields) or body_size != len(data) - 6:
+        raise ValueError("Invalid Telemetry frame format")
+    values = {}
+    offset = 14
+    for field, fmt in TELEMETRY_FIELD_FORMATS:
+        if fields & field:
+            values[field.name] = struct.unpack_from('<' + fmt, data, offset)[0]
+            offset += struct.calcsize(fmt)
+    return sequence, time_ms, values
+
+SCOPE_SAMPLE_FORMAT = '<IifffH'
+SCOPE_SAMPLE_SIZE = 22
+SCOPE_CHUNK_SAMPLES = 32
+
+def parse_get_scope_data_response(data: bytes) -> Tuple[int, List[Tuple[int, int, float, float, float, int]]]:
+    """
+    Parse a Get Scope Data response message.
+    
+    Args:
+        data: Raw message bytes
+        
+    Returns:
+        Tuple of (first, samples), each sample a tuple of (time_us, commanded_position,
+        encoder_position, commanded_velocity, encoder_velocity, status)
+    """
+    expected_length = 713
+    if len(data) != expected_length:
+        raise ValueError(f"Invalid Get Scope Data response length: expected {expected_length}, got {len(data)}")
+    if not verify_checksum(data):
+        raise ValueError("Invalid checksum")
+    message_type, body_size, first, count = struct.unpack('<HHHB', data[:7])
+    if message_type != MessageTypes.GET_SCOPE_DATA_ID or body_size != 707 or count > SCOPE_CHUNK_SAMPLES:
+        raise ValueError("Invalid Get Scope Data response format")
+    samples = [struct.unpack_from(SCOPE_SAMPLE_FORMAT, data, 7 + i * SCOPE_SAMPLE_SIZE) for i in range(count)]
+    return first, samples
+
+def parse_get_checksum_mode_response(data: bytes) -> ChecksumMode:
+    """
+    Parse a Get Checksum Mode response message.
+    
+    Args:
+        data: Raw message bytes
+        
+    Returns:
+        Footer in use on the interface the request came in on
+    """
+    expected_length = 7
+    if len(data) != expected_length:
+        raise ValueError(f"Invalid Get Checksum Mode response length: expected {expected_length}, got {len(data)}")
+    if not verify_checksum(data):
+        raise ValueError("Invalid checksum")
+    message_type, body_size, mode, checksum = struct.unpack('<HHBH', data)
+    if message_type != MessageTypes.GET_CHECKSUM_MODE_ID or body_size != 1:
+        raise ValueError("Invalid Get Checksum Mode response format")
+    return ChecksumMode(mode)
+
+def parse_get_rejected_frames_response(data: bytes) -> Tuple[int, int, int, int]:
+    """
+    Parse a Get Rejected Frames response message.
+    
+    Args:
+        data: Raw message bytes
+        
+    Returns:
+        Tuple of (truncated, checksum, unknown_type, body_size) counts since power up
+    """
+    expected_length = 22
+    if len(data) != expected_length:
+        raise ValueError(f"Invalid Get Rejected Frames response length: expected {expected_length}, got {len(data)}")
+    if not verify_checksum(data):
+        raise ValueError("Invalid checksum")
+    message_type, body_size, truncated, checksum_errors, unknown_type, wrong_size, checksum = struct.unpack('<HHIIIIH', data)
+    if message_type != MessageTypes.GET_REJECTED_FRAMES_ID or body_size != 16:
+        raise ValueError("Invalid Get Rejected Frames response format")
+    return truncated, checksum_errors, unknown_type, wrong_size
+
 # Utility functions for parsing responses
 
 def parse_message_header(data: bytes) -> Tuple[int, int]:
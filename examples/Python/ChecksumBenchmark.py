@@ -0,0 +1,97 @@
+#!/usr/bin/env python3
+"""
+Footer checksum throughput of an Axis Driver
+
+Switches the UDP interface to each checksum mode in turn and sends frames of
+a type the device doesn't know. Each is checksummed before it is rejected,
+the CHECKSUM profiler probe times that, and the mean gives the bytes per
+microsecond the device verifies. The interface is left in the mode it started
+in, SUM.
+
+Usage:
+    python ChecksumBenchmark.py 192.168.1.222
+    python ChecksumBenchmark.py 192.168.1.222 --frames 500 --sizes 16 256 1000
+"""
+
+import argparse
+import sys
+
+from Axis import AxisUDP
+from AxisProtocol import (
+    SetChecksumModeMessage, GetChecksumModeMessage, GetRejectedFramesMessage,
+    GetProfileMessage, ResetProfileMessage, ChecksumMode, ProfileProbe, MessageTypes,
+    create_message, set_checksum_mode, parse_ack_message, parse_get_checksum_mode_response,
+    parse_get_rejected_frames_response, parse_get_profile_response
+)
+
+# Not a message the device handles, rejected right after the checksum
+BENCHMARK_TYPE = 0x03FF
+
+# Largest frame the UDP receive buffer holds
+MAX_FRAME = 1024
+
+
+def switch_mode(axis: AxisUDP, mode: ChecksumMode):
+    # Acknowledged in the old mode, the host switches once it has the ACK
+    _, status = parse_ack_message(axis.request(SetChecksumModeMessage(mode), MessageTypes.ACK_ID))
+    if status != 0:
+        raise RuntimeError(f"Set Checksum Mode rejected: {status.name}")
+    set_checksum_mode(mode)
+    if parse_get_checksum_mode_response(axis.request(GetChecksumModeMessage(),
+                                                     MessageTypes.GET_CHECKSUM_MODE_ID)) != mode:
+        raise RuntimeError(f"Device didn't switch to {mode.name}")
+
+
+def measure(axis: AxisUDP, size: int, frames: int):
+    """Mean cycles to verify a `size` byte frame, and the CPU clock."""
+    axis.request(ResetProfileMessage(), MessageTypes.ACK_ID)
+    msg = create_message(BENCHMARK_TYPE, bytes(i & 0xFF for i in range(size - 6)))
+    for _ in range(frames):
+        axis.send_message(msg)
+        # Rejected with INVALID_COMMAND, waiting for it paces the frames
+        axis.wait_message(timeout=1)
+    _, clock_hz, count, _, _, mean_cycles, _ = parse_get_profile_response(
+        axis.request(GetProfileMessage(ProfileProbe.CHECKSUM), MessageTypes.GET_PROFILE_ID))
+    # The count includes the profile request, one short frame among many
+    if count < frames:
+        raise RuntimeError(f"Only {count} of {frames} frames reached the checksum")
+    return mean_cycles, clock_hz
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Measure the footer checksum throughput of an Axis Driver")
+    parser.add_argument('ip', help="Device IP address")
+    parser.add_argument('--port', type=int, default=8080, help="Device UDP port")
+    parser.add_argument('--frames', type=int, default=200, help="Frames per size and mode")
+    parser.add_argument('--sizes', type=int, nargs='+', default=[16, 64, 256, 1000],
+                        help=f"Frame sizes, header and footer included, 6 to {MAX_FRAME}")
+    args = parser.parse_args()
+    if any(size < 6 or size > MAX_FRAME for size in args.sizes):
+        parser.error(f"Frame sizes must be 6 to {MAX_FRAME}")
+
+    axis = AxisUDP(args.ip, args.port)
+    try:
+        print(f"{'mode':>6} {'bytes':>6} {'cycles':>8} {'bytes/us':>9}")
+        for mode in (ChecksumMode.SUM, ChecksumMode.CRC16):
+            switch_mode(axis, mode)
+            for size in args.sizes:
+                mean_cycles, clock_hz = measure(axis, size, args.frames)
+                us = mean_cycles / clock_hz * 1e6
+                print(f"{mode.name:>6} {size:>6} {mean_cycles:>8} {size / us if us else 0:>9.1f}")
+        truncated, checksum, unknown_type, body_size = parse_get_rejected_frames_response(
+            axis.request(GetRejectedFramesMessage(), MessageTypes.GET_REJECTED_FRAMES_ID))
+        print(f"Rejected since power up: {truncated} truncated, {checksum} checksum, "
+              f"{unknown_type} unknown type, {body_size} body size")
+    except (RuntimeError, TimeoutError, ValueError) as e:
+        print(f"Error: {e}")
+        return 1
+    finally:
+        try:
+            switch_mode(axis, ChecksumMode.SUM)
+        except (RuntimeError, TimeoutError, ValueError):
+            pass
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
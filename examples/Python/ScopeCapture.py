@@ -0,0 +1,104 @@
+#!/usr/bin/env python3
+"""
+Scope capture download for Axis Driver
+
+Arms a scope capture over UDP, waits for it to finish and writes the samples
+to a CSV file, one row per sample with the time relative to the trigger.
+
+Usage:
+    python ScopeCapture.py 192.168.1.222 --trigger MOVE_START --pre 64 -o move.csv
+    python ScopeCapture.py 192.168.1.222 --trigger RISING --channel FOLLOWING_ERROR --level 20
+"""
+
+import argparse
+import csv
+import sys
+import time
+
+from Axis import AxisUDP
+from AxisProtocol import (
+    ArmScopeMessage, StopScopeMessage, GetScopeStatusMessage, GetScopeDataMessage,
+    ScopeTrigger, ScopeChannel, ScopeState, MotorStates, MessageTypes,
+    SCOPE_CHUNK_SAMPLES,
+    parse_ack_message, parse_get_scope_status_response, parse_get_scope_data_response
+)
+
+CSV_COLUMNS = ['time_ms', 'commanded_position', 'encoder_position', 'following_error',
+               'commanded_velocity', 'encoder_velocity', 'motor_state', 'step_engine',
+               'closed_loop', 'errors']
+
+
+def capture(axis: AxisUDP, args):
+    ack = axis.request(ArmScopeMessage(args.period, ScopeTrigger[args.trigger], ScopeChannel[args.channel],
+                                   args.level, args.pre), MessageTypes.ACK_ID)
+    _, status = parse_ack_message(ack)
+    if status != 0:
+        raise RuntimeError(f"Arm Scope rejected: {status.name}")
+    print(f"Armed, waiting for {args.trigger}...")
+
+    deadline = time.time() + args.timeout
+    while True:
+        state, count, trigger_index, period_us = parse_get_scope_status_response(
+            axis.request(GetScopeStatusMessage(), MessageTypes.GET_SCOPE_STATUS_ID))
+        if state == ScopeState.DONE:
+            break
+        if time.time() > deadline:
+            axis.send_message(StopScopeMessage())
+            raise TimeoutError(f"Capture not done after {args.timeout}s, state {ScopeState(state).name}")
+        time.sleep(0.05)
+
+    samples = []
+    for first in range(0, count, SCOPE_CHUNK_SAMPLES):
+        chunk_first, chunk = parse_get_scope_data_response(
+            axis.request(GetScopeDataMessage(first), MessageTypes.GET_SCOPE_DATA_ID))
+        if chunk_first != first:
+            raise RuntimeError(f"Asked for sample {first}, got {chunk_first}")
+        samples.extend(chunk)
+    print(f"Downloaded {len(samples)} samples, trigger at {trigger_index}, period {period_us}us")
+    return samples, trigger_index
+
+
+def write_csv(path: str, samples: list, trigger_index: int):
+    trigger_us = samples[trigger_index][0]
+    with open(path, 'w', newline='') as f:
+        writer = csv.writer(f)
+        writer.writerow(CSV_COLUMNS)
+        for time_us, commanded, encoder, commanded_velocity, encoder_velocity, status in samples:
+            # Timestamps wrap at 32 bits
+            dt_us = (time_us - trigger_us + 0x80000000) % 0x100000000 - 0x80000000
+            state = status & 0x0F
+            writer.writerow([
+                f"{dt_us / 1000:.3f}", commanded, f"{encoder:.2f}", f"{commanded - encoder:.2f}",
+                f"{commanded_velocity:.1f}", f"{encoder_velocity:.1f}",
+                MotorStates(state).name if state in MotorStates._value2member_map_ else state,
+                (status >> 4) & 1, (status >> 5) & 1, status >> 8
+            ])
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Capture and download an Axis Driver scope trace as CSV")
+    parser.add_argument('ip', help="Device IP address")
+    parser.add_argument('--port', type=int, default=8080, help="Device UDP port")
+    parser.add_argument('--period', type=int, default=1000, help="Sample period, us")
+    parser.add_argument('--trigger', choices=[t.name for t in ScopeTrigger], default='IMMEDIATE')
+    parser.add_argument('--channel', choices=[c.name for c in ScopeChannel], default='COMMANDED_POSITION',
+                        help="Channel for the RISING and FALLING triggers")
+    parser.add_argument('--level', type=float, default=0.0, help="Trigger level, steps or steps/s")
+    parser.add_argument('--pre', type=int, default=0, help="Samples to keep from before the trigger")
+    parser.add_argument('--timeout', type=float, default=30.0, help="Seconds to wait for the capture")
+    parser.add_argument('-o', '--output', default='scope.csv', help="CSV file to write")
+    args = parser.parse_args()
+
+    axis = AxisUDP(args.ip, args.port)
+    try:
+        samples, trigger_index = capture(axis, args)
+    except (RuntimeError, TimeoutError, ValueError) as e:
+        print(f"Error: {e}")
+        return 1
+    write_csv(args.output, samples, trigger_index)
+    print(f"Wrote {args.output}")
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
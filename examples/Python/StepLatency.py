@@ -0,0 +1,85 @@
+#!/usr/bin/env python3
+"""
+Step interrupt latency of an Axis Driver under UDP load
+
+Resets the profiler, keeps requests in flight over UDP for a while and reads
+back how late the step interrupt started after its timer overflow (the
+STEP_LATENCY probe) and how long the Ethernet interrupt ran. The spread of the
+latency is the step timing jitter; run once with --requests 0 for the
+baseline without traffic. STEP_LATENCY is only recorded by firmware built with
+PROFILER_STEP_LATENCY defined in Profiler.h. Firmware without it still shows
+the Ethernet interrupt time, which was how long each packet held the step
+interrupt up when packets were handled in the interrupt.
+
+Usage:
+    python StepLatency.py 192.168.1.222
+    python StepLatency.py 192.168.1.222 --seconds 10 --requests 0
+"""
+
+import argparse
+import sys
+import time
+
+from Axis import AxisUDP
+from AxisProtocol import (
+    GetProfileMessage, ResetProfileMessage, GetMotorStateMessage, ProfileProbe, MessageTypes,
+    parse_get_profile_response
+)
+
+
+def print_probe(axis: AxisUDP, probe: ProfileProbe):
+    try:
+        _, clock_hz, count, min_cycles, max_cycles, mean_cycles, histogram = parse_get_profile_response(
+            axis.request(GetProfileMessage(probe), MessageTypes.GET_PROFILE_ID))
+    except RuntimeError:
+        print(f"{probe.name}: not in this firmware")
+        return
+    us = 1e6 / clock_hz
+    print(f"{probe.name}: {count} runs, min {min_cycles * us:.2f}us, mean {mean_cycles * us:.2f}us, "
+          f"max {max_cycles * us:.2f}us")
+    # Bin 0 is under 64 cycles, bin n from 2^(n+5) cycles
+    for i, runs in enumerate(histogram):
+        if runs:
+            low = 0 if i == 0 else (1 << (i + 5)) * us
+            print(f"  >= {low:8.2f}us: {runs}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Measure the step interrupt latency of an Axis Driver under UDP load")
+    parser.add_argument('ip', help="Device IP address")
+    parser.add_argument('--port', type=int, default=8080, help="Device UDP port")
+    parser.add_argument('--seconds', type=float, default=5.0, help="How long to keep the load up")
+    parser.add_argument('--requests', type=int, default=8,
+                        help="Requests sent back to back before reading the replies, 0 for no load")
+    args = parser.parse_args()
+
+    axis = AxisUDP(args.ip, args.port)
+    try:
+        axis.request(ResetProfileMessage(), MessageTypes.ACK_ID)
+        sent = 0
+        deadline = time.time() + args.seconds
+        while time.time() < deadline:
+            if args.requests == 0:
+                time.sleep(0.1)
+                continue
+            # Plain requests, so older firmware can be compared too
+            for _ in range(args.requests):
+                axis.send_message(GetMotorStateMessage())
+            sent += args.requests
+            for _ in range(args.requests):
+                if axis.wait_message(timeout=0.2) is None:
+                    break
+        # Late replies would be taken for the profile's
+        while args.requests and axis.wait_message(timeout=0.2) is not None:
+            pass
+        print(f"{sent} requests in {args.seconds:.1f}s")
+        print_probe(axis, ProfileProbe.STEP_LATENCY)
+        print_probe(axis, ProfileProbe.ETHERNET_ISR)
+    except (RuntimeError, TimeoutError, ValueError) as e:
+        print(f"Error: {e}")
+        return 1
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -18,6 +18,7 @@ Make sure to update the DEVICE_IP and DEVICE_PORT constants below to match your
 
 import time
 import sys
+import math
 import struct
 import threading
 from typing import Optional
@@ -32,6 +33,7 @@ from AxisProtocol import (
     SetTargetPositionMessage, GetTargetPositionMessage,
     SetRelativeTargetPositionMessage, HomeMessage, GetHomedStateMessage,
     SetLedColorMessage, SaveConfigurationMessage,
+    AddPvtPointMessage, SetPvtDelayMessage, GetPvtStatusMessage,
     
     # Enums and constants
     MotorStates, MESSAGE_LENGTHS, MessageTypes,
@@ -40,6 +42,7 @@ from AxisProtocol import (
     parse_get_current_position_response, parse_get_target_position_response,
     parse_get_motor_state_response, parse_get_max_speed_response,
     parse_get_acceleration_response, parse_get_homed_state_response,
+    parse_get_pvt_status_response,
     parse_ack_message, verify_checksum
 )
 
@@ -52,6 +55,7 @@ POSITION_TOLERANCE = 0.5     # Degrees tolerance for position verification
 COMMAND_TIMEOUT = 3.0        # Timeout for commands in seconds
 MOVEMENT_TIMEOUT = 5.0       # Timeout for movement completion in seconds
 MAX_RETRIES = 3              # Maximum number of retries for failed commands
+STEPS_PER_DEGREE = 8 * 200 / 360
 
 
 class PositionControlTest:
@@ -430,6 +434,62 @@ class PositionControlTest:
         
         return True
     
+    def test_pvt_streaming(self) -> bool:
+        """Test a smooth trajectory streamed as PVT points instead of position targets."""
+        print("Testing PVT streaming...")
+        
+        amplitude = 90.0        # Degrees, out and back
+        duration = 2.0          # Seconds
+        point_interval = 0.02   # 50 points per second
+        
+        msg = SetPvtDelayMessage(50000)
+        if not self._send_command_with_ack(msg, "Set PVT Delay"):
+            return False
+        
+        response = self._send_query_command(GetPvtStatusMessage(), MESSAGE_LENGTHS[MessageTypes.GET_PVT_STATUS_ID], "Get PVT Status")
+        response_pos = self._send_query_command(GetCurrentPositionMessage(), MESSAGE_LENGTHS[MessageTypes.GET_CURRENT_POSITION_ID], "Get Initial Position")
+        if not response or not response_pos:
+            return False
+        try:
+            _, _, underruns_before, _ = parse_get_pvt_status_response(response)
+            initial_pos = parse_get_current_position_response(response_pos)
+        except Exception as e:
+            print(f"  Error parsing initial state: {e}")
+            return False
+        
+        # 1 - cos starts and ends at rest, the firmware splines between points
+        w = 2 * math.pi / duration
+        start_time = time.time()
+        for i in range(int(duration / point_interval) + 1):
+            t = i * point_interval
+            delay = start_time + t - time.time()
+            if delay > 0:
+                time.sleep(delay)  # Send points in real time, like a live trajectory
+            position = amplitude * (1 - math.cos(w * t)) / 2
+            velocity = amplitude * w * math.sin(w * t) / 2
+            msg = AddPvtPointMessage(int(t * 1000000),
+                                     round((initial_pos + position) * STEPS_PER_DEGREE),
+                                     round(velocity * STEPS_PER_DEGREE))
+            # A resent point would be rejected as not after the previous one
+            if not self._send_command_with_ack(msg, f"Add PVT Point {i}", retries=1):
+                return False
+        
+        time.sleep(0.5)  # Jitter buffer delay plus the last segment
+        response = self._send_query_command(GetPvtStatusMessage(), MESSAGE_LENGTHS[MessageTypes.GET_PVT_STATUS_ID], "Get PVT Status")
+        response_pos = self._send_query_command(GetCurrentPositionMessage(), MESSAGE_LENGTHS[MessageTypes.GET_CURRENT_POSITION_ID], "Get Final Position")
+        if not response or not response_pos:
+            return False
+        try:
+            buffered, capacity, underruns, overflows = parse_get_pvt_status_response(response)
+            final_pos = parse_get_current_position_response(response_pos)
+        except Exception as e:
+            print(f"  Error parsing final state: {e}")
+            return False
+        
+        print(f"  Buffered: {buffered}/{capacity} | Underruns: {underruns - underruns_before} | Overflows: {overflows}")
+        print(f"  Start: {initial_pos:.2f}° | End: {final_pos:.2f}°")
+        return underruns == underruns_before and abs(final_pos - initial_pos) < POSITION_TOLERANCE
+    
     def test_visual_feedback(self) -> bool:
         """Test visual feedback using LED during positioning."""
         print("Testing LED feedback during positioning...")
@@ -500,6 +560,7 @@ class PositionControlTest:
             (self.test_absolute_positioning, "Absolute Positioning"),
             (self.test_relative_positioning, "Relative Positioning"),
             (self.test_position_readback, "Position Readback Accuracy"),
+            (self.test_pvt_streaming, "PVT Streaming"),
             (self.test_visual_feedback, "Visual LED Feedback"),
             (self.test_save_configuration, "Save Configuration"),
         ]
@@ -10,9 +10,16 @@ typedef void (*SendMsgPtrType)(uint8_t *send_bytes, uint32_t send_bytes_size);
 class IEncoderInterface
 {
 public:
-    virtual float GetVelocityDegreesPerSecond();
-    virtual float GetPositionDegrees();
-	virtual float GetUpdateRate();
+    virtual float GetVelocityDegreesPerSecond() = 0;
+    virtual float GetPositionDegrees() = 0;
+	virtual float GetUpdateRate() = 0;
+    // Commanded shaft velocity, for encoders that can use it
+    virtual void SetCommandedVelocity(float /*degrees_per_second*/) {}
+    // Calibration run: samples against the angle the motor was commanded to,
+    // relative to where the run started
+    virtual void BeginCalibration() {}
+    virtual void AddCalibrationSample(float /*reference_degrees*/) {}
+    virtual bool FinishCalibration() { return false; }
 };
 enum class MessageTypes : uint16_t
 {
@@ -52,6 +59,47 @@ enum class MessageTypes : uint16_t
 	SetRelativeTargetPositionId = 0x0401,
 	SetVelocityId = 0x0313,
 	GetVelocityId = 0x0314,
+	GetMotionQueueStatusId = 0x0315,
+	SetMotionProfileId = 0x0316,
+	GetMotionProfileId = 0x0317,
+	SetJerkId = 0x0318,
+	GetJerkId = 0x0319,
+	SetPlannerDepthId = 0x031A,
+	GetPlannerDepthId = 0x031B,
+	AddPvtPointId = 0x031C,
+	SetPvtDelayId = 0x031D,
+	GetPvtDelayId = 0x031E,
+	GetPvtStatusId = 0x031F,
+	SetClosedLoopId = 0x0320,
+	GetClosedLoopId = 0x0321,
+	SetClosedLoopGainsId = 0x0322,
+	GetClosedLoopGainsId = 0x0323,
+	GetClosedLoopStatusId = 0x0324,
+	SetStallWindowId = 0x0325,
+	GetStallWindowId = 0x0326,
+	SetStallActionId = 0x0327,
+	GetStallActionId = 0x0328,
+	GetFollowingErrorId = 0x0329,
+	GetMotorErrorsId = 0x032A,
+	ClearMotorErrorsId = 0x032B,
+	GetProfileId = 0x032C,
+	ResetProfileId = 0x032D,
+	GetEncoderBusStatsId = 0x032E,
+	SetEncoderObserverId = 0x032F,
+	GetEncoderObserverId = 0x0330,
+	CalibrateEncoderId = 0x0331,
+	GetEncoderCalibrationId = 0x0332,
+	ClearEncoderCalibrationId = 0x0333,
+	ArmScopeId = 0x0334,
+	StopScopeId = 0x0335,
+	GetScopeStatusId = 0x0336,
+	GetScopeDataId = 0x0337,
+	SubscribeTelemetryId = 0x0338,
+	TelemetryId = 0x0339,
+	SetChecksumModeId = 0x033A,
+	GetChecksumModeId = 0x033B,
+	GetRejectedFramesId = 0x033C,
+	BatchId = 0x033D,
 	SetVelocityAndStepsId = 0x0402,
 	StartPathId = 0x0403,
 };
@@ -79,6 +127,8 @@ enum class MotorStates{
 	VELOCITY_STEP = 0x3,
 	IDLE_ON = 0x4,
 	HOME = 0x5,
+	PVT = 0x6,
+	CALIBRATE = 0x7,
 };
 
 enum class MotorBrake{
@@ -98,11 +148,80 @@ enum class PositionMode{
 	RELATIVE = 0x1,
 };
 
+enum class MotionProfile{
+	TRAPEZOIDAL = 0x0,
+	S_CURVE = 0x1,
+};
+
+enum class StallAction{
+	REPORT = 0x0,
+	STOP = 0x1,
+	RESYNC = 0x2,
+};
+
+// Telemetry frame fields, values follow in bit order
+enum class TelemetryFields : uint16_t{
+	POSITION = 0x001,         // float, degrees
+	TARGET_POSITION = 0x002,  // float, degrees
+	VELOCITY = 0x004,         // float, target velocity
+	MOTOR_STATE = 0x008,      // uint8_t
+	HOMED = 0x010,            // uint8_t
+	ENCODER_POSITION = 0x020, // float, degrees
+	ENCODER_VELOCITY = 0x040, // float, degrees/s
+	FOLLOWING_ERROR = 0x080,  // float, steps
+	ERRORS = 0x100,           // uint32_t, motor error bits
+	ALL = 0x1FF,
+};
+
+// Footer checksum, per interface
+enum class ChecksumMode : uint8_t{
+	SUM = 0x0,   // 16-bit sum of the bytes
+	CRC16 = 0x1, // CRC-16/CCITT-FALSE
+};
+
+enum class ScopeTrigger{
+	IMMEDIATE = 0x0,
+	MOVE_START = 0x1,
+	ERROR = 0x2,
+	RISING = 0x3,
+	FALLING = 0x4,
+};
+
+enum class ScopeChannel{
+	COMMANDED_POSITION = 0x0,
+	ENCODER_POSITION = 0x1,
+	FOLLOWING_ERROR = 0x2,
+	COMMANDED_VELOCITY = 0x3,
+	ENCODER_VELOCITY = 0x4,
+};
+
+enum class ScopeState{
+	IDLE = 0x0,
+	ARMED = 0x1,
+	TRIGGERED = 0x2,
+	DONE = 0x3,
+};
+
+// One scope capture sample, see ScopeCapture. Positions in steps, velocities
+// in steps/s.
+PACKEDSTRUCT ScopeSample
+{
+	uint32_t time_us;
+	int32_t commanded_position;
+	float encoder_position;
+	float commanded_velocity;
+	float encoder_velocity;
+	uint16_t status; // bits 0-3 motor state, 4 step engine move, 5 closed loop, 8-15 motor errors
+};
+
 PACKEDSTRUCT Header
 {
 	uint16_t message_type;
 	uint16_t body_size;
 };
+// Set in message_type when a uint16_t request id follows the body, counted
+// in body_size. Replies to such a request carry the same id.
+#define REQUEST_ID_FLAG 0x8000
 PACKEDSTRUCT Footer
 {
 	uint16_t checksum;
@@ -192,6 +311,170 @@ PACKEDSTRUCT VelocityAndStepsMessage
 	Footer footer;
 };
 typedef U8Message StartPathMessage;
+PACKEDSTRUCT MotionQueueStatusMessage
+{
+	Header header;
+	uint16_t depth;
+	uint16_t capacity;
+	uint16_t high_water;
+	uint32_t overflows;
+	Footer footer;
+};
+typedef U8Message MotionProfileMessage;
+typedef U32Message JerkMessage;
+typedef U8Message PlannerDepthMessage;
+PACKEDSTRUCT PvtPointMessage
+{
+	Header header;
+	uint32_t time_us;
+	int32_t position;
+	int32_t velocity;
+	Footer footer;
+};
+typedef U32Message PvtDelayMessage;
+PACKEDSTRUCT PvtStatusMessage
+{
+	Header header;
+	uint16_t buffered;
+	uint16_t capacity;
+	uint32_t underruns;
+	uint32_t overflows;
+	Footer footer;
+};
+typedef U8Message ClosedLoopMessage;
+PACKEDSTRUCT ClosedLoopGainsMessage
+{
+	Header header;
+	float p;
+	float i;
+	float d;
+	float limit;
+	Footer footer;
+};
+PACKEDSTRUCT ClosedLoopStatusMessage
+{
+	Header header;
+	float error;
+	float correction;
+	int32_t offset;
+	Footer footer;
+};
+typedef U32Message StallWindowMessage;
+typedef U8Message StallActionMessage;
+PACKEDSTRUCT FollowingErrorMessage
+{
+	Header header;
+	float error;
+	float peak;
+	uint32_t stalls;
+	Footer footer;
+};
+typedef U32Message MotorErrorsMessage;
+typedef U8Message ProfileRequestMessage;
+PACKEDSTRUCT ProfileMessage
+{
+	Header header;
+	uint8_t probe;
+	uint32_t clock_hz;
+	uint32_t count;
+	uint32_t min;
+	uint32_t max;
+	uint32_t mean;
+	uint32_t histogram[16];
+	Footer footer;
+};
+PACKEDSTRUCT EncoderBusStatsMessage
+{
+	Header header;
+	uint32_t reads;
+	uint32_t errors;
+	uint32_t transfer_mean_us;
+	uint32_t transfer_max_us;
+	uint32_t foreground_mean_us;
+	Footer footer;
+};
+PACKEDSTRUCT EncoderObserverMessage
+{
+	Header header;
+	float alpha;
+	float beta;
+	uint8_t feed_forward;
+	Footer footer;
+};
+PACKEDSTRUCT EncoderCalibrationMessage
+{
+	Header header;
+	uint8_t state;
+	int16_t coefficients[4][2];
+	float residual;
+	Footer footer;
+};
+PACKEDSTRUCT ArmScopeMessage
+{
+	Header header;
+	uint32_t period_us;
+	uint8_t trigger;
+	uint8_t channel;
+	float level;
+	uint16_t pre_trigger;
+	Footer footer;
+};
+PACKEDSTRUCT ScopeStatusMessage
+{
+	Header header;
+	uint8_t state;
+	uint16_t count;
+	uint16_t trigger_index;
+	uint32_t period_us;
+	Footer footer;
+};
+PACKEDSTRUCT ScopeDataRequestMessage
+{
+	Header header;
+	uint16_t first;
+	Footer footer;
+};
+PACKEDSTRUCT TelemetrySubscriptionMessage
+{
+	Header header;
+	uint16_t fields;
+	uint16_t period_ms;
+	Footer footer;
+};
+// Followed by the values of `fields` and a Footer
+PACKEDSTRUCT TelemetryHeader
+{
+	Header header;
+	uint32_t sequence;
+	uint32_t time_ms;
+	uint16_t fields;
+};
+PACKEDSTRUCT ScopeDataMessage
+{
+	Header header;
+	uint16_t first;
+	uint8_t count;
+	ScopeSample samples[32];
+	Footer footer;
+};
+typedef U8Message ChecksumModeMessage;
+PACKEDSTRUCT RejectedFramesMessage
+{
+	Header header;
+	uint32_t truncated;
+	uint32_t checksum;
+	uint32_t unknown_type;
+	uint32_t body_size;
+	Footer footer;
+};
+// Batch requests have a variable body, see BatchId in AxisProtocol.md
+PACKEDSTRUCT BatchResultMessage
+{
+	Header header;
+	uint8_t count;      // commands run
+	uint8_t status[16]; // StatusCodes of the commands run, in order
+	Footer footer;
+};
 
 
 // Message length definitions (in bytes)
@@ -219,3 +502,30 @@ const size_t RELATIVE_TARGET_POSITION_MESSAGE_LENGTH = sizeof(RelativeTargetPosi
 const size_t VELOCITY_MESSAGE_LENGTH = sizeof(VelocityMessage);
 const size_t VELOCITY_AND_STEPS_MESSAGE_LENGTH = sizeof(VelocityAndStepsMessage);
 const size_t START_PATH_MESSAGE_LENGTH = sizeof(StartPathMessage);
+const size_t MOTION_QUEUE_STATUS_MESSAGE_LENGTH = sizeof(MotionQueueStatusMessage);
+const size_t MOTION_PROFILE_MESSAGE_LENGTH = sizeof(MotionProfileMessage);
+const size_t JERK_MESSAGE_LENGTH = sizeof(JerkMessage);
+const size_t PLANNER_DEPTH_MESSAGE_LENGTH = sizeof(PlannerDepthMessage);
+const size_t PVT_POINT_MESSAGE_LENGTH = sizeof(PvtPointMessage);
+const size_t PVT_DELAY_MESSAGE_LENGTH = sizeof(PvtDelayMessage);
+const size_t PVT_STATUS_MESSAGE_LENGTH = sizeof(PvtStatusMessage);
+const size_t CLOSED_LOOP_MESSAGE_LENGTH = sizeof(ClosedLoopMessage);
+const size_t CLOSED_LOOP_GAINS_MESSAGE_LENGTH = sizeof(ClosedLoopGainsMessage);
+const size_t CLOSED_LOOP_STATUS_MESSAGE_LENGTH = sizeof(ClosedLoopStatusMessage);
+const size_t STALL_WINDOW_MESSAGE_LENGTH = sizeof(StallWindowMessage);
+const size_t STALL_ACTION_MESSAGE_LENGTH = sizeof(StallActionMessage);
+const size_t FOLLOWING_ERROR_MESSAGE_LENGTH = sizeof(FollowingErrorMessage);
+const size_t MOTOR_ERRORS_MESSAGE_LENGTH = sizeof(MotorErrorsMessage);
+const size_t PROFILE_REQUEST_MESSAGE_LENGTH = sizeof(ProfileRequestMessage);
+const size_t PROFILE_MESSAGE_LENGTH = sizeof(ProfileMessage);
+const size_t ENCODER_BUS_STATS_MESSAGE_LENGTH = sizeof(EncoderBusStatsMessage);
+const size_t ENCODER_OBSERVER_MESSAGE_LENGTH = sizeof(EncoderObserverMessage);
+const size_t ENCODER_CALIBRATION_MESSAGE_LENGTH = sizeof(EncoderCalibrationMessage);
+const size_t ARM_SCOPE_MESSAGE_LENGTH = sizeof(ArmScopeMessage);
+const size_t SCOPE_STATUS_MESSAGE_LENGTH = sizeof(ScopeStatusMessage);
+const size_t SCOPE_DATA_REQUEST_MESSAGE_LENGTH = sizeof(ScopeDataRequestMessage);
+const size_t SCOPE_DATA_MESSAGE_LENGTH = sizeof(ScopeDataMessage);
+const size_t TELEMETRY_SUBSCRIPTION_MESSAGE_LENGTH = sizeof(TelemetrySubscriptionMessage);
+const size_t CHECKSUM_MODE_MESSAGE_LENGTH = sizeof(ChecksumModeMessage);
+const size_t REJECTED_FRAMES_MESSAGE_LENGTH = sizeof(RejectedFramesMessage);
+const size_t BATCH_RESULT_MESSAGE_LENGTH = sizeof(BatchResultMessage);
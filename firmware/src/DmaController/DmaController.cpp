@@ -0,0 +1,71 @@
+#include "DmaController.h"
+
+namespace DmaController
+{
+    static const uint8_t channel_count = (uint8_t)DmaChannel::COUNT;
+
+    __attribute__((aligned(16))) static DmacDescriptor descriptor_table[channel_count];
+    __attribute__((aligned(16))) static DmacDescriptor writeback_table[channel_count];
+
+    static bool initialized = false;
+
+    void Init()
+    {
+        if (initialized)
+            return;
+
+        MCLK->AHBMASK.bit.DMAC_ = 1;
+
+        DMAC->CTRL.bit.DMAENABLE = 0;
+        DMAC->CTRL.bit.SWRST = 1;
+        while (DMAC->CTRL.bit.SWRST)
+            ;
+
+        memset(descriptor_table, 0, sizeof(descriptor_table));
+        memset(writeback_table, 0, sizeof(writeback_table));
+
+        DMAC->BASEADDR.reg = (uint32_t)descriptor_table;
+        DMAC->WRBADDR.reg = (uint32_t)writeback_table;
+        DMAC->CTRL.reg = DMAC_CTRL_DMAENABLE | DMAC_CTRL_LVLEN(0xF);
+
+        initialized = true;
+    }
+
+    DmacDescriptor *GetDescriptor(DmaChannel channel)
+    {
+        return &descriptor_table[(uint8_t)channel];
+    }
+
+    DmacDescriptor *GetWriteback(DmaChannel channel)
+    {
+        return &writeback_table[(uint8_t)channel];
+    }
+
+    void ConfigureChannel(DmaChannel channel, uint8_t trigger_source, uint8_t priority)
+    {
+        Init();
+        uint8_t ch = (uint8_t)channel;
+
+        DMAC->Channel[ch].CHCTRLA.bit.ENABLE = 0;
+        DMAC->Channel[ch].CHCTRLA.bit.SWRST = 1;
+        while (DMAC->Channel[ch].CHCTRLA.bit.SWRST)
+            ;
+
+        DMAC->Channel[ch].CHCTRLA.reg = DMAC_CHCTRLA_TRIGSRC(trigger_source) |
+                                        DMAC_CHCTRLA_TRIGACT_BURST;
+        DMAC->Channel[ch].CHPRILVL.reg = DMAC_CHPRILVL_PRILVL(priority);
+    }
+
+    void EnableChannel(DmaChannel channel)
+    {
+        DMAC->Channel[(uint8_t)channel].CHCTRLA.bit.ENABLE = 1;
+    }
+
+    void DisableChannel(DmaChannel channel)
+    {
+        uint8_t ch = (uint8_t)channel;
+        DMAC->Channel[ch].CHCTRLA.bit.ENABLE = 0;
+        while (DMAC->Channel[ch].CHCTRLA.bit.ENABLE)
+            ;
+    }
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Owner of the DMAC descriptor and write-back tables. Each peripheral that
+// streams through DMA gets a fixed channel from this list so the channel
+// numbers (and their DMAC_n_Handler vectors) never collide.
+enum class DmaChannel : uint8_t
+{
+    STEP_PULSES = 0,
+    ENCODER_I2C = 1,
+    COUNT = 2,
+};
+
+namespace DmaController
+{
+    void Init();
+
+    DmacDescriptor *GetDescriptor(DmaChannel channel);
+    DmacDescriptor *GetWriteback(DmaChannel channel);
+
+    // Reset the channel and attach it to a peripheral trigger source
+    void ConfigureChannel(DmaChannel channel, uint8_t trigger_source, uint8_t priority);
+
+    void EnableChannel(DmaChannel channel);
+    void DisableChannel(DmaChannel channel);
+}
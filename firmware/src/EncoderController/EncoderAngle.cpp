@@ -0,0 +1,87 @@
+#include "EncoderAngle.h"
+
+// atan(t) for t in [0, 1], Abramowitz and Stegun 4.4.49, error below 1e-5
+// radians. Scaled to angle units in Q16.
+static constexpr int32_t AtanCoefficient(double c)
+{
+  return c < 0.0 ? (int32_t)(c * ANGLE_UNITS_PER_TURN / (2.0 * 3.14159265358979323846) * 65536.0 - 0.5)
+                 : (int32_t)(c * ANGLE_UNITS_PER_TURN / (2.0 * 3.14159265358979323846) * 65536.0 + 0.5);
+}
+
+static const int32_t ATAN_C1 = AtanCoefficient(0.9998660);
+static const int32_t ATAN_C3 = AtanCoefficient(-0.3302995);
+static const int32_t ATAN_C5 = AtanCoefficient(0.1801410);
+static const int32_t ATAN_C7 = AtanCoefficient(-0.0851330);
+static const int32_t ATAN_C9 = AtanCoefficient(0.0208351);
+
+#define QUARTER_TURN (ANGLE_UNITS_PER_TURN / 4)
+#define HALF_TURN (ANGLE_UNITS_PER_TURN / 2)
+
+uint16_t FixedAtan2(int16_t y, int16_t x)
+{
+  uint32_t ax = x < 0 ? -(int32_t)x : x;
+  uint32_t ay = y < 0 ? -(int32_t)y : y;
+  if (ax == 0 && ay == 0)
+    return 0;
+
+  // First octant: the smaller over the larger component, Q15
+  bool steep = ay > ax;
+  uint32_t num = steep ? ax : ay;
+  uint32_t den = steep ? ay : ax;
+  int32_t t = (int32_t)(((num << 15) + den / 2) / den);
+  int32_t t2 = (int32_t)(((int64_t)t * t) >> 15);
+
+  int32_t acc = ATAN_C9;
+  acc = ATAN_C7 + (int32_t)(((int64_t)acc * t2) >> 15);
+  acc = ATAN_C5 + (int32_t)(((int64_t)acc * t2) >> 15);
+  acc = ATAN_C3 + (int32_t)(((int64_t)acc * t2) >> 15);
+  acc = ATAN_C1 + (int32_t)(((int64_t)acc * t2) >> 15);
+  int32_t angle = (int32_t)(((int64_t)acc * t + (1LL << 30)) >> 31);
+
+  if (steep)
+    angle = QUARTER_TURN - angle;
+  if (x < 0)
+    angle = HALF_TURN - angle;
+  if (y < 0)
+    angle = -angle;
+  return (uint16_t)angle;
+}
+
+AngleTracker::AngleTracker(uint16_t radius, uint16_t alpha)
+    : radius_(radius),
+      alpha_(alpha),
+      position_(0),
+      primed_(false)
+{
+}
+
+int64_t AngleTracker::Update(uint16_t angle)
+{
+  if (!primed_)
+  {
+    position_ = angle;
+    primed_ = true;
+    return position_;
+  }
+
+  int32_t difference = (int16_t)(angle - (uint16_t)position_);
+  if (difference > radius_)
+  {
+    position_ += difference - radius_;
+  }
+  else if (difference < -(int32_t)radius_)
+  {
+    position_ += difference + radius_;
+  }
+  else
+  {
+    position_ += (difference * (int32_t)alpha_ + 0x8000) >> 16;
+  }
+  return position_;
+}
+
+void AngleTracker::Reset()
+{
+  position_ = 0;
+  primed_ = false;
+}
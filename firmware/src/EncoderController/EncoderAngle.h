@@ -0,0 +1,52 @@
+#pragma once
+#include <cstdint>
+
+// Integer angles, 1/65536 turn. A uint16_t wraps exactly once per turn, so
+// the difference of two angles cast to int16_t is the shortest way round.
+#define ANGLE_UNITS_PER_TURN 65536
+
+// Sliding window filter defaults, as the float filter had them: 0.4 degrees
+// (the noise amplitude with the shaft still) and alpha 0.4 in Q16
+#define ANGLE_WINDOW_RADIUS 73
+#define ANGLE_WINDOW_ALPHA 26214
+
+// Angle of (x, y) from the +x axis, counter clockwise, 0 to 65535. Any
+// int16_t inputs, (0, 0) gives 0. Within 1 unit (0.0055 degrees) of atan2()
+// for field values the TLV493D produces.
+//
+// Folds the vector into the first octant, takes atan() of the ratio there with
+// a 9th order polynomial and unfolds the result. One division and five
+// multiply-accumulates, no floating point.
+uint16_t FixedAtan2(int16_t y, int16_t x);
+
+inline float AngleUnitsToDegrees(int64_t units)
+{
+    return (float)units * (360.0f / ANGLE_UNITS_PER_TURN);
+}
+
+// Tracks the shaft over any number of turns from raw sensor angles.
+//
+// The position is the center of a sliding window: a raw angle more than the
+// radius away drags the window edge onto it, one inside moves the center by
+// alpha of the difference. The difference is taken the short way round, so
+// the position carries on past a full turn by itself.
+class AngleTracker
+{
+public:
+    AngleTracker(uint16_t radius = ANGLE_WINDOW_RADIUS, uint16_t alpha = ANGLE_WINDOW_ALPHA);
+
+    // Filters one raw angle and returns the new position. The first angle
+    // after Reset() becomes the position, within the first turn.
+    int64_t Update(uint16_t angle);
+
+    // Multi-turn position, 1/65536 turn
+    int64_t Position() { return position_; }
+
+    void Reset();
+
+private:
+    uint16_t radius_;
+    uint16_t alpha_;
+    int64_t position_;
+    bool primed_;
+};
@@ -0,0 +1,131 @@
+#include "EncoderCalibration.h"
+#include <cmath>
+#include <cstring>
+
+static_assert(ENCODER_CALIBRATION_TABLE_SIZE == 256, "Correct() indexes the table with the high byte");
+
+#define CALIBRATION_TWO_PI 6.28318530717958647692f
+
+EncoderCalibration::EncoderCalibration()
+    : residual_(0.0f),
+      loaded_(false)
+{
+  BeginRun();
+}
+
+void EncoderCalibration::BeginRun()
+{
+  memset(bin_sum_, 0, sizeof(bin_sum_));
+  memset(bin_count_, 0, sizeof(bin_count_));
+}
+
+void EncoderCalibration::AddSample(uint16_t raw, uint16_t reference)
+{
+  uint32_t bin = raw / (65536 / ENCODER_CALIBRATION_BINS);
+  if (bin_count_[bin] == UINT16_MAX)
+    return;
+  // The short way round, the constant offset goes with the fit's mean
+  bin_sum_[bin] += (int16_t)(raw - reference);
+  bin_count_[bin]++;
+}
+
+bool EncoderCalibration::Fit(int16_t coefficients[ENCODER_CALIBRATION_HARMONICS][2])
+{
+  float mean[ENCODER_CALIBRATION_BINS];
+  float offset = 0.0f;
+  for (int b = 0; b < ENCODER_CALIBRATION_BINS; b++)
+  {
+    if (bin_count_[b] < ENCODER_CALIBRATION_MIN_BIN_SAMPLES)
+      return false;
+    mean[b] = (float)bin_sum_[b] / bin_count_[b];
+    offset += mean[b];
+  }
+  offset /= ENCODER_CALIBRATION_BINS;
+  for (int b = 0; b < ENCODER_CALIBRATION_BINS; b++)
+    mean[b] -= offset;
+
+  // Discrete Fourier series over the bin centers
+  float fitted[ENCODER_CALIBRATION_HARMONICS][2];
+  for (int h = 0; h < ENCODER_CALIBRATION_HARMONICS; h++)
+  {
+    float c = 0.0f, s = 0.0f;
+    for (int b = 0; b < ENCODER_CALIBRATION_BINS; b++)
+    {
+      float angle = CALIBRATION_TWO_PI * (h + 1) * (b + 0.5f) / ENCODER_CALIBRATION_BINS;
+      c += mean[b] * cosf(angle);
+      s += mean[b] * sinf(angle);
+    }
+    fitted[h][0] = 2.0f * c / ENCODER_CALIBRATION_BINS;
+    fitted[h][1] = 2.0f * s / ENCODER_CALIBRATION_BINS;
+    if (fabsf(fitted[h][0]) > INT16_MAX || fabsf(fitted[h][1]) > INT16_MAX)
+      return false;
+  }
+
+  float squares = 0.0f;
+  for (int b = 0; b < ENCODER_CALIBRATION_BINS; b++)
+  {
+    float left = mean[b];
+    for (int h = 0; h < ENCODER_CALIBRATION_HARMONICS; h++)
+    {
+      float angle = CALIBRATION_TWO_PI * (h + 1) * (b + 0.5f) / ENCODER_CALIBRATION_BINS;
+      left -= fitted[h][0] * cosf(angle) + fitted[h][1] * sinf(angle);
+    }
+    squares += left * left;
+  }
+  residual_ = sqrtf(squares / ENCODER_CALIBRATION_BINS);
+  if (residual_ > ENCODER_CALIBRATION_MAX_RESIDUAL)
+    return false;
+
+  for (int h = 0; h < ENCODER_CALIBRATION_HARMONICS; h++)
+  {
+    coefficients[h][0] = (int16_t)lroundf(fitted[h][0]);
+    coefficients[h][1] = (int16_t)lroundf(fitted[h][1]);
+  }
+  return true;
+}
+
+void EncoderCalibration::Load(const int16_t coefficients[ENCODER_CALIBRATION_HARMONICS][2])
+{
+  for (int i = 0; i < ENCODER_CALIBRATION_TABLE_SIZE; i++)
+  {
+    float error = 0.0f;
+    for (int h = 0; h < ENCODER_CALIBRATION_HARMONICS; h++)
+    {
+      float angle = CALIBRATION_TWO_PI * (h + 1) * i / ENCODER_CALIBRATION_TABLE_SIZE;
+      error += coefficients[h][0] * cosf(angle) + coefficients[h][1] * sinf(angle);
+    }
+    table_[i] = (int16_t)lroundf(error);
+  }
+  // Interpolating past the last entry wraps to the first
+  table_[ENCODER_CALIBRATION_TABLE_SIZE] = table_[0];
+  loaded_ = true;
+}
+
+void EncoderCalibration::Clear()
+{
+  loaded_ = false;
+}
+
+static uint8_t CalibrationChecksum(const EncoderCalibrationStruct &stored)
+{
+  const uint8_t *bytes = (const uint8_t *)&stored;
+  uint8_t sum = 0;
+  for (size_t i = 0; i < sizeof(EncoderCalibrationStruct) - 1; i++)
+    sum += bytes[i];
+  return ~sum;
+}
+
+void EncoderCalibration::Pack(const int16_t coefficients[ENCODER_CALIBRATION_HARMONICS][2], EncoderCalibrationStruct &stored)
+{
+  stored.magic = ENCODER_CALIBRATION_MAGIC;
+  memcpy(stored.coefficients, coefficients, sizeof(stored.coefficients));
+  stored.checksum = CalibrationChecksum(stored);
+}
+
+bool EncoderCalibration::Unpack(const EncoderCalibrationStruct &stored, int16_t coefficients[ENCODER_CALIBRATION_HARMONICS][2])
+{
+  if (stored.magic != ENCODER_CALIBRATION_MAGIC || stored.checksum != CalibrationChecksum(stored))
+    return false;
+  memcpy(coefficients, stored.coefficients, sizeof(stored.coefficients));
+  return true;
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include <cstdint>
+
+// Harmonics of the angle error that get corrected. Magnet misalignment shows
+// up once and twice per turn, 3 and 4 take what's left of a tilted magnet.
+#define ENCODER_CALIBRATION_HARMONICS 4
+
+// Error samples are averaged per 1/64 turn of sensor angle before the fit, so
+// a turn at uneven speed weighs every part of it the same
+#define ENCODER_CALIBRATION_BINS 64
+#define ENCODER_CALIBRATION_MIN_BIN_SAMPLES 4
+
+// Correction table entries per turn, interpolated in between
+#define ENCODER_CALIBRATION_TABLE_SIZE 256
+
+// A fit leaving more than this rms (1 degree) isn't the sensor, most likely
+// the motor slipped or turns the other way
+#define ENCODER_CALIBRATION_MAX_RESIDUAL 182
+
+#define ENCODER_CALIBRATION_MAGIC 0xCA1B
+
+// Kept in FlashStorageStruct. Coefficients in 1/65536 turn, cosine then sine
+// of each harmonic.
+struct __attribute__((packed)) EncoderCalibrationStruct
+{
+    uint16_t magic;
+    int16_t coefficients[ENCODER_CALIBRATION_HARMONICS][2];
+    uint8_t checksum;
+};
+
+enum class EncoderCalibrationState : uint8_t
+{
+    NONE = 0,    // no correction applied
+    RUNNING = 1, // collecting a turn
+    ACTIVE = 2,  // correction applied
+    FAILED = 3,  // the last run didn't fit, an earlier correction stays
+};
+
+// Linearizes the sensor angle against a reference turn.
+//
+// During a calibration run AddSample() pairs each raw sensor angle with the
+// angle the step counter says the shaft is at. Fit() takes the per bin mean
+// of their difference, drops the constant part (the home offset takes care of
+// it) and fits the low harmonics. Load() turns the harmonics into a table so
+// Correct() costs one lookup and one interpolation per sample.
+class EncoderCalibration
+{
+public:
+    EncoderCalibration();
+
+    void BeginRun();
+    void AddSample(uint16_t raw, uint16_t reference);
+
+    // Ends the run. False when the samples didn't cover a whole turn or don't
+    // fit, the coefficients are left alone then.
+    bool Fit(int16_t coefficients[ENCODER_CALIBRATION_HARMONICS][2]);
+
+    // RMS of the bin means left over by the last Fit(), 1/65536 turn
+    float Residual() { return residual_; }
+
+    void Load(const int16_t coefficients[ENCODER_CALIBRATION_HARMONICS][2]);
+    void Clear();
+    bool IsLoaded() { return loaded_; }
+
+    uint16_t Correct(uint16_t raw) const
+    {
+        if (!loaded_)
+            return raw;
+        uint32_t index = raw >> 8;
+        int32_t fraction = raw & 0xFF;
+        int32_t error = table_[index] + (((table_[index + 1] - table_[index]) * fraction) >> 8);
+        return (uint16_t)(raw - error);
+    }
+
+    // Storage with a check that it isn't blank or damaged
+    static void Pack(const int16_t coefficients[ENCODER_CALIBRATION_HARMONICS][2], EncoderCalibrationStruct &stored);
+    static bool Unpack(const EncoderCalibrationStruct &stored, int16_t coefficients[ENCODER_CALIBRATION_HARMONICS][2]);
+
+private:
+    int32_t bin_sum_[ENCODER_CALIBRATION_BINS];
+    uint16_t bin_count_[ENCODER_CALIBRATION_BINS];
+    float residual_;
+
+    bool loaded_;
+    int16_t table_[ENCODER_CALIBRATION_TABLE_SIZE + 1];
+};
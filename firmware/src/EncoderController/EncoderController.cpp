@@ -1,14 +1,8 @@
 #include "EncoderController.h"
 #include "DebugPrinter.h"
-float Wrap0to360(float input)
-{
-    input = fmodf(input, 360.0f);
-    if (input < 0)
-    {
-        input += 360.0f;
-    }
-    return input;
-}
+#include "wiring_private.h"
+#include "Profiler/Profiler.h"
+#include "FlashStorage/FlashStorage.h"
 
 void EncoderController::OnStart()
 {
@@ -34,8 +28,40 @@ void EncoderController::OnStart()
     Tlv493dMagnetic3DSensor.begin(Wire1);
     Tlv493dMagnetic3DSensor.setAccessMode(Tlv493d::AccessMode_e::MASTERCONTROLLEDMODE);
     Tlv493dMagnetic3DSensor.disableTemp();
+    if (EncoderCalibration::Unpack(*FlashStorage::GetEncoderCalibration(), calibration_coefficients_))
+    {
+        calibration_.Load(calibration_coefficients_);
+        calibration_state_ = EncoderCalibrationState::ACTIVE;
+    }
+
     Tlv493dMagnetic3DSensor.updateData();
-    home_position_offset = Wrap0to360(degrees(Tlv493dMagnetic3DSensor.getAzimuth()));
+    int16_t x, y;
+    ReadLibraryField(x, y);
+    home_position_offset = AngleUnitsToDegrees(calibration_.Correct(FixedAtan2(y, x)));
+
+#ifdef ENCODER_INT_SAMPLING
+    // The sensor converts continuously and pulls its INT line low (shared
+    // with SCL) when a new value is ready
+    Tlv493dMagnetic3DSensor.setAccessMode(Tlv493d::AccessMode_e::FASTMODE);
+    Tlv493dMagnetic3DSensor.enableInterrupt();
+#endif
+
+#ifdef ENCODER_DMA_READ
+    // From here on the DMAC reads the sensor, OnRun() paces the reads itself
+    encoder_bus.Init();
+    executionPeriod = 0;
+    read_start_us_ = micros();
+#endif
+
+#ifdef ENCODER_INT_SAMPLING
+    attachInterrupt(PIN_WIRE1_SCL, OnSensorInterrupt, FALLING);
+    // attachInterrupt() leaves the EIC line at priority 0, above the step
+    // timer. OnSensorInterrupt() starts a read about 3.3k times a second and
+    // must not delay a step, so it goes below TC0 with the encoder DMAC channel
+    NVIC_SetPriority(EIC_7_IRQn, 2);
+    last_trigger_us_ = micros();
+    ArmSensorInterrupt();
+#endif
 }
 
 void EncoderController::OnStop()
@@ -44,6 +70,42 @@ void EncoderController::OnStop()
 
 void EncoderController::OnRun()
 {
+#ifdef ENCODER_DMA_READ
+    encoder_bus.Service();
+
+    // Every sample in order, each with the time it was taken
+    EncoderSample sample;
+    while (samples_.Pop(sample))
+    {
+        CountRead(sample.frame_ok, sample.transfer_us, 0);
+        // A frame error still has data, as with updateData()
+        UpdateShaftAngle(sample.x, sample.y, sample.time_us);
+    }
+
+#ifdef ENCODER_INT_SAMPLING
+    if (int_armed_ && micros() - last_trigger_us_ > ENCODER_INT_TIMEOUT_US)
+    {
+        // Missed pulse, or the sensor reset and lost its configuration. A
+        // read clears a pending INT and restarts the pulses.
+        noInterrupts();
+        bool armed = int_armed_;
+        int_armed_ = false;
+        interrupts();
+        if (armed)
+        {
+            last_trigger_us_ = micros();
+            StartSample(last_trigger_us_);
+        }
+    }
+#else
+    if (!encoder_bus.IsBusy() && micros() - read_start_us_ >= Tlv493dMagnetic3DSensor.getMeasurementDelay() * 1000UL)
+    {
+        read_start_us_ = micros();
+        StartSample(read_start_us_);
+        bus_start_total_us_ += micros() - read_start_us_;
+    }
+#endif
+#else
     if (Tlv493dMagnetic3DSensor.getMeasurementDelay() != executionPeriod)
     {
         executionPeriod = Tlv493dMagnetic3DSensor.getMeasurementDelay();
@@ -52,63 +114,129 @@ void EncoderController::OnRun()
     long m = micros();
     Tlv493d_Error_t err = Tlv493dMagnetic3DSensor.updateData();
     long t = micros();
-    // DEBUG_PRINTF("Micros:%lu\n", t-m);
+    CountRead(err == Tlv493d_Error_t::TLV493D_NO_ERROR, t - m, t - m);
     if (err != Tlv493d_Error_t::TLV493D_NO_ERROR)
     {
         Serial.printf("Encoder Error: %d\n", err);
     }
 
-    raw_shaft_angle = Wrap0to360(degrees(Tlv493dMagnetic3DSensor.getAzimuth()));
-    // round to 1 decimal place
-    raw_shaft_angle = roundf(raw_shaft_angle * 10.0f) / 10.0f;
-    // Serial.printf("%8.5f\n", raw_shaft_angle);
-    //  load the sliding window filter
-    //  to avoid invalid values at the ends, apply an offset
+    int16_t x, y;
+    ReadLibraryField(x, y);
+    UpdateShaftAngle(x, y, m);
+#endif
+}
 
+bool EncoderController::StartSample(unsigned long time_us)
+{
+    sample_time_us_ = time_us;
+#ifdef ENCODER_INT_SAMPLING
+    // SCL back to the SERCOM for the read
+    pinPeripheral(PIN_WIRE1_SCL, PIO_SERCOM);
+#endif
+    bool started = encoder_bus.StartRead(device_address, TLV493D_FRAME_LENGTH, OnFrame, this);
+#ifdef ENCODER_INT_SAMPLING
+    if (!started)
     {
-        float offset = 180 - raw_shaft_angle;
-        sliding_window_center += offset;
-        raw_shaft_angle += offset;
+        ArmSensorInterrupt();
+    }
+#endif
+    return started;
+}
 
-        if (sliding_window_center - raw_shaft_angle > sliding_window_radius)
-        { // center > shaft_angle
-            sliding_window_center = raw_shaft_angle + sliding_window_radius;
-        }
-        else if (raw_shaft_angle - sliding_window_center > sliding_window_radius)
-        { // shaft_angle > center
-            sliding_window_center = raw_shaft_angle - sliding_window_radius;
-        }
-        else
-        {
-            sliding_window_center = sliding_window_alpha * raw_shaft_angle + (1 - sliding_window_alpha) * sliding_window_center;
-        }
+void EncoderController::ArmSensorInterrupt()
+{
+    // Between reads SCL is the sensor's INT line. Drop the edge the read
+    // itself left in the flag.
+    pinPeripheral(PIN_WIRE1_SCL, PIO_EXTINT);
+    EIC->INTFLAG.reg = 1 << g_APinDescription[PIN_WIRE1_SCL].ulExtInt;
+    int_armed_ = true;
+}
 
-        sliding_window_center -= offset;
-        raw_shaft_angle -= offset;
-    }
+void EncoderController::OnSensorInterrupt()
+{
+    // EIC interrupt: the sensor has a new value
+    if (!encoderController.int_armed_)
+        return;
+    encoderController.int_armed_ = false;
+    encoderController.last_trigger_us_ = micros();
+    encoderController.StartSample(encoderController.last_trigger_us_);
+}
 
-    // keep track of the full turns
-    float delta = sliding_window_center - prev_sliding_window_center;
-    if (delta < -180)
+void EncoderController::OnFrame(const uint8_t *data, uint8_t length, bool ok, void *context)
+{
+    // DMAC interrupt, or Service() for a failed read
+    EncoderController *encoder = (EncoderController *)context;
+    if (ok && length >= TLV493D_FRAME_LENGTH)
+    {
+        EncoderSample sample;
+        Tlv493dField field;
+        sample.frame_ok = Tlv493dDecodeFrame(data, field);
+        sample.time_us = encoder->sample_time_us_;
+        sample.transfer_us = encoder->encoder_bus.LastTransferUs();
+        sample.x = field.x;
+        sample.y = field.y;
+        // Full only when the loop has stalled, the oldest samples are kept
+        encoder->samples_.Push(sample);
+    }
+    else
     {
-        number_full_turns++;
+        // A failed read held the bus until it timed out
+        encoder->CountRead(false, I2C_DMA_TIMEOUT_US, 0);
     }
+#ifdef ENCODER_INT_SAMPLING
+    encoder->ArmSensorInterrupt();
+#endif
+}
 
-    if (delta > 180)
+void EncoderController::CountRead(bool ok, uint32_t transfer_us, uint32_t foreground_us)
+{
+    bus_reads_++;
+    if (!ok)
     {
-        number_full_turns--;
+        bus_errors_++;
     }
+    bus_transfer_total_us_ += transfer_us;
+    if (transfer_us > bus_transfer_max_us_)
+    {
+        bus_transfer_max_us_ = transfer_us;
+    }
+    bus_start_total_us_ += foreground_us;
+}
 
-    full_shaft_position = Wrap0to360(sliding_window_center) + (360 * number_full_turns) + home_position_offset;
-    prev_sliding_window_center = sliding_window_center;
+void EncoderController::GetBusStats(uint32_t &reads, uint32_t &errors, uint32_t &transfer_mean_us, uint32_t &transfer_max_us, uint32_t &foreground_mean_us)
+{
+    reads = bus_reads_;
+    errors = bus_errors_;
+    transfer_mean_us = bus_reads_ > 0 ? (uint32_t)(bus_transfer_total_us_ / bus_reads_) : 0;
+    transfer_max_us = bus_transfer_max_us_;
+    foreground_mean_us = bus_reads_ > 0 ? (uint32_t)(bus_start_total_us_ / bus_reads_) : 0;
+}
 
-    float vel = (full_shaft_position - last_full_shaft_position) / ((float)(micros() - last_read_time) / 1000000);
-    shaft_velocity = vel * velocity_alpha + shaft_velocity * (1 - velocity_alpha);
-    // DEBUG_PRINTF("%8.1f %8.1f %8.1f %lu \n", shaft_velocity, full_shaft_position, last_full_shaft_position, micros()-last_read_time);
-    //DEBUG_PRINTF("%8.1f %8.1f %8.1f %8.1f %8.1f\n", sliding_window_center, delta, number_full_turns, full_shaft_position, shaft_velocity);
+void EncoderController::ReadLibraryField(int16_t &x, int16_t &y)
+{
+    // The library only hands out mT
+    x = (int16_t)lroundf(Tlv493dMagnetic3DSensor.getX() / TLV493D_B_MULT);
+    y = (int16_t)lroundf(Tlv493dMagnetic3DSensor.getY() / TLV493D_B_MULT);
+}
 
-    last_full_shaft_position = full_shaft_position;
+void EncoderController::UpdateShaftAngle(int16_t x, int16_t y, unsigned long sample_us)
+{
+    {
+        PROFILE_SCOPE(ProfileProbe::ENCODER_ANGLE);
+        last_raw_angle_ = FixedAtan2(y, x);
+        int64_t measured = angle_tracker_.Update(calibration_.Correct(last_raw_angle_));
+        observer_.Update(measured, sample_us - (unsigned long)last_read_time);
+    }
+    last_read_time = sample_us;
+    full_shaft_position = AngleUnitsToDegrees(observer_.Position()) + home_position_offset;
+    shaft_velocity = observer_.Velocity() * (360.0f / ANGLE_UNITS_PER_TURN);
+    // DEBUG_PRINTF("%8.1f %8.1f %8.3f\n", shaft_velocity, full_shaft_position, observer_.Residual());
 
+    if (sample_us - update_tick_us_ < ENCODER_UPDATE_TICK_US)
+    {
+        return;
+    }
+    update_tick_us_ = sample_us;
     update_rate_ticker++;
 
     if (millis() - update_rate_timer > update_rate_poll_period)
@@ -117,8 +245,6 @@ void EncoderController::OnRun()
         update_rate = (float)update_rate_ticker * (1000 / (float)update_rate_poll_period);
         update_rate_ticker = 0;
     }
-
-    last_read_time = micros();
 }
 
 float EncoderController::GetShaftAngle()
@@ -153,4 +279,78 @@ float EncoderController::GetUpdateRate()
     return update_rate;
 }
 
+void EncoderController::SetCommandedVelocity(float degrees_per_second)
+{
+    observer_.SetCommandedVelocity(degrees_per_second * (ANGLE_UNITS_PER_TURN / 360.0f));
+}
+
+bool EncoderController::SetObserver(float alpha, float beta, bool feed_forward)
+{
+    if (!observer_.SetGains(alpha, beta))
+    {
+        return false;
+    }
+    observer_.SetFeedForward(feed_forward);
+    return true;
+}
+
+void EncoderController::GetObserver(float &alpha, float &beta, bool &feed_forward)
+{
+    observer_.GetGains(alpha, beta);
+    feed_forward = observer_.GetFeedForward();
+}
+
+void EncoderController::BeginCalibration()
+{
+    calibration_.BeginRun();
+    calibration_state_ = EncoderCalibrationState::RUNNING;
+}
+
+void EncoderController::AddCalibrationSample(float reference_degrees)
+{
+    if (calibration_state_ != EncoderCalibrationState::RUNNING)
+    {
+        return;
+    }
+    uint16_t reference = (uint16_t)lroundf(reference_degrees * (ANGLE_UNITS_PER_TURN / 360.0f));
+    calibration_.AddSample(last_raw_angle_, reference);
+}
+
+bool EncoderController::FinishCalibration()
+{
+    if (calibration_state_ != EncoderCalibrationState::RUNNING)
+    {
+        return false;
+    }
+    int16_t coefficients[ENCODER_CALIBRATION_HARMONICS][2];
+    if (!calibration_.Fit(coefficients))
+    {
+        // Whatever correction was in use stays
+        DEBUG_PRINTF("Encoder calibration failed, residual %f\n", calibration_.Residual() * (360.0f / ANGLE_UNITS_PER_TURN));
+        calibration_state_ = EncoderCalibrationState::FAILED;
+        return false;
+    }
+    memcpy(calibration_coefficients_, coefficients, sizeof(coefficients));
+    calibration_.Load(calibration_coefficients_);
+    EncoderCalibration::Pack(calibration_coefficients_, *FlashStorage::GetEncoderCalibration());
+    calibration_state_ = EncoderCalibrationState::ACTIVE;
+    return true;
+}
+
+void EncoderController::ClearCalibration()
+{
+    calibration_.Clear();
+    memset(calibration_coefficients_, 0, sizeof(calibration_coefficients_));
+    // As blank EEPROM
+    memset(FlashStorage::GetEncoderCalibration(), 0xFF, sizeof(EncoderCalibrationStruct));
+    calibration_state_ = EncoderCalibrationState::NONE;
+}
+
+EncoderCalibrationState EncoderController::GetCalibration(int16_t coefficients[ENCODER_CALIBRATION_HARMONICS][2], float &residual_degrees)
+{
+    memcpy(coefficients, calibration_coefficients_, sizeof(calibration_coefficients_));
+    residual_degrees = calibration_.Residual() * (360.0f / ANGLE_UNITS_PER_TURN);
+    return calibration_state_;
+}
+
 EncoderController encoderController(500);
@@ -5,43 +5,104 @@
 #include "AxisMessages.h"
 #include "MessageProcessor/MessageProcessor.hpp"
 #include "LedController/LedController.h"
+#include "EncoderController/I2cDmaReader.h"
+#include "EncoderController/Tlv493dFrame.h"
+#include "EncoderController/EncoderAngle.h"
+#include "EncoderController/PositionObserver.h"
+#include "EncoderController/EncoderCalibration.h"
+#include "SpscRing/SpscRing.h"
+
+// Sensor frames are read by the DMAC without blocking the loop, see
+// I2cDmaReader. Without it every read waits for the whole I2C transfer.
+#define ENCODER_DMA_READ
+
+// With ENCODER_DMA_READ: the sensor measures continuously (FASTMODE) and
+// each of its INT pulses starts a read. Without it reads are paced by the
+// master controlled mode's measurement delay.
+#define ENCODER_INT_SAMPLING
+
+// Samples waiting for OnRun(), must be a power of two
+#define ENCODER_SAMPLE_RING_SIZE 32
+
+// No INT pulse for this long starts a read anyway
+#define ENCODER_INT_TIMEOUT_US 5000
+
+// GetUpdateRate() counts one update per this much sample time. Homing moves
+// at half the update rate in steps/s, this keeps it where it was with the
+// 10ms master controlled mode reads.
+#define ENCODER_UPDATE_TICK_US 10000
+
+// One sensor read, as the interrupt that completed it left it
+struct EncoderSample
+{
+    uint32_t time_us;     // INT pulse, or the start of the read
+    uint32_t transfer_us; // from the start of the read to its data
+    int16_t x;
+    int16_t y;
+    bool frame_ok;        // all axes from the same conversion
+};
 
 class EncoderController : public ITask, public IEncoderInterface
 {
 private:
     static const uint32_t device_address = 0x5E;
 
-    float number_full_turns = 0;
     float home_position_offset = 0;
-    float last_full_shaft_position = 0, full_shaft_position = 0;
+    float full_shaft_position = 0;
     float shaft_velocity = 0;
-    float velocity_alpha = 0.1;
-    // testing using an averaging filter
-    static const uint32_t average_filter_length = 100;
-    float average_filter[average_filter_length] = {};
-    uint8_t filter_write_pos = 0;
-
-    // testing using a sliding window filter
-    float sliding_window_center = 0, prev_sliding_window_center;
-    float sliding_window_radius = 0.4; // amplitude of noise when sensor is still
-    float sliding_window_alpha = 0.4;
-
-    float raw_shaft_angle = 0;
-    float smoothed_shaft_angle;
+
+    // turn counting only, the observer does the filtering. 1/65536 turn.
+    AngleTracker angle_tracker_ = AngleTracker(0, 0);
+    PositionObserver observer_;
+
+    // harmonic angle correction, applied before the turn counting
+    EncoderCalibration calibration_;
+    EncoderCalibrationState calibration_state_ = EncoderCalibrationState::NONE;
+    int16_t calibration_coefficients_[ENCODER_CALIBRATION_HARMONICS][2] = {};
+    uint16_t last_raw_angle_ = 0;
+
     Tlv493d Tlv493dMagnetic3DSensor = Tlv493d();
 
     JsonDocument recvd_json;
 
-    // loop timer
+    // time of the previous sample
     long last_read_time = 0;
+    unsigned long update_tick_us_ = 0;
     // update rate tracking
     const uint32_t update_rate_poll_period = 2000;
     uint32_t update_rate_timer = 0;
     long update_rate_ticker = 0;
     float update_rate;
 
+    // DMA reads, pushed by OnFrame() from the DMAC interrupt
+    SpscRing<EncoderSample, ENCODER_SAMPLE_RING_SIZE> samples_;
+    volatile unsigned long sample_time_us_ = 0;
+    unsigned long read_start_us_ = 0;
+
+    // INT sampling
+    volatile bool int_armed_ = false;
+    volatile unsigned long last_trigger_us_ = 0;
+
+    // bus statistics
+    uint32_t bus_reads_ = 0;
+    uint32_t bus_errors_ = 0;
+    uint64_t bus_transfer_total_us_ = 0;
+    uint32_t bus_transfer_max_us_ = 0;
+    uint64_t bus_start_total_us_ = 0;
+
+    static void OnFrame(const uint8_t *data, uint8_t length, bool ok, void *context);
+    static void OnSensorInterrupt();
+    bool StartSample(unsigned long time_us);
+    void ArmSensorInterrupt();
+    void ReadLibraryField(int16_t &x, int16_t &y);
+    void UpdateShaftAngle(int16_t x, int16_t y, unsigned long sample_us);
+    void CountRead(bool ok, uint32_t transfer_us, uint32_t foreground_us);
+
 public:
-    EncoderController(uint32_t period)
+    // Wire1 is SERCOM3, see variant.h
+    I2cDmaReader encoder_bus;
+
+    EncoderController(uint32_t period) : encoder_bus(SERCOM3, SERCOM3_DMAC_ID_RX, DmaChannel::ENCODER_I2C)
     {
         executionPeriod = period;
     }
@@ -65,7 +126,32 @@ public:
     float *GetShaftAnglePtr();
 
     void SetPosition(float position);
+    // Updates per second, see ENCODER_UPDATE_TICK_US
     float GetUpdateRate();
+
+    // Feed-forward for the observer, from MotorController
+    void SetCommandedVelocity(float degrees_per_second);
+
+    // Observer gains, see PositionObserver. False for gains outside its
+    // stable region.
+    bool SetObserver(float alpha, float beta, bool feed_forward);
+    void GetObserver(float &alpha, float &beta, bool &feed_forward);
+
+    // Calibration run, driven by MotorController::CalibrateEncoder(). A fit
+    // goes into the settings, SaveConfiguration keeps it.
+    void BeginCalibration();
+    void AddCalibrationSample(float reference_degrees);
+    bool FinishCalibration();
+    void ClearCalibration();
+    // Coefficients of the correction in use, all 0 without one. Residual of
+    // the last fit, degrees rms.
+    EncoderCalibrationState GetCalibration(int16_t coefficients[ENCODER_CALIBRATION_HARMONICS][2], float &residual_degrees);
+
+    // Sensor reads and failed ones, and the mean and longest time from the
+    // start of a read to its data, us. `foreground_mean_us` is how long the
+    // loop was held up per read: the whole transfer for blocking reads, only
+    // starting it for DMA reads.
+    void GetBusStats(uint32_t &reads, uint32_t &errors, uint32_t &transfer_mean_us, uint32_t &transfer_max_us, uint32_t &foreground_mean_us);
 };
 
 extern EncoderController encoderController;
\ No newline at end of file
@@ -0,0 +1,149 @@
+#include "I2cDmaReader.h"
+#include "EncoderController/EncoderController.h"
+
+static_assert((uint8_t)DmaChannel::ENCODER_I2C == 1, "DMAC_1_Handler serves the encoder channel");
+
+void DMAC_1_Handler()
+{
+  uint8_t flags = DMAC->Channel[(uint8_t)DmaChannel::ENCODER_I2C].CHINTFLAG.reg;
+  DMAC->Channel[(uint8_t)DmaChannel::ENCODER_I2C].CHINTFLAG.reg = flags;
+
+  if (flags & DMAC_CHINTFLAG_TCMPL)
+  {
+    encoderController.encoder_bus.OnDmaComplete();
+  }
+  if (flags & DMAC_CHINTFLAG_TERR)
+  {
+    encoderController.encoder_bus.OnDmaFault();
+  }
+}
+
+I2cDmaReader::I2cDmaReader(Sercom *sercom, uint8_t dma_trigger, DmaChannel channel)
+    : sercom_(sercom),
+      dma_trigger_(dma_trigger),
+      channel_(channel)
+{
+}
+
+void I2cDmaReader::Init()
+{
+  // Smart mode: the DMAC reading DATA acknowledges the byte and starts the
+  // next one. SMEN can only be written while the SERCOM is disabled.
+  sercom_->I2CM.CTRLA.bit.ENABLE = 0;
+  while (sercom_->I2CM.SYNCBUSY.bit.ENABLE)
+    ;
+  sercom_->I2CM.CTRLB.bit.SMEN = 1;
+  sercom_->I2CM.CTRLA.bit.ENABLE = 1;
+  while (sercom_->I2CM.SYNCBUSY.bit.ENABLE)
+    ;
+  // The bus state is unknown after enabling
+  sercom_->I2CM.STATUS.bit.BUSSTATE = 1;
+  while (sercom_->I2CM.SYNCBUSY.bit.SYSOP)
+    ;
+
+  DmaController::ConfigureChannel(channel_, dma_trigger_, 2);
+  DMAC->Channel[(uint8_t)channel_].CHINTENSET.reg = DMAC_CHINTENSET_TCMPL |
+                                                    DMAC_CHINTENSET_TERR;
+  // Channels 0 to 3 have a vector each
+  IRQn_Type irq = (IRQn_Type)(DMAC_0_IRQn + (uint8_t)channel_);
+  NVIC_SetPriority(irq, 2);
+  NVIC_EnableIRQ(irq);
+}
+
+bool I2cDmaReader::StartRead(uint8_t address, uint8_t length, I2cReadCallback callback, void *context)
+{
+  if (busy_ || length == 0 || length > I2C_DMA_MAX_READ)
+    return false;
+
+  DmacDescriptor *desc = DmaController::GetDescriptor(channel_);
+  desc->BTCTRL.reg = DMAC_BTCTRL_VALID |
+                     DMAC_BTCTRL_BEATSIZE_BYTE |
+                     DMAC_BTCTRL_DSTINC |
+                     DMAC_BTCTRL_BLOCKACT_INT;
+  desc->BTCNT.reg = length;
+  desc->SRCADDR.reg = (uint32_t)&sercom_->I2CM.DATA.reg;
+  // With DSTINC the address is the end of the block
+  desc->DSTADDR.reg = (uint32_t)&buffer_[length];
+  desc->DESCADDR.reg = 0;
+
+  length_ = length;
+  callback_ = callback;
+  context_ = context;
+  failed_ = false;
+  busy_ = true;
+  start_us_ = micros();
+  DmaController::EnableChannel(channel_);
+
+  // ACK every byte, with LENEN the SERCOM NACKs the last one and sends STOP
+  // by itself
+  sercom_->I2CM.STATUS.reg = SERCOM_I2CM_STATUS_BUSERR |
+                             SERCOM_I2CM_STATUS_ARBLOST |
+                             SERCOM_I2CM_STATUS_LENERR;
+  sercom_->I2CM.CTRLB.bit.ACKACT = 0;
+  while (sercom_->I2CM.SYNCBUSY.bit.SYSOP)
+    ;
+  sercom_->I2CM.ADDR.reg = SERCOM_I2CM_ADDR_ADDR((address << 1) | 1) |
+                           SERCOM_I2CM_ADDR_LENEN |
+                           SERCOM_I2CM_ADDR_LEN(length);
+  return true;
+}
+
+void I2cDmaReader::Service()
+{
+  noInterrupts();
+  bool failed = busy_ && (failed_ || micros() - start_us_ > I2C_DMA_TIMEOUT_US);
+  if (failed)
+  {
+    // A completion after this point is ignored
+    busy_ = false;
+  }
+  interrupts();
+  if (!failed)
+    return;
+
+  Abort();
+  if (callback_ != nullptr)
+  {
+    callback_(buffer_, length_, false, context_);
+  }
+}
+
+void I2cDmaReader::OnDmaComplete()
+{
+  if (!busy_)
+    return;
+  last_transfer_us_ = micros() - start_us_;
+
+  // The SERCOM is still sending NACK and STOP after the last byte, let it
+  // finish so the callback may use the bus or its pins straight away
+  unsigned long stop_start = micros();
+  while (sercom_->I2CM.STATUS.bit.BUSSTATE != 1 && micros() - stop_start < I2C_DMA_STOP_TIMEOUT_US)
+    ;
+  busy_ = false;
+  if (callback_ != nullptr)
+  {
+    callback_(buffer_, length_, true, context_);
+  }
+}
+
+void I2cDmaReader::OnDmaFault()
+{
+  failed_ = true;
+}
+
+void I2cDmaReader::Abort()
+{
+  DmaController::DisableChannel(channel_);
+  if (sercom_->I2CM.STATUS.bit.BUSSTATE == 2)
+  {
+    // Still owns the bus, release it
+    sercom_->I2CM.CTRLB.bit.ACKACT = 1;
+    sercom_->I2CM.CTRLB.bit.CMD = 3;
+  }
+  else
+  {
+    sercom_->I2CM.STATUS.bit.BUSSTATE = 1;
+  }
+  while (sercom_->I2CM.SYNCBUSY.bit.SYSOP)
+    ;
+}
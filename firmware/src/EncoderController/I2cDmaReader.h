@@ -0,0 +1,73 @@
+#pragma once
+#include <Arduino.h>
+#include "DmaController/DmaController.h"
+
+// Longest read, bytes
+#define I2C_DMA_MAX_READ 16
+
+// A read that hasn't completed by then is aborted. 7 bytes at 400kHz take
+// about 200us.
+#define I2C_DMA_TIMEOUT_US 2000
+
+// The NACK and STOP after the last byte take a few us at 400kHz
+#define I2C_DMA_STOP_TIMEOUT_US 50
+
+// Called with the received bytes when a read completes, from the DMAC
+// interrupt once the bus is released, or with ok = false from Service() when
+// it fails. `data` stays valid until the next StartRead().
+typedef void (*I2cReadCallback)(const uint8_t *data, uint8_t length, bool ok, void *context);
+
+// Asynchronous I2C master reads on a SERCOM that the Wire library has set up
+// (pins, baud rate).
+//
+// StartRead() writes the address with ADDR.LENEN, so the SERCOM clocks in
+// exactly `length` bytes by itself, ACKs all but the last one and finishes
+// with NACK and STOP. The DMAC moves each byte from DATA into the buffer on
+// the RX trigger and the transfer complete interrupt hands the buffer to the
+// callback. The CPU only writes a few registers per read instead of waiting
+// for the whole transfer.
+//
+// The Wire library owns the SERCOM interrupt vectors, so bus errors, lost
+// arbitration and an address NACK aren't signalled by interrupt. A failed
+// read never completes its DMA transfer, Service() aborts it after
+// I2C_DMA_TIMEOUT_US.
+class I2cDmaReader
+{
+public:
+    I2cDmaReader(Sercom *sercom, uint8_t dma_trigger, DmaChannel channel);
+
+    // After Wire.begin(), the Wire library can't use the SERCOM any more
+    void Init();
+
+    // Begin reading `length` bytes from `address`. Returns false without
+    // touching the bus while the previous read is still running.
+    bool StartRead(uint8_t address, uint8_t length, I2cReadCallback callback, void *context);
+
+    // Aborts a read that has timed out. Call from the main loop.
+    void Service();
+
+    bool IsBusy() { return busy_; }
+
+    // From StartRead() to the end of the last read that completed, us
+    uint32_t LastTransferUs() { return last_transfer_us_; }
+
+    void OnDmaComplete();
+    void OnDmaFault();
+
+private:
+    Sercom *sercom_;
+    uint8_t dma_trigger_;
+    DmaChannel channel_;
+
+    uint8_t buffer_[I2C_DMA_MAX_READ];
+    uint8_t length_ = 0;
+    I2cReadCallback callback_ = nullptr;
+    void *context_ = nullptr;
+
+    volatile bool busy_ = false;
+    volatile bool failed_ = false;
+    unsigned long start_us_ = 0;
+    volatile uint32_t last_transfer_us_ = 0;
+
+    void Abort();
+};
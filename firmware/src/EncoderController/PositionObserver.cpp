@@ -0,0 +1,78 @@
+#include "PositionObserver.h"
+
+PositionObserver::PositionObserver()
+    : alpha_(OBSERVER_DEFAULT_ALPHA),
+      beta_(OBSERVER_DEFAULT_BETA),
+      feed_forward_(true),
+      commanded_(0.0f),
+      primed_(false),
+      base_(0),
+      offset_(0.0f),
+      deviation_(0.0f),
+      residual_(0.0f)
+{
+}
+
+bool PositionObserver::SetGains(float alpha, float beta)
+{
+  if (!(alpha > 0.0f && alpha < 2.0f && beta > 0.0f && beta < 4.0f - 2.0f * alpha))
+    return false;
+  alpha_ = alpha;
+  beta_ = beta;
+  return true;
+}
+
+void PositionObserver::GetGains(float &alpha, float &beta)
+{
+  alpha = alpha_;
+  beta = beta_;
+}
+
+void PositionObserver::SetFeedForward(bool enabled)
+{
+  if (enabled == feed_forward_)
+    return;
+  deviation_ += enabled ? -commanded_ : commanded_;
+  feed_forward_ = enabled;
+}
+
+void PositionObserver::Reset()
+{
+  primed_ = false;
+}
+
+void PositionObserver::Update(int64_t measured, uint32_t dt_us)
+{
+  if (!primed_ || dt_us == 0 || dt_us > OBSERVER_MAX_GAP_US)
+  {
+    primed_ = true;
+    base_ = measured;
+    offset_ = 0.0f;
+    deviation_ = 0.0f;
+    residual_ = 0.0f;
+    return;
+  }
+
+  float dt = dt_us * 1e-6f;
+  float feed_forward = feed_forward_ ? commanded_ : 0.0f;
+  offset_ += (feed_forward + deviation_) * dt;
+
+  residual_ = (float)(measured - base_) - offset_;
+  offset_ += alpha_ * residual_;
+  deviation_ += beta_ / dt * residual_;
+
+  // Move whole units into the integer part
+  int32_t whole = (int32_t)offset_;
+  base_ += whole;
+  offset_ -= whole;
+}
+
+int64_t PositionObserver::Position() const
+{
+  return base_ + (int64_t)(offset_ < 0.0f ? offset_ - 0.5f : offset_ + 0.5f);
+}
+
+float PositionObserver::Velocity() const
+{
+  return (feed_forward_ ? commanded_ : 0.0f) + deviation_;
+}
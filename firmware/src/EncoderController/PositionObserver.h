@@ -0,0 +1,67 @@
+#pragma once
+#include <cstdint>
+
+// Defaults for the sensor's FASTMODE rate (about 3.3kHz). Velocity noise with
+// the shaft still stays well under the 1 degree/s homing waits for, a jammed
+// shaft reads below half speed within about 30ms.
+#define OBSERVER_DEFAULT_ALPHA 0.02f
+#define OBSERVER_DEFAULT_BETA 0.0002f
+
+// A gap longer than this between samples restarts the observer from the
+// sample, the prediction across it is worthless
+#define OBSERVER_MAX_GAP_US 100000
+
+// Alpha-beta observer of position and velocity, in whatever unit the
+// measurements come in (the encoder uses 1/65536 turn).
+//
+// Each Update() predicts the position from the previous estimate and
+// velocity, then corrects both by the residual to the measurement, position
+// by alpha and velocity by beta / dt. With feed-forward the velocity is the
+// commanded velocity plus an estimated deviation, so the observer only has to
+// track what the commanded motion doesn't explain: following a ramp costs no
+// lag, while a shaft that stops against a load still shows up, at the rate
+// beta lets the deviation grow.
+//
+// The position is kept as an integer plus a float fraction so it stays exact
+// over any number of turns.
+class PositionObserver
+{
+public:
+    PositionObserver();
+
+    // Returns false for gains outside the stable region (0 < alpha < 2,
+    // 0 < beta < 4 - 2 alpha), keeping the current ones
+    bool SetGains(float alpha, float beta);
+    void GetGains(float &alpha, float &beta);
+
+    // The velocity carries on smoothly across a change
+    void SetFeedForward(bool enabled);
+    bool GetFeedForward() { return feed_forward_; }
+
+    // Commanded velocity, units/s, used from the next Update()
+    void SetCommandedVelocity(float velocity) { commanded_ = velocity; }
+
+    // Next Update() starts over from its measurement
+    void Reset();
+
+    // One measurement taken `dt_us` after the previous one
+    void Update(int64_t measured, uint32_t dt_us);
+
+    int64_t Position() const;
+    float Velocity() const;
+
+    // Measured minus predicted position of the last Update()
+    float Residual() const { return residual_; }
+
+private:
+    float alpha_;
+    float beta_;
+    bool feed_forward_;
+    float commanded_;
+
+    bool primed_;
+    int64_t base_;
+    float offset_;    // position = base_ + offset_, |offset_| < 1
+    float deviation_; // velocity beyond the feed-forward, units/s
+    float residual_;
+};
@@ -0,0 +1,31 @@
+#pragma once
+#include <cstdint>
+
+// Bytes of a TLV493D measurement read: Bx, By, Bz high bytes, temperature
+// high nibble / frame counter / channel, Bx and By low nibbles, Bz low nibble,
+// temperature low byte. The same registers Tlv493d::updateData() reads.
+#define TLV493D_FRAME_LENGTH 7
+
+struct Tlv493dField
+{
+    int16_t x;
+    int16_t y;
+    int16_t z;
+};
+
+// 12 bit two's complement from the high byte and a low nibble in bits 7..4,
+// as Tlv493d::concatResults()
+inline int16_t Tlv493dConcat(uint8_t upper, uint8_t lower_nibble)
+{
+    return (int16_t)((uint16_t)(upper << 8) | (lower_nibble << 4)) >> 4;
+}
+
+// Returns false when the channel bits say the three axes aren't all from the
+// same conversion. The values are filled in either way.
+inline bool Tlv493dDecodeFrame(const uint8_t *frame, Tlv493dField &field)
+{
+    field.x = Tlv493dConcat(frame[0], frame[4] >> 4);
+    field.y = Tlv493dConcat(frame[1], frame[4] & 0x0F);
+    field.z = Tlv493dConcat(frame[2], frame[5] & 0x0F);
+    return (frame[3] & 0x03) == 0;
+}
@@ -4,6 +4,7 @@
 #include "Site.h"
 #include "../EncoderController/EncoderController.h"
 #include "../LedController/LedController.h"
+#include "../Profiler/Profiler.h"
 #include <cstdarg>
 void HandleInturrupts();
 
@@ -74,49 +75,53 @@ void AxisEthernet::OnStart()
     interrupts();
     NVIC_EnableIRQ(EIC_3_IRQn);
     NVIC_SetPriority(EIC_3_IRQn, 1);
-    attachInterrupt(AUX4, HandleInturrupts, CHANGE);
+    // INTn is active low, the rising edge when OnRun() clears it isn't news
+    attachInterrupt(AUX4, HandleInturrupts, FALLING);
 }
 
 void AxisEthernet::HandleInturrupt()
 {
-    uint8_t intr = W5100.readSnIR(Udp.GetSocketIndex());
-    W5100.writeSnIR(Udp.GetSocketIndex(), intr);
-    //DEBUG_PRINTF("interupt: 0x%x\n", intr);
-    
-    while (true)
-    {
-        uint16_t packetSize = Udp.parsePacket();
-        if (packetSize == 0)
-            return;
-        remoteIp = Udp.remoteIP();
-        remotePort = Udp.remotePort();
-        //DEBUG_PRINTF("Received message from %d.%d.%d.%d:%d\n", remoteIp[0], remoteIp[1], remoteIp[2], remoteIp[3], remotePort);
-    
-        //DEBUG_PRINTF("Inturrupt received size %d\n", packetSize);
-        memset(buffer, 0, 1024);
-        Udp.read(buffer, packetSize);
-        HandleIncomingMsg(buffer, packetSize);
-    }
+    // The SPI reads and the message handlers run from OnRun(), at the step
+    // interrupt's priority they would hold it up for the whole packet
+    packet_pending_ = true;
 }
 
 void HandleInturrupts()
 {
+    PROFILE_SCOPE(ProfileProbe::ETHERNET_ISR);
     AEthernet.HandleInturrupt();
 }
 
 void AxisEthernet::OnRun()
 {
-    uint16_t packetSize = Udp.parsePacket();
-    if (packetSize == 0)
+    uint32_t now = millis();
+    if (!packet_pending_ && now - last_poll_ms_ < ETHERNET_POLL_MS)
         return;
-    //DEBUG_PRINTF("Run Received %d\n", packetSize);
-    
-    remoteIp = Udp.remoteIP();
-    remotePort = Udp.remotePort();
-    //DEBUG_PRINTF("Received message from %d.%d.%d.%d:%d\n", remoteIp[0], remoteIp[1], remoteIp[2], remoteIp[3], remotePort);
-    memset(buffer, 0, 1024);
-    Udp.read(buffer, packetSize);
-    HandleIncomingMsg(buffer, packetSize);
+    last_poll_ms_ = now;
+    packet_pending_ = false;
+
+    // Cleared before reading, a packet arriving meanwhile interrupts again
+    uint8_t intr = W5100.readSnIR(Udp.GetSocketIndex());
+    W5100.writeSnIR(Udp.GetSocketIndex(), intr);
+
+    for (uint8_t i = 0; i < ETHERNET_DRAIN_PACKETS; i++)
+    {
+        uint16_t packetSize = Udp.parsePacket();
+        if (packetSize == 0)
+            return;
+        //DEBUG_PRINTF("Run Received %d\n", packetSize);
+
+        remoteIp = Udp.remoteIP();
+        remotePort = Udp.remotePort();
+        //DEBUG_PRINTF("Received message from %d.%d.%d.%d:%d\n", remoteIp[0], remoteIp[1], remoteIp[2], remoteIp[3], remotePort);
+        memset(buffer, 0, sizeof(buffer));
+        // A packet too big for the buffer is cut short and rejected
+        int size = Udp.read(buffer, sizeof(buffer));
+        if (size > 0)
+            HandleIncomingMsg(buffer, size);
+    }
+    // Others may be waiting, the other tasks get a turn first
+    packet_pending_ = true;
 }
 
 void AxisEthernet::HandleIncomingMsg(uint8_t *recv_bytes, uint32_t recv_bytes_size)
@@ -150,6 +155,25 @@ void AxisEthernet::SendMsg(uint8_t *send_bytes, uint32_t send_bytes_size)
     Udp.endPacket();
 };
 
+uint64_t AxisEthernet::Sender()
+{
+    // Every host shares the one socket, its address and port tell them apart
+    return ((uint64_t)(uint32_t)remoteIp << 16) | remotePort;
+}
+
+void AxisEthernet::SaveTelemetryDestination()
+{
+    telemetryIp = remoteIp;
+    telemetryPort = remotePort;
+}
+
+void AxisEthernet::SendTelemetryMsg(uint8_t *send_bytes, uint32_t send_bytes_size)
+{
+    Udp.beginPacket(telemetryIp, telemetryPort);
+    Udp.write(send_bytes, send_bytes_size);
+    Udp.endPacket();
+}
+
 void AxisEthernet::OnStop()
 {
 }
@@ -178,4 +202,5 @@ void AxisEthernet::printf(const char* format, ...) {
     print(buf);
 }
 
-AxisEthernet AEthernet(10);
+// Every loop, OnRun() returns straight away unless a packet came in
+AxisEthernet AEthernet(0);
@@ -9,7 +9,11 @@
 #include <Ethernet.h>
 #include <ArduinoHA.h>
 
+// Packets read and handled per OnRun(), more wait for the next run
+#define ETHERNET_DRAIN_PACKETS 4
 
+// Looks for packets this often without an interrupt, in case one was missed
+#define ETHERNET_POLL_MS 100
 
 class W5500UdpClient : public EthernetUDP
 {
@@ -34,10 +38,18 @@ private:
     IPAddress remoteIp;
     uint16_t remotePort;
 
+    // Host that subscribed to telemetry, remoteIp changes with every packet
+    IPAddress telemetryIp;
+    uint16_t telemetryPort = 0;
+
     bool device_found = false;
 
     W5500UdpClient Udp; 
     uint8_t buffer[1024];
+
+    // Set by the W5500 interrupt, OnRun() reads and handles the packets
+    volatile bool packet_pending_ = false;
+    uint32_t last_poll_ms_ = 0;
     
 public:
     // EthernetServer server;
@@ -56,6 +68,9 @@ public:
     // messageHandlers
     void HandleIncomingMsg(uint8_t *recv_bytes, uint32_t recv_bytes_size);
     void SendMsg(uint8_t* send_bytes, uint32_t send_bytes_size);
+    uint64_t Sender();
+    void SaveTelemetryDestination();
+    void SendTelemetryMsg(uint8_t* send_bytes, uint32_t send_bytes_size);
 
     void print(const char* str);
     void println(const char* str);
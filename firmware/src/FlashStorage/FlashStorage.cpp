@@ -213,6 +213,11 @@ namespace FlashStorage
         return &FlashStorageData->HASettings;
     }
 
+    EncoderCalibrationStruct *GetEncoderCalibration()
+    {
+        return &FlashStorageData->EncoderCalibration;
+    }
+
     uint8_t *GetBuffer()
     {
         return &current_settings_buffer[0];
@@ -4,6 +4,7 @@
 #include <Wire.h>
 #include <assert.h>
 #include "DebugPrinter.h"
+#include "EncoderController/EncoderCalibration.h"
 
 #define FLASH_ADDRESS 0b01011000
 #define MAC_ARRAY_LEN 6
@@ -55,7 +56,8 @@ struct __attribute__ ((packed)) FlashStorageStruct
     I2CSettingsStruct I2CSettings;
     MotorSettingsStruct MotorSettings;
     HASettingsStruct HASettings;
-    uint8_t empty[82];
+    EncoderCalibrationStruct EncoderCalibration;
+    uint8_t empty[82 - sizeof(EncoderCalibrationStruct)];
 };
 
 static_assert(sizeof(FlashStorageStruct) == 256, "Incorrect flash struct size");
@@ -90,6 +92,7 @@ namespace FlashStorage
     I2CSettingsStruct* GetI2CSettings();
     MotorSettingsStruct* GetMotorSettings();
     HASettingsStruct* GetHASettings();
+    EncoderCalibrationStruct* GetEncoderCalibration();
     uint8_t* GetBuffer();
 
     void WriteFlash();
@@ -0,0 +1,16 @@
+#pragma once
+#include <cstdint>
+#include "AxisMessages.h"
+
+// 16-bit sum of the bytes, the protocol's original footer
+uint16_t ChecksumSum(const uint8_t *data, uint32_t size);
+
+// CRC-16/CCITT-FALSE: polynomial 0x1021, initial value 0xFFFF, no
+// reflection, no final XOR. One table lookup per byte.
+uint16_t ChecksumCrc16(const uint8_t *data, uint32_t size);
+
+// Footer checksum of `data` in `mode`
+inline uint16_t FrameChecksum(ChecksumMode mode, const uint8_t *data, uint32_t size)
+{
+    return mode == ChecksumMode::CRC16 ? ChecksumCrc16(data, size) : ChecksumSum(data, size);
+}
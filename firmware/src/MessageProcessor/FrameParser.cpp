@@ -0,0 +1,101 @@
+#include "FrameParser.h"
+#include "Checksum.h"
+#include <string.h>
+
+FrameParser::FrameParser()
+    : start_(0),
+      ready_(0),
+      end_(0),
+      dropped_(0)
+{
+}
+
+uint16_t FrameParser::Push(const uint8_t *data, uint16_t size)
+{
+  // Frames waiting for Pop() can't move
+  if (ready_ == start_ && start_ > 0)
+  {
+    memmove(buffer_, buffer_ + start_, end_ - start_);
+    end_ -= start_;
+    ready_ = 0;
+    start_ = 0;
+  }
+  uint16_t space = FRAME_PARSER_SIZE - end_;
+  uint16_t n = size < space ? size : space;
+  memcpy(buffer_ + end_, data, n);
+  end_ += n;
+  Parse();
+  return n;
+}
+
+uint16_t FrameParser::Peek(const uint8_t **frames)
+{
+  *frames = buffer_ + start_;
+  return ready_ - start_;
+}
+
+void FrameParser::Pop()
+{
+  start_ = ready_;
+  if (start_ == end_)
+  {
+    start_ = 0;
+    ready_ = 0;
+    end_ = 0;
+  }
+}
+
+void FrameParser::Reset()
+{
+  // The header that is waiting may be noise with frames behind it
+  while (Pending() > 0)
+  {
+    Skip();
+    Parse();
+  }
+}
+
+void FrameParser::Parse()
+{
+  while ((uint32_t)(end_ - ready_) >= sizeof(Header) + sizeof(Footer))
+  {
+    Header hdr;
+    memcpy(&hdr, buffer_ + ready_, sizeof(Header));
+    uint32_t frame_size = sizeof(Header) + hdr.body_size + sizeof(Footer);
+    if (frame_size > FRAME_PARSER_SIZE)
+    {
+      Skip();
+      continue;
+    }
+    if ((uint32_t)(end_ - ready_) < frame_size)
+      return;
+
+    // Either footer, the processor holds it to the interface's mode
+    const uint8_t *frame = buffer_ + ready_;
+    uint32_t checked = frame_size - sizeof(Footer);
+    Footer footer;
+    memcpy(&footer, frame + checked, sizeof(Footer));
+    if (footer.checksum != ChecksumSum(frame, checked) && footer.checksum != ChecksumCrc16(frame, checked))
+    {
+      Skip();
+      continue;
+    }
+    ready_ += frame_size;
+  }
+}
+
+void FrameParser::Skip()
+{
+  if (ready_ == start_)
+  {
+    start_++;
+    ready_++;
+  }
+  else
+  {
+    // Complete frames come before it, close the gap instead
+    memmove(buffer_ + ready_, buffer_ + ready_ + 1, end_ - ready_ - 1);
+    end_--;
+  }
+  dropped_++;
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <cstdint>
+#include "AxisMessages.h"
+
+// Largest frame reassembled, header and footer included
+#define FRAME_PARSER_SIZE 512
+
+// Splits a byte stream into protocol frames.
+//
+// Bytes go in with Push() in whatever pieces the transport delivers them.
+// Frames are delimited by the header's body_size and checked against the
+// footer, which may be in either ChecksumMode. Peek() returns every complete
+// frame at the front of the buffer as one back to back batch, the way
+// MessageProcessor::HandleByteMsg() takes them.
+//
+// A header whose frame can't fit the buffer, or a frame with a bad checksum,
+// is noise: the parser drops its first byte and tries the next one as a
+// header, which finds the frames again after corruption. Noise that looks
+// like the header of a longer frame holds up the frames behind it until
+// enough bytes arrive to fail its checksum, or until Reset(). The caller
+// resets after a gap in the stream.
+class FrameParser
+{
+public:
+    FrameParser();
+
+    // Copies in as much of `data` as fits and returns how much. Only short of
+    // `size` while a full buffer of frames waits for Pop().
+    uint16_t Push(const uint8_t *data, uint16_t size);
+
+    // Complete frames at the front of the buffer, back to back, valid until
+    // Pop(). Returns their total size, zero for none.
+    uint16_t Peek(const uint8_t **frames);
+    void Pop();
+
+    // Gives up on the partial frame, the bytes after its first one are
+    // parsed again
+    void Reset();
+
+    // Bytes waiting for the rest of their frame
+    uint16_t Pending() { return end_ - ready_; }
+
+    // Bytes skipped looking for a frame
+    uint32_t Dropped() { return dropped_; }
+
+private:
+    uint8_t buffer_[FRAME_PARSER_SIZE];
+    uint16_t start_; // first byte not popped
+    uint16_t ready_; // end of the complete frames
+    uint16_t end_;   // end of the bytes pushed
+    uint32_t dropped_;
+
+    void Parse();
+    void Skip();
+};
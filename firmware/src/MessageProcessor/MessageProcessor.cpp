@@ -3,437 +3,1034 @@
 #include "LedController/LedController.h"
 #include "FlashStorage/FlashStorage.h"
 #include "MotorController/MotorController.h"
+#include "EncoderController/EncoderController.h"
+#include "Profiler/Profiler.h"
 #include "Ethernet.h"
-MessageProcessor::MessageProcessor(uint32_t period)
+
+// Message handlers. `msg` is the whole request, header included, already
+// checked against the registry. Set handlers return the status to ack,
+// Get handlers send their response and return false to ack ERROR instead.
+typedef bool (*MessageHandler)(MessageProcessor &processor, const uint8_t *msg);
+
+static bool OnAck(MessageProcessor &processor, const uint8_t *msg)
 {
-  executionPeriod = period;
+  // Acks are sent, not received. One from a host needs no reply.
+  return true;
 }
 
-void MessageProcessor::AddExternalInterface(IExternalInterface *new_interface)
+static bool OnGetVersion(MessageProcessor &processor, const uint8_t *msg)
 {
-  externalInterfaces.push_back(new_interface);
-  new_interface->SetProcessorInterface(this);
+  VersionMessage *response = processor.BeginResponse<VersionMessage>(MessageTypes::GetVersionId);
+  unsigned int v0, v1, v2, v3;
+  sscanf(FIRMWARE_VERSION, "%u.%u.%u.%u", &v0, &v1, &v2, &v3);
+  uint8_t *v_buf = (uint8_t *)&response->value;
+  v_buf[0] = (uint8_t)v0;
+  v_buf[1] = (uint8_t)v1;
+  v_buf[2] = (uint8_t)v2;
+  v_buf[3] = (uint8_t)v3;
+  processor.SendResponse(response);
+  return true;
 }
 
-void MessageProcessor::OnStart()
+static bool OnSetI2CAddress(MessageProcessor &processor, const uint8_t *msg)
 {
+  FlashStorage::GetI2CSettings()->address = ((const I2CAddressMessage *)msg)->value;
+  return true;
 }
 
-void MessageProcessor::OnStop()
+static bool OnGetI2CAddress(MessageProcessor &processor, const uint8_t *msg)
 {
+  return processor.SendValue<I2CAddressMessage>(MessageTypes::GetI2CAddressId, FlashStorage::GetI2CSettings()->address);
 }
 
-void MessageProcessor::OnRun()
+static bool OnSetEthernetAddress(MessageProcessor &processor, const uint8_t *msg)
 {
+  FlashStorage::GetEthernetSettings()->ip_address = ((const EthernetAddressMessage *)msg)->value;
+  return true;
 }
 
-void MessageProcessor::HandleJsonMsg(uint8_t *recv_bytes, uint32_t recv_bytes_size)
+static bool OnGetEthernetAddress(MessageProcessor &processor, const uint8_t *msg)
 {
+  return processor.SendValue<EthernetAddressMessage>(MessageTypes::GetEthernetAddressId, FlashStorage::GetEthernetSettings()->ip_address);
 }
 
-void MessageProcessor::HandleByteMsg(uint8_t *recv_bytes, uint32_t recv_bytes_size)
+static bool OnSetEthernetPort(MessageProcessor &processor, const uint8_t *msg)
 {
-  Header *hdr = (Header *)&recv_bytes[0];
+  FlashStorage::GetEthernetSettings()->port = (uint16_t)((const EthernetPortMessage *)msg)->value;
+  return true;
+}
 
-  addrLedController.AddLedStep(CRGB::Green, 10);
-  addrLedController.AddLedStep(CRGB::Black, 1);
+static bool OnGetEthernetPort(MessageProcessor &processor, const uint8_t *msg)
+{
+  return processor.SendValue<EthernetPortMessage>(MessageTypes::GetEthernetPortId, FlashStorage::GetEthernetSettings()->port);
+}
 
-  // TODO: check for checksum
-  DEBUG_PRINTF("Received %d bytes\n", recv_bytes_size);
-  // DEBUG_PRINTF("Received message type: 0x%x\n", hdr->message_type);
-  switch ((MessageTypes)hdr->message_type)
-  {
-  case MessageTypes::AckId: // 0x0100
-  {
-    // Note: ACK messages are typically not received but sent in response to other messages
-    // This case is included for completeness but may not be used
-    break;
-  }
+static bool OnGetMacAddress(MessageProcessor &processor, const uint8_t *msg)
+{
+  MacAddressMessage *response = processor.BeginResponse<MacAddressMessage>(MessageTypes::GetMacAddressId);
+  memcpy(&(response->mac[0]), FlashStorage::GetMacAddress(), 6);
+  processor.SendResponse(response);
+  return true;
+}
 
-  case MessageTypes::GetVersionId: // 0x0101
-  {
-    VersionMessage *msg = (VersionMessage *)&send_buffer[0];
-
-    msg->header.message_type = (uint16_t)MessageTypes::GetVersionId;
-    msg->header.body_size = sizeof(VersionMessage::value);
-    unsigned int v0, v1, v2, v3;
-    sscanf(FIRMWARE_VERSION, "%u.%u.%u.%u", &v0, &v1, &v2, &v3);
-    uint8_t *v_buf = (uint8_t *)&msg->value;
-    v_buf[0] = (uint8_t)v0;
-    v_buf[1] = (uint8_t)v1;
-    v_buf[2] = (uint8_t)v2;
-    v_buf[3] = (uint8_t)v3;
-    msg->footer.checksum = CalculateChecksum((uint8_t *)msg, sizeof(VersionMessage) - sizeof(Footer));
-    SendMsg(send_buffer, sizeof(VersionMessage));
-    DEBUG_PRINTF("0x%8X\n", msg->value);
-    break;
-  }
+static bool OnSaveConfiguration(MessageProcessor &processor, const uint8_t *msg)
+{
+  FlashStorage::WriteFlash();
+  return true;
+}
 
-  case MessageTypes::SetI2CAddressId: // 0x0102
-  {
-    I2CAddressMessage *msg = (I2CAddressMessage *)recv_bytes;
-    FlashStorage::GetI2CSettings()->address = msg->value;
+static bool OnSetLedColor(MessageProcessor &processor, const uint8_t *msg)
+{
+  const LedColorMessage *request = (const LedColorMessage *)msg;
+  addrLedController.SetLEDColor(CRGB(request->ledColor[0], request->ledColor[1], request->ledColor[2]));
+  return true;
+}
 
-    SendAck(MessageTypes::SetI2CAddressId, StatusCodes::SUCCESS);
-    break;
-  }
+static bool OnGetLedColor(MessageProcessor &processor, const uint8_t *msg)
+{
+  CRGB led_color = addrLedController.GetLedColor();
+  LedColorMessage *response = processor.BeginResponse<LedColorMessage>(MessageTypes::GetLedColorId);
+  response->ledColor[0] = led_color.r;
+  response->ledColor[1] = led_color.g;
+  response->ledColor[2] = led_color.b;
+  processor.SendResponse(response);
+  return true;
+}
 
-  case MessageTypes::GetI2CAddressId: // 0x0103
-  {
-    I2CAddressMessage *msg = (I2CAddressMessage *)&send_buffer[0];
-    msg->header.message_type = (uint16_t)MessageTypes::GetI2CAddressId;
-    msg->header.body_size = sizeof(I2CAddressMessage::value);
-    msg->value = FlashStorage::GetI2CSettings()->address;
-    msg->footer.checksum = CalculateChecksum((uint8_t *)msg, sizeof(I2CAddressMessage) - sizeof(Footer));
-    // DEBUG_PRINTF("Sending I2C Address: 0x%x\n", msg->value);
-    SendMsg(send_buffer, sizeof(I2CAddressMessage));
-    break;
-  }
+static bool OnAddLedStep(MessageProcessor &processor, const uint8_t *msg)
+{
+  const AddLedStepMessage *request = (const AddLedStepMessage *)msg;
+  addrLedController.AddLedStep(CRGB(request->ledColor[0], request->ledColor[1], request->ledColor[2]), request->time_ms);
+  return true;
+}
 
-  case MessageTypes::SetEthernetAddressId: // 0x0104
-  {
-    EthernetAddressMessage *msg = (EthernetAddressMessage *)recv_bytes;
-    FlashStorage::GetEthernetSettings()->ip_address = msg->value;
+static bool OnSetHomeDirection(MessageProcessor &processor, const uint8_t *msg)
+{
+  motorController.SetHomeDirection((HomeDirection)((const HomeDirectionMessage *)msg)->value);
+  return true;
+}
 
-    // Respond with Ack
-    SendAck(MessageTypes::SetEthernetAddressId, StatusCodes::SUCCESS);
-    break;
-  }
+static bool OnGetHomeDirection(MessageProcessor &processor, const uint8_t *msg)
+{
+  return processor.SendValue<HomeDirectionMessage>(MessageTypes::GetHomeDirectionId, (uint8_t)motorController.GetHomeDirection());
+}
 
-  case MessageTypes::GetEthernetAddressId: // 0x0105
-  {
-    EthernetAddressMessage *msg = (EthernetAddressMessage *)&send_buffer[0];
-    msg->header.message_type = (uint16_t)MessageTypes::GetEthernetAddressId;
-    msg->header.body_size = sizeof(EthernetAddressMessage::value);
-    msg->value = FlashStorage::GetEthernetSettings()->ip_address;
-    msg->footer.checksum = CalculateChecksum((uint8_t *)msg, sizeof(EthernetAddressMessage) - sizeof(Footer));
-    SendMsg(send_buffer, sizeof(EthernetAddressMessage));
-    // DEBUG_PRINTF("Sending IP Address: 0x%x\n", sizeof(IPAddressMessage));
-    break;
-  }
+static bool OnSetHomeThreshold(MessageProcessor &processor, const uint8_t *msg)
+{
+  motorController.SetHomeThreshold(((const HomeThresholdMessage *)msg)->value);
+  return true;
+}
 
-  case MessageTypes::SetEthernetPortId: // 0x0106
-  {
-    EthernetPortMessage *msg = (EthernetPortMessage *)recv_bytes;
-    FlashStorage::GetEthernetSettings()->port = (uint16_t)(msg->value);
+static bool OnGetHomeThreshold(MessageProcessor &processor, const uint8_t *msg)
+{
+  return processor.SendValue<HomeThresholdMessage>(MessageTypes::GetHomeThresholdId, motorController.GetHomeThreshold());
+}
 
-    // Respond with Ack
-    SendAck(MessageTypes::SetEthernetPortId, StatusCodes::SUCCESS);
-    break;
-  }
+static bool OnSetHomeSpeed(MessageProcessor &processor, const uint8_t *msg)
+{
+  motorController.SetHomingSpeed(((const HomeSpeedMessage *)msg)->value);
+  return true;
+}
 
-  case MessageTypes::GetEthernetPortId: // 0x0107
-  {
-    EthernetPortMessage *msg = (EthernetPortMessage *)&send_buffer[0];
-    msg->header.message_type = (uint16_t)MessageTypes::GetEthernetPortId;
-    msg->header.body_size = sizeof(EthernetPortMessage::value);
-    msg->value = FlashStorage::GetEthernetSettings()->port;
-    msg->footer.checksum = CalculateChecksum((uint8_t *)msg, sizeof(EthernetPortMessage) - sizeof(Footer));
-    SendMsg(send_buffer, sizeof(EthernetPortMessage));
-    DEBUG_PRINTF("Sending Port: %d\n", msg->value);
-    // DEBUG_PRINTF("Port msg size: %d\n", sizeof(EthernetPortMessage));
-    break;
-  }
+static bool OnGetHomeSpeed(MessageProcessor &processor, const uint8_t *msg)
+{
+  return processor.SendValue<HomeSpeedMessage>(MessageTypes::GetHomeSpeedId, motorController.GetHomingSpeed());
+}
 
-  case MessageTypes::GetMacAddressId: // 0x0108
-  {
-    MacAddressMessage *msg = (MacAddressMessage *)&send_buffer[0];
-    msg->header.message_type = (uint16_t)MessageTypes::GetMacAddressId;
-    msg->header.body_size = sizeof(MacAddressMessage::mac);
-    memcpy(&(msg->mac[0]), FlashStorage::GetMacAddress(), 6);
-    msg->footer.checksum = CalculateChecksum((uint8_t *)msg, sizeof(MacAddressMessage) - sizeof(Footer));
-    SendMsg(send_buffer, sizeof(MacAddressMessage));
-    break;
-  }
+static bool OnGetHomedState(MessageProcessor &processor, const uint8_t *msg)
+{
+  return processor.SendValue<HomedStateMessage>(MessageTypes::GetHomedStateId, (uint8_t)motorController.GetHomeState());
+}
 
-  case MessageTypes::SaveConfigurationId: // 0x0109
-  {
-    FlashStorage::WriteFlash();
-    SendAck(MessageTypes::SaveConfigurationId, StatusCodes::SUCCESS);
-    break;
-  }
+static bool OnSetMotorState(MessageProcessor &processor, const uint8_t *msg)
+{
+  motorController.SetMotorState((MotorStates)((const MotorStateMessage *)msg)->value);
+  return true;
+}
 
-  case MessageTypes::SetLedColorId: // 0x010A
-  {
-    LedColorMessage *msg = (LedColorMessage *)recv_bytes;
-    //DEBUG_PRINTF("Setting LED Color: %d, %d, %d\n", msg->ledColor[0], msg->ledColor[1], msg->ledColor[2]);
-    addrLedController.SetLEDColor(CRGB(msg->ledColor[0], msg->ledColor[1], msg->ledColor[2]));
-    
-    AckMessage *ack_msg = (AckMessage *)&send_buffer[0];
-    ack_msg->header.message_type = (uint16_t)MessageTypes::AckId;
-    ack_msg->header.body_size = sizeof(AckMessage::ack_message_type) + sizeof(AckMessage::status);
-    ack_msg->ack_message_type = (uint16_t)MessageTypes::SetLedColorId;
-    ack_msg->status = (uint8_t)StatusCodes::SUCCESS;
-    ack_msg->footer.checksum = CalculateChecksum((uint8_t *)ack_msg, sizeof(AckMessage) - sizeof(Footer));
-    SendMsg(send_buffer, sizeof(AckMessage));
-
-    break;
-  }
+static bool OnGetMotorState(MessageProcessor &processor, const uint8_t *msg)
+{
+  return processor.SendValue<MotorStateMessage>(MessageTypes::GetMotorStateId, (uint8_t)motorController.GetMotorState());
+}
 
-  case MessageTypes::GetLedColorId: // 0x010B
-  {
-    CRGB led_color = addrLedController.GetLedColor();
-    LedColorMessage *msg = (LedColorMessage *)&send_buffer[0];
-    msg->header.message_type = (uint16_t)MessageTypes::GetLedColorId;
-    msg->header.body_size = sizeof(LedColorMessage::ledColor);
-    msg->ledColor[0] = led_color.r;
-    msg->ledColor[1] = led_color.g;
-    msg->ledColor[2] = led_color.b;
-    msg->footer.checksum = CalculateChecksum((uint8_t *)msg, sizeof(LedColorMessage) - sizeof(Footer));
-    SendMsg(send_buffer, sizeof(LedColorMessage));
-    break;
-  }
+static bool OnSetMotorBrake(MessageProcessor &processor, const uint8_t *msg)
+{
+  motorController.SetMotorBraking((MotorBrake)((const MotorBrakeMessage *)msg)->value);
+  return true;
+}
 
-  case MessageTypes::AddLedStepId: // Add LED Step
-  {
-    AddLedStepMessage *msg = (AddLedStepMessage *)recv_bytes;
-    addrLedController.AddLedStep(CRGB(msg->ledColor[0], msg->ledColor[1], msg->ledColor[2]), msg->time_ms);
-    SendAck(MessageTypes::AddLedStepId, StatusCodes::SUCCESS);
-    break;
-  }
+static bool OnGetMotorBrake(MessageProcessor &processor, const uint8_t *msg)
+{
+  return processor.SendValue<MotorBrakeMessage>(MessageTypes::GetMotorBrakeId, (uint8_t)motorController.GetMotorBraking());
+}
 
-  case MessageTypes::SetHomeDirectionId: // 0x010E
-  {
-    HomeDirectionMessage *msg = (HomeDirectionMessage *)recv_bytes;
-    motorController.SetHomeDirection((HomeDirection)msg->value);
-    SendAck(MessageTypes::SetHomeDirectionId, StatusCodes::SUCCESS);
-    break;
-  }
+static bool OnSetMaxSpeed(MessageProcessor &processor, const uint8_t *msg)
+{
+  motorController.SetMaxSpeed(((const MaxSpeedMessage *)msg)->value);
+  return true;
+}
 
-  case MessageTypes::GetHomeDirectionId: // 0x010F
-  {
-    HomeDirectionMessage *msg = (HomeDirectionMessage *)&send_buffer[0];
-    msg->header.message_type = (uint16_t)MessageTypes::GetHomeDirectionId;
-    msg->header.body_size = sizeof(HomeDirectionMessage::value);
-    msg->value = (uint8_t)motorController.GetHomeDirection();
-    msg->footer.checksum = CalculateChecksum((uint8_t *)msg, sizeof(HomeDirectionMessage) - sizeof(Footer));
-    SendMsg(send_buffer, sizeof(HomeDirectionMessage));
-    break;
-  }
+static bool OnGetMaxSpeed(MessageProcessor &processor, const uint8_t *msg)
+{
+  return processor.SendValue<MaxSpeedMessage>(MessageTypes::GetMaxSpeedId, motorController.GetMaxSpeed());
+}
 
-  case MessageTypes::SetHomeThresholdId: // 0x0110
-  {
-    HomeThresholdMessage *msg = (HomeThresholdMessage *)&recv_bytes[0];
-    motorController.SetHomeThreshold(msg->value);
-    // DEBUG_PRINTF("Setting Home Threshold to: %d\n", msg->value);
-    SendAck(MessageTypes::SetHomeThresholdId, StatusCodes::SUCCESS);
-    break;
-  }
+static bool OnSetAcceleration(MessageProcessor &processor, const uint8_t *msg)
+{
+  motorController.SetAcceleration(((const AccelerationMessage *)msg)->value);
+  return true;
+}
 
-  case MessageTypes::GetHomeThresholdId: // 0x0111
-  {
-    HomeThresholdMessage *msg = (HomeThresholdMessage *)&send_buffer[0];
-    msg->header.message_type = (uint16_t)MessageTypes::GetHomeThresholdId;
-    msg->header.body_size = sizeof(HomeThresholdMessage::value);
-    msg->value = motorController.GetHomeThreshold();
-    msg->footer.checksum = CalculateChecksum((uint8_t *)msg, sizeof(HomeThresholdMessage) - sizeof(Footer));
-    SendMsg(send_buffer, sizeof(HomeThresholdMessage));
-    break;
-  }
+static bool OnGetAcceleration(MessageProcessor &processor, const uint8_t *msg)
+{
+  return processor.SendValue<AccelerationMessage>(MessageTypes::GetAccelerationId, motorController.GetAcceleration());
+}
 
-  case MessageTypes::SetHomeSpeedId: // 0x0112
-  {
-    HomeSpeedMessage *msg = (HomeSpeedMessage *)&recv_bytes[0];
-    motorController.SetHomingSpeed(msg->value);
-    // DEBUG_PRINTF("Setting Home Speed to: %d\n", msg->value);
-    SendAck(MessageTypes::SetHomeSpeedId, StatusCodes::SUCCESS);
-    break;
-  }
+static bool OnSetCurrentPosition(MessageProcessor &processor, const uint8_t *msg)
+{
+  motorController.SetPosition(((const CurrentPositionMessage *)msg)->value);
+  return true;
+}
 
-  case MessageTypes::GetHomeSpeedId: // 0x0113
-  {
-    HomeSpeedMessage *msg = (HomeSpeedMessage *)&send_buffer[0];
-    msg->header.message_type = (uint16_t)MessageTypes::GetHomeSpeedId;
-    msg->header.body_size = sizeof(HomeSpeedMessage::value);
-    msg->value = motorController.GetHomingSpeed();
-    msg->footer.checksum = CalculateChecksum((uint8_t *)msg, sizeof(HomeSpeedMessage) - sizeof(Footer));
-    SendMsg(send_buffer, sizeof(HomeSpeedMessage));
-    break;
-  }
+static bool OnGetCurrentPosition(MessageProcessor &processor, const uint8_t *msg)
+{
+  return processor.SendValue<CurrentPositionMessage>(MessageTypes::GetCurrentPositionId, motorController.GetPosition());
+}
 
-  case MessageTypes::GetHomedStateId: // 0x0114
-  {
-    HomedStateMessage *msg = (HomedStateMessage *)&send_buffer[0];
-    msg->header.message_type = (uint16_t)MessageTypes::GetHomedStateId;
-    msg->header.body_size = sizeof(HomedStateMessage::value);
-    msg->value = (uint8_t)motorController.GetHomeState();
-    msg->footer.checksum = CalculateChecksum((uint8_t *)msg, sizeof(HomedStateMessage) - sizeof(Footer));
-    SendMsg(send_buffer, sizeof(HomedStateMessage));
-    //DEBUG_PRINTF("Sending Homed State: %d\n", msg->value);
-
-    break;
-  }
+static bool OnSetTargetPosition(MessageProcessor &processor, const uint8_t *msg)
+{
+  motorController.SetPositionTarget(((const TargetPositionMessage *)msg)->value);
+  return true;
+}
+
+static bool OnGetTargetPosition(MessageProcessor &processor, const uint8_t *msg)
+{
+  return processor.SendValue<TargetPositionMessage>(MessageTypes::GetTargetPositionId, motorController.GetPositionTarget());
+}
+
+static bool OnSetVelocity(MessageProcessor &processor, const uint8_t *msg)
+{
+  motorController.SetVelocityTarget(((const VelocityMessage *)msg)->value);
+  return true;
+}
+
+static bool OnGetVelocity(MessageProcessor &processor, const uint8_t *msg)
+{
+  return processor.SendValue<VelocityMessage>(MessageTypes::GetVelocityId, motorController.GetVelocityTarget());
+}
+
+static bool OnGetMotionQueueStatus(MessageProcessor &processor, const uint8_t *msg)
+{
+  MotionQueueStatusMessage *response = processor.BeginResponse<MotionQueueStatusMessage>(MessageTypes::GetMotionQueueStatusId);
+  response->depth = motorController.velocity_planner.Size();
+  response->capacity = motorController.velocity_planner.GetCapacity();
+  response->high_water = motorController.velocity_planner.HighWater();
+  response->overflows = motorController.velocity_planner.Overflows();
+  processor.SendResponse(response);
+  return true;
+}
+
+static bool OnSetMotionProfile(MessageProcessor &processor, const uint8_t *msg)
+{
+  return motorController.SetMotionProfile((MotionProfile)((const MotionProfileMessage *)msg)->value);
+}
+
+static bool OnGetMotionProfile(MessageProcessor &processor, const uint8_t *msg)
+{
+  return processor.SendValue<MotionProfileMessage>(MessageTypes::GetMotionProfileId, (uint8_t)motorController.GetMotionProfile());
+}
+
+static bool OnSetJerk(MessageProcessor &processor, const uint8_t *msg)
+{
+  return motorController.SetJerk(((const JerkMessage *)msg)->value);
+}
+
+static bool OnGetJerk(MessageProcessor &processor, const uint8_t *msg)
+{
+  return processor.SendValue<JerkMessage>(MessageTypes::GetJerkId, motorController.GetJerk());
+}
+
+static bool OnSetPlannerDepth(MessageProcessor &processor, const uint8_t *msg)
+{
+  return motorController.SetPlannerDepth(((const PlannerDepthMessage *)msg)->value);
+}
+
+static bool OnGetPlannerDepth(MessageProcessor &processor, const uint8_t *msg)
+{
+  return processor.SendValue<PlannerDepthMessage>(MessageTypes::GetPlannerDepthId, motorController.GetPlannerDepth());
+}
+
+static bool OnAddPvtPoint(MessageProcessor &processor, const uint8_t *msg)
+{
+  const PvtPointMessage *request = (const PvtPointMessage *)msg;
+  return motorController.AddPvtPoint(request->time_us, request->position, request->velocity);
+}
+
+static bool OnSetPvtDelay(MessageProcessor &processor, const uint8_t *msg)
+{
+  motorController.SetPvtDelay(((const PvtDelayMessage *)msg)->value);
+  return true;
+}
+
+static bool OnGetPvtDelay(MessageProcessor &processor, const uint8_t *msg)
+{
+  return processor.SendValue<PvtDelayMessage>(MessageTypes::GetPvtDelayId, motorController.GetPvtDelay());
+}
+
+static bool OnGetPvtStatus(MessageProcessor &processor, const uint8_t *msg)
+{
+  PvtStatusMessage *response = processor.BeginResponse<PvtStatusMessage>(MessageTypes::GetPvtStatusId);
+  response->buffered = motorController.pvt.Size();
+  response->capacity = motorController.pvt.GetCapacity();
+  response->underruns = motorController.GetPvtUnderruns();
+  response->overflows = motorController.pvt.Overflows();
+  processor.SendResponse(response);
+  return true;
+}
+
+static bool OnSetClosedLoop(MessageProcessor &processor, const uint8_t *msg)
+{
+  motorController.SetClosedLoop(((const ClosedLoopMessage *)msg)->value != 0);
+  return true;
+}
+
+static bool OnGetClosedLoop(MessageProcessor &processor, const uint8_t *msg)
+{
+  return processor.SendValue<ClosedLoopMessage>(MessageTypes::GetClosedLoopId, motorController.GetClosedLoop() ? 1 : 0);
+}
+
+static bool OnSetClosedLoopGains(MessageProcessor &processor, const uint8_t *msg)
+{
+  const ClosedLoopGainsMessage *request = (const ClosedLoopGainsMessage *)msg;
+  return motorController.SetClosedLoopGains(request->p, request->i, request->d, request->limit);
+}
+
+static bool OnGetClosedLoopGains(MessageProcessor &processor, const uint8_t *msg)
+{
+  ClosedLoopGainsMessage *response = processor.BeginResponse<ClosedLoopGainsMessage>(MessageTypes::GetClosedLoopGainsId);
+  float p, i, d, limit;
+  motorController.GetClosedLoopGains(p, i, d, limit);
+  response->p = p;
+  response->i = i;
+  response->d = d;
+  response->limit = limit;
+  processor.SendResponse(response);
+  return true;
+}
+
+static bool OnGetClosedLoopStatus(MessageProcessor &processor, const uint8_t *msg)
+{
+  ClosedLoopStatusMessage *response = processor.BeginResponse<ClosedLoopStatusMessage>(MessageTypes::GetClosedLoopStatusId);
+  response->error = motorController.GetClosedLoopError();
+  response->correction = motorController.GetClosedLoopCorrection();
+  response->offset = motorController.GetClosedLoopOffset();
+  processor.SendResponse(response);
+  return true;
+}
+
+static bool OnSetStallWindow(MessageProcessor &processor, const uint8_t *msg)
+{
+  motorController.stall_detector.SetWindow(((const StallWindowMessage *)msg)->value);
+  return true;
+}
+
+static bool OnGetStallWindow(MessageProcessor &processor, const uint8_t *msg)
+{
+  return processor.SendValue<StallWindowMessage>(MessageTypes::GetStallWindowId, motorController.stall_detector.GetWindow());
+}
+
+static bool OnSetStallAction(MessageProcessor &processor, const uint8_t *msg)
+{
+  return motorController.SetStallAction((StallAction)((const StallActionMessage *)msg)->value);
+}
+
+static bool OnGetStallAction(MessageProcessor &processor, const uint8_t *msg)
+{
+  return processor.SendValue<StallActionMessage>(MessageTypes::GetStallActionId, (uint8_t)motorController.GetStallAction());
+}
+
+static bool OnGetFollowingError(MessageProcessor &processor, const uint8_t *msg)
+{
+  FollowingErrorMessage *response = processor.BeginResponse<FollowingErrorMessage>(MessageTypes::GetFollowingErrorId);
+  response->error = motorController.stall_detector.Error();
+  response->peak = motorController.stall_detector.PeakError();
+  response->stalls = motorController.stall_detector.Stalls();
+  processor.SendResponse(response);
+  return true;
+}
+
+static bool OnGetMotorErrors(MessageProcessor &processor, const uint8_t *msg)
+{
+  return processor.SendValue<MotorErrorsMessage>(MessageTypes::GetMotorErrorsId, motorController.GetErrors());
+}
+
+static bool OnClearMotorErrors(MessageProcessor &processor, const uint8_t *msg)
+{
+  motorController.ClearErrors();
+  return true;
+}
+
+static bool OnGetProfile(MessageProcessor &processor, const uint8_t *msg)
+{
+  uint8_t probe = ((const ProfileRequestMessage *)msg)->value;
+  ProfileStats stats;
+  if (!Profiler::Get(probe, stats))
+    return false;
+  ProfileMessage *response = processor.BeginResponse<ProfileMessage>(MessageTypes::GetProfileId);
+  response->probe = probe;
+  response->clock_hz = SystemCoreClock;
+  response->count = stats.count;
+  response->min = stats.min;
+  response->max = stats.max;
+  response->mean = stats.count > 0 ? (uint32_t)(stats.total / stats.count) : 0;
+  static_assert(sizeof(response->histogram) == sizeof(stats.histogram), "Profile histogram size mismatch");
+  memcpy(response->histogram, stats.histogram, sizeof(response->histogram));
+  processor.SendResponse(response);
+  return true;
+}
+
+static bool OnResetProfile(MessageProcessor &processor, const uint8_t *msg)
+{
+  Profiler::Reset();
+  return true;
+}
 
-  case MessageTypes::HomeId: // 0x0115
-    motorController.Home();
-    SendAck(MessageTypes::HomeId, StatusCodes::SUCCESS);
-    break;
+static bool OnGetEncoderBusStats(MessageProcessor &processor, const uint8_t *msg)
+{
+  EncoderBusStatsMessage *response = processor.BeginResponse<EncoderBusStatsMessage>(MessageTypes::GetEncoderBusStatsId);
+  uint32_t reads, errors, transfer_mean_us, transfer_max_us, foreground_mean_us;
+  encoderController.GetBusStats(reads, errors, transfer_mean_us, transfer_max_us, foreground_mean_us);
+  response->reads = reads;
+  response->errors = errors;
+  response->transfer_mean_us = transfer_mean_us;
+  response->transfer_max_us = transfer_max_us;
+  response->foreground_mean_us = foreground_mean_us;
+  processor.SendResponse(response);
+  return true;
+}
 
-  case MessageTypes::SetMotorStateId: // 0x0116
+static bool OnSetEncoderObserver(MessageProcessor &processor, const uint8_t *msg)
+{
+  const EncoderObserverMessage *request = (const EncoderObserverMessage *)msg;
+  return encoderController.SetObserver(request->alpha, request->beta, request->feed_forward != 0);
+}
+
+static bool OnGetEncoderObserver(MessageProcessor &processor, const uint8_t *msg)
+{
+  EncoderObserverMessage *response = processor.BeginResponse<EncoderObserverMessage>(MessageTypes::GetEncoderObserverId);
+  float alpha, beta;
+  bool feed_forward;
+  encoderController.GetObserver(alpha, beta, feed_forward);
+  response->alpha = alpha;
+  response->beta = beta;
+  response->feed_forward = feed_forward ? 1 : 0;
+  processor.SendResponse(response);
+  return true;
+}
+
+static bool OnCalibrateEncoder(MessageProcessor &processor, const uint8_t *msg)
+{
+  return motorController.CalibrateEncoder();
+}
+
+static bool OnGetEncoderCalibration(MessageProcessor &processor, const uint8_t *msg)
+{
+  EncoderCalibrationMessage *response = processor.BeginResponse<EncoderCalibrationMessage>(MessageTypes::GetEncoderCalibrationId);
+  int16_t coefficients[ENCODER_CALIBRATION_HARMONICS][2];
+  static_assert(sizeof(response->coefficients) == sizeof(coefficients), "Encoder calibration size mismatch");
+  float residual;
+  response->state = (uint8_t)encoderController.GetCalibration(coefficients, residual);
+  memcpy(response->coefficients, coefficients, sizeof(response->coefficients));
+  response->residual = residual;
+  processor.SendResponse(response);
+  return true;
+}
+
+static bool OnClearEncoderCalibration(MessageProcessor &processor, const uint8_t *msg)
+{
+  encoderController.ClearCalibration();
+  return true;
+}
+
+static bool OnArmScope(MessageProcessor &processor, const uint8_t *msg)
+{
+  const ArmScopeMessage *request = (const ArmScopeMessage *)msg;
+  uint32_t period_us = request->period_us;
+  float level = request->level;
+  uint16_t pre_trigger = request->pre_trigger;
+  return motorController.scope.Arm(period_us, (ScopeTrigger)request->trigger, (ScopeChannel)request->channel, level, pre_trigger);
+}
+
+static bool OnStopScope(MessageProcessor &processor, const uint8_t *msg)
+{
+  motorController.scope.Stop();
+  return true;
+}
+
+static bool OnGetScopeStatus(MessageProcessor &processor, const uint8_t *msg)
+{
+  ScopeStatusMessage *response = processor.BeginResponse<ScopeStatusMessage>(MessageTypes::GetScopeStatusId);
+  response->state = (uint8_t)motorController.scope.State();
+  response->count = motorController.scope.Count();
+  response->trigger_index = motorController.scope.TriggerIndex();
+  response->period_us = motorController.scope.Period();
+  processor.SendResponse(response);
+  return true;
+}
+
+static bool OnGetScopeData(MessageProcessor &processor, const uint8_t *msg)
+{
+  uint16_t first = ((const ScopeDataRequestMessage *)msg)->first;
+  ScopeDataMessage *response = processor.BeginResponse<ScopeDataMessage>(MessageTypes::GetScopeDataId);
+  static_assert(sizeof(response->samples) == SCOPE_CHUNK_SAMPLES * sizeof(ScopeSample), "Scope chunk size mismatch");
+  memset(response->samples, 0, sizeof(response->samples));
+  uint16_t count = motorController.scope.Read(first, response->samples, SCOPE_CHUNK_SAMPLES);
+  if (count == 0)
   {
-    MotorStateMessage *msg = (MotorStateMessage *)recv_bytes;
-    // DEBUG_PRINTF("Setting Motor State to: %d\n", msg->value);
-    motorController.SetMotorState((MotorStates)msg->value);
-    SendAck(MessageTypes::SetMotorStateId, StatusCodes::SUCCESS);
-    break;
+    // Not DONE, or past the end of the capture
+    return false;
   }
+  response->first = first;
+  response->count = (uint8_t)count;
+  processor.SendResponse(response);
+  return true;
+}
+
+static bool OnSubscribeTelemetry(MessageProcessor &processor, const uint8_t *msg)
+{
+  const TelemetrySubscriptionMessage *request = (const TelemetrySubscriptionMessage *)msg;
+  return processor.SubscribeTelemetry(request->fields, request->period_ms);
+}
+
+static bool OnSetChecksumMode(MessageProcessor &processor, const uint8_t *msg)
+{
+  uint8_t mode = ((const ChecksumModeMessage *)msg)->value;
+  if (mode > (uint8_t)ChecksumMode::CRC16 || !processor.HasInterface())
+    return false;
+  // Acked with the footer the request came with, the next message switches.
+  // Can't fail from here on, the host gets this one reply.
+  processor.SendAck(MessageTypes::SetChecksumModeId, StatusCodes::SUCCESS);
+  processor.SetChecksumMode((ChecksumMode)mode);
+  return true;
+}
+
+static bool OnGetChecksumMode(MessageProcessor &processor, const uint8_t *msg)
+{
+  return processor.SendValue<ChecksumModeMessage>(MessageTypes::GetChecksumModeId, (uint8_t)processor.GetChecksumMode());
+}
+
+static bool OnGetRejectedFrames(MessageProcessor &processor, const uint8_t *msg)
+{
+  const RejectedFrames &rejected = processor.GetRejectedFrames();
+  RejectedFramesMessage *response = processor.BeginResponse<RejectedFramesMessage>(MessageTypes::GetRejectedFramesId);
+  response->truncated = rejected.truncated;
+  response->checksum = rejected.checksum;
+  response->unknown_type = rejected.unknown_type;
+  response->body_size = rejected.body_size;
+  processor.SendResponse(response);
+  return true;
+}
+
+static bool OnBatch(MessageProcessor &processor, const uint8_t *msg)
+{
+  return processor.RunBatch(msg);
+}
+
+static bool OnHome(MessageProcessor &processor, const uint8_t *msg)
+{
+  motorController.Home();
+  return true;
+}
+
+static bool OnSetRelativeTargetPosition(MessageProcessor &processor, const uint8_t *msg)
+{
+  motorController.SetPositionTargetRelative(((const RelativeTargetPositionMessage *)msg)->value);
+  return true;
+}
+
+static bool OnSetVelocityAndSteps(MessageProcessor &processor, const uint8_t *msg)
+{
+  const VelocityAndStepsMessage *request = (const VelocityAndStepsMessage *)msg;
+  return motorController.AddVelocityStep(request->velocity, request->steps, request->positionMode);
+}
+
+static bool OnStartPath(MessageProcessor &processor, const uint8_t *msg)
+{
+  motorController.StartPath();
+  return true;
+}
+
+enum class MessageReply : uint8_t
+{
+  ACK,      // acked with the handler's status
+  RESPONSE, // the handler responds, acked only with ERROR
+};
+
+struct MessageEntry
+{
+  MessageTypes type;
+  uint16_t body_size; // of the request
+  MessageReply reply;
+  MessageHandler handler;
+};
+
+// Request body sizes
+#define BODY(msg_struct) (sizeof(msg_struct) - sizeof(Header) - sizeof(Footer))
+#define NO_BODY 0
+#define ANY_BODY 0xFFFF // checked by the handler
 
-  case MessageTypes::GetMotorStateId: // 0x0117
+// Every message the processor accepts, in id order. Anything else, or a
+// request whose body size doesn't match, is acked INVALID_COMMAND.
+static constexpr MessageEntry message_registry[] = {
+    {MessageTypes::AckId, BODY(AckMessage), MessageReply::RESPONSE, OnAck},
+    {MessageTypes::GetVersionId, NO_BODY, MessageReply::RESPONSE, OnGetVersion},
+    {MessageTypes::SetI2CAddressId, BODY(I2CAddressMessage), MessageReply::ACK, OnSetI2CAddress},
+    {MessageTypes::GetI2CAddressId, NO_BODY, MessageReply::RESPONSE, OnGetI2CAddress},
+    {MessageTypes::SetEthernetAddressId, BODY(EthernetAddressMessage), MessageReply::ACK, OnSetEthernetAddress},
+    {MessageTypes::GetEthernetAddressId, NO_BODY, MessageReply::RESPONSE, OnGetEthernetAddress},
+    {MessageTypes::SetEthernetPortId, BODY(EthernetPortMessage), MessageReply::ACK, OnSetEthernetPort},
+    {MessageTypes::GetEthernetPortId, NO_BODY, MessageReply::RESPONSE, OnGetEthernetPort},
+    {MessageTypes::GetMacAddressId, NO_BODY, MessageReply::RESPONSE, OnGetMacAddress},
+    {MessageTypes::SaveConfigurationId, BODY(SaveConfigurationMessage), MessageReply::ACK, OnSaveConfiguration},
+    {MessageTypes::SetLedColorId, BODY(LedColorMessage), MessageReply::ACK, OnSetLedColor},
+    {MessageTypes::GetLedColorId, NO_BODY, MessageReply::RESPONSE, OnGetLedColor},
+    {MessageTypes::AddLedStepId, BODY(AddLedStepMessage), MessageReply::ACK, OnAddLedStep},
+    {MessageTypes::SetHomeDirectionId, BODY(HomeDirectionMessage), MessageReply::ACK, OnSetHomeDirection},
+    {MessageTypes::GetHomeDirectionId, NO_BODY, MessageReply::RESPONSE, OnGetHomeDirection},
+    {MessageTypes::SetHomeThresholdId, BODY(HomeThresholdMessage), MessageReply::ACK, OnSetHomeThreshold},
+    {MessageTypes::GetHomeThresholdId, NO_BODY, MessageReply::RESPONSE, OnGetHomeThreshold},
+    {MessageTypes::SetHomeSpeedId, BODY(HomeSpeedMessage), MessageReply::ACK, OnSetHomeSpeed},
+    {MessageTypes::GetHomeSpeedId, NO_BODY, MessageReply::RESPONSE, OnGetHomeSpeed},
+    {MessageTypes::GetHomedStateId, NO_BODY, MessageReply::RESPONSE, OnGetHomedState},
+    {MessageTypes::SetMotorStateId, BODY(MotorStateMessage), MessageReply::ACK, OnSetMotorState},
+    {MessageTypes::GetMotorStateId, NO_BODY, MessageReply::RESPONSE, OnGetMotorState},
+    {MessageTypes::SetMotorBrakeId, BODY(MotorBrakeMessage), MessageReply::ACK, OnSetMotorBrake},
+    {MessageTypes::GetMotorBrakeId, NO_BODY, MessageReply::RESPONSE, OnGetMotorBrake},
+    {MessageTypes::SetMaxSpeedId, BODY(MaxSpeedMessage), MessageReply::ACK, OnSetMaxSpeed},
+    {MessageTypes::GetMaxSpeedId, NO_BODY, MessageReply::RESPONSE, OnGetMaxSpeed},
+    {MessageTypes::SetAccelerationId, BODY(AccelerationMessage), MessageReply::ACK, OnSetAcceleration},
+    {MessageTypes::GetAccelerationId, NO_BODY, MessageReply::RESPONSE, OnGetAcceleration},
+    {MessageTypes::SetCurrentPositionId, BODY(CurrentPositionMessage), MessageReply::ACK, OnSetCurrentPosition},
+    {MessageTypes::GetCurrentPositionId, NO_BODY, MessageReply::RESPONSE, OnGetCurrentPosition},
+    {MessageTypes::SetTargetPositionId, BODY(TargetPositionMessage), MessageReply::ACK, OnSetTargetPosition},
+    {MessageTypes::GetTargetPositionId, NO_BODY, MessageReply::RESPONSE, OnGetTargetPosition},
+    {MessageTypes::SetVelocityId, BODY(VelocityMessage), MessageReply::ACK, OnSetVelocity},
+    {MessageTypes::GetVelocityId, NO_BODY, MessageReply::RESPONSE, OnGetVelocity},
+    {MessageTypes::GetMotionQueueStatusId, NO_BODY, MessageReply::RESPONSE, OnGetMotionQueueStatus},
+    {MessageTypes::SetMotionProfileId, BODY(MotionProfileMessage), MessageReply::ACK, OnSetMotionProfile},
+    {MessageTypes::GetMotionProfileId, NO_BODY, MessageReply::RESPONSE, OnGetMotionProfile},
+    {MessageTypes::SetJerkId, BODY(JerkMessage), MessageReply::ACK, OnSetJerk},
+    {MessageTypes::GetJerkId, NO_BODY, MessageReply::RESPONSE, OnGetJerk},
+    {MessageTypes::SetPlannerDepthId, BODY(PlannerDepthMessage), MessageReply::ACK, OnSetPlannerDepth},
+    {MessageTypes::GetPlannerDepthId, NO_BODY, MessageReply::RESPONSE, OnGetPlannerDepth},
+    {MessageTypes::AddPvtPointId, BODY(PvtPointMessage), MessageReply::ACK, OnAddPvtPoint},
+    {MessageTypes::SetPvtDelayId, BODY(PvtDelayMessage), MessageReply::ACK, OnSetPvtDelay},
+    {MessageTypes::GetPvtDelayId, NO_BODY, MessageReply::RESPONSE, OnGetPvtDelay},
+    {MessageTypes::GetPvtStatusId, NO_BODY, MessageReply::RESPONSE, OnGetPvtStatus},
+    {MessageTypes::SetClosedLoopId, BODY(ClosedLoopMessage), MessageReply::ACK, OnSetClosedLoop},
+    {MessageTypes::GetClosedLoopId, NO_BODY, MessageReply::RESPONSE, OnGetClosedLoop},
+    {MessageTypes::SetClosedLoopGainsId, BODY(ClosedLoopGainsMessage), MessageReply::ACK, OnSetClosedLoopGains},
+    {MessageTypes::GetClosedLoopGainsId, NO_BODY, MessageReply::RESPONSE, OnGetClosedLoopGains},
+    {MessageTypes::GetClosedLoopStatusId, NO_BODY, MessageReply::RESPONSE, OnGetClosedLoopStatus},
+    {MessageTypes::SetStallWindowId, BODY(StallWindowMessage), MessageReply::ACK, OnSetStallWindow},
+    {MessageTypes::GetStallWindowId, NO_BODY, MessageReply::RESPONSE, OnGetStallWindow},
+    {MessageTypes::SetStallActionId, BODY(StallActionMessage), MessageReply::ACK, OnSetStallAction},
+    {MessageTypes::GetStallActionId, NO_BODY, MessageReply::RESPONSE, OnGetStallAction},
+    {MessageTypes::GetFollowingErrorId, NO_BODY, MessageReply::RESPONSE, OnGetFollowingError},
+    {MessageTypes::GetMotorErrorsId, NO_BODY, MessageReply::RESPONSE, OnGetMotorErrors},
+    {MessageTypes::ClearMotorErrorsId, NO_BODY, MessageReply::ACK, OnClearMotorErrors},
+    {MessageTypes::GetProfileId, BODY(ProfileRequestMessage), MessageReply::RESPONSE, OnGetProfile},
+    {MessageTypes::ResetProfileId, NO_BODY, MessageReply::ACK, OnResetProfile},
+    {MessageTypes::GetEncoderBusStatsId, NO_BODY, MessageReply::RESPONSE, OnGetEncoderBusStats},
+    {MessageTypes::SetEncoderObserverId, BODY(EncoderObserverMessage), MessageReply::ACK, OnSetEncoderObserver},
+    {MessageTypes::GetEncoderObserverId, NO_BODY, MessageReply::RESPONSE, OnGetEncoderObserver},
+    {MessageTypes::CalibrateEncoderId, NO_BODY, MessageReply::ACK, OnCalibrateEncoder},
+    {MessageTypes::GetEncoderCalibrationId, NO_BODY, MessageReply::RESPONSE, OnGetEncoderCalibration},
+    {MessageTypes::ClearEncoderCalibrationId, NO_BODY, MessageReply::ACK, OnClearEncoderCalibration},
+    {MessageTypes::ArmScopeId, BODY(ArmScopeMessage), MessageReply::ACK, OnArmScope},
+    {MessageTypes::StopScopeId, NO_BODY, MessageReply::ACK, OnStopScope},
+    {MessageTypes::GetScopeStatusId, NO_BODY, MessageReply::RESPONSE, OnGetScopeStatus},
+    {MessageTypes::GetScopeDataId, BODY(ScopeDataRequestMessage), MessageReply::RESPONSE, OnGetScopeData},
+    {MessageTypes::SubscribeTelemetryId, BODY(TelemetrySubscriptionMessage), MessageReply::ACK, OnSubscribeTelemetry},
+    {MessageTypes::SetChecksumModeId, BODY(ChecksumModeMessage), MessageReply::RESPONSE, OnSetChecksumMode},
+    {MessageTypes::GetChecksumModeId, NO_BODY, MessageReply::RESPONSE, OnGetChecksumMode},
+    {MessageTypes::GetRejectedFramesId, NO_BODY, MessageReply::RESPONSE, OnGetRejectedFrames},
+    {MessageTypes::BatchId, ANY_BODY, MessageReply::RESPONSE, OnBatch},
+    {MessageTypes::HomeId, BODY(HomeMessage), MessageReply::ACK, OnHome},
+    {MessageTypes::SetRelativeTargetPositionId, BODY(RelativeTargetPositionMessage), MessageReply::ACK, OnSetRelativeTargetPosition},
+    {MessageTypes::SetVelocityAndStepsId, BODY(VelocityAndStepsMessage), MessageReply::ACK, OnSetVelocityAndSteps},
+    {MessageTypes::StartPathId, BODY(StartPathMessage), MessageReply::ACK, OnStartPath},
+};
+
+#define MESSAGE_COUNT (sizeof(message_registry) / sizeof(message_registry[0]))
+#define MESSAGE_SLOT_EMPTY 0xFF
+
+static constexpr bool MessageHasSlot(uint16_t type)
+{
+  return (type >> 8) >= 1 && (type >> 8) <= MESSAGE_PAGES && (type & 0xFF) < MESSAGE_PAGE_SIZE;
+}
+
+static constexpr uint16_t MessageSlot(uint16_t type)
+{
+  return ((type >> 8) - 1) * MESSAGE_PAGE_SIZE + (type & 0xFF);
+}
+
+// Every id has a slot and comes after the one before it, which also rules
+// out an id registered twice
+static constexpr bool RegistryValid(const MessageEntry *entry, size_t count)
+{
+  return count == 0 ||
+         (MessageHasSlot((uint16_t)entry[0].type) &&
+          (count == 1 || (uint16_t)entry[0].type < (uint16_t)entry[1].type) &&
+          RegistryValid(entry + 1, count - 1));
+}
+
+static_assert(RegistryValid(message_registry, MESSAGE_COUNT), "Message registry ids must be in order and fit MESSAGE_SLOTS");
+static_assert(MESSAGE_COUNT < MESSAGE_SLOT_EMPTY, "Message registry doesn't fit the slot index");
+static_assert(sizeof(BatchResultMessage::status) == BATCH_MAX_COMMANDS, "Batch result doesn't match BATCH_MAX_COMMANDS");
+
+MessageProcessor::MessageProcessor(uint32_t period)
+{
+  executionPeriod = period;
+  memset(message_slots_, MESSAGE_SLOT_EMPTY, sizeof(message_slots_));
+  for (uint8_t i = 0; i < MESSAGE_COUNT; i++)
   {
-    MotorStateMessage *msg = (MotorStateMessage *)&send_buffer[0];
-    msg->header.message_type = (uint16_t)MessageTypes::GetMotorStateId;
-    msg->header.body_size = sizeof(MotorStateMessage::value);
-    msg->value = (uint8_t)motorController.GetMotorState();
-    msg->footer.checksum = CalculateChecksum((uint8_t *)msg, sizeof(MotorStateMessage) - sizeof(Footer));
-    SendMsg(send_buffer, sizeof(MotorStateMessage));
-    // DEBUG_PRINTF("Sending Motor State: %d\n", (uint8_t)motorController.GetMotorState());
-    break;
+    message_slots_[MessageSlot((uint16_t)message_registry[i].type)] = i;
   }
+}
+
+void MessageProcessor::AddExternalInterface(IExternalInterface *new_interface)
+{
+  externalInterfaces.push_back(new_interface);
+  new_interface->SetProcessorInterface(this);
+}
+
+void MessageProcessor::OnStart()
+{
+}
 
-  case MessageTypes::SetMotorBrakeId: // 0x0118
+void MessageProcessor::OnStop()
+{
+}
+
+void MessageProcessor::OnRun()
+{
+  IExternalInterface *destination = telemetry_interface_;
+  if (destination == nullptr)
+    return;
+  uint32_t now = millis();
+  if ((int32_t)(now - telemetry_next_ms_) < 0)
+    return;
+  telemetry_next_ms_ += telemetry_period_ms_;
+  if ((int32_t)(now - telemetry_next_ms_) >= 0)
   {
-    MotorBrakeMessage *msg = (MotorBrakeMessage *)&recv_bytes[0];
-    motorController.SetMotorBraking((MotorBrake)msg->value);
-    SendAck(MessageTypes::SetMotorBrakeId, StatusCodes::SUCCESS);
-    break;
+    // Fell behind, skip frames rather than send a burst
+    telemetry_next_ms_ = now + telemetry_period_ms_;
   }
+  SendTelemetry(destination);
+}
+
+bool MessageProcessor::SubscribeTelemetry(uint16_t fields, uint16_t period_ms)
+{
+  // Any subscription ends here, also when the new one is rejected
+  telemetry_interface_ = nullptr;
+  if (fields == 0 || period_ms == 0)
+    return true;
+  if ((fields & ~(uint16_t)TelemetryFields::ALL) != 0 || period_ms < TELEMETRY_MIN_PERIOD_MS)
+    return false;
 
-  case MessageTypes::GetMotorBrakeId: // 0x0119
+  telemetry_fields_ = fields;
+  telemetry_period_ms_ = period_ms;
+  telemetry_sequence_ = 0;
+  telemetry_next_ms_ = millis();
+  if (last_interface_ != nullptr)
+    last_interface_->SaveTelemetryDestination();
+  telemetry_interface_ = last_interface_;
+  return true;
+}
+
+template <typename T>
+static uint8_t *AppendValue(uint8_t *p, T value)
+{
+  memcpy(p, &value, sizeof(T));
+  return p + sizeof(T);
+}
+
+void MessageProcessor::SendTelemetry(IExternalInterface *destination)
+{
+  // All fields, 46 bytes
+  static_assert(sizeof(TelemetryHeader) + 6 * sizeof(float) + 2 * sizeof(uint8_t) + sizeof(uint32_t) + sizeof(Footer) <= sizeof(telemetry_buffer_),
+                "Telemetry frame doesn't fit its buffer");
+  // Own buffer, send_buffer holds the replies to messages
+  TelemetryHeader *hdr = (TelemetryHeader *)&telemetry_buffer_[0];
+  uint16_t fields = telemetry_fields_;
+  uint8_t *p = &telemetry_buffer_[sizeof(TelemetryHeader)];
+
+  if (fields & (uint16_t)TelemetryFields::POSITION)
+    p = AppendValue(p, (float)motorController.GetPosition());
+  if (fields & (uint16_t)TelemetryFields::TARGET_POSITION)
+    p = AppendValue(p, (float)motorController.GetPositionTarget());
+  if (fields & (uint16_t)TelemetryFields::VELOCITY)
+    p = AppendValue(p, (float)motorController.GetVelocityTarget());
+  if (fields & (uint16_t)TelemetryFields::MOTOR_STATE)
+    p = AppendValue(p, (uint8_t)motorController.GetMotorState());
+  if (fields & (uint16_t)TelemetryFields::HOMED)
+    p = AppendValue(p, (uint8_t)motorController.GetHomeState());
+  if (fields & (uint16_t)TelemetryFields::ENCODER_POSITION)
+    p = AppendValue(p, encoderController.GetPositionDegrees());
+  if (fields & (uint16_t)TelemetryFields::ENCODER_VELOCITY)
+    p = AppendValue(p, encoderController.GetVelocityDegreesPerSecond());
+  if (fields & (uint16_t)TelemetryFields::FOLLOWING_ERROR)
+    p = AppendValue(p, motorController.stall_detector.Error());
+  if (fields & (uint16_t)TelemetryFields::ERRORS)
+    p = AppendValue(p, motorController.GetErrors());
+
+  uint32_t size = p - telemetry_buffer_;
+  hdr->header.message_type = (uint16_t)MessageTypes::TelemetryId;
+  hdr->header.body_size = size - sizeof(Header);
+  hdr->sequence = telemetry_sequence_++;
+  hdr->time_ms = millis();
+  hdr->fields = fields;
+  p = AppendValue(p, FrameChecksum(destination->GetChecksumMode(), telemetry_buffer_, size));
+  destination->SendTelemetryMsg(telemetry_buffer_, p - telemetry_buffer_);
+}
+
+void MessageProcessor::HandleJsonMsg(uint8_t *recv_bytes, uint32_t recv_bytes_size)
+{
+}
+
+void MessageProcessor::HandleByteMsg(uint8_t *recv_bytes, uint32_t recv_bytes_size)
+{
+  PROFILE_SCOPE(ProfileProbe::MESSAGE);
+
+  addrLedController.AddLedStep(CRGB::Green, 10);
+  addrLedController.AddLedStep(CRGB::Black, 1);
+
+  DEBUG_PRINTF("Received %d bytes\n", recv_bytes_size);
+  // A serial read can hold several messages back to back
+  while (recv_bytes_size > 0)
   {
-    MotorBrakeMessage *msg = (MotorBrakeMessage *)&send_buffer[0];
-    msg->header.message_type = (uint16_t)MessageTypes::GetMotorBrakeId;
-    msg->header.body_size = sizeof(MotorBrakeMessage::value);
-    msg->value = (uint8_t)motorController.GetMotorBraking();
-    msg->footer.checksum = CalculateChecksum((uint8_t *)msg, sizeof(MotorBrakeMessage) - sizeof(Footer));
-    SendMsg(send_buffer, sizeof(MotorBrakeMessage));
-    break;
+    uint32_t used = HandleFrame(recv_bytes, recv_bytes_size);
+    if (used == 0)
+      break;
+    recv_bytes += used;
+    recv_bytes_size -= used;
   }
+  request_has_id_ = false;
+}
 
-  case MessageTypes::SetMaxSpeedId: // 0x011A
+// Checks and runs the message at the start of `frame`. Returns its size, or
+// zero when the rest of `frame` can't be trusted.
+uint32_t MessageProcessor::HandleFrame(const uint8_t *frame, uint32_t size)
+{
+  request_has_id_ = false;
+  reply_checksum_mode_ = GetChecksumMode();
+  if (size < sizeof(Header) + sizeof(Footer))
   {
-    MaxSpeedMessage *msg = (MaxSpeedMessage *)&recv_bytes[0];
-    motorController.SetMaxSpeed(msg->value);
-    SendAck(MessageTypes::SetMaxSpeedId, StatusCodes::SUCCESS);
-    break;
+    DEBUG_PRINTF("Dropped %d byte fragment\n", size);
+    rejected_.truncated++;
+    return 0;
   }
-
-  case MessageTypes::GetMaxSpeedId: // 0x011B
+  Header hdr;
+  memcpy(&hdr, frame, sizeof(Header));
+  MessageTypes type = (MessageTypes)(hdr.message_type & ~REQUEST_ID_FLAG);
+  uint32_t frame_size = sizeof(Header) + hdr.body_size + sizeof(Footer);
+  if (frame_size > size)
   {
-    MaxSpeedMessage *msg = (MaxSpeedMessage *)&send_buffer[0];
-    msg->header.message_type = (uint16_t)MessageTypes::GetMaxSpeedId;
-    msg->header.body_size = sizeof(MaxSpeedMessage::value);
-    msg->value = motorController.GetMaxSpeed();
-    msg->footer.checksum = CalculateChecksum((uint8_t *)msg, sizeof(MaxSpeedMessage) - sizeof(Footer));
-    SendMsg(send_buffer, sizeof(MaxSpeedMessage));
-    break;
+    // Cut short, or body_size is garbage
+    DEBUG_PRINTF("Truncated message type: 0x%x\n", hdr.message_type);
+    rejected_.truncated++;
+    SendAck(type, StatusCodes::INVALID_COMMAND);
+    return 0;
   }
-
-  case MessageTypes::SetAccelerationId: // 0x011C
+  Footer footer;
+  memcpy(&footer, frame + frame_size - sizeof(Footer), sizeof(Footer));
+  ChecksumMode mode = reply_checksum_mode_;
+  bool checksum_ok;
   {
-    AccelerationMessage *msg = (AccelerationMessage *)&recv_bytes[0];
-    motorController.SetAcceleration(msg->value);
-    SendAck(MessageTypes::SetAccelerationId, StatusCodes::SUCCESS);
-    break;
+    PROFILE_SCOPE(ProfileProbe::CHECKSUM);
+    checksum_ok = footer.checksum == FrameChecksum(mode, frame, frame_size - sizeof(Footer));
   }
-
-  case MessageTypes::GetAccelerationId: // 0x011D
+  if (!checksum_ok && type == MessageTypes::SetChecksumModeId)
   {
-    AccelerationMessage *msg = (AccelerationMessage *)&send_buffer[0];
-    msg->header.message_type = (uint16_t)MessageTypes::GetAccelerationId;
-    msg->header.body_size = sizeof(AccelerationMessage::value);
-    msg->value = motorController.GetAcceleration();
-    msg->footer.checksum = CalculateChecksum((uint8_t *)msg, sizeof(AccelerationMessage) - sizeof(Footer));
-    SendMsg(send_buffer, sizeof(AccelerationMessage));
-    break;
+    // Either footer switches modes, a host that missed the ack of its last
+    // switch can still get back in step. Replies use the footer it matched,
+    // the interface only switches once OnSetChecksumMode() accepts the mode.
+    ChecksumMode other = mode == ChecksumMode::SUM ? ChecksumMode::CRC16 : ChecksumMode::SUM;
+    checksum_ok = footer.checksum == FrameChecksum(other, frame, frame_size - sizeof(Footer));
+    if (checksum_ok)
+      reply_checksum_mode_ = other;
   }
-
-  case MessageTypes::SetCurrentPositionId: // 0x011E
+  if (!checksum_ok)
   {
-    CurrentPositionMessage *msg = (CurrentPositionMessage *)&recv_bytes[0];
-    motorController.SetPosition(msg->value);
-    SendAck(MessageTypes::SetCurrentPositionId, StatusCodes::SUCCESS);
-    break;
+    // The header may be corrupted too, body_size included
+    DEBUG_PRINTF("Bad checksum for message type: 0x%x\n", hdr.message_type);
+    rejected_.checksum++;
+    SendAck(type, StatusCodes::INVALID_COMMAND);
+    return 0;
   }
 
-  case MessageTypes::GetCurrentPositionId: // 0x011F
+  if (hdr.message_type & REQUEST_ID_FLAG)
   {
-    //DEBUG_PRINTLN("Getting Current Position");
-    CurrentPositionMessage *msg = (CurrentPositionMessage *)send_buffer;
-    msg->header.message_type = (uint16_t)MessageTypes::GetCurrentPositionId;
-    msg->header.body_size = sizeof(CurrentPositionMessage::value);
-    msg->value = motorController.GetPosition();
-    msg->footer.checksum = CalculateChecksum((uint8_t *)msg, sizeof(CurrentPositionMessage) - sizeof(Footer));
-    SendMsg(send_buffer, sizeof(CurrentPositionMessage));
-    break;
+    if (hdr.body_size < sizeof(uint16_t))
+    {
+      DEBUG_PRINTF("No request id in message type: 0x%x\n", hdr.message_type);
+      rejected_.body_size++;
+      SendAck(type, StatusCodes::INVALID_COMMAND);
+      return frame_size;
+    }
+    hdr.body_size -= sizeof(uint16_t);
+    memcpy(&request_id_, frame + sizeof(Header) + hdr.body_size, sizeof(uint16_t));
+    request_body_crc_ = ChecksumCrc16(frame + sizeof(Header), hdr.body_size);
+    request_has_id_ = true;
+    if (ResendReply(type))
+      return frame_size;
   }
 
-  case MessageTypes::SetTargetPositionId: // 0x0120
+  uint8_t index = MessageIndex((uint16_t)type);
+  if (index == MESSAGE_SLOT_EMPTY || (message_registry[index].body_size != ANY_BODY && hdr.body_size != message_registry[index].body_size))
   {
-    TargetPositionMessage *msg = (TargetPositionMessage *)recv_bytes;
-    // DEBUG_PRINTF("Setting Motor Position to: %f\n", msg->value);
-    motorController.SetPositionTarget(msg->value);
-    SendAck(MessageTypes::SetTargetPositionId, StatusCodes::SUCCESS);
-    break;
+    DEBUG_PRINTF("Unable to handle message type: 0x%x, %d byte body\n", hdr.message_type, hdr.body_size);
+    if (index == MESSAGE_SLOT_EMPTY)
+      rejected_.unknown_type++;
+    else
+      rejected_.body_size++;
+    SendAck(type, StatusCodes::INVALID_COMMAND);
+    return frame_size;
   }
 
-  case MessageTypes::GetTargetPositionId: // 0x0121
+  // The request id sits after the body, handlers see the header and body
+  // as usual
+  const MessageEntry &entry = message_registry[index];
+  if (request_has_id_ && entry.reply == MessageReply::ACK)
+    RecordReply(type);
+  bool ok = entry.handler(*this, frame);
+  if (entry.reply == MessageReply::ACK || !ok)
+    SendAck(type, ok ? StatusCodes::SUCCESS : StatusCodes::ERROR);
+  recording_ = nullptr;
+  return frame_size;
+}
+
+// Starts keeping the reply to the current request for its retries, in
+// place of the oldest one kept
+void MessageProcessor::RecordReply(MessageTypes type)
+{
+  recording_ = &recent_[recent_next_];
+  recent_next_ = (recent_next_ + 1) % REQUEST_HISTORY;
+  recording_->source = last_interface_;
+  recording_->sender = last_interface_ != nullptr ? last_interface_->Sender() : 0;
+  recording_->request_id = request_id_;
+  recording_->message_type = (uint16_t)type;
+  recording_->body_crc = request_body_crc_;
+  recording_->reply_size = 0;
+}
+
+// Sends the kept reply again when the current request is a retry of a
+// recent one. Gets aren't kept and run again, they don't change anything.
+bool MessageProcessor::ResendReply(MessageTypes type)
+{
+  uint64_t sender = last_interface_ != nullptr ? last_interface_->Sender() : 0;
+  for (RecentRequest &recent : recent_)
   {
-    TargetPositionMessage *msg = (TargetPositionMessage *)&send_buffer[0];
-    msg->header.message_type = (uint16_t)MessageTypes::GetTargetPositionId;
-    msg->header.body_size = sizeof(TargetPositionMessage::value);
-    msg->value = motorController.GetPositionTarget();
-    msg->footer.checksum = CalculateChecksum((uint8_t *)msg, sizeof(TargetPositionMessage) - sizeof(Footer));
-    SendMsg(send_buffer, sizeof(TargetPositionMessage));
-    break;
+    // A new command that reuses an id, e.g. from a restarted host, has to run
+    if (recent.reply_size == 0 || recent.source != last_interface_ || recent.sender != sender ||
+        recent.request_id != request_id_ || recent.message_type != (uint16_t)type ||
+        recent.body_crc != request_body_crc_)
+      continue;
+    DEBUG_PRINTF("Retry of request %d, not run again\n", request_id_);
+    memcpy(send_buffer, recent.reply, recent.reply_size);
+    SendFrame(send_buffer, recent.reply_size);
+    return true;
   }
+  return false;
+}
 
-  case MessageTypes::SetRelativeTargetPositionId: // 0x0122
+// Sends the `size` bytes of header and body at `frame`, in send_buffer,
+// with the request id of the current request if it had one and the footer
+void MessageProcessor::SendFrame(uint8_t *frame, uint32_t size)
+{
+  if (recording_ != nullptr && size <= sizeof(recording_->reply))
   {
-    RelativeTargetPositionMessage *msg = (RelativeTargetPositionMessage *)recv_bytes;
-    motorController.SetPositionTargetRelative(msg->value);
-    // DEBUG_PRINTF("Setting Motor Position Relative: %f\n", msg->value);
-    SendAck(MessageTypes::SetRelativeTargetPositionId, StatusCodes::SUCCESS);
-    break;
+    memcpy(recording_->reply, frame, size);
+    recording_->reply_size = size;
   }
-
-  case MessageTypes::SetVelocityId: // 0x0123
+  if (request_has_id_)
   {
-    VelocityMessage *msg = (VelocityMessage *)recv_bytes;
-    motorController.SetVelocityTarget(msg->value);
-    // DEBUG_PRINTF("Setting Motor Velocity to: %d\n", msg->value);
-    SendAck(MessageTypes::SetVelocityId, StatusCodes::SUCCESS);
-    break;
+    Header *hdr = (Header *)frame;
+    hdr->message_type |= REQUEST_ID_FLAG;
+    hdr->body_size += sizeof(uint16_t);
+    memcpy(frame + size, &request_id_, sizeof(uint16_t));
+    size += sizeof(uint16_t);
   }
+  uint16_t checksum = FrameChecksum(reply_checksum_mode_, frame, size);
+  memcpy(frame + size, &checksum, sizeof(Footer));
+  SendMsg(frame, size + sizeof(Footer));
+}
+
+// Registry index of `type`, MESSAGE_SLOT_EMPTY when it isn't registered
+uint8_t MessageProcessor::MessageIndex(uint16_t type)
+{
+  return MessageHasSlot(type) ? message_slots_[MessageSlot(type)] : MESSAGE_SLOT_EMPTY;
+}
 
-  case MessageTypes::GetVelocityId: // 0x0124
+// The batch body is the commands back to back, each a header and body
+// without a footer, the batch footer covers them. Only messages acked with
+// a status can be batched. The whole batch is checked before any command
+// runs, one that doesn't parse runs nothing and is acked INVALID_COMMAND.
+// Otherwise they run in order up to the first that doesn't succeed.
+bool MessageProcessor::RunBatch(const uint8_t *msg)
+{
+  Header batch;
+  memcpy(&batch, msg, sizeof(Header));
+  if (request_has_id_)
+    batch.body_size -= sizeof(uint16_t);
+  const uint8_t *commands[BATCH_MAX_COMMANDS];
+  uint8_t handlers[BATCH_MAX_COMMANDS];
+  uint8_t count = 0;
+  const uint8_t *p = msg + sizeof(Header);
+  const uint8_t *end = p + batch.body_size;
+  while (p < end)
   {
-    VelocityMessage *msg = (VelocityMessage *)&send_buffer[0];
-    msg->header.message_type = (uint16_t)MessageTypes::GetVelocityId;
-    msg->header.body_size = sizeof(VelocityMessage::value);
-    msg->value = motorController.GetVelocityTarget();
-    msg->footer.checksum = CalculateChecksum((uint8_t *)msg, sizeof(VelocityMessage) - sizeof(Footer));
-    SendMsg(send_buffer, sizeof(VelocityMessage));
-    break;
+    Header hdr;
+    uint8_t index = MESSAGE_SLOT_EMPTY;
+    if (count < BATCH_MAX_COMMANDS && end - p >= (int32_t)sizeof(Header))
+    {
+      memcpy(&hdr, p, sizeof(Header));
+      index = MessageIndex(hdr.message_type);
+    }
+    if (index == MESSAGE_SLOT_EMPTY || message_registry[index].reply != MessageReply::ACK ||
+        hdr.body_size != message_registry[index].body_size || end - p < (int32_t)(sizeof(Header) + hdr.body_size))
+    {
+      DEBUG_PRINTF("Batch command %d doesn't parse\n", count);
+      rejected_.body_size++;
+      SendAck(MessageTypes::BatchId, StatusCodes::INVALID_COMMAND);
+      return true;
+    }
+    commands[count] = p;
+    handlers[count++] = index;
+    p += sizeof(Header) + hdr.body_size;
   }
 
-  case MessageTypes::SetVelocityAndStepsId: // 0x0125
+  StatusCodes status[BATCH_MAX_COMMANDS];
+  uint8_t run = 0;
+  while (run < count)
   {
-    VelocityAndStepsMessage *msg = (VelocityAndStepsMessage *)&recv_bytes[0];
-    motorController.AddVelocityStep(msg->velocity, msg->steps, msg->positionMode);
-    // DEBUG_PRINTF("Velocity: %d, Steps: %d, Position Mode: %d\n", msg->velocity, msg->steps, msg->positionMode);
-    SendAck(MessageTypes::SetVelocityAndStepsId, StatusCodes::SUCCESS);
-    break;
+    bool ok = message_registry[handlers[run]].handler(*this, commands[run]);
+    status[run++] = ok ? StatusCodes::SUCCESS : StatusCodes::ERROR;
+    if (!ok)
+      break;
   }
 
-  case MessageTypes::StartPathId: // 0x0126
-    motorController.StartPath();
-    SendAck(MessageTypes::StartPathId, StatusCodes::SUCCESS);
-    break;
-
-  default:
-    DEBUG_PRINTF("Unable to handle message type: 0x%x", hdr->message_type);
-    break;
-  }
+  // Running it again for a retry would repeat the commands
+  if (request_has_id_)
+    RecordReply(MessageTypes::BatchId);
+  BatchResultMessage *response = BeginResponse<BatchResultMessage>(MessageTypes::BatchId);
+  memset(response->status, 0, sizeof(response->status));
+  response->count = run;
+  for (uint8_t i = 0; i < run; i++)
+    response->status[i] = (uint8_t)status[i];
+  SendResponse(response);
+  return true;
 }
 
 void MessageProcessor::HandleIncomingMsg(uint8_t *recv_bytes, uint32_t recv_bytes_size, IExternalInterface *calling_interface)
@@ -471,16 +1068,13 @@ void MessageProcessor::SendAck(MessageTypes msg_type, StatusCodes status)
   ack_msg->header.body_size = sizeof(AckMessage::ack_message_type) + sizeof(AckMessage::status);
   ack_msg->ack_message_type = (uint16_t)msg_type;
   ack_msg->status = (uint8_t)status;
-  ack_msg->footer.checksum = CalculateChecksum((uint8_t *)ack_msg, sizeof(AckMessage) - sizeof(Footer));
-  SendMsg(send_buffer, sizeof(AckMessage));
+  SendFrame(send_buffer, sizeof(AckMessage) - sizeof(Footer));
 }
 
-uint16_t MessageProcessor::CalculateChecksum(uint8_t *data, uint32_t size)
+bool MessageProcessor::SetChecksumMode(ChecksumMode mode)
 {
-  uint16_t checksum = 0;
-  for (uint32_t i = 0; i < size; ++i)
-  {
-    checksum += data[i];
-  }
-  return checksum;
+  if (last_interface_ == nullptr)
+    return false;
+  last_interface_->SetChecksumMode(mode);
+  return true;
 }
\ No newline at end of file
@@ -2,9 +2,25 @@
 
 #include <cstdint>
 #include "AxisMessages.h"
+#include "Checksum.h"
 #include <ArduinoJson.h>
 #include "Task/Task.h"
 
+// Shortest telemetry push period
+#define TELEMETRY_MIN_PERIOD_MS 2
+
+// Dispatch table size. Message ids are 0xPPNN with page PP from 1 and NN
+// under MESSAGE_PAGE_SIZE, each id has one slot.
+#define MESSAGE_PAGES 4
+#define MESSAGE_PAGE_SIZE 64
+#define MESSAGE_SLOTS (MESSAGE_PAGES * MESSAGE_PAGE_SIZE)
+
+// Commands in one BatchId request, matches BatchResultMessage::status
+#define BATCH_MAX_COMMANDS 16
+
+// Replies kept for retries of requests with an id, see REQUEST_ID_FLAG
+#define REQUEST_HISTORY 8
+
 class IExternalInterface; // Forward declaration
 
 class IProcessorInterface
@@ -19,10 +35,26 @@ class IExternalInterface
 {
 protected:
   IProcessorInterface *processor_interface_ = nullptr;
+  ChecksumMode checksum_mode_ = ChecksumMode::SUM;
 
 public:
   virtual void SendMsg(uint8_t *send_bytes, uint32_t send_bytes_size) = 0;
 
+  // Host the current message came from, on interfaces that answer several
+  virtual uint64_t Sender() { return 0; }
+
+  // Telemetry goes to the host that subscribed, interfaces that answer
+  // several hosts remember the one the current message came from
+  virtual void SaveTelemetryDestination() {}
+  virtual void SendTelemetryMsg(uint8_t *send_bytes, uint32_t send_bytes_size)
+  {
+    SendMsg(send_bytes, send_bytes_size);
+  }
+
+  // Footer the host on this interface negotiated, see SetChecksumModeId
+  ChecksumMode GetChecksumMode() { return checksum_mode_; }
+  void SetChecksumMode(ChecksumMode mode) { checksum_mode_ = mode; }
+
   void SetProcessorInterface(IProcessorInterface *proc_interface)
   {
     processor_interface_ = proc_interface;
@@ -43,14 +75,64 @@ public:
   }
 };
 
+// Frames HandleByteMsg() turned away, by reason
+struct RejectedFrames
+{
+  uint32_t truncated;    // shorter than their body_size
+  uint32_t checksum;     // footer doesn't match
+  uint32_t unknown_type; // no handler registered
+  uint32_t body_size;    // body_size isn't the registered one
+};
+
+// Reply to a recent request with an id, sent again for a retry of it
+// instead of running it twice. Without its id and footer. A retry comes from
+// the same host with the same id, type and body.
+struct RecentRequest
+{
+  IExternalInterface *source;
+  uint64_t sender;
+  uint16_t request_id;
+  uint16_t message_type;
+  uint16_t body_crc;
+  uint8_t reply_size; // zero when nothing was kept
+  uint8_t reply[sizeof(BatchResultMessage) - sizeof(Footer)];
+};
+
 class MessageProcessor : public ITask, public IProcessorInterface
 {
 private:
   std::vector<IExternalInterface *> externalInterfaces; // Vector to hold pointers to interfaces
   IExternalInterface *last_interface_ = nullptr;
   uint8_t send_buffer[1024];
-  void SendAck(MessageTypes msg_type, StatusCodes status);
-  uint16_t CalculateChecksum(uint8_t *data, uint32_t size);
+  RejectedFrames rejected_ = {};
+
+  // Registry index of each message id, filled in by the constructor
+  uint8_t message_slots_[MESSAGE_SLOTS];
+  uint8_t MessageIndex(uint16_t type);
+  uint32_t HandleFrame(const uint8_t *frame, uint32_t size);
+
+  // Request id of the message being handled, echoed by SendFrame()
+  bool request_has_id_ = false;
+  uint16_t request_id_ = 0;
+  uint16_t request_body_crc_ = 0;
+  // Footer the message being handled came with, replies use it
+  ChecksumMode reply_checksum_mode_ = ChecksumMode::SUM;
+  RecentRequest recent_[REQUEST_HISTORY] = {};
+  uint8_t recent_next_ = 0;
+  RecentRequest *recording_ = nullptr;
+  void RecordReply(MessageTypes type);
+  bool ResendReply(MessageTypes type);
+  void SendFrame(uint8_t *frame, uint32_t size);
+
+  // Telemetry subscription, pushed from OnRun() to the interface that
+  // subscribed. One subscriber at a time.
+  uint8_t telemetry_buffer_[64];
+  IExternalInterface *telemetry_interface_ = nullptr;
+  uint16_t telemetry_fields_ = 0;
+  uint16_t telemetry_period_ms_ = 0;
+  uint32_t telemetry_next_ms_ = 0;
+  uint32_t telemetry_sequence_ = 0;
+  void SendTelemetry(IExternalInterface *destination);
 public:
   MessageProcessor(uint32_t period);
 
@@ -65,4 +147,54 @@ public:
   void HandleIncomingMsg(uint8_t *recv_bytes, uint32_t recv_bytes_size, IExternalInterface* calling_interface);
 
   void SendMsg(uint8_t *send_bytes, uint32_t send_bytes_size);
+  void SendAck(MessageTypes msg_type, StatusCodes status);
+
+  // Footer of the interface replies go to
+  ChecksumMode GetChecksumMode()
+  {
+    return last_interface_ != nullptr ? last_interface_->GetChecksumMode() : ChecksumMode::SUM;
+  }
+  // The current message came in on an interface, SetChecksumMode() needs one
+  bool HasInterface() { return last_interface_ != nullptr; }
+  // For the interface of the current message, false without one
+  bool SetChecksumMode(ChecksumMode mode);
+
+  const RejectedFrames &GetRejectedFrames() { return rejected_; }
+
+  // Runs the commands of a BatchId request in order and answers them all
+  // with one BatchResultMessage
+  bool RunBatch(const uint8_t *msg);
+
+  // Response of type T in the send buffer, with its header filled in
+  template <typename T>
+  T *BeginResponse(MessageTypes type)
+  {
+    static_assert(sizeof(T) + sizeof(uint16_t) <= sizeof(send_buffer), "Response and request id don't fit the send buffer");
+    T *msg = (T *)&send_buffer[0];
+    msg->header.message_type = (uint16_t)type;
+    msg->header.body_size = sizeof(T) - sizeof(Header) - sizeof(Footer);
+    return msg;
+  }
+
+  // Sends a response from BeginResponse()
+  template <typename T>
+  void SendResponse(T *msg)
+  {
+    SendFrame((uint8_t *)msg, sizeof(T) - sizeof(Footer));
+  }
+
+  // Response with a single value field, U8Message and the like
+  template <typename T, typename V>
+  bool SendValue(MessageTypes type, V value)
+  {
+    T *msg = BeginResponse<T>(type);
+    msg->value = value;
+    SendResponse(msg);
+    return true;
+  }
+
+  // Pushes the `fields` every `period_ms` to the interface of the current
+  // message, zero for either stops it. False for unknown fields or a period
+  // under TELEMETRY_MIN_PERIOD_MS.
+  bool SubscribeTelemetry(uint16_t fields, uint16_t period_ms);
 };
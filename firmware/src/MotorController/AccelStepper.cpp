@@ -5,6 +5,10 @@
 
 #include "AccelStepper.h"
 
+#ifdef ACCELSTEPPER_PORT_IO
+#define PORT_IO_WAIT_4 __asm__ volatile("nop\n\tnop\n\tnop\n\tnop")
+#endif
+
 #if 0
 // Some debugging assistance
 void dump(uint8_t* p, int l)
@@ -25,6 +29,7 @@ void AccelStepper::moveTo(long absolute)
     if (_targetPos != absolute)
     {
 	_targetPos = absolute;
+	_aheadValid = false;
 	computeNewSpeed();
 	// compute new n?
     }
@@ -45,7 +50,11 @@ boolean AccelStepper::runSpeed()
 	return false;
 
     unsigned long time = micros();   
-    if (time - _lastStepTime >= _stepInterval_us)
+    unsigned long elapsed = time - _lastStepTime;
+    // With absolute scheduling the step timer is what decides when to step,
+    // allow it to fire a little before the deadline
+    unsigned long slack = _absoluteScheduling ? ACCELSTEPPER_SCHEDULE_SLACK_US : 0;
+    if (elapsed + slack >= _stepInterval_us)
     {
 	if (_direction == DIRECTION_CW)
 	{
@@ -59,7 +68,19 @@ boolean AccelStepper::runSpeed()
 	}
 	step(_currentPos);
 
-	_lastStepTime = time; // Caution: does not account for costs in step()
+	if (_absoluteScheduling && elapsed < 2 * _stepInterval_us)
+	{
+	    // The next deadline is exactly one interval after this one, however
+	    // late this step was. Fractions of a microsecond are carried forward.
+	    _stepFracAccum += _stepIntervalFrac;
+	    _lastStepTime += _stepInterval_us + (_stepFracAccum >> 8);
+	    _stepFracAccum &= 0xFF;
+	}
+	else
+	{
+	    _lastStepTime = time; // Caution: does not account for costs in step()
+	    _stepFracAccum = 0;
+	}
 
 	return true;
     }
@@ -89,23 +110,44 @@ long AccelStepper::currentPosition()
 void AccelStepper::setCurrentPosition(long position)
 {
     _targetPos = _currentPos = position;
+    _aheadValid = false;
     _step_counter = 0;
     _stepInterval_us = 0;
+    _stepIntervalFrac = 0;
     _speed = 0.0;
+    _speedStale = false;
 }
 
 // Subclasses can override
 unsigned long AccelStepper::computeNewSpeed()
 {
+    if (_aheadValid && _ahead.position == _currentPos)
+    {
+	// Already worked out by intervalAfterNextStepUs()
+	loadRampState(_ahead);
+	_aheadValid = false;
+	return _stepInterval_us;
+    }
+    _aheadValid = false;
+
     long distanceTo = distanceToGo(); // +ve is clockwise from curent location
 
-    long stepsToStop = (long)((_speed * _speed) / (2.0 * _acceleration)); // Equation 16
+    long stepsToStop;
+    if (_integerRamp)
+    {
+	_ramp.Sync(_stepInterval_us); // in case setSpeed() changed it
+	stepsToStop = _ramp.StepsToStop(); // Equation 16
+    }
+    else
+	stepsToStop = (long)((_speed * _speed) / (2.0 * _acceleration)); // Equation 16
 
     if (distanceTo == 0 && stepsToStop <= 1)
     {
 	// We are at the target and its time to stop
 	_stepInterval_us = 0;
+	_stepIntervalFrac = 0;
 	_speed = 0.0;
+	_speedStale = false;
 	_step_counter = 0;
 	return _stepInterval_us;
     }
@@ -152,14 +194,28 @@ unsigned long AccelStepper::computeNewSpeed()
 	_cn = _c0;
 	_direction = (distanceTo > 0) ? DIRECTION_CW : DIRECTION_CCW;
     }
-    else
+    else if (!_integerRamp)
     {
 	// Subsequent step. Works for accel (n is +_ve) and decel (n is -ve).
 	_cn = _cn - ((2.0 * _cn) / ((4.0 * _step_counter) + 1)); // Equation 13
 	_cn = max(_cn, _cmin); 
     }
+
+    if (_integerRamp)
+    {
+	// Equation 13 in integer math, no floating point per step
+	_stepInterval_us = _ramp.Next(_step_counter);
+	_stepIntervalFrac = _ramp.IntervalFrac();
+	_step_counter++;
+	// Only the sign of _speed is kept here, see currentSpeed()
+	_speed = (_direction == DIRECTION_CCW) ? -1.0 : 1.0;
+	_speedStale = true;
+	return _stepInterval_us;
+    }
+
     _step_counter++;
     _stepInterval_us = _cn;
+    _stepIntervalFrac = (uint8_t)((_cn - _stepInterval_us) * 256.0);
     _speed = 1000000.0 / _cn;
     if (_direction == DIRECTION_CCW)
 	_speed = -_speed;
@@ -199,6 +255,9 @@ AccelStepper::AccelStepper(uint8_t interface, uint8_t pin1, uint8_t pin2, uint8_
     _acceleration = 0.0;
     _sqrt_twoa = 1.0;
     _stepInterval_us = 0;
+    _stepIntervalFrac = 0;
+    _stepFracAccum = 0;
+    _absoluteScheduling = false;
     _minPulseWidth = 1;
     _enablePin = 0xff;
     _lastStepTime = 0;
@@ -214,10 +273,18 @@ AccelStepper::AccelStepper(uint8_t interface, uint8_t pin1, uint8_t pin2, uint8_
     _cn = 0.0;
     _cmin = 1.0;
     _direction = DIRECTION_CCW;
+    _speedStale = false;
+    _aheadValid = false;
+#ifdef ACCELSTEPPER_INTEGER_RAMP
+    _integerRamp = true;
+#else
+    _integerRamp = false;
+#endif
 
     int i;
     for (i = 0; i < 4; i++)
 	_pinInverted[i] = 0;
+    resolvePortPins();
     if (enable)
 	enableOutputs();
     // Some reasonable default
@@ -235,6 +302,9 @@ AccelStepper::AccelStepper(void (*forward)(), void (*backward)())
     _acceleration = 0.0;
     _sqrt_twoa = 1.0;
     _stepInterval_us = 0;
+    _stepIntervalFrac = 0;
+    _stepFracAccum = 0;
+    _absoluteScheduling = false;
     _minPulseWidth = 1;
     _enablePin = 0xff;
     _lastStepTime = 0;
@@ -251,6 +321,13 @@ AccelStepper::AccelStepper(void (*forward)(), void (*backward)())
     _cn = 0.0;
     _cmin = 1.0;
     _direction = DIRECTION_CCW;
+    _speedStale = false;
+    _aheadValid = false;
+#ifdef ACCELSTEPPER_INTEGER_RAMP
+    _integerRamp = true;
+#else
+    _integerRamp = false;
+#endif
 
     int i;
     for (i = 0; i < 4; i++)
@@ -267,11 +344,14 @@ void AccelStepper::setMaxSpeed(float speed)
     if (_maxSpeed != speed)
     {
 	_maxSpeed = speed;
+	_aheadValid = false;
 	_cmin = 1000000.0 / speed;
+	_ramp.SetMaxSpeed(speed);
 	// Recompute _n from current speed and adjust speed if accelerating or cruising
 	if (_step_counter > 0)
 	{
-	    _step_counter = (long)((_speed * _speed) / (2.0 * _acceleration)); // Equation 16
+	    float currSpeed = currentSpeed();
+	    _step_counter = (long)((currSpeed * currSpeed) / (2.0 * _acceleration)); // Equation 16
 	    computeNewSpeed();
 	}
     }
@@ -290,10 +370,12 @@ void AccelStepper::setAcceleration(float acceleration)
       acceleration = -acceleration;
     if (_acceleration != acceleration)
     {
+	_aheadValid = false;
 	// Recompute _n per Equation 17
 	_step_counter = _step_counter * (_acceleration / acceleration);
 	// New c0 per Equation 7, with correction per Equation 15
 	_c0 = 0.676 * sqrt(2.0 / acceleration) * 1000000.0; // Equation 15
+	_ramp.SetAcceleration(acceleration);
 	_acceleration = acceleration;
 	computeNewSpeed();
     }
@@ -307,24 +389,162 @@ float   AccelStepper::acceleration()
 void AccelStepper::setSpeed(float speed)
 {
     //Serial.printf("Setting Speed: %f\n", speed);
-    if (speed == _speed)
+    if (!_speedStale && speed == _speed)
         return;
     speed = constrain(speed, -_maxSpeed, _maxSpeed);
+    _aheadValid = false;
     if (speed == 0.0)
+    {
 	_stepInterval_us = 0;
+	_stepIntervalFrac = 0;
+    }
     else
     {
-	_stepInterval_us = fabs(1000000.0 / speed);
+	double interval = fabs(1000000.0 / speed);
+	_stepInterval_us = interval;
+	_stepIntervalFrac = (uint8_t)((interval - _stepInterval_us) * 256.0);
 	_direction = (speed > 0.0) ? DIRECTION_CW : DIRECTION_CCW;
     }
     _speed = speed;
+    _speedStale = false;
+}
+
+void AccelStepper::setStepInterval(unsigned long interval_us, uint8_t interval_frac, bool clockwise)
+{
+    _aheadValid = false;
+    _stepInterval_us = interval_us;
+    _stepIntervalFrac = interval_frac;
+    _direction = clockwise ? DIRECTION_CW : DIRECTION_CCW;
+    if (interval_us == 0)
+    {
+	_speed = 0.0;
+	_step_counter = 0;
+    }
+    else
+    {
+	_cn = interval_us + interval_frac * (1.0f / 256.0f);
+	_speed = clockwise ? 1000000.0f / _cn : -1000000.0f / _cn;
+	// Steps to stop from this speed, so computeNewSpeed() carries on
+	// decelerating or accelerating from here (Equation 16)
+	_step_counter = (long)((_speed * _speed) / (2.0f * _acceleration));
+    }
+    _speedStale = false;
+}
+
+void AccelStepper::setStepDeadline(unsigned long deadline_us, unsigned long now, bool clockwise)
+{
+    long ahead = (long)(deadline_us - now);
+    _lastStepTime = now;
+    _stepFracAccum = 0;
+    setStepInterval(ahead > 0 ? ahead : 1, 0, clockwise);
+}
+
+void AccelStepper::stepUncounted(bool clockwise)
+{
+    boolean direction = _direction;
+    _direction = clockwise ? DIRECTION_CW : DIRECTION_CCW;
+    step(_currentPos);
+    _direction = direction;
 }
 
 float AccelStepper::speed()
 {
+    return currentSpeed();
+}
+
+float AccelStepper::currentSpeed()
+{
+    // Called from the step interrupt and the foreground alike, so it only
+    // reads. _speed is only written where the motion state changes.
+    if (_speedStale)
+	return (_speed < 0.0) ? -_ramp.Speed() : _ramp.Speed();
     return _speed;
 }
 
+void AccelStepper::setIntegerRamp(bool enable)
+{
+    // Switch while stopped, the two ramps do not share their running state
+    _speed = currentSpeed();
+    _speedStale = false;
+    _aheadValid = false;
+    _integerRamp = enable;
+}
+
+bool AccelStepper::integerRamp()
+{
+    return _integerRamp;
+}
+
+void AccelStepper::setAbsoluteScheduling(bool enable)
+{
+    _absoluteScheduling = enable;
+    _stepFracAccum = 0;
+}
+
+unsigned long AccelStepper::timeToNextStepUs(unsigned long now)
+{
+    if (!_stepInterval_us)
+	return 0;
+    // now may be a little before a step that re-anchored _lastStepTime
+    long left = (long)(_lastStepTime + _stepInterval_us - now);
+    return left > 0 ? left : 0;
+}
+
+void AccelStepper::resetStepTime(unsigned long now)
+{
+    // runSpeed() starts over from the time of a step this late
+    _lastStepTime = now - 2 * _stepInterval_us;
+    _stepFracAccum = 0;
+}
+
+unsigned long AccelStepper::intervalAfterNextStepUs(uint8_t &interval_frac)
+{
+    if (!_stepInterval_us)
+    {
+	interval_frac = 0;
+	return 0;
+    }
+    if (!_aheadValid)
+    {
+	// Step, compute and put everything back, keeping the result for the step
+	RampState now;
+	saveRampState(now);
+	_currentPos += (_direction == DIRECTION_CW) ? 1 : -1;
+	computeNewSpeed();
+	saveRampState(_ahead);
+	loadRampState(now);
+	_aheadValid = true;
+    }
+    interval_frac = _ahead.interval_frac;
+    return _ahead.interval_us;
+}
+
+void AccelStepper::saveRampState(RampState &state)
+{
+    state.position = _currentPos;
+    state.interval_us = _stepInterval_us;
+    state.interval_frac = _stepIntervalFrac;
+    state.speed = _speed;
+    state.speed_stale = _speedStale;
+    state.step_counter = _step_counter;
+    state.cn = _cn;
+    state.direction = _direction;
+    state.ramp = _ramp;
+}
+
+void AccelStepper::loadRampState(const RampState &state)
+{
+    _currentPos = state.position;
+    _stepInterval_us = state.interval_us;
+    _stepIntervalFrac = state.interval_frac;
+    _speed = state.speed;
+    _speedStale = state.speed_stale;
+    _step_counter = state.step_counter;
+    _cn = state.cn;
+    _direction = state.direction;
+    _ramp = state.ramp;
+}
+
 // Subclasses can override
 void AccelStepper::step(long step)
 {
@@ -411,6 +631,25 @@ void AccelStepper::step1(long step)
 {
     (void)(step); // Unused
 
+#ifdef ACCELSTEPPER_PORT_IO
+    // Same sequence as below, one store per pin update
+    *(_direction ? _dirCwReg : _dirCcwReg) = _dirMask; // Set direction first else get rogue pulses
+    PORT_IO_WAIT_4; // DIR setup time
+    *_stepOnReg = _stepMask; // step HIGH
+    if (_minPulseWidth)
+	delayMicroseconds(_minPulseWidth);
+    else
+    {
+	// ~130ns at 120MHz, enough for the TMC2209
+	PORT_IO_WAIT_4;
+	PORT_IO_WAIT_4;
+	PORT_IO_WAIT_4;
+	PORT_IO_WAIT_4;
+    }
+    *_stepOffReg = _stepMask; // step LOW
+    return;
+#endif
+
     // _pin[0] is step, _pin[1] is direction
     setOutputPins(_direction ? 0b10 : 0b00); // Set direction first else get rogue pulses
     setOutputPins(_direction ? 0b11 : 0b01); // step HIGH
@@ -626,6 +865,7 @@ void AccelStepper::setPinsInverted(bool directionInvert, bool stepInvert, bool e
     _pinInverted[0] = stepInvert;
     _pinInverted[1] = directionInvert;
     _enableInverted = enableInvert;
+    resolvePortPins();
 }
 
 void AccelStepper::setPinsInverted(bool pin1Invert, bool pin2Invert, bool pin3Invert, bool pin4Invert, bool enableInvert)
@@ -635,6 +875,27 @@ void AccelStepper::setPinsInverted(bool pin1Invert, bool pin2Invert, bool pin3In
     _pinInverted[2] = pin3Invert;
     _pinInverted[3] = pin4Invert;
     _enableInverted = enableInvert;
+    resolvePortPins();
+}
+
+void AccelStepper::resolvePortPins()
+{
+#ifdef ACCELSTEPPER_PORT_IO
+    if (_interface != DRIVER)
+	return;
+
+    // _pin[0] is step, _pin[1] is direction
+    PortGroup *stepGroup = &PORT_IOBUS->Group[g_APinDescription[_pin[0]].ulPort];
+    PortGroup *dirGroup = &PORT_IOBUS->Group[g_APinDescription[_pin[1]].ulPort];
+    _stepMask = 1ul << g_APinDescription[_pin[0]].ulPin;
+    _dirMask = 1ul << g_APinDescription[_pin[1]].ulPin;
+
+    _stepOnReg = _pinInverted[0] ? &stepGroup->OUTCLR.reg : &stepGroup->OUTSET.reg;
+    _stepOffReg = _pinInverted[0] ? &stepGroup->OUTSET.reg : &stepGroup->OUTCLR.reg;
+    // Clockwise drives DIR high, see step1()
+    _dirCwReg = _pinInverted[1] ? &dirGroup->OUTCLR.reg : &dirGroup->OUTSET.reg;
+    _dirCcwReg = _pinInverted[1] ? &dirGroup->OUTSET.reg : &dirGroup->OUTCLR.reg;
+#endif
 }
 
 // Blocks until the target position is reached and stopped
@@ -664,9 +925,10 @@ void AccelStepper::runToNewPosition(long position)
 
 void AccelStepper::stop()
 {
-    if (_speed != 0.0)
+    float currSpeed = currentSpeed();
+    if (currSpeed != 0.0)
     {    
-	long stepsToStop = (long)((_speed * _speed) / (2.0 * _acceleration)) + 1; // Equation 16 (+integer rounding)
+	long stepsToStop = (long)((currSpeed * currSpeed) / (2.0 * _acceleration)) + 1; // Equation 16 (+integer rounding)
 	if (_speed > 0)
 	    move(stepsToStop);
 	else
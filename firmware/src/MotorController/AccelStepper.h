@@ -277,6 +277,16 @@
 #include <WProgram.h>
 #include <wiring.h>
 #endif
+#include "MotorController/IntegerRamp.h"
+
+// On the SAMD51 the DRIVER interface writes STEP/DIR straight to the single
+// cycle IOBUS port registers instead of going through digitalWrite()
+#if defined(__SAMD51__)
+#define ACCELSTEPPER_PORT_IO
+#endif
+
+// How early runSpeed() accepts a step with absolute scheduling enabled
+#define ACCELSTEPPER_SCHEDULE_SLACK_US 5
 
 // These defs cause trouble on some versions of Arduino
 #undef round
@@ -456,6 +466,33 @@ public:
     /// The speed will be limited by the current value of setMaxSpeed()
     void    setSpeed(float speed);
 
+    /// Sets the interval to the next step directly, for an external profile
+    /// that times every step itself (e.g. SCurveProfile) and calls this after
+    /// each step runSpeed() takes. speed() follows the interval and the
+    /// acceleration state is set to match it, so run() can take over from
+    /// this speed later. Not limited by setMaxSpeed().
+    /// \param[in] interval_us Whole microseconds to the next step, 0 to stop
+    /// \param[in] interval_frac Fraction of a microsecond in 1/256us
+    /// \param[in] clockwise Direction of the next step
+    void    setStepInterval(unsigned long interval_us, uint8_t interval_frac, bool clockwise);
+
+    /// Sets the time of the next step directly, for an external profile that
+    /// keeps its own absolute schedule (e.g. PvtInterpolator). The interval is
+    /// counted from now, so any time since the last step is fine, and speed()
+    /// follows it only roughly.
+    /// \param[in] deadline_us micros() time the next step is due, steps
+    /// already late are due straight away
+    /// \param[in] now The current micros() value
+    /// \param[in] clockwise Direction of the next step
+    void    setStepDeadline(unsigned long deadline_us, unsigned long now, bool clockwise);
+
+    /// Outputs one step pulse right now without counting it in the current
+    /// position or touching the step schedule, e.g. for a closed loop
+    /// correction on top of the profile. The direction of the profile is
+    /// restored afterwards.
+    /// \param[in] clockwise Direction of the extra step
+    void    stepUncounted(bool clockwise);
+
     /// The most recently set speed.
     /// \return the most recent speed in steps per second
     float   speed();
@@ -559,6 +596,47 @@ public:
         return _stepInterval_us;
     }
 
+    /// Selects the integer ramp (IntegerRamp) instead of the float/double
+    /// math in computeNewSpeed(). Defaults to on when the build defines
+    /// ACCELSTEPPER_INTEGER_RAMP.
+    /// \param[in] enable True to use the integer ramp
+    void    setIntegerRamp(bool enable);
+
+    /// \return true if the integer ramp is in use
+    bool    integerRamp();
+
+    /// Absolute scheduling: runSpeed() advances the last step time by exactly
+    /// one interval (carrying fractions of a microsecond) instead of setting
+    /// it to micros(), so latency in calling runSpeed() does not lower the
+    /// step rate. Steps are accepted up to ACCELSTEPPER_SCHEDULE_SLACK_US
+    /// early, which suits a hardware timer that fires on the deadline.
+    /// \param[in] enable True to schedule steps on absolute deadlines
+    void    setAbsoluteScheduling(bool enable);
+
+    /// Fractional part of GetStepIntervalUs() in 1/256 microseconds
+    inline uint8_t GetStepIntervalFrac()
+    {
+        return _stepIntervalFrac;
+    }
+
+    /// \param[in] now The current micros() value
+    /// \return microseconds from now until the next step is due, 0 if it is
+    /// already due or the motor is stopped
+    unsigned long timeToNextStepUs(unsigned long now);
+
+    /// The interval run() moves on to after the next step. Lets a step timer
+    /// be loaded a period early. The ramp state it comes from is kept and
+    /// computeNewSpeed() adopts it at that step instead of working it out again.
+    /// \param[out] interval_frac Fractional part in 1/256 microseconds
+    /// \return microseconds, 0 if the motor stops at the next step
+    unsigned long intervalAfterNextStepUs(uint8_t &interval_frac);
+
+    /// Makes the next step due straight away and times the ones after it
+    /// from when it is taken, as on a start from rest. Without this a step
+    /// taken within two intervals of the previous one is timed from there.
+    /// \param[in] now The current micros() value
+    void    resetStepTime(unsigned long now);
+
     /// Virtual destructor to prevent warnings during delete
     virtual ~AccelStepper() {};
 protected:
@@ -661,6 +739,9 @@ protected:
     /// 0 means the motor is currently stopped with _speed == 0
     unsigned long  _stepInterval_us;
 
+    /// Fraction of _stepInterval_us in 1/256 microseconds
+    uint8_t        _stepIntervalFrac;
+
 private:
     /// Number of pins on the stepper motor. Permits 2 or 4. 2 pins is a
     /// bipolar, and 4 pins is a unipolar.
@@ -696,6 +777,12 @@ private:
     /// The last step time in microseconds
     unsigned long  _lastStepTime;
 
+    /// Step deadlines advance from _lastStepTime instead of micros()
+    bool           _absoluteScheduling;
+
+    /// Accumulated _stepIntervalFrac not yet added to _lastStepTime
+    uint16_t       _stepFracAccum;
+
     /// The minimum allowed pulse width in microseconds
     unsigned int   _minPulseWidth;
 
@@ -729,6 +816,56 @@ private:
     /// Min step size in microseconds based on maxSpeed
     float _cmin; // at max speed
 
+    /// Integer replacement for _c0, _cn, _cmin and the equation 16 math
+    IntegerRamp _ramp;
+
+    /// computeNewSpeed() uses _ramp instead of the float math
+    bool _integerRamp;
+
+    /// Everything computeNewSpeed() changes, as it is after a step to position
+    struct RampState
+    {
+	long position;
+	unsigned long interval_us;
+	uint8_t interval_frac;
+	float speed;
+	bool speed_stale;
+	long step_counter;
+	float cn;
+	boolean direction;
+	IntegerRamp ramp;
+    };
+
+    /// Result of intervalAfterNextStepUs() for the next step, valid until
+    /// computeNewSpeed() takes it or anything it depends on changes
+    RampState _ahead;
+    bool _aheadValid;
+
+    void saveRampState(RampState &state);
+    void loadRampState(const RampState &state);
+
+#ifdef ACCELSTEPPER_PORT_IO
+    /// STEP/DIR port registers for step1(), with the pin inversion already
+    /// folded into the choice of OUTSET/OUTCLR
+    volatile uint32_t *_stepOnReg;
+    volatile uint32_t *_stepOffReg;
+    volatile uint32_t *_dirCwReg;
+    volatile uint32_t *_dirCcwReg;
+    uint32_t _stepMask;
+    uint32_t _dirMask;
+#endif
+
+    /// Resolve the port registers used by step1(). Called whenever the pins
+    /// or their inversion change.
+    void resolvePortPins();
+
+    /// With the integer ramp computeNewSpeed() only keeps the sign of _speed
+    /// up to date, the magnitude is recomputed on demand by currentSpeed()
+    bool _speedStale;
+
+    /// _speed, or its magnitude from _ramp if it is stale. Leaves both as they are.
+    float currentSpeed();
+
 };
 
 #endif 
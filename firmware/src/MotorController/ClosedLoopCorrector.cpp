@@ -0,0 +1,72 @@
+#include "ClosedLoopCorrector.h"
+
+ClosedLoopCorrector::ClosedLoopCorrector(PIDController &pid)
+    : pid_(pid),
+      rate_(0.0f),
+      accum_(0.0f),
+      last_us_(0),
+      offset_(0),
+      reset_(true)
+{
+}
+
+void ClosedLoopCorrector::Reset(float commanded_steps, float measured_steps)
+{
+  following_.Reset(commanded_steps, measured_steps);
+  rate_ = 0.0f;
+  pid_.reset();
+  // The interrupt clears its own state
+  reset_ = true;
+}
+
+float ClosedLoopCorrector::Update(float commanded_steps, float measured_steps)
+{
+  float error = following_.Update(commanded_steps, measured_steps);
+  if (error > -CLOSED_LOOP_DEADBAND_STEPS && error < CLOSED_LOOP_DEADBAND_STEPS)
+    error = 0.0f;
+  rate_ = pid_(error);
+  return rate_;
+}
+
+bool ClosedLoopCorrector::NextCorrectionStep(unsigned long now, bool &clockwise)
+{
+  if (reset_)
+  {
+    reset_ = false;
+    accum_ = 0.0f;
+    offset_ = 0;
+    last_us_ = now;
+    return false;
+  }
+
+  float dt = (now - last_us_) * 1.0e-6f;
+  last_us_ = now;
+  if (dt > CLOSED_LOOP_MAX_DT)
+    dt = CLOSED_LOOP_MAX_DT;
+
+  float rate = rate_;
+  accum_ += rate * dt;
+  if (rate == 0.0f)
+  {
+    // Nothing left over for the next correction
+    accum_ = 0.0f;
+    return false;
+  }
+  // At most one step per interrupt, more than that is dropped rather than
+  // released as a burst later
+  if (accum_ >= 1.0f)
+  {
+    accum_ = accum_ >= 2.0f ? 0.0f : accum_ - 1.0f;
+    offset_++;
+    clockwise = true;
+    return true;
+  }
+  if (accum_ <= -1.0f)
+  {
+    accum_ = accum_ <= -2.0f ? 0.0f : accum_ + 1.0f;
+    offset_--;
+    clockwise = false;
+    return true;
+  }
+  return false;
+}
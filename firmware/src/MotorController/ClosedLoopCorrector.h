@@ -0,0 +1,63 @@
+#pragma once
+#include <cstdint>
+#include "pid.h"
+#include "MotorController/FollowingError.h"
+
+// Control loop period, independent of the step interrupt
+#define CLOSED_LOOP_PERIOD_US 2000
+
+// Position errors smaller than this are encoder noise, steps
+#define CLOSED_LOOP_DEADBAND_STEPS 1.0f
+
+// Longest gap between two interrupts that still counts towards a correction
+// step, seconds. Longer gaps don't release a burst of steps.
+#define CLOSED_LOOP_MAX_DT 0.01f
+
+// Closed loop position correction on top of the open loop step generator.
+//
+// At a fixed rate Update() compares the commanded step position with the
+// encoder position and runs a PIDController on the difference. Its output,
+// bounded by the PID's limit and output ramp, is a correction speed in steps
+// per second. The step interrupt turns that speed into extra step pulses with
+// NextCorrectionStep() which are not counted in the commanded position, so
+// the motion profile carries on as if nothing happened while the shaft is
+// pulled back onto it.
+//
+// Reset() lines the encoder up with the commanded position, errors are
+// measured from there (see FollowingError).
+class ClosedLoopCorrector
+{
+public:
+    ClosedLoopCorrector(PIDController &pid);
+
+    // Control loop. Takes the current positions as the reference and stops
+    // correcting.
+    void Reset(float commanded_steps, float measured_steps);
+
+    // Control loop. Returns the new correction speed in steps per second.
+    float Update(float commanded_steps, float measured_steps);
+
+    // Step interrupt. True when a correction step is due, at most one per
+    // call, with its direction.
+    bool NextCorrectionStep(unsigned long now, bool &clockwise);
+
+    // Commanded minus measured position at the last Update(), steps
+    float Error() { return following_.Error(); }
+
+    // Correction speed, steps per second
+    float Rate() { return rate_; }
+
+    // Correction steps emitted since Reset(), net
+    long Offset() { return offset_; }
+
+private:
+    PIDController &pid_;
+    FollowingError following_;
+    volatile float rate_;
+
+    // Step interrupt side
+    float accum_;
+    unsigned long last_us_;
+    volatile long offset_;
+    volatile bool reset_;
+};
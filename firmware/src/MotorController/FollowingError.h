@@ -0,0 +1,34 @@
+#pragma once
+
+// Commanded minus measured position, shared by the closed loop corrector and
+// the stall detector.
+//
+// The encoder reads an absolute angle while the step counter starts wherever
+// it was set, so Reset() takes the offset between the two as the reference
+// and Update() measures the error from there.
+class FollowingError
+{
+public:
+    FollowingError() : measured_offset_(0.0f), error_(0.0f) {}
+
+    // Takes the current positions as the reference, the error is 0 from here
+    void Reset(float commanded_steps, float measured_steps)
+    {
+        measured_offset_ = commanded_steps - measured_steps;
+        error_ = 0.0f;
+    }
+
+    // Returns the new error, steps
+    float Update(float commanded_steps, float measured_steps)
+    {
+        error_ = commanded_steps - (measured_steps + measured_offset_);
+        return error_;
+    }
+
+    // Error at the last Update(), steps
+    float Error() { return error_; }
+
+private:
+    float measured_offset_;
+    float error_;
+};
@@ -0,0 +1,164 @@
+#include "IntegerRamp.h"
+#include <cmath>
+#include <climits>
+
+// Largest interval the ramp will hold, ~4.2s. Keeps 2 * cn_ inside 32 bits.
+#define INTEGER_RAMP_MAX_INTERVAL (1UL << 30)
+
+// c_n / c_0 after n steps of equation 13 from rest:
+// c_n = c_n-1 * (4n - 1) / (4n + 1)
+static constexpr double RampRatio(long n)
+{
+  return n == 0 ? 1.0 : RampRatio(n - 1) * (4.0 * n - 1.0) / (4.0 * n + 1.0);
+}
+
+// Q2.30
+static constexpr uint32_t RampRatioQ30(long n)
+{
+  return (uint32_t)(RampRatio(n) * (double)(1UL << 30) + 0.5);
+}
+
+#define RAMP_RATIOS_4(n) RampRatioQ30(n), RampRatioQ30(n + 1), RampRatioQ30(n + 2), RampRatioQ30(n + 3)
+#define RAMP_RATIOS_16(n) RAMP_RATIOS_4(n), RAMP_RATIOS_4(n + 4), RAMP_RATIOS_4(n + 8), RAMP_RATIOS_4(n + 12)
+
+static_assert(INTEGER_RAMP_TABLE_SIZE == 64, "ramp_table initializer must match INTEGER_RAMP_TABLE_SIZE");
+static constexpr uint32_t ramp_table[INTEGER_RAMP_TABLE_SIZE] = {
+    RAMP_RATIOS_16(0), RAMP_RATIOS_16(16), RAMP_RATIOS_16(32), RAMP_RATIOS_16(48)};
+
+IntegerRamp::IntegerRamp()
+    : c0_(0),
+      cn_(0),
+      rest_(0),
+      cmin_(256),
+      stop_k_(0),
+      stop_exp_(0),
+      table_n_(0)
+{
+  SetAcceleration(1.0f);
+  SetMaxSpeed(1.0f);
+}
+
+void IntegerRamp::SetAcceleration(float acceleration)
+{
+  if (acceleration < 0.0f)
+    acceleration = -acceleration;
+  if (acceleration == 0.0f)
+    return;
+
+  double c0 = 0.676 * sqrt(2.0 / acceleration) * 1000000.0 * 256.0; // Equation 15
+  c0_ = c0 > INTEGER_RAMP_MAX_INTERVAL ? INTEGER_RAMP_MAX_INTERVAL : (uint32_t)(c0 + 0.5);
+
+  // speed^2 / 2a with speed = 256e6 / cn_, as a 32 bit mantissa with the top
+  // bit set and a power of two
+  int exp;
+  double stop_k = frexp((256.0e6 * 256.0e6) / (2.0 * acceleration), &exp);
+  stop_k_ = (uint32_t)ldexp(stop_k, 32);
+  stop_exp_ = exp - 32;
+  table_n_ = 0; // the table is scaled by the old c0
+}
+
+void IntegerRamp::SetMaxSpeed(float speed)
+{
+  if (speed < 0.0f)
+    speed = -speed;
+  if (speed == 0.0f)
+    return;
+
+  double cmin = 256.0e6 / speed;
+  if (cmin < 1.0)
+    cmin_ = 1;
+  else if (cmin > INTEGER_RAMP_MAX_INTERVAL)
+    cmin_ = INTEGER_RAMP_MAX_INTERVAL;
+  else
+    cmin_ = (uint32_t)(cmin + 0.5);
+}
+
+void IntegerRamp::Sync(unsigned long interval_us)
+{
+  if (IntervalUs() == interval_us)
+    return;
+  cn_ = interval_us >= (INTEGER_RAMP_MAX_INTERVAL >> 8) ? INTEGER_RAMP_MAX_INTERVAL : interval_us << 8;
+  rest_ = 0;
+  table_n_ = 0;
+}
+
+unsigned long IntegerRamp::Next(long n)
+{
+  if (n == 0)
+  {
+    // First step from stopped
+    cn_ = c0_;
+    rest_ = 0;
+    table_n_ = 1;
+    return cn_ >> 8;
+  }
+
+  if (n == table_n_ && n < INTEGER_RAMP_TABLE_SIZE)
+  {
+    cn_ = (uint32_t)(((uint64_t)c0_ * ramp_table[n] + (1UL << 29)) >> 30);
+    table_n_++;
+  }
+  else
+  {
+    // Equation 13. The division remainder is carried to the next step so the
+    // small per step changes of a long ramp are not lost to truncation.
+    if (table_n_ != 0)
+    {
+      rest_ = 0;
+      table_n_ = 0;
+    }
+    uint32_t d = n > 0 ? 4 * n + 1 : -4 * n - 1;
+    if (rest_ >= d)
+      rest_ = 0; // left over from the other ramp direction
+    uint32_t num = (cn_ << 1) + rest_;
+    uint32_t delta = num / d;
+    rest_ = num - delta * d;
+    if (n > 0)
+    {
+      cn_ -= delta;
+    }
+    else
+    {
+      // 4n + 1 is negative while decelerating
+      cn_ += delta;
+      if (cn_ > INTEGER_RAMP_MAX_INTERVAL)
+        cn_ = INTEGER_RAMP_MAX_INTERVAL;
+    }
+  }
+
+  if (cn_ < cmin_)
+  {
+    cn_ = cmin_;
+    rest_ = 0;
+  }
+  return cn_ >> 8;
+}
+
+long IntegerRamp::StepsToStop()
+{
+  if (cn_ == 0)
+    return 0;
+  // k / c^2 as two 32 bit divisions by c cut to 16 bits, each quotient
+  // shifted up to use all 32 bits. Good to about 1 part in 2^15.
+  uint8_t shift = cn_ > 0xFFFF ? 16 - __builtin_clz(cn_) : 0;
+  uint32_t c = (cn_ + ((1UL << shift) >> 1)) >> shift;
+  uint32_t q = stop_k_ / c;
+  uint8_t z = __builtin_clz(q);
+  q = (q << z) / c;
+
+  int exp = stop_exp_ - 2 * shift - z;
+  if (exp <= -32)
+    return 0;
+  if (exp < 0)
+    return (long)(q >> -exp);
+  if (exp >= 31 || q > ((unsigned long)LONG_MAX >> exp))
+    return LONG_MAX;
+  return (long)q << exp;
+}
+
+float IntegerRamp::Speed()
+{
+  if (cn_ == 0)
+    return 0.0f;
+  return 256.0e6f / cn_;
+}
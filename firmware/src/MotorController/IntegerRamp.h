@@ -0,0 +1,51 @@
+#pragma once
+#include <cstdint>
+
+// Number of ramp steps from rest taken from the precomputed table
+#define INTEGER_RAMP_TABLE_SIZE 64
+
+// Integer version of the per step math in AccelStepper::computeNewSpeed().
+//
+// Intervals are kept in Q24.8 microseconds. The first INTEGER_RAMP_TABLE_SIZE
+// steps of an acceleration from rest are c0 scaled by a constexpr table of
+// c_n / c_0 (which does not depend on the acceleration), after that the
+// Austin recurrence (equation 13) runs with a single 32 bit division per step,
+// carrying the remainder the way the AVR446 integer implementation does.
+// Equation 16 takes two more 32 bit divisions, none of the per step math
+// needs a 64 bit division (a library call on the M4).
+// Only SetAcceleration(), SetMaxSpeed() and Speed() use floating point and
+// those are meant to be called from the foreground.
+class IntegerRamp
+{
+public:
+    IntegerRamp();
+
+    void SetAcceleration(float acceleration);
+    void SetMaxSpeed(float speed);
+
+    // Adopt an interval that was set outside the ramp (e.g. setSpeed()).
+    // 0 means stopped.
+    void Sync(unsigned long interval_us);
+
+    // Interval for step counter `n` as AccelStepper counts it: 0 is the first
+    // step from rest, positive while accelerating, negative while decelerating.
+    unsigned long Next(long n);
+
+    // Equation 16, steps needed to stop from the current interval
+    long StepsToStop();
+
+    // Current speed in steps per second, always positive
+    float Speed();
+
+    unsigned long IntervalUs() { return cn_ >> 8; }
+    uint8_t IntervalFrac() { return cn_ & 0xFF; }
+
+private:
+    uint32_t c0_;
+    uint32_t cn_;
+    uint32_t rest_; // equation 13 division remainder
+    uint32_t cmin_;
+    uint32_t stop_k_;   // equation 16 numerator, stop_k_ * 2^stop_exp_
+    int16_t stop_exp_;
+    long table_n_; // next counter value the table can serve, 0 when off table
+};
@@ -25,72 +25,6 @@ double MotorController::stepsToDegrees(long steps)
   return (steps / 8) * 360 / 200;
 }
 
-void TC0_Handler()
-{
-  if (TC0->COUNT16.INTFLAG.bit.OVF)
-  {
-    motorController.OnTimer();
-    TC0->COUNT16.INTFLAG.bit.OVF = 1;
-  }
-}
-
-void init_timer()
-{
-  // Enable the TC0 module
-  MCLK->APBAMASK.bit.TC0_ = 1;
-
-  // Configure the Generic Clock Generator 0 (GCLK0) for TC0
-  GCLK->PCHCTRL[TC0_GCLK_ID].reg = GCLK_PCHCTRL_GEN_GCLK1 | GCLK_PCHCTRL_CHEN;
-  while (GCLK->PCHCTRL[TC0_GCLK_ID].bit.CHEN == 0)
-    ;
-
-  GCLK->GENCTRL[1].bit.DIV = 0x00;
-  while (GCLK->SYNCBUSY.bit.GENCTRL1)
-    ;
-
-  GCLK->GENCTRL[1].bit.DIVSEL = 0;
-  while (GCLK->SYNCBUSY.bit.GENCTRL1)
-    ;
-
-  DEBUG_PRINTF("Prescaler: %d\n", GCLK->GENCTRL[0].bit.DIV);
-
-  // Reset TC0
-  TC0->COUNT16.CTRLA.bit.SWRST = 1;
-  while (TC0->COUNT16.SYNCBUSY.bit.SWRST)
-    ;
-
-  TC0->COUNT16.CTRLA.bit.MODE = TC_CTRLA_MODE_COUNT16;
-  TC0->COUNT16.CTRLA.bit.PRESCALER = TC_CTRLA_PRESCALER_DIV8_Val;
-  TC0->COUNT16.WAVE.bit.WAVEGEN = TC_WAVE_WAVEGEN_MFRQ_Val;
-  while (TC0->COUNT16.SYNCBUSY.bit.ENABLE)
-    ;
-  // Set the period (TOP value) for the timer
-  TC0->COUNT16.CC[0].reg = TIMER_COUNT;
-  while (TC0->COUNT16.SYNCBUSY.bit.CC0)
-    ;
-
-  // Enable the overflow interrupt
-  TC0->COUNT16.INTENSET.bit.OVF = 1;
-
-  // Enable the TC0 interrupt in the NVIC
-  NVIC_EnableIRQ(TC0_IRQn);
-  NVIC_SetPriority(TC0_IRQn, 1);
-
-  // Enable TC0
-  TC0->COUNT16.CTRLA.bit.ENABLE = 1;
-  while (TC0->COUNT16.SYNCBUSY.bit.ENABLE)
-    ;
-}
-
-void SetTimerIntervalUs(unsigned long interval_us)
-{
-  // Set the timer period (TOP value) for the timer
-  TC0->COUNT16.CC[0].reg = US_TO_TIMER_COUNT(interval_us);
-  while (TC0->COUNT16.SYNCBUSY.bit.CC0)
-    ;
-  // DEBUG_PRINTF("Set timer interval to %lu us\n", US_TO_TIMER_COUNT(interval_us));
-}
-
 void MotorController::OnStart()
 {
 
@@ -109,9 +43,17 @@ void MotorController::OnStart()
 
   stepper.setEnablePin(MOTOR_EN);
   stepper.setPinsInverted(true, false, true);
+  // The PORT register step path holds STEP high for ~130ns, well above the
+  // TMC2209 minimum, instead of delaying a full microsecond per step
+  stepper.setMinPulseWidth(0);
+#ifdef ABSOLUTE_STEP_SCHEDULING
+  stepper.setAbsoluteScheduling(true);
+#endif
   stepper.disableOutputs();
   stepper.setAcceleration(400 * 8);
   stepper.setMaxSpeed(100 * 8);
+  velocity_planner.SetAcceleration(stepper.acceleration());
+  velocity_planner.SetMaxSpeed(stepper.maxSpeed());
 
   driver.setup(serial_stream, 115200, TMC2209base::SerialAddress::SERIAL_ADDRESS_0);
 
@@ -120,6 +62,9 @@ void MotorController::OnStart()
   target_position = 0;
 
   init_timer();
+#ifdef HW_STEP_ENGINE
+  step_engine.Init(MOTOR_STEP);
+#endif
 
   stepper.enableOutputs();
 }
@@ -131,11 +76,51 @@ void MotorController::OnStop()
 
 void MotorController::OnTimer()
 {
+  unsigned long isr_time = micros();
+  long isr_position = stepper.currentPosition();
+  if (scope.Due(isr_time))
+  {
+    RecordScopeSample(isr_time);
+  }
+  if (closed_loop_enabled_ && !hw_move_active_ && controlMode != MotorStates::OFF && controlMode != MotorStates::HOME &&
+      controlMode != MotorStates::CALIBRATE)
+  {
+    // Extra pulses on top of the profile, at most one per interrupt
+    bool clockwise;
+    if (closed_loop_.NextCorrectionStep(isr_time, clockwise))
+    {
+      stepper.stepUncounted(clockwise);
+    }
+  }
+#ifdef ABSOLUTE_STEP_SCHEDULING
+  if (step_timer_schedule.Stopped() && stepper.GetStepIntervalUs() != 0)
+  {
+    // Started from rest since the last interrupt. The period after this one
+    // is already an idle one, so the first step waits for the next overflow
+    // rather than the second one being late.
+    stepper.resetStepTime(isr_time);
+    uint8_t next_frac;
+    unsigned long next_us = StepIntervalAfterNext(next_frac);
+    LoadTimerPeriod(step_timer_schedule.Next(false, stepper.GetStepIntervalUs(), stepper.GetStepIntervalFrac(),
+                                             next_us, next_frac, STEP_TIMER_IDLE_PERIOD_US));
+    return;
+  }
+#endif
   switch (controlMode)
   {
   case MotorStates::OFF:
     break;
   case MotorStates::POSITION:
+    if (hw_move_active_)
+    {
+      // pulses are coming from the step engine, OnRun() finishes the move
+      break;
+    }
+    if (s_curve_move_)
+    {
+      RunSCurveMove();
+      break;
+    }
     stepper.run();
     if (stepper.distanceToGo() == 0)
     {
@@ -148,43 +133,29 @@ void MotorController::OnTimer()
     break;
   case MotorStates::VELOCITY_STEP:
   {
-
-    if (stepper.currentPosition() == velocity_step_end)
+    if (stepper.currentPosition() == velocity_step_end && !NextPathSegment())
     {
-      if (velocity_steps.size() == 0)
-      {
-        // DEBUG_PRINTF("Finished velocity step at %ld\n", stepper.currentPosition());
-        stepper.setSpeed(0);
-        SetMotorState(MotorStates::IDLE_ON);
-        addrLedController.AddLedStep(CRGB::Purple, 500);
-        addrLedController.AddLedStep(CRGB::Black, 1);
-        return;
-      }
-
-      // Done stepping, on to the next
-      auto this_move = velocity_steps.front();
-      // DEBUG_PRINTF("Current End: %ld, current position: %ld new step: %d\n", velocity_step_end, stepper.currentPosition(), this_move.step);
-      if (this_move.positionMode == PositionMode::ABSOLUTE)
-      {
-        velocity_step_end = this_move.step;
-      }
-      else if (this_move.positionMode == PositionMode::RELATIVE)
-      {
-        velocity_step_end = stepper.currentPosition() + this_move.step;
-      }
-      if (stepper.currentPosition() > velocity_step_end)
+      return;
+    }
+    if (stepper.runSpeed())
+    {
+      if (stepper.currentPosition() != velocity_step_end)
       {
-        stepper.setSpeed(-this_move.velocity);
+        NextPathStep();
       }
-      else
+      else if (!NextPathSegment())
       {
-        stepper.setSpeed(this_move.velocity);
+        return;
       }
-      velocity_steps.pop_front();
     }
-    stepper.runSpeed();
     break;
   }
+  case MotorStates::PVT:
+    RunPvt(isr_time);
+    break;
+  case MotorStates::CALIBRATE:
+    stepper.runSpeed();
+    break;
   case MotorStates::HOME:
   {
     float currentVelocityDegPerSec = encoder_ptr->GetVelocityDegreesPerSecond() * homing_direction;
@@ -248,6 +219,15 @@ void MotorController::OnTimer()
   case MotorStates::IDLE_ON:
     break;
   }
+#ifdef ABSOLUTE_STEP_SCHEDULING
+  uint8_t next_frac;
+  unsigned long next_us = StepIntervalAfterNext(next_frac);
+  LoadTimerPeriod(step_timer_schedule.Next(stepper.currentPosition() != isr_position,
+                                           stepper.GetStepIntervalUs(),
+                                           stepper.GetStepIntervalFrac(),
+                                           next_us, next_frac,
+                                           stepper.timeToNextStepUs(isr_time)));
+#else
   unsigned long new_int = stepper.GetStepIntervalUs();
   if (new_int <= 10 || new_int > 1000000)
   {
@@ -257,17 +237,541 @@ void MotorController::OnTimer()
   {
     SetTimerIntervalUs(new_int);
   }
+#endif
 }
 
 void MotorController::OnRun()
 {
-  
+#ifdef HW_STEP_ENGINE
+  if (hw_move_active_)
+  {
+    step_engine.Service();
+    if (!step_engine.IsBusy())
+    {
+      FinishHardwareMove();
+      if (hw_target_pending_)
+      {
+        hw_target_pending_ = false;
+        StartPositionMove();
+      }
+      else if (controlMode == MotorStates::POSITION)
+      {
+        SetMotorState(MotorStates::IDLE_ON);
+      }
+    }
+  }
+#endif
+  if (closed_loop_enabled_ && micros() - closed_loop_last_us_ >= CLOSED_LOOP_PERIOD_US)
+  {
+    closed_loop_last_us_ += CLOSED_LOOP_PERIOD_US;
+    if (micros() - closed_loop_last_us_ >= CLOSED_LOOP_PERIOD_US)
+    {
+      // Fell behind, don't try to catch up
+      closed_loop_last_us_ = micros();
+    }
+    RunClosedLoop();
+  }
+  if (encoder_ptr != nullptr && micros() - stall_last_us_ >= STALL_CHECK_PERIOD_US)
+  {
+    stall_last_us_ = micros();
+    RunStallCheck();
+  }
+  if (encoder_ptr != nullptr)
+  {
+    encoder_ptr->SetCommandedVelocity(CommandedDegreesPerSecond());
+  }
+  if (controlMode == MotorStates::CALIBRATE)
+  {
+    RunEncoderCalibration();
+  }
+}
+
+void MotorController::RunEncoderCalibration()
+{
+  long travelled = stepper.currentPosition() - calibration_start_;
+  if (travelled < ENCODER_CALIBRATION_LEAD_IN)
+    return;
+
+  if (micros() - calibration_last_us_ >= ENCODER_CALIBRATION_SAMPLE_US)
+  {
+    calibration_last_us_ = micros();
+    // Fractions of a degree, stepsToDegrees() rounds to whole ones
+    encoder_ptr->AddCalibrationSample((travelled - ENCODER_CALIBRATION_LEAD_IN) * 360.0f / (8 * 200));
+  }
+  if (travelled < ENCODER_CALIBRATION_LEAD_IN + 200 * 8)
+    return;
+
+  SetMotorState(MotorStates::IDLE_ON);
+  encoder_ptr->FinishCalibration();
+  // The encoder position moved with the new correction
+  stall_detector.Reset(CurrentSteps(), EncoderSteps());
+  if (closed_loop_enabled_)
+  {
+    ResetClosedLoop();
+  }
+}
+
+void MotorController::RecordScopeSample(unsigned long now)
+{
+  ScopeSample sample;
+  sample.time_us = now;
+  // Up to one loop behind during a hardware move
+  sample.commanded_position = hw_move_active_ ? hw_move_position_ : stepper.currentPosition();
+  // Not kept up to date by the step engine either, see CommandedDegreesPerSecond()
+  sample.commanded_velocity = hw_move_active_ ? 0.0f : stepper.speed();
+  if (encoder_ptr != nullptr)
+  {
+    sample.encoder_position = EncoderSteps();
+    sample.encoder_velocity = encoder_ptr->GetVelocityDegreesPerSecond() * (8 * 200) / 360.0f;
+  }
+  else
+  {
+    sample.encoder_position = 0.0f;
+    sample.encoder_velocity = 0.0f;
+  }
+  sample.status = ((uint16_t)controlMode & SCOPE_STATUS_STATE_MASK) |
+                  (hw_move_active_ ? SCOPE_STATUS_STEP_ENGINE : 0) |
+                  (closed_loop_enabled_ ? SCOPE_STATUS_CLOSED_LOOP : 0) |
+                  (uint16_t)((error_flag.errors & 0xFF) << SCOPE_STATUS_ERROR_SHIFT);
+
+  bool moving = hw_move_active_ || s_curve_move_ || stepper.speed() != 0.0f;
+  scope.Record(sample, moving && !scope_was_moving_);
+  scope_was_moving_ = moving;
+}
+
+float MotorController::CommandedDegreesPerSecond()
+{
+  // The hardware engine doesn't keep stepper.speed() up to date, the encoder
+  // observer tracks those moves without feed-forward
+  if (controlMode == MotorStates::OFF || hw_move_active_)
+    return 0.0f;
+  return stepper.speed() * 360.0f / (8 * 200);
+}
+
+void MotorController::RunClosedLoop()
+{
+  if (controlMode == MotorStates::OFF || controlMode == MotorStates::HOME || controlMode == MotorStates::CALIBRATE ||
+      hw_move_active_)
+  {
+    // Not holding the profile, follow the shaft instead
+    ResetClosedLoop();
+    return;
+  }
+  if (encoder_ptr != nullptr)
+  {
+    closed_loop_.Update(CurrentSteps(), EncoderSteps());
+  }
+}
+
+void MotorController::ResetClosedLoop()
+{
+  if (encoder_ptr != nullptr)
+  {
+    closed_loop_.Reset(CurrentSteps(), EncoderSteps());
+  }
+}
+
+void MotorController::RunStallCheck()
+{
+  if (controlMode == MotorStates::OFF || controlMode == MotorStates::HOME || controlMode == MotorStates::CALIBRATE)
+  {
+    // Free to turn, stalling on purpose, or the encoder is being recalibrated
+    stall_detector.Reset(CurrentSteps(), EncoderSteps());
+    return;
+  }
+  if (!stall_detector.Update(CurrentSteps(), EncoderSteps()))
+  {
+    return;
+  }
+
+  error_flag.bits.stall = true;
+  DEBUG_PRINTF("Stall, following error %f steps\n", stall_detector.Error());
+  addrLedController.AddLedStep(CRGB::Red, 100);
+  addrLedController.AddLedStep(CRGB::Black, 1);
+
+  switch (stall_action_)
+  {
+  case StallAction::REPORT:
+    break;
+  case StallAction::STOP:
+    StopOnStall(false);
+    break;
+  case StallAction::RESYNC:
+    StopOnStall(true);
+    break;
+  }
+}
+
+void MotorController::StopOnStall(bool resync)
+{
+  MotorStates mode = controlMode;
+  long target = target_position;
+  long position = CurrentSteps();
+  if (resync)
+  {
+    // Where the encoder says the shaft is
+    position -= lroundf(stall_detector.Error());
+  }
+
+  // The interrupt stops stepping first, then the position is set, which drops
+  // the speed at once rather than ramping against the jam
+  SetMotorState(MotorStates::IDLE_ON);
+  stepper.setCurrentPosition(position);
+  target_position = position;
+  if (closed_loop_enabled_)
+  {
+    ResetClosedLoop();
+  }
+  if (!resync)
+  {
+    return;
+  }
+
+  stall_detector.Reset(CurrentSteps(), EncoderSteps());
+  // Moves with a target or a speed carry on from the true position, streamed
+  // paths are absolute and stay stopped
+  if (mode == MotorStates::POSITION)
+  {
+    SetMotorState(MotorStates::POSITION);
+    target_position = target;
+    StartPositionMove();
+  }
+  else if (mode == MotorStates::VELOCITY)
+  {
+    SetVelocityTarget(target_velocity);
+  }
+}
+
+float MotorController::EncoderSteps()
+{
+  return encoder_ptr->GetPositionDegrees() * (8 * 200) / 360.0f;
+}
+
+void MotorController::StartPositionMove()
+{
+  if (s_curve_move_)
+  {
+    // OnTimer() carries on to the new target from the current speed
+    s_curve_retarget_ = true;
+    return;
+  }
+
+  long distance = target_position - stepper.currentPosition();
+  bool s_curve = motion_profile_ == MotionProfile::S_CURVE;
+
+#ifdef HW_STEP_ENGINE
+  if (hw_move_active_)
+  {
+    // Carry on from the speed the queued pulses end at. Otherwise the move
+    // ramps down and OnRun() starts the new target afterwards.
+    hw_target_pending_ = !step_engine.Retarget((target_position - hw_move_start_) * hw_move_direction_);
+    return;
+  }
+
+  // Corrections come from the step interrupt, which the step engine bypasses
+  if (stepper.speed() == 0.0 && distance != 0 && !closed_loop_enabled_)
+  {
+    step_engine.generator.SetMaxSpeed(stepper.maxSpeed());
+    step_engine.generator.SetAcceleration(stepper.acceleration());
+    step_engine.generator.SetJerk(s_curve ? jerk_ : 0);
+
+    hw_move_direction_ = distance > 0 ? 1 : -1;
+    hw_move_start_ = stepper.currentPosition();
+    hw_move_position_ = hw_move_start_;
+    // DIR is inverted, see setPinsInverted() in OnStart()
+    digitalWrite(MOTOR_DIR, distance > 0 ? LOW : HIGH);
+
+    if (step_engine.Start(abs(distance)))
+    {
+      hw_move_active_ = true;
+      return;
+    }
+  }
+#endif
+  if (s_curve && stepper.speed() == 0.0 && distance != 0)
+  {
+    s_curve_.SetMaxSpeed(stepper.maxSpeed());
+    s_curve_.SetAcceleration(stepper.acceleration());
+    s_curve_.SetJerk(jerk_);
+    s_curve_clockwise_ = distance > 0;
+    s_curve_.BeginMove(abs(distance));
+    // The first step is due straight away, OnTimer() times the rest
+    stepper.setStepInterval(1, 0, s_curve_clockwise_);
+    s_curve_next_valid_ = s_curve_.NextInterval(s_curve_next_us_, s_curve_next_frac_);
+    s_curve_retarget_ = false;
+    s_curve_move_ = true;
+    return;
+  }
+  stepper.moveTo(target_position);
+}
+
+bool MotorController::NextPathSegment()
+{
+  // The running segment stays queued until it ends so the planner can still
+  // raise its exit speed
+  if (path_segment_active_)
+  {
+    velocity_planner.Finish();
+    path_segment_active_ = false;
+  }
+
+  const VelocityPlanner::Segment *segment = velocity_planner.Current();
+  while (segment != nullptr && segment->end == stepper.currentPosition())
+  {
+    // Already there, e.g. a path resumed after a mode change
+    velocity_planner.Finish();
+    segment = velocity_planner.Current();
+  }
+  if (segment == nullptr)
+  {
+    // DEBUG_PRINTF("Finished velocity step at %ld\n", stepper.currentPosition());
+    path_speed_ = 0.0f;
+    stepper.setSpeed(0);
+    SetMotorState(MotorStates::IDLE_ON);
+    addrLedController.AddLedStep(CRGB::Purple, 500);
+    addrLedController.AddLedStep(CRGB::Black, 1);
+    return false;
+  }
+
+  // DEBUG_PRINTF("Current End: %ld, current position: %ld new end: %ld\n", velocity_step_end, stepper.currentPosition(), segment->end);
+  path_segment_active_ = true;
+  velocity_step_end = segment->end;
+  bool clockwise = velocity_step_end > stepper.currentPosition();
+  if (clockwise != path_clockwise_)
+  {
+    // Reversals are planned through a stop
+    path_speed_ = 0.0f;
+  }
+  path_clockwise_ = clockwise;
+
+  if (motion_profile_ == MotionProfile::S_CURVE)
+  {
+    StartSCurveSegment(segment->speed, clockwise);
+  }
+  else
+  {
+    NextPathStep();
+  }
+  return true;
+}
+
+void MotorController::NextPathStep()
+{
+  if (motion_profile_ == MotionProfile::S_CURVE)
+  {
+    // Holding its final speed once nothing is queued
+    if (s_curve_next_valid_)
+    {
+      NextSCurveStep();
+    }
+    return;
+  }
+
+  unsigned long interval_us;
+  uint8_t interval_frac;
+  velocity_planner.NextInterval(path_speed_, abs(velocity_step_end - stepper.currentPosition()), interval_us, interval_frac);
+  stepper.setStepInterval(interval_us, interval_frac, path_clockwise_);
+}
+
+void MotorController::RunPvt(unsigned long now)
+{
+  if (!pvt_playing_)
+  {
+    // Jitter buffer: the first point waits pvt_delay_us_ so the ones after it
+    // arrive before they are needed
+    if (pvt.Size() == 0)
+      return;
+    if (!pvt_buffering_)
+    {
+      pvt_buffering_ = true;
+      pvt_buffer_start_us_ = now;
+    }
+    if (now - pvt_buffer_start_us_ < pvt_delay_us_)
+      return;
+    pvt.Start(stepper.currentPosition());
+    pvt_start_us_ = now;
+    pvt_playing_ = true;
+    pvt_step_pending_ = false;
+  }
+
+  if (pvt_step_pending_)
+  {
+    if (!stepper.runSpeed())
+      return;
+    pvt_step_pending_ = false;
+  }
+
+  uint64_t time_q8;
+  bool forward;
+  if (pvt.NextStep(stepper.currentPosition(), time_q8, forward))
+  {
+    stepper.setStepDeadline(pvt_start_us_ + (unsigned long)((time_q8 + 128) >> 8), now, forward);
+    pvt_step_pending_ = true;
+    return;
+  }
+
+  // No step before the last point so far, check again next interrupt
+  stepper.setStepInterval(0, 0, true);
+  if ((long)(now - (pvt_start_us_ + (unsigned long)pvt.EndTimeUs())) < 0)
+    return;
+
+  pvt_playing_ = false;
+  pvt_buffering_ = false;
+  float velocity = pvt.EndVelocity();
+  if (velocity == 0.0f)
+  {
+    // DEBUG_PRINTF("PVT stream finished at %ld\n", stepper.currentPosition());
+    SetMotorState(MotorStates::IDLE_ON);
+    return;
+  }
+
+  // Underrun, the stream stopped while moving. Ramp down from the last
+  // point's velocity the way a position move does.
+  pvt_underruns_++;
+  float interval = 1000000.0f / fabsf(velocity);
+  stepper.setStepInterval(interval > 1.0f ? (unsigned long)interval : 1, 0, velocity > 0.0f);
+  stepper.stop();
+  target_position = stepper.targetPosition();
+  controlMode = MotorStates::POSITION;
+  addrLedController.AddLedStep(CRGB::Red, 100);
+  addrLedController.AddLedStep(CRGB::Black, 1);
+}
+
+void MotorController::RunSCurveMove()
+{
+  if (s_curve_retarget_)
+  {
+    // Hand the move over to the trapezoidal ramp, which decelerates or
+    // reverses from the current speed as needed
+    s_curve_retarget_ = false;
+    s_curve_move_ = false;
+    stepper.moveTo(target_position);
+    return;
+  }
+
+  if (!stepper.runSpeed())
+    return;
+  // Nothing queued once the profile has handed out its last step, which is
+  // the one just taken
+  if (!s_curve_next_valid_)
+  {
+    s_curve_move_ = false;
+    stepper.setCurrentPosition(stepper.currentPosition());
+    SetMotorState(MotorStates::IDLE_ON);
+    return;
+  }
+  NextSCurveStep();
+}
+
+void MotorController::StartSCurveSegment(int32_t velocity, bool clockwise)
+{
+  // Ramp from the current speed, or from rest when the direction reverses
+  float from = stepper.speed();
+  if ((from > 0.0f) != clockwise)
+    from = 0.0f;
+
+  s_curve_.SetMaxSpeed(stepper.maxSpeed());
+  s_curve_.SetAcceleration(stepper.acceleration());
+  s_curve_.SetJerk(jerk_);
+  s_curve_clockwise_ = clockwise;
+  s_curve_.BeginVelocity(fabsf(from), velocity);
+  s_curve_next_valid_ = s_curve_.NextInterval(s_curve_next_us_, s_curve_next_frac_);
+  NextSCurveStep();
+}
+
+void MotorController::NextSCurveStep()
+{
+  if (!s_curve_next_valid_)
+  {
+    stepper.setStepInterval(0, 0, s_curve_clockwise_);
+    return;
+  }
+  // 0 would stop runSpeed(), the step is late anyway
+  stepper.setStepInterval(s_curve_next_us_ > 0 ? s_curve_next_us_ : 1, s_curve_next_frac_, s_curve_clockwise_);
+  // A path segment holds its speed once the ramp is over
+  s_curve_next_valid_ = s_curve_.Ramping() && s_curve_.NextInterval(s_curve_next_us_, s_curve_next_frac_);
+}
+
+unsigned long MotorController::StepIntervalAfterNext(uint8_t &interval_frac)
+{
+  interval_frac = stepper.GetStepIntervalFrac();
+  switch (controlMode)
+  {
+  case MotorStates::POSITION:
+    if (hw_move_active_)
+      break;
+    if (s_curve_move_)
+    {
+      interval_frac = s_curve_next_valid_ ? s_curve_next_frac_ : 0;
+      return s_curve_next_valid_ ? (s_curve_next_us_ > 0 ? s_curve_next_us_ : 1) : 0;
+    }
+    return stepper.intervalAfterNextStepUs(interval_frac);
+  case MotorStates::VELOCITY_STEP:
+  {
+    if (motion_profile_ == MotionProfile::S_CURVE)
+    {
+      if (!s_curve_next_valid_)
+        break;
+      interval_frac = s_curve_next_frac_;
+      return s_curve_next_us_ > 0 ? s_curve_next_us_ : 1;
+    }
+    long steps_left = abs(velocity_step_end - stepper.currentPosition());
+    if (steps_left <= 1)
+      break; // the next segment takes over
+    float speed = path_speed_;
+    unsigned long interval_us;
+    velocity_planner.NextInterval(speed, steps_left - 1, interval_us, interval_frac);
+    return interval_us;
+  }
+  case MotorStates::HOME:
+    if (home_step == BACKUP)
+      return stepper.intervalAfterNextStepUs(interval_frac);
+    break;
+  default:
+    break;
+  }
+  // Constant between setpoints, OnTimer() catches up if one comes in
+  return stepper.GetStepIntervalUs();
+}
+
+void MotorController::FinishHardwareMove()
+{
+  step_engine.Abort();
+  stepper.setCurrentPosition(hw_move_start_ + hw_move_direction_ * step_engine.StepsEmitted());
+  hw_move_active_ = false;
+
+  if (step_engine.HadUnderrun())
+  {
+    DEBUG_PRINTLN("Step engine underrun");
+    addrLedController.AddLedStep(CRGB::Red, 100);
+    addrLedController.AddLedStep(CRGB::Black, 1);
+  }
+}
+
+long MotorController::CurrentSteps()
+{
+  if (hw_move_active_)
+  {
+    hw_move_position_ = hw_move_start_ + hw_move_direction_ * step_engine.StepsEmitted();
+    return hw_move_position_;
+  }
+  return stepper.currentPosition();
 }
 
 void MotorController::SetMotorState(MotorStates state)
 {
   state_change_time_ = millis();
 
+  if (hw_move_active_ && state != MotorStates::POSITION)
+  {
+    hw_target_pending_ = false;
+    FinishHardwareMove();
+  }
+  if (state != MotorStates::POSITION)
+  {
+    s_curve_move_ = false;
+  }
+
   switch (state)
   {
   case MotorStates::OFF:
@@ -286,11 +790,26 @@ void MotorController::SetMotorState(MotorStates state)
     {
       stepper.setSpeed(0); // initialize it to 0
       velocity_step_end = stepper.currentPosition();
+      path_segment_active_ = false;
+      path_speed_ = 0.0f;
       // DEBUG_PRINTF("Starting Velocity Step at %ld\n", velocity_step_end);
     }
     driver.setAllCurrentValues(100, 0, 0);
     stepper.enableOutputs();
     break;
+  case MotorStates::PVT:
+    if (controlMode != MotorStates::PVT)
+    {
+      // The interrupt isn't playing, anything left from an earlier stream is stale
+      stepper.setSpeed(0);
+      pvt.Clear();
+      pvt_buffering_ = false;
+      pvt_playing_ = false;
+      pvt_step_pending_ = false;
+    }
+    driver.setRunCurrent(100);
+    stepper.enableOutputs();
+    break;
   case MotorStates::HOME:
     stepper.enableOutputs();
     stepper.setSpeed(homing_direction * homing_speed_);
@@ -300,6 +819,21 @@ void MotorController::SetMotorState(MotorStates state)
     home_state_ = false;
     // driver.setStallGuardThreshold(homing_threshold);
     break;
+  case MotorStates::CALIBRATE:
+    if (encoder_ptr == nullptr)
+    {
+      // Nothing to calibrate
+      state = MotorStates::IDLE_ON;
+      stepper.enableOutputs();
+      break;
+    }
+    driver.setRunCurrent(100);
+    stepper.enableOutputs();
+    stepper.setSpeed(ENCODER_CALIBRATION_SPEED);
+    calibration_start_ = stepper.currentPosition();
+    calibration_last_us_ = micros();
+    encoder_ptr->BeginCalibration();
+    break;
   case MotorStates::IDLE_ON:
     stepper.enableOutputs();
     break;
@@ -326,6 +860,7 @@ MotorBrake MotorController::GetMotorBraking()
 void MotorController::SetMaxSpeed(uint32_t spd)
 {
   stepper.setMaxSpeed(spd);
+  velocity_planner.SetMaxSpeed(spd);
 }
 
 uint32_t MotorController::GetMaxSpeed()
@@ -336,6 +871,7 @@ uint32_t MotorController::GetMaxSpeed()
 void MotorController::SetAcceleration(uint32_t acl)
 {
   stepper.setAcceleration(acl);
+  velocity_planner.SetAcceleration(acl);
 }
 
 uint32_t MotorController::GetAcceleration()
@@ -343,14 +879,59 @@ uint32_t MotorController::GetAcceleration()
   return stepper.acceleration();
 }
 
+bool MotorController::SetMotionProfile(MotionProfile profile)
+{
+  if (profile != MotionProfile::TRAPEZOIDAL && profile != MotionProfile::S_CURVE)
+  {
+    return false;
+  }
+  // Takes effect at the next move or path segment
+  motion_profile_ = profile;
+  return true;
+}
+
+MotionProfile MotorController::GetMotionProfile()
+{
+  return motion_profile_;
+}
+
+bool MotorController::SetJerk(uint32_t jerk)
+{
+  if (jerk == 0)
+  {
+    return false;
+  }
+  jerk_ = jerk;
+  return true;
+}
+
+uint32_t MotorController::GetJerk()
+{
+  return jerk_;
+}
+
 void MotorController::SetPosition(double position)
 {
+  if (hw_move_active_)
+  {
+    hw_target_pending_ = false;
+    FinishHardwareMove();
+  }
+  s_curve_move_ = false;
   stepper.setCurrentPosition((long)degreesToSteps(position));
+  if (closed_loop_enabled_)
+  {
+    ResetClosedLoop();
+  }
+  if (encoder_ptr != nullptr)
+  {
+    stall_detector.Reset(CurrentSteps(), EncoderSteps());
+  }
 }
 
 double MotorController::GetPosition()
 {
-  return stepsToDegrees(stepper.currentPosition());
+  return stepsToDegrees(CurrentSteps());
 }
 
 void MotorController::SetPositionTargetRelative(double position)
@@ -358,14 +939,14 @@ void MotorController::SetPositionTargetRelative(double position)
   // DEBUG_PRINTF("Steps: %f\n", position);
   SetMotorState(MotorStates::POSITION);
   target_position += degreesToSteps(position);
-  stepper.moveTo(target_position);
+  StartPositionMove();
 }
 
 void MotorController::SetPositionTarget(double position)
 {
   SetMotorState(MotorStates::POSITION);
   target_position = degreesToSteps(position);
-  stepper.moveTo(target_position);
+  StartPositionMove();
 }
 
 double MotorController::GetPositionTarget()
@@ -376,6 +957,12 @@ double MotorController::GetPositionTarget()
 void MotorController::SetVelocityTarget(double velocity)
 {
   DEBUG_PRINTF("Setting velocity target: %f\n", velocity);
+  if (hw_move_active_)
+  {
+    hw_target_pending_ = false;
+    FinishHardwareMove();
+  }
+  s_curve_move_ = false;
   stepper.enableOutputs();
   controlMode = MotorStates::VELOCITY;
   target_velocity = velocity;
@@ -387,10 +974,26 @@ double MotorController::GetVelocityTarget()
   return target_velocity;
 }
 
-void MotorController::AddVelocityStep(int32_t velocity, int32_t step, uint8_t position_mode)
+bool MotorController::AddVelocityStep(int32_t velocity, int32_t step, uint8_t position_mode)
 {
   // DEBUG_PRINTF("Adding velocity step: %d, %d\n", velocity, step);
-  velocity_steps.push_back({(PositionMode)position_mode, abs(velocity), step});
+  // Segments follow on from the end of the queued path
+  long start = velocity_planner.LastEnd(CurrentSteps());
+  long end = start;
+  if ((PositionMode)position_mode == PositionMode::ABSOLUTE)
+  {
+    end = step;
+  }
+  else if ((PositionMode)position_mode == PositionMode::RELATIVE)
+  {
+    end = start + step;
+  }
+  if (!velocity_planner.Add(start, end, abs(velocity)))
+  {
+    DEBUG_PRINTLN("Velocity step queue full");
+    return false;
+  }
+  return true;
 }
 
 void MotorController::StartPath()
@@ -398,6 +1001,100 @@ void MotorController::StartPath()
   SetMotorState(MotorStates::VELOCITY_STEP);
 }
 
+bool MotorController::SetPlannerDepth(uint8_t depth)
+{
+  return velocity_planner.SetDepth(depth);
+}
+
+uint8_t MotorController::GetPlannerDepth()
+{
+  return velocity_planner.Depth();
+}
+
+bool MotorController::AddPvtPoint(uint32_t time_us, int32_t position, int32_t velocity)
+{
+  if (controlMode != MotorStates::PVT)
+  {
+    // The first point of a stream switches to PVT, playback starts once the
+    // jitter buffer delay is up
+    SetMotorState(MotorStates::PVT);
+  }
+  if (!pvt.Add(time_us, position, velocity))
+  {
+    DEBUG_PRINTLN("PVT point rejected");
+    return false;
+  }
+  return true;
+}
+
+void MotorController::SetPvtDelay(uint32_t delay_us)
+{
+  pvt_delay_us_ = delay_us;
+}
+
+uint32_t MotorController::GetPvtDelay()
+{
+  return pvt_delay_us_;
+}
+
+uint32_t MotorController::GetPvtUnderruns()
+{
+  return pvt_underruns_;
+}
+
+void MotorController::SetClosedLoop(bool enabled)
+{
+  if (enabled && !closed_loop_enabled_)
+  {
+    // Start from wherever the shaft is now
+    ResetClosedLoop();
+    closed_loop_last_us_ = micros();
+  }
+  closed_loop_enabled_ = enabled;
+}
+
+bool MotorController::GetClosedLoop()
+{
+  return closed_loop_enabled_;
+}
+
+bool MotorController::SetClosedLoopGains(float p, float i, float d, float limit)
+{
+  if (p < 0 || i < 0 || d < 0 || limit <= 0)
+  {
+    return false;
+  }
+  pid.P = p;
+  pid.I = i;
+  pid.D = d;
+  pid.limit = limit;
+  pid.reset();
+  return true;
+}
+
+void MotorController::GetClosedLoopGains(float &p, float &i, float &d, float &limit)
+{
+  p = pid.P;
+  i = pid.I;
+  d = pid.D;
+  limit = pid.limit;
+}
+
+float MotorController::GetClosedLoopError()
+{
+  return closed_loop_.Error();
+}
+
+float MotorController::GetClosedLoopCorrection()
+{
+  return closed_loop_.Rate();
+}
+
+long MotorController::GetClosedLoopOffset()
+{
+  return closed_loop_.Offset();
+}
+
 void MotorController::setEncoderValueSource(IEncoderInterface *encoder_value)
 {
   encoder_ptr = encoder_value;
@@ -405,7 +1102,33 @@ void MotorController::setEncoderValueSource(IEncoderInterface *encoder_value)
 
 uint32_t MotorController::GetErrors()
 {
-  return error_flag;
+  return error_flag.errors;
+}
+
+void MotorController::ClearErrors()
+{
+  error_flag.errors = 0;
+  stall_detector.ClearStatistics();
+  if (encoder_ptr != nullptr)
+  {
+    // Re-arm from where the shaft is now
+    stall_detector.Reset(CurrentSteps(), EncoderSteps());
+  }
+}
+
+bool MotorController::SetStallAction(StallAction action)
+{
+  if (action != StallAction::REPORT && action != StallAction::STOP && action != StallAction::RESYNC)
+  {
+    return false;
+  }
+  stall_action_ = action;
+  return true;
+}
+
+StallAction MotorController::GetStallAction()
+{
+  return stall_action_;
 }
 
 void MotorController::SetHomeDirection(HomeDirection direction)
@@ -448,6 +1171,14 @@ void MotorController::Home()
   SetMotorState(MotorStates::HOME);
 }
 
+bool MotorController::CalibrateEncoder()
+{
+  if (encoder_ptr == nullptr)
+    return false;
+  SetMotorState(MotorStates::CALIBRATE);
+  return true;
+}
+
 void MotorController::PrintErrorsToSerial()
 {
   auto stat = driver.getStatus();
@@ -2,6 +2,15 @@
 #include <Arduino.h>
 #include "Task/Task.h"
 #include "MotorController/AccelStepper.h"
+#include "MotorController/StepPulseEngine.h"
+#include "MotorController/StepTimerSchedule.h"
+#include "MotorController/StepTimer.h"
+#include "MotorController/SCurveProfile.h"
+#include "MotorController/VelocityPlanner.h"
+#include "MotorController/PvtInterpolator.h"
+#include "MotorController/ClosedLoopCorrector.h"
+#include "MotorController/StallDetector.h"
+#include "MotorController/ScopeCapture.h"
 #include "LedController/LedController.h"
 #include "easyTMC2209.h"
 #include "wiring_private.h"
@@ -16,6 +25,12 @@
 #define DEFAULT_HOMING_DIRECTION 1
 #define DEFAULT_HOMING_THRESHOLD 2
 
+// Encoder calibration: one turn at a slow constant speed after a lead-in that
+// lets the shaft settle, sampled every few ms
+#define ENCODER_CALIBRATION_SPEED 200   // steps/s
+#define ENCODER_CALIBRATION_LEAD_IN 100 // steps
+#define ENCODER_CALIBRATION_SAMPLE_US 2000
+
 #define US_PER_SEC 1000000
 #define TIMER_FREQ 10000 // ticks per second
 #define TIMER_PERIOD (1.0/TIMER_FREQ) // 1ms period
@@ -27,10 +42,21 @@ constexpr uint32_t TIMER_COUNT = (48000000 / 8) * TIMER_PERIOD;
 
 static_assert(TIMER_COUNT > 0 && TIMER_COUNT < 0xFFFF, "TIMER_COUNT must be greater than 0 and less than 0xFFFF");
 
-#define DOUBLE_BUF_SIZE 1024
-
 #define SENSORLESS_HOMING
 
+// POSITION moves started from standstill are emitted by the TC4/DMA step
+// engine instead of stepping from the TC0 interrupt
+#define HW_STEP_ENGINE
+
+// TC0 periods run from step deadline to step deadline and are loaded through
+// CCBUF0, see StepTimerSchedule
+#define ABSOLUTE_STEP_SCHEDULING
+#define STEP_TIMER_TICKS_PER_US ((48000000 / 8) / US_PER_SEC)
+#define STEP_TIMER_IDLE_PERIOD_US 1000
+
+// Jerk limit of S-curve profiles, steps/s^3
+#define DEFAULT_JERK 100000
+
 enum HomeState
 {
     ROUGH,
@@ -44,7 +70,8 @@ union MotorError
     {
         bool lostPower : 1;
         bool TMC_lost_comms : 1;
-        uint32_t spares : 30;
+        bool stall : 1; // following error left the stall window
+        uint32_t spares : 29;
     } bits;
     uint32_t errors;
 };
@@ -63,24 +90,31 @@ private:
     HardwareSerial &serial_stream;
     easyTMC2209 driver;
     PIDController pid;
+    ClosedLoopCorrector closed_loop_;
+    StepTimerSchedule step_timer_schedule;
 
 public:
     AccelStepper stepper;
+    StepPulseEngine step_engine;
 
     MotorStates controlMode;
     MotorBrake motorBrake;
     String modeString = "";
 
     //Velocity Step variables
-    struct VelocityStep
-    {
-        PositionMode positionMode;
-        int32_t velocity;
-        int32_t step;
-    };
-    std::deque<VelocityStep> velocity_steps;
+    // Pushed by AddVelocityStep(), run by OnTimer()
+    VelocityPlanner velocity_planner;
     long velocity_step_end = 0;
 
+    // PVT stream, pushed by AddPvtPoint(), played by OnTimer()
+    PvtInterpolator pvt;
+
+    // Following error monitor, checked from OnRun()
+    StallDetector stall_detector;
+
+    // Triggered sample capture, recorded from OnTimer()
+    ScopeCapture scope;
+
     // data that holds encoder data
     IEncoderInterface *encoder_ptr = nullptr;
     int step = 0;
@@ -101,10 +135,16 @@ public:
     uint16_t homing_threshold = DEFAULT_HOMING_THRESHOLD;
     float homing_coarse_limit_;
     float homing_fine_limit_;
+
+    // Encoder calibration run, see CalibrateEncoder()
+    long calibration_start_ = 0;
+    unsigned long calibration_last_us_ = 0;
+
+    void RunEncoderCalibration();
     
 
 
-    int error_flag;
+    MotorError error_flag = {};
     uint32_t state_change_time_;
 
     uint8_t send_buffer[1024];
@@ -112,9 +152,84 @@ public:
     long degreesToSteps(double degrees);
     double stepsToDegrees(long steps);
 
+    // hardware step engine move bookkeeping
+    volatile bool hw_move_active_ = false;
+    bool hw_target_pending_ = false;
+    long hw_move_start_ = 0;
+    int hw_move_direction_ = 1;
+    // Position of a hardware move as of the last CurrentSteps(), for the
+    // step interrupt, which mustn't read the pulse counter
+    volatile long hw_move_position_ = 0;
+
+    void StartPositionMove();
+    void FinishHardwareMove();
+    long CurrentSteps();
+
+    // S-curve profile, see SetMotionProfile(). Timed from OnTimer() for
+    // VELOCITY_STEP segments and for POSITION moves the step engine can't take.
+    MotionProfile motion_profile_ = MotionProfile::TRAPEZOIDAL;
+    uint32_t jerk_ = DEFAULT_JERK;
+    SCurveProfile s_curve_;
+    volatile bool s_curve_move_ = false;
+    volatile bool s_curve_retarget_ = false;
+    bool s_curve_clockwise_ = true;
+    // The profile runs a step ahead of the stepper, see StepIntervalAfterNext()
+    bool s_curve_next_valid_ = false;
+    unsigned long s_curve_next_us_ = 0;
+    uint8_t s_curve_next_frac_ = 0;
+
+    // running path segment, see NextPathSegment()
+    bool path_segment_active_ = false;
+    bool path_clockwise_ = true;
+    float path_speed_ = 0.0f;
+
+    bool NextPathSegment();
+    void NextPathStep();
+
+    // PVT playback, see RunPvt()
+    uint32_t pvt_delay_us_ = PVT_DEFAULT_DELAY_US;
+    bool pvt_buffering_ = false;
+    bool pvt_playing_ = false;
+    bool pvt_step_pending_ = false;
+    unsigned long pvt_buffer_start_us_ = 0;
+    unsigned long pvt_start_us_ = 0;
+    volatile uint32_t pvt_underruns_ = 0;
+
+    void RunPvt(unsigned long now);
+
+    // Encoder position correction, see ClosedLoopCorrector
+    volatile bool closed_loop_enabled_ = false;
+    unsigned long closed_loop_last_us_ = 0;
+
+    void RunClosedLoop();
+    void ResetClosedLoop();
+
+    // Reaction to a stall, see RunStallCheck()
+    StallAction stall_action_ = StallAction::REPORT;
+    unsigned long stall_last_us_ = 0;
+
+    void RunStallCheck();
+
+    // Scope sample at the start of the step interrupt
+    bool scope_was_moving_ = false;
+    void RecordScopeSample(unsigned long now);
+    void StopOnStall(bool resync);
+    float EncoderSteps();
+    float CommandedDegreesPerSecond();
+
+    void RunSCurveMove();
+    void StartSCurveSegment(int32_t velocity, bool clockwise);
+    void NextSCurveStep();
+
+    // Interval that follows the next step, for loading the step timer a
+    // period ahead
+    unsigned long StepIntervalAfterNext(uint8_t &interval_frac);
+
 public:
     MotorController(uint32_t period) : serial_stream(Serial1),
                                        pid(10, 0.01, 0, 100000, 1000),
+                                       closed_loop_(pid),
+                                       step_timer_schedule(STEP_TIMER_TICKS_PER_US, STEP_TIMER_IDLE_PERIOD_US),
                                        stepper(stepper.DRIVER, MOTOR_STEP, MOTOR_DIR)
     {
         executionPeriod = period;
@@ -138,6 +253,12 @@ public:
     void SetAcceleration(uint32_t acl);
     uint32_t GetAcceleration();
 
+    bool SetMotionProfile(MotionProfile profile);
+    MotionProfile GetMotionProfile();
+
+    bool SetJerk(uint32_t jerk);
+    uint32_t GetJerk();
+
     void SetPosition(double position);
     double GetPosition();
 
@@ -148,11 +269,31 @@ public:
     void SetVelocityTarget(double velocity);
     double GetVelocityTarget();
 
-    void AddVelocityStep(int32_t velocity, int32_t step, uint8_t position_mode);
+    bool AddVelocityStep(int32_t velocity, int32_t step, uint8_t position_mode);
     void StartPath();
 
+    bool SetPlannerDepth(uint8_t depth);
+    uint8_t GetPlannerDepth();
+
+    bool AddPvtPoint(uint32_t time_us, int32_t position, int32_t velocity);
+    void SetPvtDelay(uint32_t delay_us);
+    uint32_t GetPvtDelay();
+    uint32_t GetPvtUnderruns();
+
+    void SetClosedLoop(bool enabled);
+    bool GetClosedLoop();
+    bool SetClosedLoopGains(float p, float i, float d, float limit);
+    void GetClosedLoopGains(float &p, float &i, float &d, float &limit);
+    float GetClosedLoopError();
+    float GetClosedLoopCorrection();
+    long GetClosedLoopOffset();
+
     void setEncoderValueSource(IEncoderInterface *encoder_value);
     uint32_t GetErrors();
+    void ClearErrors();
+
+    bool SetStallAction(StallAction action);
+    StallAction GetStallAction();
 
     void SetHomeDirection(HomeDirection direction);
     HomeDirection GetHomeDirection();
@@ -165,6 +306,11 @@ public:
     
     bool GetHomeState();
     void Home();
+
+    // Turns the motor once at ENCODER_CALIBRATION_SPEED for the encoder to
+    // fit its angle correction, then stops in IDLE_ON. False without an
+    // encoder.
+    bool CalibrateEncoder();
     
 
     void PrintErrorsToSerial();
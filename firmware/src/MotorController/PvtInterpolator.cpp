@@ -0,0 +1,188 @@
+#include "PvtInterpolator.h"
+#include <cmath>
+
+// Newton steps shorter than this end the search, seconds
+#define PVT_SOLVE_TOLERANCE_S 1.0e-7f
+// Enough bisections to get there from a second long piece
+#define PVT_SOLVE_ITERATIONS 24
+
+PvtInterpolator::PvtInterpolator()
+    : has_last_(false),
+      last_time_us_(0),
+      in_segment_(false),
+      segment_start_q8_(0),
+      duration_us_(0),
+      c1_(0.0f),
+      c2_(0.0f),
+      c3_(0.0f),
+      piece_count_(0),
+      piece_(0),
+      tau_(0.0f)
+{
+  start_.time_us = 0;
+  start_.position = 0;
+  start_.velocity = 0.0f;
+}
+
+bool PvtInterpolator::Add(uint32_t time_us, long position, float velocity)
+{
+  // Timestamps wrap, only the difference to the previous point counts
+  if (has_last_ && (int32_t)(time_us - last_time_us_) <= 0)
+    return false;
+
+  Point point;
+  point.time_us = time_us;
+  point.position = position;
+  point.velocity = velocity;
+  if (!ring_.Push(point))
+    return false;
+  has_last_ = true;
+  last_time_us_ = time_us;
+  return true;
+}
+
+void PvtInterpolator::Clear()
+{
+  ring_.Clear();
+  has_last_ = false;
+  in_segment_ = false;
+}
+
+bool PvtInterpolator::Start(long position)
+{
+  const Point *first = ring_.Front();
+  if (first == nullptr)
+    return false;
+  start_ = *first;
+  start_.position = position;
+  ring_.Pop();
+  in_segment_ = false;
+  segment_start_q8_ = 0;
+  return true;
+}
+
+bool PvtInterpolator::NextStep(long position, uint64_t &time_q8, bool &forward)
+{
+  for (;;)
+  {
+    if (!in_segment_)
+    {
+      const Point *end = ring_.Front();
+      if (end == nullptr)
+        return false;
+      BeginSegment(*end);
+    }
+
+    float level_base = (float)(position - start_.position);
+    while (piece_ < piece_count_)
+    {
+      float end = piece_end_[piece_];
+      int dir = piece_dir_[piece_];
+      // The half step the motor moves on at, ahead in this piece's direction
+      float level = level_base + 0.5f * dir;
+      if (dir != 0 && (Position(end) - level) * dir > 0.0f)
+      {
+        tau_ = Solve(level, dir, tau_, end);
+        time_q8 = segment_start_q8_ + (uint64_t)(tau_ * 256.0e6f + 0.5f);
+        forward = dir > 0;
+        return true;
+      }
+      tau_ = end;
+      piece_++;
+    }
+
+    // On to the next segment, which starts where this one ended
+    segment_start_q8_ += (uint64_t)duration_us_ << 8;
+    start_ = *ring_.Front();
+    ring_.Pop();
+    in_segment_ = false;
+  }
+}
+
+void PvtInterpolator::BeginSegment(const Point &end)
+{
+  duration_us_ = end.time_us - start_.time_us;
+  float t = duration_us_ * 1.0e-6f;
+  float d = (float)(end.position - start_.position);
+  float v0 = start_.velocity;
+  float v1 = end.velocity;
+
+  // Cubic Hermite through both points with both velocities
+  c1_ = v0;
+  c2_ = (3.0f * d / t - 2.0f * v0 - v1) / t;
+  c3_ = (v0 + v1 - 2.0f * d / t) / (t * t);
+
+  // Turning points, where 3 c3 t^2 + 2 c2 t + c1 changes sign
+  float a = 3.0f * c3_;
+  float b = 2.0f * c2_;
+  float roots[2];
+  int count = 0;
+  if (a == 0.0f)
+  {
+    if (b != 0.0f)
+      roots[count++] = -c1_ / b;
+  }
+  else
+  {
+    float disc = b * b - 4.0f * a * c1_;
+    if (disc > 0.0f)
+    {
+      // Without the cancellation of the textbook formula
+      float q = -0.5f * (b + copysignf(sqrtf(disc), b));
+      roots[count++] = q / a;
+      roots[count++] = c1_ / q;
+      if (roots[0] > roots[1])
+      {
+        float swap = roots[0];
+        roots[0] = roots[1];
+        roots[1] = swap;
+      }
+    }
+  }
+
+  piece_count_ = 0;
+  for (int i = 0; i < count; i++)
+  {
+    if (roots[i] > 0.0f && roots[i] < t)
+      AddPiece(roots[i]);
+  }
+  AddPiece(t);
+  piece_ = 0;
+  tau_ = 0.0f;
+  in_segment_ = true;
+}
+
+void PvtInterpolator::AddPiece(float end)
+{
+  float start = piece_count_ > 0 ? piece_end_[piece_count_ - 1] : 0.0f;
+  if (end <= start)
+    return;
+  float v = Velocity(0.5f * (start + end));
+  piece_end_[piece_count_] = end;
+  piece_dir_[piece_count_] = v > 0.0f ? 1 : (v < 0.0f ? -1 : 0);
+  piece_count_++;
+}
+
+float PvtInterpolator::Solve(float level, int dir, float lo, float hi)
+{
+  // Position() - level goes from behind the level at lo to past it at hi
+  float t = lo;
+  float f = Position(lo) - level;
+  for (int i = 0; i < PVT_SOLVE_ITERATIONS && f != 0.0f; i++)
+  {
+    float v = Velocity(t);
+    float next = v != 0.0f ? t - f / v : lo;
+    if (!(next > lo && next < hi))
+      next = 0.5f * (lo + hi);
+    float change = next - t;
+    t = next;
+    if (fabsf(change) < PVT_SOLVE_TOLERANCE_S)
+      break;
+    f = Position(t) - level;
+    if (f * dir < 0.0f)
+      lo = t;
+    else
+      hi = t;
+  }
+  return t;
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include <cstdint>
+#include "SpscRing/SpscRing.h"
+
+// Buffered PVT points, must be a power of two
+#define PVT_QUEUE_SIZE 32
+
+// Jitter buffer: playback starts this long after the first point arrives
+#define PVT_DEFAULT_DELAY_US 20000
+
+// A monotonic stretch of a segment has at most 3 pieces split at the turning
+// points of the cubic
+#define PVT_MAX_PIECES 3
+
+// Position-velocity-time interpolation for streamed trajectories.
+//
+// The host sends points with a timestamp, a step position and a velocity.
+// Between two points the position follows the cubic Hermite spline that
+// passes through both with the given velocities, so the path and its
+// velocity are continuous from point to point. The motor steps whenever the
+// spline crosses a half step, which keeps it on the nearest whole step.
+//
+// Each segment is split at the turning points of the cubic into monotonic
+// pieces up front. Per step only the time the next half step is crossed gets
+// solved inside the current piece, with Newton iterations kept inside a
+// bisection bracket. Positions are relative to the segment's start point and
+// times to the start of the segment, so single precision floats stay accurate
+// however long the stream runs.
+//
+// Add() is the producer and Start() / NextStep() the consumer of the
+// underlying SpscRing. Clear() only while the consumer is stopped.
+class PvtInterpolator
+{
+public:
+    struct Point
+    {
+        uint32_t time_us; // host clock, wraps
+        long position;    // steps
+        float velocity;   // steps per second
+    };
+
+    PvtInterpolator();
+
+    // Producer. Queues a point. Returns false when the queue is full or the
+    // time is not after the previous point's.
+    bool Add(uint32_t time_us, long position, float velocity);
+
+    // Drops all points, the next Add() starts a new stream
+    void Clear();
+
+    // Consumer. Begins playback at the oldest point, which only sets the time
+    // origin: the first segment starts from `position`, where the motor is.
+    // Point positions are absolute steps, so a stream should begin there.
+    // Returns false when nothing is queued.
+    bool Start(long position);
+
+    // Consumer. Time of the next step after the last one, from the start of
+    // the stream in 1/256us, and its direction. `position` is the step
+    // position the motor is on. Returns false when there is no step before
+    // the last queued point; calling again after more points arrive carries
+    // on from there.
+    bool NextStep(long position, uint64_t &time_q8, bool &forward);
+
+    // Consumer. Time of the last point reached from the start of the stream
+    // and the velocity there, for when NextStep() returns false.
+    uint64_t EndTimeUs() { return segment_start_q8_ >> 8; }
+    float EndVelocity() { return start_.velocity; }
+
+    uint32_t Size() { return ring_.Size(); }
+    static constexpr uint32_t GetCapacity() { return PVT_QUEUE_SIZE; }
+    uint32_t Overflows() { return ring_.Overflows(); }
+
+private:
+    SpscRing<Point, PVT_QUEUE_SIZE> ring_;
+
+    // Written by the producer
+    bool has_last_;
+    uint32_t last_time_us_;
+
+    // Segment from start_ to the point at the front of the ring
+    Point start_;
+    bool in_segment_;
+    uint64_t segment_start_q8_;
+    uint32_t duration_us_;
+    float c1_; // x(t) = c1 t + c2 t^2 + c3 t^3 steps from start_.position
+    float c2_;
+    float c3_;
+    float piece_end_[PVT_MAX_PIECES];
+    int8_t piece_dir_[PVT_MAX_PIECES];
+    uint8_t piece_count_;
+    uint8_t piece_;
+    float tau_; // seconds into the segment of the last step
+
+    void BeginSegment(const Point &end);
+    void AddPiece(float end);
+    float Position(float t) { return t * (c1_ + t * (c2_ + t * c3_)); }
+    float Velocity(float t) { return c1_ + t * (2.0f * c2_ + t * 3.0f * c3_); }
+    float Solve(float level, int dir, float lo, float hi);
+};
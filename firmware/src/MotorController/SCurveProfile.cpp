@@ -0,0 +1,371 @@
+#include "SCurveProfile.h"
+#include <cmath>
+
+// Newton iterations per step, each one roughly doubles the correct digits of
+// a guess that starts within one step of the answer
+#define SCURVE_NEWTON_ITERATIONS 3
+#define SCURVE_NEWTON_TOLERANCE 2.0e-8f // seconds
+
+SCurveProfile::SCurveProfile()
+    : max_speed_(1.0f),
+      acceleration_(1.0f),
+      jerk_(1.0f),
+      count_(0),
+      phase_(0),
+      hold_(false),
+      done_(true),
+      tau_(0.0f),
+      fresh_(true),
+      pos_(0),
+      distance_(0),
+      speed_(0.0f),
+      plan_base_(0),
+      plan_x_(0.0f),
+      plan_v_(0.0f),
+      plan_a_(0.0f)
+{
+}
+
+void SCurveProfile::SetMaxSpeed(float speed)
+{
+  if (speed < 0.0f)
+    speed = -speed;
+  if (speed == 0.0f)
+    return;
+  max_speed_ = speed;
+}
+
+void SCurveProfile::SetAcceleration(float acceleration)
+{
+  if (acceleration < 0.0f)
+    acceleration = -acceleration;
+  if (acceleration == 0.0f)
+    return;
+  acceleration_ = acceleration;
+}
+
+void SCurveProfile::SetJerk(float jerk)
+{
+  if (jerk < 0.0f)
+    jerk = -jerk;
+  if (jerk == 0.0f)
+    return;
+  jerk_ = jerk;
+}
+
+void SCurveProfile::Reset(long base, float speed)
+{
+  count_ = 0;
+  phase_ = 0;
+  hold_ = false;
+  done_ = false;
+  tau_ = 0.0f;
+  fresh_ = true;
+  distance_ = 0;
+  plan_base_ = base;
+  plan_x_ = 0.0f;
+  plan_v_ = speed;
+  plan_a_ = 0.0f;
+}
+
+void SCurveProfile::AddPhase(float duration, float jerk)
+{
+  if (duration <= 0.0f || count_ >= SCURVE_MAX_PHASES)
+    return;
+
+  Phase &ph = phases_[count_++];
+  ph.duration = duration;
+  ph.jerk = jerk;
+  ph.v0 = plan_v_;
+  ph.a0 = plan_a_;
+  ph.length = duration * (plan_v_ + duration * (plan_a_ * 0.5f + duration * jerk * (1.0f / 6.0f)));
+  ph.base = plan_base_;
+  ph.offset = plan_x_;
+
+  plan_x_ += ph.length;
+  plan_v_ += duration * (plan_a_ + duration * jerk * 0.5f);
+  plan_a_ += duration * jerk;
+}
+
+void SCurveProfile::RampTimes(float dv, float &jerk_time, float &accel_time)
+{
+  if (dv * jerk_ >= acceleration_ * acceleration_)
+  {
+    // Reaches full acceleration
+    jerk_time = acceleration_ / jerk_;
+    accel_time = dv / acceleration_ - jerk_time;
+  }
+  else
+  {
+    jerk_time = sqrtf(dv / jerk_);
+    accel_time = 0.0f;
+  }
+}
+
+void SCurveProfile::AddRamp(float from, float to)
+{
+  float dv = to - from;
+  float jerk = jerk_;
+  if (dv < 0.0f)
+  {
+    dv = -dv;
+    jerk = -jerk;
+  }
+  if (dv == 0.0f)
+    return;
+
+  float jerk_time, accel_time;
+  RampTimes(dv, jerk_time, accel_time);
+  AddPhase(jerk_time, jerk);
+  AddPhase(accel_time, 0.0f);
+  AddPhase(jerk_time, -jerk);
+
+  // Land exactly on the target instead of the rounded sum
+  plan_v_ = to;
+  plan_a_ = 0.0f;
+}
+
+void SCurveProfile::Shift(float steps)
+{
+  for (uint8_t i = 0; i < count_; i++)
+    phases_[i].offset += steps;
+  plan_x_ += steps;
+}
+
+void SCurveProfile::EndAtRest()
+{
+  // The last step is the last one at least half a step before the end, so
+  // the final interval is as long as the first one of a move from rest. If
+  // there is none left the next step lands on the end.
+  long last = plan_base_ + (long)floorf(plan_x_ - 0.5f + 1.0e-3f);
+  distance_ = last > pos_ ? last : pos_ + 1;
+}
+
+void SCurveProfile::BeginMove(long distance)
+{
+  pos_ = 0;
+  speed_ = 0.0f;
+  Reset(0, 0.0f);
+  if (distance <= 0)
+  {
+    done_ = true;
+    return;
+  }
+
+  // Peak speed, lowered when the move is too short to reach max speed.
+  // Ramping 0 -> v takes v / a + a / j when full acceleration is reached,
+  // 2 * sqrt(v / j) otherwise, and covers v * time / 2 steps.
+  float peak = max_speed_;
+  float jerk_time, accel_time;
+  RampTimes(peak, jerk_time, accel_time);
+  if (peak * (2.0f * jerk_time + accel_time) > (float)distance)
+  {
+    float a_j = acceleration_ / jerk_;
+    peak = 0.5f * acceleration_ * (sqrtf(a_j * a_j + 4.0f * distance / acceleration_) - a_j);
+    if (peak * jerk_ < acceleration_ * acceleration_)
+      peak = cbrtf((float)distance * (float)distance * jerk_ * 0.25f);
+  }
+
+  AddRamp(0.0f, peak);
+  float cruise = (float)distance - 2.0f * plan_x_;
+  if (cruise > 0.0f)
+    AddPhase(cruise / peak, 0.0f);
+  uint8_t first_stop_phase = count_;
+  AddRamp(peak, 0.0f);
+
+  // Anchor the stopping phases to the target
+  float to_end = 0.0f;
+  for (int8_t i = count_ - 1; i >= first_stop_phase; i--)
+  {
+    to_end -= phases_[i].length;
+    phases_[i].base = distance;
+    phases_[i].offset = to_end;
+  }
+  distance_ = distance;
+
+  // Step k happens half way along the motion from k - 1 to k, which keeps
+  // the first and last intervals equal and short
+  Shift(0.5f);
+
+  // The first step is due now
+  unsigned long interval_us;
+  uint8_t interval_frac;
+  NextInterval(interval_us, interval_frac);
+}
+
+void SCurveProfile::BeginVelocity(float from, float to)
+{
+  if (from < 0.0f)
+    from = -from;
+  if (to < 0.0f)
+    to = -to;
+  if (to > max_speed_)
+    to = max_speed_;
+
+  pos_ = 0;
+  speed_ = from;
+  Reset(0, from);
+  AddRamp(from, to);
+  if (from == 0.0f)
+    Shift(0.5f); // like a move from rest
+  if (to > 0.0f)
+  {
+    AddPhase(1.0f, 0.0f); // duration unused, the cruise never ends
+    hold_ = true;
+  }
+  else if (count_ > 0)
+  {
+    EndAtRest();
+  }
+  else
+  {
+    done_ = true;
+  }
+}
+
+void SCurveProfile::Stop()
+{
+  if (Done())
+    return;
+  if (speed_ == 0.0f)
+  {
+    done_ = true;
+    return;
+  }
+
+  float jerk_time, accel_time;
+  RampTimes(speed_, jerk_time, accel_time);
+  float stop_length = speed_ * (2.0f * jerk_time + accel_time) * 0.5f;
+  if (distance_ > 0 && pos_ + (long)floorf(stop_length + 1.0e-3f) >= distance_)
+    return; // already stopping at least this soon
+
+  Reset(pos_, speed_);
+  AddRamp(speed_, 0.0f);
+  EndAtRest();
+}
+
+float SCurveProfile::Solve(const Phase &ph, float d, bool last)
+{
+  if (ph.v0 == 0.0f && ph.a0 == 0.0f)
+  {
+    // From rest: d = j t^3 / 6
+    return cbrtf(6.0f * d / ph.jerk);
+  }
+
+  if (last && !hold_)
+  {
+    // Into rest, the same cubic counted back from the end of the phase
+    float to_end = (float)(ph.base - pos_ - 1) + (ph.offset + ph.length);
+    if (to_end <= 0.0f)
+      return ph.duration;
+    return ph.duration - cbrtf(6.0f * to_end / ph.jerk);
+  }
+
+  // Newton, starting from where the speed and acceleration at the previous
+  // step would get to. Speed stays well above zero inside these phases.
+  float t_lo = tau_;
+  float t = tau_;
+  float x0 = t * (ph.v0 + t * (ph.a0 * 0.5f + t * ph.jerk * (1.0f / 6.0f)));
+  float v0 = ph.v0 + t * (ph.a0 + t * ph.jerk * 0.5f);
+  float a0 = ph.a0 + t * ph.jerk;
+  float ahead = d - x0;
+  float disc = v0 * v0 + 2.0f * a0 * ahead;
+  if (disc > 0.0f && v0 > 0.0f)
+    t += 2.0f * ahead / (v0 + sqrtf(disc));
+  for (uint8_t i = 0; i < SCURVE_NEWTON_ITERATIONS; i++)
+  {
+    float x = t * (ph.v0 + t * (ph.a0 * 0.5f + t * ph.jerk * (1.0f / 6.0f)));
+    float v = ph.v0 + t * (ph.a0 + t * ph.jerk * 0.5f);
+    if (v <= 0.0f)
+      break;
+    float step = (x - d) / v;
+    t -= step;
+    if (t < t_lo)
+      t = t_lo;
+    else if (t > ph.duration)
+      t = ph.duration;
+    if (fabsf(step) < SCURVE_NEWTON_TOLERANCE)
+      break;
+  }
+  return t;
+}
+
+bool SCurveProfile::NextInterval(unsigned long &interval_us, uint8_t &interval_frac)
+{
+  interval_us = 0;
+  interval_frac = 0;
+  if (Done())
+    return false;
+
+  long n = pos_ + 1;
+  float dt = 0.0f;
+  for (;;)
+  {
+    const Phase &ph = phases_[phase_];
+    bool last = phase_ + 1 >= count_;
+
+    if (ph.jerk == 0.0f && ph.a0 == 0.0f)
+    {
+      // Cruise. Distances are taken from the nearest phase boundary, the
+      // phase itself can be millions of steps long.
+      bool inside = last;
+      if (!last)
+      {
+        const Phase &next = phases_[phase_ + 1];
+        inside = (float)(next.base - n) + next.offset >= 0.0f;
+        if (!inside)
+        {
+          dt += fresh_ ? ph.duration : ((float)(next.base - pos_) + next.offset) / ph.v0;
+          phase_++;
+          tau_ = 0.0f;
+          fresh_ = true;
+          continue;
+        }
+      }
+      dt += fresh_ ? ((float)(n - ph.base) - ph.offset) / ph.v0 : 1.0f / ph.v0;
+      fresh_ = false;
+      speed_ = ph.v0;
+      break;
+    }
+
+    float d = (float)(n - ph.base) - ph.offset;
+    if (d >= ph.length)
+    {
+      dt += ph.duration - tau_;
+      if (!last)
+      {
+        phase_++;
+        tau_ = 0.0f;
+        fresh_ = true;
+        continue;
+      }
+      // Past the end of the profile, the step lands on the end
+      tau_ = ph.duration;
+      fresh_ = false;
+      speed_ = 0.0f;
+      done_ = true;
+      break;
+    }
+
+    float t = d > 0.0f ? Solve(ph, d, last) : 0.0f;
+    dt += t - tau_;
+    tau_ = t;
+    fresh_ = false;
+    speed_ = ph.v0 + t * (ph.a0 + t * ph.jerk * 0.5f);
+    break;
+  }
+  pos_ = n;
+
+  if (dt < 0.0f)
+    dt = 0.0f;
+  uint32_t interval_q8 = (uint32_t)(dt * 256.0e6f + 0.5f);
+  interval_us = interval_q8 >> 8;
+  interval_frac = interval_q8 & 0xFF;
+  return true;
+}
+
+float SCurveProfile::FirstIntervalUs()
+{
+  // Step 1 to step 2 of the jerk phase from rest, at 0.5 and 1.5 steps
+  return (cbrtf(9.0f / jerk_) - cbrtf(3.0f / jerk_)) * 1.0e6f;
+}
@@ -0,0 +1,102 @@
+#pragma once
+#include <cstdint>
+
+// A move is at most 7 phases: jerk up, constant acceleration, jerk down,
+// cruise and the same three again to stop
+#define SCURVE_MAX_PHASES 7
+
+// Jerk limited (S-curve) step interval generator.
+//
+// Each move or speed change is planned once as a list of constant jerk
+// phases. Per step only the time at which the next whole step position is
+// reached gets solved inside the current phase: a cube root for the phases
+// that start or end at rest, a couple of Newton iterations for the others and
+// a constant interval while cruising. Every phase has its own time and
+// position origin, moves ending on a target are planned backwards from it, so
+// single precision floats stay accurate however long the move is.
+class SCurveProfile
+{
+public:
+    SCurveProfile();
+
+    void SetMaxSpeed(float speed);
+    void SetAcceleration(float acceleration);
+    void SetJerk(float jerk);
+    float Jerk() { return jerk_; }
+
+    // Rest to rest move of `distance` (> 0) steps. The first step is due
+    // straight away and NextInterval() times the ones after it, the same way
+    // StepIntervalGenerator does.
+    void BeginMove(long distance);
+
+    // Change speed from `from` to `to` steps per second (both >= 0, `to` is
+    // limited to the max speed) starting at the step just taken, then hold
+    // `to`. A profile going to 0 ends once it is at rest.
+    void BeginVelocity(float from, float to);
+
+    // Ramp down to rest from the current speed as soon as possible. The
+    // acceleration at the moment of the call is not carried over.
+    void Stop();
+
+    // Interval from the step just taken to the next one, in microseconds plus
+    // 1/256us. Returns false once the profile has no more steps.
+    bool NextInterval(unsigned long &interval_us, uint8_t &interval_frac);
+
+    // Longest interval of any move from rest, in microseconds
+    float FirstIntervalUs();
+
+    // Speed at the step just taken, steps per second
+    float Speed() { return speed_; }
+
+    // Steps taken since BeginMove() / BeginVelocity()
+    long Steps() { return pos_; }
+
+    // Step the profile ends on, 0 while it holds a speed
+    long Distance() { return distance_; }
+
+    bool Done() { return done_ || (distance_ > 0 && pos_ >= distance_); }
+
+    // Still changing speed, false once it holds its final speed
+    bool Ramping() { return !Done() && !(hold_ && phase_ + 1 >= count_); }
+
+private:
+    struct Phase
+    {
+        float duration; // seconds
+        float jerk;
+        float v0;       // speed and acceleration at the start of the phase
+        float a0;
+        float length;   // steps
+        long base;      // the phase starts at step position base + offset
+        float offset;
+    };
+
+    float max_speed_;
+    float acceleration_;
+    float jerk_;
+
+    Phase phases_[SCURVE_MAX_PHASES];
+    uint8_t count_;
+    uint8_t phase_;
+    bool hold_;      // the last phase is a cruise without end
+    bool done_;
+    float tau_;      // time of the last step within the current phase
+    bool fresh_;     // no step taken in the current phase yet
+    long pos_;
+    long distance_;
+    float speed_;
+
+    // planning state at the end of the phases added so far
+    long plan_base_;
+    float plan_x_;
+    float plan_v_;
+    float plan_a_;
+
+    void Reset(long base, float speed);
+    void AddPhase(float duration, float jerk);
+    void AddRamp(float from, float to);
+    void RampTimes(float dv, float &jerk_time, float &accel_time);
+    float Solve(const Phase &ph, float d, bool last);
+    void Shift(float steps);
+    void EndAtRest();
+};
@@ -0,0 +1,148 @@
+#include "ScopeCapture.h"
+
+ScopeCapture::ScopeCapture()
+    : head_(0),
+      filled_(0),
+      start_(0),
+      pre_actual_(0),
+      post_left_(0),
+      state_(ScopeState::IDLE),
+      period_us_(0),
+      next_us_(0),
+      first_sample_(false),
+      trigger_(ScopeTrigger::IMMEDIATE),
+      channel_(ScopeChannel::COMMANDED_POSITION),
+      level_(0.0f),
+      pre_trigger_(0),
+      last_value_(0.0f),
+      last_errors_(0)
+{
+}
+
+bool ScopeCapture::Arm(uint32_t period_us, ScopeTrigger trigger, ScopeChannel channel, float level, uint16_t pre_trigger)
+{
+  if (period_us < SCOPE_MIN_PERIOD_US || trigger > ScopeTrigger::FALLING ||
+      channel > ScopeChannel::ENCODER_VELOCITY || pre_trigger >= SCOPE_DEPTH)
+    return false;
+
+  // The interrupt ignores the ring until the state says otherwise
+  state_ = ScopeState::IDLE;
+  period_us_ = period_us;
+  trigger_ = trigger;
+  channel_ = channel;
+  level_ = level;
+  pre_trigger_ = pre_trigger;
+  head_ = 0;
+  filled_ = 0;
+  start_ = 0;
+  pre_actual_ = 0;
+  post_left_ = 0;
+  first_sample_ = true;
+  state_ = ScopeState::ARMED;
+  return true;
+}
+
+void ScopeCapture::Stop()
+{
+  state_ = ScopeState::IDLE;
+}
+
+float ScopeCapture::ChannelValue(const ScopeSample &sample, ScopeChannel channel)
+{
+  switch (channel)
+  {
+  case ScopeChannel::COMMANDED_POSITION:
+    return (float)sample.commanded_position;
+  case ScopeChannel::ENCODER_POSITION:
+    return sample.encoder_position;
+  case ScopeChannel::FOLLOWING_ERROR:
+    return (float)sample.commanded_position - sample.encoder_position;
+  case ScopeChannel::COMMANDED_VELOCITY:
+    return sample.commanded_velocity;
+  case ScopeChannel::ENCODER_VELOCITY:
+    return sample.encoder_velocity;
+  }
+  return 0.0f;
+}
+
+bool ScopeCapture::Triggered(const ScopeSample &sample, bool move_started)
+{
+  // Edges need the previous sample, the first one only sets it
+  bool first = filled_ == 0;
+  float value = ChannelValue(sample, channel_);
+  uint8_t errors = (uint8_t)(sample.status >> SCOPE_STATUS_ERROR_SHIFT);
+  float last_value = last_value_;
+  uint8_t last_errors = last_errors_;
+  last_value_ = value;
+  last_errors_ = errors;
+
+  switch (trigger_)
+  {
+  case ScopeTrigger::IMMEDIATE:
+    return true;
+  case ScopeTrigger::MOVE_START:
+    return move_started;
+  case ScopeTrigger::ERROR:
+    return !first && last_errors == 0 && errors != 0;
+  case ScopeTrigger::RISING:
+    return !first && last_value < level_ && value >= level_;
+  case ScopeTrigger::FALLING:
+    return !first && last_value > level_ && value <= level_;
+  }
+  return false;
+}
+
+void ScopeCapture::Record(const ScopeSample &sample, bool move_started)
+{
+  if (state_ == ScopeState::ARMED)
+  {
+    if (!Triggered(sample, move_started))
+    {
+      ring_[head_] = sample;
+      head_ = (head_ + 1) % SCOPE_DEPTH;
+      if (filled_ < SCOPE_DEPTH)
+        filled_++;
+      return;
+    }
+    pre_actual_ = filled_ < pre_trigger_ ? filled_ : pre_trigger_;
+    start_ = (head_ + SCOPE_DEPTH - pre_actual_) % SCOPE_DEPTH;
+    post_left_ = SCOPE_DEPTH - pre_trigger_;
+    state_ = ScopeState::TRIGGERED;
+  }
+  if (state_ != ScopeState::TRIGGERED)
+    return;
+
+  ring_[head_] = sample;
+  head_ = (head_ + 1) % SCOPE_DEPTH;
+  if (--post_left_ == 0)
+  {
+    state_ = ScopeState::DONE;
+  }
+}
+
+uint16_t ScopeCapture::Count()
+{
+  if (state_ != ScopeState::DONE)
+    return 0;
+  return pre_actual_ + SCOPE_DEPTH - pre_trigger_;
+}
+
+uint16_t ScopeCapture::TriggerIndex()
+{
+  if (state_ != ScopeState::DONE)
+    return 0;
+  return pre_actual_;
+}
+
+uint16_t ScopeCapture::Read(uint16_t first, ScopeSample *out, uint16_t max)
+{
+  uint16_t count = Count();
+  if (first >= count)
+    return 0;
+  uint16_t n = count - first < max ? count - first : max;
+  for (uint16_t i = 0; i < n; i++)
+  {
+    out[i] = ring_[(start_ + first + i) % SCOPE_DEPTH];
+  }
+  return n;
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include <cstdint>
+#include "AxisMessages.h"
+
+// Samples kept by a capture, pre-trigger included
+#define SCOPE_DEPTH 512
+
+// Samples per GetScopeData response, matches ScopeDataMessage::samples
+#define SCOPE_CHUNK_SAMPLES 32
+
+// Shortest sample period, us
+#define SCOPE_MIN_PERIOD_US 50
+
+// Status word bits, see ScopeSample
+#define SCOPE_STATUS_STATE_MASK 0x000F
+#define SCOPE_STATUS_STEP_ENGINE 0x0010
+#define SCOPE_STATUS_CLOSED_LOOP 0x0020
+#define SCOPE_STATUS_ERROR_SHIFT 8
+
+// Triggered capture of the motion state into a RAM ring, for tuning.
+//
+// Arm() starts recording a sample every period into the ring, overwriting
+// the oldest ones while it waits for the trigger. The trigger keeps the last
+// `pre_trigger` samples before it, the ring then fills up with the samples
+// after it and recording stops until the next Arm(). Read() copies the
+// capture out oldest first once it is DONE.
+//
+// Due() and Record() run in the step interrupt, the others in the loop. The
+// interrupt leaves the ring alone unless the state is ARMED or TRIGGERED and
+// the loop only reads it in DONE, so they don't need a lock.
+class ScopeCapture
+{
+public:
+    ScopeCapture();
+
+    // False for a period under SCOPE_MIN_PERIOD_US, an unknown trigger or
+    // channel, or pre_trigger not under SCOPE_DEPTH. RISING and FALLING fire
+    // when `channel` crosses `level`.
+    bool Arm(uint32_t period_us, ScopeTrigger trigger, ScopeChannel channel, float level, uint16_t pre_trigger);
+
+    // Drops a capture in progress
+    void Stop();
+
+    // True once per period while recording. Catches up by skipping samples,
+    // never by bunching them.
+    inline bool Due(uint32_t now_us)
+    {
+        if (state_ != ScopeState::ARMED && state_ != ScopeState::TRIGGERED)
+            return false;
+        if (first_sample_)
+        {
+            first_sample_ = false;
+            next_us_ = now_us + period_us_;
+            return true;
+        }
+        if ((int32_t)(now_us - next_us_) < 0)
+            return false;
+        next_us_ += period_us_;
+        if ((int32_t)(now_us - next_us_) >= 0)
+            next_us_ = now_us + period_us_;
+        return true;
+    }
+
+    // `move_started`: a move began since the previous sample
+    void Record(const ScopeSample &sample, bool move_started);
+
+    ScopeState State() { return state_; }
+    uint32_t Period() { return period_us_; }
+
+    // Samples in a DONE capture and the position of the trigger among them
+    uint16_t Count();
+    uint16_t TriggerIndex();
+
+    // Copies up to `max` samples from index `first` of a DONE capture,
+    // returns how many
+    uint16_t Read(uint16_t first, ScopeSample *out, uint16_t max);
+
+    static float ChannelValue(const ScopeSample &sample, ScopeChannel channel);
+
+private:
+    ScopeSample ring_[SCOPE_DEPTH];
+    uint16_t head_;        // next write
+    uint16_t filled_;      // valid samples while ARMED
+    uint16_t start_;       // oldest sample of the capture
+    uint16_t pre_actual_;  // samples before the trigger
+    uint16_t post_left_;   // samples still to record after the trigger
+
+    volatile ScopeState state_;
+    uint32_t period_us_;
+    uint32_t next_us_;
+    bool first_sample_;
+
+    ScopeTrigger trigger_;
+    ScopeChannel channel_;
+    float level_;
+    uint16_t pre_trigger_;
+    float last_value_;
+    uint8_t last_errors_;
+
+    bool Triggered(const ScopeSample &sample, bool move_started);
+};
@@ -0,0 +1,51 @@
+#include "StallDetector.h"
+
+StallDetector::StallDetector()
+    : window_(STALL_DEFAULT_WINDOW_STEPS),
+      peak_(0.0f),
+      outside_(0),
+      tripped_(false),
+      stalls_(0)
+{
+}
+
+void StallDetector::SetWindow(uint32_t steps)
+{
+  window_ = steps;
+  outside_ = 0;
+}
+
+void StallDetector::Reset(float commanded_steps, float measured_steps)
+{
+  following_.Reset(commanded_steps, measured_steps);
+  outside_ = 0;
+  tripped_ = false;
+}
+
+bool StallDetector::Update(float commanded_steps, float measured_steps)
+{
+  float error = following_.Update(commanded_steps, measured_steps);
+  float magnitude = error < 0.0f ? -error : error;
+  if (magnitude > peak_)
+    peak_ = magnitude;
+
+  if (window_ == 0 || tripped_)
+    return false;
+  if (magnitude <= (float)window_)
+  {
+    outside_ = 0;
+    return false;
+  }
+  if (++outside_ < STALL_CONFIRM_SAMPLES)
+    return false;
+
+  tripped_ = true;
+  stalls_++;
+  return true;
+}
+
+void StallDetector::ClearStatistics()
+{
+  peak_ = 0.0f;
+  stalls_ = 0;
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <cstdint>
+#include "MotorController/FollowingError.h"
+
+// Following error check period, independent of the encoder task
+#define STALL_CHECK_PERIOD_US 1000
+
+// Consecutive checks outside the window before it counts as a stall, so a
+// single bad encoder reading doesn't stop the axis
+#define STALL_CONFIRM_SAMPLES 2
+
+// Default following error window, steps. Well inside one revolution (1600)
+// and well outside the encoder filter lag at full speed.
+#define STALL_DEFAULT_WINDOW_STEPS 100
+
+// Watches the following error between the commanded step position and the
+// encoder.
+//
+// Reset() lines the encoder up with the commanded position, Update() then
+// measures the error from there (see FollowingError). Once the error has stayed outside the window
+// for STALL_CONFIRM_SAMPLES checks Update() reports the stall, once; it is
+// armed again by the next Reset().
+class StallDetector
+{
+public:
+    StallDetector();
+
+    // Largest following error allowed, steps. 0 turns detection off.
+    void SetWindow(uint32_t steps);
+    uint32_t GetWindow() { return window_; }
+
+    // Takes the current positions as the reference and re-arms detection
+    void Reset(float commanded_steps, float measured_steps);
+
+    // True when this check confirms a stall
+    bool Update(float commanded_steps, float measured_steps);
+
+    // Commanded minus measured position at the last Update(), steps
+    float Error() { return following_.Error(); }
+
+    // Largest error magnitude since ClearStatistics(), steps
+    float PeakError() { return peak_; }
+
+    // Stalls detected since ClearStatistics()
+    uint32_t Stalls() { return stalls_; }
+
+    void ClearStatistics();
+
+private:
+    uint32_t window_;
+    FollowingError following_;
+    float peak_;
+    uint8_t outside_;
+    bool tripped_;
+    uint32_t stalls_;
+};
@@ -0,0 +1,205 @@
+#include "StepIntervalGenerator.h"
+#include <cmath>
+
+StepIntervalGenerator::StepIntervalGenerator()
+    : max_speed_(1.0f),
+      acceleration_(1.0f),
+      tick_hz_(1000000),
+      jerk_(0.0f),
+      s_curve_(false),
+      c0_(0.0f),
+      cn_(0.0f),
+      cmin_(1000000.0f),
+      speed_(0.0f),
+      n_(0),
+      distance_(0),
+      generated_(0),
+      last_interval_us_(0.0f),
+      tick_remainder_(0.0f)
+{
+  SetAcceleration(1.0f);
+}
+
+void StepIntervalGenerator::SetMaxSpeed(float speed)
+{
+  if (speed < 0.0f)
+    speed = -speed;
+  if (speed == 0.0f)
+    return;
+  max_speed_ = speed;
+  cmin_ = 1000000.0 / speed;
+}
+
+void StepIntervalGenerator::SetAcceleration(float acceleration)
+{
+  if (acceleration < 0.0f)
+    acceleration = -acceleration;
+  if (acceleration == 0.0f)
+    return;
+  acceleration_ = acceleration;
+  c0_ = 0.676 * sqrt(2.0 / acceleration) * 1000000.0; // Equation 15
+}
+
+void StepIntervalGenerator::SetTickFrequency(uint32_t tick_hz)
+{
+  tick_hz_ = tick_hz;
+}
+
+void StepIntervalGenerator::SetJerk(float jerk)
+{
+  jerk_ = jerk < 0.0f ? -jerk : jerk;
+}
+
+void StepIntervalGenerator::Begin(long distance)
+{
+  distance_ = distance > 0 ? distance : 0;
+  generated_ = 0;
+  tick_remainder_ = 0.0f;
+
+  s_curve_ = jerk_ > 0.0f;
+  if (s_curve_)
+  {
+    profile_.SetMaxSpeed(max_speed_);
+    profile_.SetAcceleration(acceleration_);
+    profile_.SetJerk(jerk_);
+    profile_.BeginMove(distance_);
+    speed_ = profile_.Speed();
+    last_interval_us_ = 0.0f;
+    return;
+  }
+
+  // First computeNewSpeed() call from standstill
+  n_ = 1;
+  cn_ = c0_;
+  speed_ = 1000000.0 / cn_;
+  last_interval_us_ = cn_;
+}
+
+void StepIntervalGenerator::Stop()
+{
+  if (s_curve_)
+  {
+    profile_.Stop();
+    if (profile_.Distance() < distance_)
+      distance_ = profile_.Distance();
+    return;
+  }
+
+  long steps_to_stop = (long)((speed_ * speed_) / (2.0 * acceleration_)) + 1; // Equation 16
+  if (steps_to_stop < 2)
+    steps_to_stop = 2;
+  if (generated_ + steps_to_stop < distance_)
+  {
+    distance_ = generated_ + steps_to_stop;
+  }
+}
+
+bool StepIntervalGenerator::Retarget(long distance)
+{
+  if (generated_ == 0 || generated_ >= distance_)
+    return false;
+  long steps_to_stop = (long)((speed_ * speed_) / (2.0 * acceleration_)); // Equation 16
+  if (distance <= generated_ + steps_to_stop)
+    return false;
+
+  if (s_curve_)
+  {
+    // The recurrence picks up where the speed would be after n steps from
+    // rest at constant acceleration
+    s_curve_ = false;
+    cn_ = last_interval_us_;
+    n_ = steps_to_stop > 0 ? steps_to_stop : 1;
+  }
+  distance_ = distance;
+  return true;
+}
+
+unsigned long StepIntervalGenerator::NextIntervalUs()
+{
+  if (generated_ >= distance_)
+    return 0;
+
+  // Emit the step, then work out how long to wait before the next one
+  generated_++;
+
+  if (s_curve_)
+  {
+    unsigned long interval_us;
+    uint8_t interval_frac;
+    if (generated_ >= distance_ || !profile_.NextInterval(interval_us, interval_frac))
+    {
+      distance_ = generated_;
+      speed_ = 0.0f;
+      last_interval_us_ = 0.0f;
+      return 0;
+    }
+    speed_ = profile_.Speed();
+    last_interval_us_ = interval_us + interval_frac * (1.0f / 256.0f);
+    // Never 0 while steps are left, that would read as the end of the move
+    return interval_us > 0 ? interval_us : 1;
+  }
+
+  long distance_to = distance_ - generated_;
+  long steps_to_stop = (long)((speed_ * speed_) / (2.0 * acceleration_)); // Equation 16
+
+  if (distance_to == 0)
+  {
+    // A from-rest move never reverses, so the last step always ends the move
+    speed_ = 0.0f;
+    n_ = 0;
+    last_interval_us_ = 0.0f;
+    return 0;
+  }
+
+  if (n_ > 0)
+  {
+    if (steps_to_stop >= distance_to)
+      n_ = -steps_to_stop; // Start deceleration
+  }
+  else if (n_ < 0)
+  {
+    if (steps_to_stop < distance_to)
+      n_ = -n_; // Start acceleration
+  }
+
+  cn_ = cn_ - ((2.0 * cn_) / ((4.0 * n_) + 1)); // Equation 13
+  if (cn_ < cmin_)
+    cn_ = cmin_;
+  n_++;
+  speed_ = 1000000.0 / cn_;
+  last_interval_us_ = cn_;
+  return (unsigned long)cn_;
+}
+
+uint32_t StepIntervalGenerator::Fill(uint16_t *buf, uint32_t len, uint32_t max_ticks)
+{
+  uint32_t written = 0;
+  uint32_t ticks_written = 0;
+  while (written < len && generated_ < distance_ && ticks_written < max_ticks)
+  {
+    if (NextIntervalUs() == 0)
+      break;
+
+    float ticks = last_interval_us_ * ((float)tick_hz_ / 1000000.0f) + tick_remainder_;
+    uint32_t whole = (uint32_t)ticks;
+    tick_remainder_ = ticks - whole;
+    buf[written] = whole > 0xFFFF ? 0xFFFF : (uint16_t)whole;
+    ticks_written += buf[written++];
+  }
+  return written;
+}
+
+uint32_t StepIntervalGenerator::FirstIntervalTicks()
+{
+  if (jerk_ > 0.0f)
+  {
+    profile_.SetJerk(jerk_);
+    return (uint32_t)(profile_.FirstIntervalUs() * ((float)tick_hz_ / 1000000.0f));
+  }
+
+  // The interval after the first step is the longest one of the ramp
+  float c1 = c0_ - ((2.0 * c0_) / 5.0);
+  if (c1 < cmin_)
+    c1 = cmin_;
+  return (uint32_t)(c1 * ((float)tick_hz_ / 1000000.0f));
+}
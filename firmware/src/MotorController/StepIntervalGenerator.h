@@ -0,0 +1,77 @@
+#pragma once
+#include <cstdint>
+#include "MotorController/SCurveProfile.h"
+
+// Precomputes the step-to-step intervals of a trapezoidal move from rest.
+// The recurrence is the same one AccelStepper::computeNewSpeed() runs per step
+// (Austin's equations 13/15/16) so the hardware pulse train reproduces the
+// profile the TC0 path would have generated, but it runs in the foreground
+// instead of inside the step ISR.
+// With a jerk limit set the intervals come from an SCurveProfile instead.
+class StepIntervalGenerator
+{
+public:
+    StepIntervalGenerator();
+
+    void SetMaxSpeed(float speed);
+    void SetAcceleration(float acceleration);
+    void SetTickFrequency(uint32_t tick_hz);
+
+    // Jerk limit in steps/s^3 for S-curve moves, 0 for trapezoidal ones.
+    // Takes effect at the next Begin().
+    void SetJerk(float jerk);
+
+    // Start a new move of `distance` steps (> 0) from standstill.
+    void Begin(long distance);
+
+    // Shorten the move so it decelerates to rest as soon as possible. At least
+    // one more interval is always left so a streaming consumer can close out.
+    void Stop();
+
+    // Move the end of the move to `distance` steps from its start, carrying on
+    // from the speed of the step just generated. S-curve moves continue on the
+    // trapezoidal ramp. Returns false, changing nothing, if the new end can't
+    // be reached without stopping and reversing first.
+    bool Retarget(long distance);
+
+    // Interval in microseconds between the step just generated and the next,
+    // truncated the same way AccelStepper::GetStepIntervalUs() is.
+    // Returns 0 once the final step has been generated.
+    unsigned long NextIntervalUs();
+
+    // Fill `buf` with intervals converted to timer ticks. Fractional ticks are
+    // carried forward so the cumulative time does not drift. Stops early once
+    // the entries add up to `max_ticks`. Returns the number of entries
+    // written, 0 when the move is complete.
+    uint32_t Fill(uint16_t *buf, uint32_t len, uint32_t max_ticks = 0xFFFFFFFF);
+
+    // First interval of a move from rest, in ticks. Used to check whether a
+    // profile fits in a 16 bit timer period.
+    uint32_t FirstIntervalTicks();
+
+    // Intervals still to be produced; the last step of a move has none after it
+    long RemainingIntervals() { return distance_ - generated_ - 1; }
+
+    bool Done() { return generated_ >= distance_; }
+    long Generated() { return generated_; }
+    long Distance() { return distance_; }
+
+private:
+    float max_speed_;
+    float acceleration_;
+    uint32_t tick_hz_;
+    float jerk_;
+    bool s_curve_;
+    SCurveProfile profile_;
+
+    float c0_;
+    float cn_;
+    float cmin_;
+    float speed_;
+    long n_;
+
+    long distance_;
+    long generated_;
+    float last_interval_us_;
+    float tick_remainder_;
+};
@@ -0,0 +1,287 @@
+#include "StepPulseEngine.h"
+#include "MotorController.h"
+
+void DMAC_0_Handler()
+{
+  uint8_t flags = DMAC->Channel[(uint8_t)DmaChannel::STEP_PULSES].CHINTFLAG.reg;
+  DMAC->Channel[(uint8_t)DmaChannel::STEP_PULSES].CHINTFLAG.reg = flags;
+
+  if (flags & DMAC_CHINTFLAG_TCMPL)
+  {
+    motorController.step_engine.OnDmaBlockComplete();
+  }
+  if (flags & (DMAC_CHINTFLAG_SUSP | DMAC_CHINTFLAG_TERR))
+  {
+    motorController.step_engine.OnDmaFault();
+  }
+}
+
+void TC4_Handler()
+{
+  if (TC4->COUNT16.INTFLAG.bit.OVF)
+  {
+    TC4->COUNT16.INTFLAG.bit.OVF = 1;
+    motorController.step_engine.OnTimerUnderflow();
+  }
+}
+
+void StepPulseEngine::Init(uint8_t step_pin)
+{
+  step_pin_ = step_pin;
+  generator.SetTickFrequency(STEP_ENGINE_TICK_HZ);
+
+  // TC4 generates the pulses, TC5 counts them. They share a GCLK channel.
+  MCLK->APBCMASK.bit.TC4_ = 1;
+  MCLK->APBCMASK.bit.TC5_ = 1;
+  GCLK->PCHCTRL[TC4_GCLK_ID].reg = GCLK_PCHCTRL_GEN_GCLK1 | GCLK_PCHCTRL_CHEN;
+  while (GCLK->PCHCTRL[TC4_GCLK_ID].bit.CHEN == 0)
+    ;
+
+  TC4->COUNT16.CTRLA.bit.SWRST = 1;
+  while (TC4->COUNT16.SYNCBUSY.bit.SWRST)
+    ;
+  TC4->COUNT16.CTRLA.reg = TC_CTRLA_MODE_COUNT16 | TC_CTRLA_PRESCALER_DIV16 | TC_CTRLA_PRESCSYNC_PRESC;
+  TC4->COUNT16.WAVE.reg = TC_WAVE_WAVEGEN_MPWM;
+  TC4->COUNT16.CTRLBSET.reg = TC_CTRLBSET_DIR;
+  while (TC4->COUNT16.SYNCBUSY.bit.CTRLB)
+    ;
+  TC4->COUNT16.EVCTRL.reg = TC_EVCTRL_OVFEO;
+
+  TC5->COUNT16.CTRLA.bit.SWRST = 1;
+  while (TC5->COUNT16.SYNCBUSY.bit.SWRST)
+    ;
+  TC5->COUNT16.CTRLA.reg = TC_CTRLA_MODE_COUNT16;
+  TC5->COUNT16.EVCTRL.reg = TC_EVCTRL_TCEI | TC_EVCTRL_EVACT_COUNT;
+  TC5->COUNT16.CTRLA.bit.ENABLE = 1;
+  while (TC5->COUNT16.SYNCBUSY.bit.ENABLE)
+    ;
+
+  MCLK->APBBMASK.bit.EVSYS_ = 1;
+  EVSYS->USER[EVSYS_ID_USER_TC5_EVU].reg = EVSYS_USER_CHANNEL(STEP_ENGINE_EVSYS_CHANNEL + 1);
+  EVSYS->Channel[STEP_ENGINE_EVSYS_CHANNEL].CHANNEL.reg = EVSYS_CHANNEL_EVGEN(EVSYS_ID_GEN_TC4_OVF) |
+                                                          EVSYS_CHANNEL_PATH_ASYNCHRONOUS;
+
+  DmaController::ConfigureChannel(DmaChannel::STEP_PULSES, TC4_DMAC_ID_OVF, 3);
+  DMAC->Channel[(uint8_t)DmaChannel::STEP_PULSES].CHINTENSET.reg = DMAC_CHINTENSET_TCMPL |
+                                                                   DMAC_CHINTENSET_SUSP |
+                                                                   DMAC_CHINTENSET_TERR;
+  NVIC_SetPriority(DMAC_0_IRQn, 1);
+  NVIC_EnableIRQ(DMAC_0_IRQn);
+
+  NVIC_SetPriority(TC4_IRQn, 1);
+  NVIC_EnableIRQ(TC4_IRQn);
+
+  last_pulse_count_ = ReadPulseCounter();
+}
+
+bool StepPulseEngine::Start(long steps)
+{
+  if (busy_ || steps <= 0)
+    return false;
+  if (generator.FirstIntervalTicks() > 0xFFFF)
+    return false;
+
+  StepsEmitted(); // bring the counter baseline up to date
+  steps_emitted_ = 0;
+  underrun_ = false;
+  stream_finished_ = false;
+  final_half_ = -1;
+  active_half_ = 0;
+
+  generator.Begin(steps);
+
+  // Period 1 is the lead-in before the first pulse, period 2 comes from CC0,
+  // everything after that is streamed into CCBUF0 by the DMAC.
+  uint16_t first_interval = STEP_ENGINE_LEAD_TICKS;
+  if (generator.RemainingIntervals() > 0)
+    generator.Fill(&first_interval, 1);
+
+  TC4->COUNT16.COUNT.reg = STEP_ENGINE_LEAD_TICKS;
+  TC4->COUNT16.CC[0].reg = first_interval;
+  TC4->COUNT16.CC[1].reg = STEP_ENGINE_PULSE_TICKS;
+  while (TC4->COUNT16.SYNCBUSY.reg & (TC_SYNCBUSY_COUNT | TC_SYNCBUSY_CC0 | TC_SYNCBUSY_CC1))
+    ;
+  TC4->COUNT16.INTFLAG.reg = TC_INTFLAG_OVF;
+  TC4->COUNT16.INTENCLR.reg = TC_INTENCLR_OVF;
+
+  if (steps == 1)
+  {
+    TC4->COUNT16.CTRLBSET.reg = TC_CTRLBSET_ONESHOT;
+    while (TC4->COUNT16.SYNCBUSY.bit.CTRLB)
+      ;
+    BeginTail(1);
+  }
+  else if (steps == 2)
+  {
+    BeginTail(2);
+  }
+  else
+  {
+    half_free_[0] = half_free_[1] = false;
+    FillHalf(0);
+    if (final_half_ < 0)
+      FillHalf(1);
+
+    memcpy((void *)DmaController::GetDescriptor(DmaChannel::STEP_PULSES), (const void *)&descriptors_[0], sizeof(DmacDescriptor));
+    DmaController::EnableChannel(DmaChannel::STEP_PULSES);
+  }
+
+  busy_ = true;
+  digitalWrite(step_pin_, LOW);
+  pinPeripheral(step_pin_, PIO_TIMER);
+
+  TC4->COUNT16.CTRLA.bit.ENABLE = 1;
+  while (TC4->COUNT16.SYNCBUSY.bit.ENABLE)
+    ;
+  return true;
+}
+
+bool StepPulseEngine::FillHalf(uint8_t half)
+{
+  uint32_t count = generator.Fill(step_buffer_[half], DOUBLE_BUF_SIZE,
+                                  (uint32_t)((uint64_t)STEP_ENGINE_HALF_US * STEP_ENGINE_TICK_HZ / 1000000));
+  if (count == 0)
+    return false;
+
+  bool last = generator.RemainingIntervals() <= 0;
+  DmacDescriptor &desc = descriptors_[half];
+  desc.BTCTRL.reg = DMAC_BTCTRL_BEATSIZE_HWORD |
+                    DMAC_BTCTRL_SRCINC |
+                    DMAC_BTCTRL_BLOCKACT_INT;
+  desc.BTCNT.reg = count;
+  // Incrementing source addresses point at the end of the block
+  desc.SRCADDR.reg = (uint32_t)&step_buffer_[half][count];
+  desc.DSTADDR.reg = (uint32_t)&TC4->COUNT16.CCBUF[0].reg;
+  desc.DESCADDR.reg = last ? 0 : (uint32_t)&descriptors_[half ^ 1];
+
+  if (last)
+  {
+    final_half_ = half;
+    stream_finished_ = true;
+  }
+  half_free_[half] = false;
+  desc.BTCTRL.bit.VALID = 1;
+  return true;
+}
+
+void StepPulseEngine::Service()
+{
+  if (!busy_ || stream_finished_)
+    return;
+
+  for (uint8_t half = 0; half < 2; half++)
+  {
+    if (half_free_[half] && !stream_finished_)
+    {
+      FillHalf(half);
+    }
+  }
+}
+
+void StepPulseEngine::Stop()
+{
+  if (busy_ && !stream_finished_)
+  {
+    generator.Stop();
+  }
+}
+
+bool StepPulseEngine::Retarget(long steps)
+{
+  // Once the last half is queued the DMAC chain has ended, too late to extend
+  if (busy_ && !stream_finished_ && generator.Retarget(steps))
+    return true;
+  Stop();
+  return false;
+}
+
+void StepPulseEngine::Abort()
+{
+  if (!busy_)
+    return;
+  TC4->COUNT16.INTENCLR.reg = TC_INTENCLR_OVF;
+  DmaController::DisableChannel(DmaChannel::STEP_PULSES);
+  Finish();
+}
+
+void StepPulseEngine::OnDmaBlockComplete()
+{
+  uint8_t half = active_half_;
+  if ((int8_t)half == final_half_)
+  {
+    // Last period value has been loaded into CCBUF0. Two more underflows:
+    // one starts the final period, the next ends it with the last pulse.
+    BeginTail(2);
+    return;
+  }
+
+  descriptors_[half].BTCTRL.bit.VALID = 0;
+  half_free_[half] = true;
+  active_half_ = half ^ 1;
+}
+
+void StepPulseEngine::OnDmaFault()
+{
+  // The DMAC reached a half that Service() had not refilled in time
+  underrun_ = true;
+  Abort();
+}
+
+void StepPulseEngine::BeginTail(uint8_t underflows)
+{
+  tail_underflows_ = underflows;
+  TC4->COUNT16.INTFLAG.reg = TC_INTFLAG_OVF;
+  TC4->COUNT16.INTENSET.reg = TC_INTENSET_OVF;
+}
+
+void StepPulseEngine::OnTimerUnderflow()
+{
+  if (tail_underflows_ == 0)
+    return;
+
+  tail_underflows_--;
+  if (tail_underflows_ == 1)
+  {
+    // Stop the counter at the end of the final period
+    TC4->COUNT16.CTRLBSET.reg = TC_CTRLBSET_ONESHOT;
+  }
+  else if (tail_underflows_ == 0)
+  {
+    TC4->COUNT16.INTENCLR.reg = TC_INTENCLR_OVF;
+    Finish();
+  }
+}
+
+void StepPulseEngine::Finish()
+{
+  TC4->COUNT16.CTRLA.bit.ENABLE = 0;
+  TC4->COUNT16.CTRLBCLR.reg = TC_CTRLBCLR_ONESHOT;
+  pinMode(step_pin_, OUTPUT);
+  digitalWrite(step_pin_, LOW);
+  descriptors_[0].BTCTRL.bit.VALID = 0;
+  descriptors_[1].BTCTRL.bit.VALID = 0;
+  tail_underflows_ = 0;
+  busy_ = false;
+}
+
+uint16_t StepPulseEngine::ReadPulseCounter()
+{
+  TC5->COUNT16.CTRLBSET.reg = TC_CTRLBSET_CMD_READSYNC;
+  while (TC5->COUNT16.SYNCBUSY.bit.CTRLB || TC5->COUNT16.CTRLBSET.bit.CMD)
+    ;
+  return TC5->COUNT16.COUNT.reg;
+}
+
+long StepPulseEngine::StepsEmitted()
+{
+  // Read and both stores as one, a caller cutting in between would count
+  // the same pulses twice
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  uint16_t count = ReadPulseCounter();
+  steps_emitted_ += (uint16_t)(count - last_pulse_count_);
+  last_pulse_count_ = count;
+  long steps = steps_emitted_;
+  __set_PRIMASK(primask);
+  return steps;
+}
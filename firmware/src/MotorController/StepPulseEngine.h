@@ -0,0 +1,87 @@
+#pragma once
+#include <Arduino.h>
+#include "wiring_private.h"
+#include "MotorController/StepIntervalGenerator.h"
+#include "DmaController/DmaController.h"
+
+// Number of step intervals in each half of the ping-pong buffer
+#define DOUBLE_BUF_SIZE 1024
+
+// Time each half is filled up to, which bounds how far ahead of the pulses a
+// new target can take effect. Service() must refill a half within this.
+#define STEP_ENGINE_HALF_US 4000
+
+// TC4 runs from GCLK1 (48MHz) / 16, max period is 0xFFFF ticks (~21.8ms)
+#define STEP_ENGINE_TICK_HZ (48000000 / 16)
+#define STEP_ENGINE_PULSE_TICKS 6 // 2us STEP high time
+#define STEP_ENGINE_LEAD_TICKS 30 // 10us from DIR change to the first STEP edge
+#define STEP_ENGINE_EVSYS_CHANNEL 0
+
+// Hardware timed STEP pulse train.
+//
+// MOTOR_STEP (PB09) is only routable to TC4/WO[1], so TC4 runs in MPWM mode
+// counting down: CC0 is the period and CC1 the pulse width, which puts the
+// STEP pulse at the end of every period. The DMAC copies the next period into
+// CCBUF0 on every underflow, streaming from two DOUBLE_BUF_SIZE halves that
+// Service() refills in the foreground from the StepIntervalGenerator. Each
+// half holds at most STEP_ENGINE_HALF_US worth of intervals so a Stop() or
+// Retarget() is heard within a few milliseconds.
+// TC4 overflow events are also routed to TC5 through the EVSYS so the number
+// of pulses actually emitted can be read back at any time.
+class StepPulseEngine
+{
+public:
+    StepIntervalGenerator generator;
+
+    void Init(uint8_t step_pin);
+
+    // Begin a move of `steps` (> 0) pulses using the generator's speed and
+    // acceleration. The caller sets the DIR pin beforehand. Returns false if the
+    // profile does not fit the timer, in which case nothing was started.
+    bool Start(long steps);
+
+    // Decelerate to a stop as soon as the already queued intervals allow
+    void Stop();
+
+    // Change the move to `steps` pulses in total, carrying on from the speed
+    // the queued intervals end at. Returns false if that needs a stop first,
+    // in which case the move decelerates to one as Stop() does.
+    bool Retarget(long steps);
+
+    // Halt the pulse train immediately
+    void Abort();
+
+    // Refill free buffer halves. Call from the main loop while busy.
+    void Service();
+
+    bool IsBusy() { return busy_; }
+    bool HadUnderrun() { return underrun_; }
+    // Syncs the TC5 pulse counter, not for the step interrupt
+    long StepsEmitted();
+
+    void OnDmaBlockComplete();
+    void OnDmaFault();
+    void OnTimerUnderflow();
+
+private:
+    uint8_t step_pin_ = 0;
+
+    uint16_t step_buffer_[2][DOUBLE_BUF_SIZE];
+    __attribute__((aligned(16))) DmacDescriptor descriptors_[2];
+
+    volatile bool busy_ = false;
+    volatile bool underrun_ = false;
+    volatile bool half_free_[2] = {false, false};
+    volatile uint8_t active_half_ = 0;
+    volatile int8_t final_half_ = -1;
+    volatile uint8_t tail_underflows_ = 0;
+    bool stream_finished_ = false;
+
+    uint16_t last_pulse_count_ = 0;
+    long steps_emitted_ = 0;
+
+    bool FillHalf(uint8_t half);
+    void BeginTail(uint8_t underflows);
+    void Finish();
+    uint16_t ReadPulseCounter();
+};
@@ -0,0 +1,114 @@
+#include "StepTimer.h"
+#include "MotorController/MotorController.h"
+
+#ifdef STEP_TIMER_TC0
+void TC0_Handler()
+{
+  if (TC0->COUNT16.INTFLAG.bit.OVF)
+  {
+#if defined(PROFILER) && defined(PROFILER_STEP_LATENCY)
+    // The counter restarted at the overflow, its ticks since then are how
+    // long other interrupts held this one up. READSYNC takes a few 48MHz
+    // clocks.
+    TC0->COUNT16.CTRLBSET.reg = TC_CTRLBSET_CMD_READSYNC;
+    while (TC0->COUNT16.SYNCBUSY.bit.CTRLB || TC0->COUNT16.CTRLBSET.bit.CMD)
+      ;
+    Profiler::Record(ProfileProbe::STEP_LATENCY, TC0->COUNT16.COUNT.reg * (SystemCoreClock / US_PER_SEC / STEP_TIMER_TICKS_PER_US));
+#endif
+    PROFILE_SCOPE(ProfileProbe::STEP_ISR);
+    motorController.OnTimer();
+    TC0->COUNT16.INTFLAG.bit.OVF = 1;
+  }
+}
+
+void init_timer()
+{
+  // Enable the TC0 module
+  MCLK->APBAMASK.bit.TC0_ = 1;
+
+  // Configure the Generic Clock Generator 0 (GCLK0) for TC0
+  GCLK->PCHCTRL[TC0_GCLK_ID].reg = GCLK_PCHCTRL_GEN_GCLK1 | GCLK_PCHCTRL_CHEN;
+  while (GCLK->PCHCTRL[TC0_GCLK_ID].bit.CHEN == 0)
+    ;
+
+  GCLK->GENCTRL[1].bit.DIV = 0x00;
+  while (GCLK->SYNCBUSY.bit.GENCTRL1)
+    ;
+
+  GCLK->GENCTRL[1].bit.DIVSEL = 0;
+  while (GCLK->SYNCBUSY.bit.GENCTRL1)
+    ;
+
+  DEBUG_PRINTF("Prescaler: %d\n", GCLK->GENCTRL[0].bit.DIV);
+
+  // Reset TC0
+  TC0->COUNT16.CTRLA.bit.SWRST = 1;
+  while (TC0->COUNT16.SYNCBUSY.bit.SWRST)
+    ;
+
+  TC0->COUNT16.CTRLA.bit.MODE = TC_CTRLA_MODE_COUNT16;
+  TC0->COUNT16.CTRLA.bit.PRESCALER = TC_CTRLA_PRESCALER_DIV8_Val;
+  TC0->COUNT16.WAVE.bit.WAVEGEN = TC_WAVE_WAVEGEN_MFRQ_Val;
+  while (TC0->COUNT16.SYNCBUSY.bit.ENABLE)
+    ;
+  // Set the period (TOP value) for the timer
+  TC0->COUNT16.CC[0].reg = TIMER_COUNT;
+  while (TC0->COUNT16.SYNCBUSY.bit.CC0)
+    ;
+
+  // Enable the overflow interrupt
+  TC0->COUNT16.INTENSET.bit.OVF = 1;
+
+  // Enable the TC0 interrupt in the NVIC
+  NVIC_EnableIRQ(TC0_IRQn);
+  NVIC_SetPriority(TC0_IRQn, 1);
+
+  // Enable TC0
+  TC0->COUNT16.CTRLA.bit.ENABLE = 1;
+  while (TC0->COUNT16.SYNCBUSY.bit.ENABLE)
+    ;
+}
+
+void SetTimerIntervalUs(unsigned long interval_us)
+{
+  // Set the timer period (TOP value) for the timer
+  TC0->COUNT16.CC[0].reg = US_TO_TIMER_COUNT(interval_us);
+  while (TC0->COUNT16.SYNCBUSY.bit.CC0)
+    ;
+  // DEBUG_PRINTF("Set timer interval to %lu us\n", US_TO_TIMER_COUNT(interval_us));
+}
+
+void LoadTimerPeriod(uint16_t period)
+{
+  // MFRQ counts 0..CC0. CCBUF0 is copied into CC0 by the hardware at the next
+  // overflow, the running period is never touched. No SYNCBUSY wait, the
+  // previous write was at least a whole period ago.
+  TC0->COUNT16.CCBUF[0].reg = period - 1;
+}
+
+#else
+static HostStepTimer host_step_timer = {0, 0, false, false};
+
+HostStepTimer &GetHostStepTimer()
+{
+  return host_step_timer;
+}
+
+void init_timer()
+{
+  host_step_timer.cc0 = TIMER_COUNT;
+  host_step_timer.ccbuf0_valid = false;
+  host_step_timer.running = true;
+}
+
+void SetTimerIntervalUs(unsigned long interval_us)
+{
+  host_step_timer.cc0 = US_TO_TIMER_COUNT(interval_us);
+}
+
+void LoadTimerPeriod(uint16_t period)
+{
+  host_step_timer.ccbuf0 = period - 1;
+  host_step_timer.ccbuf0_valid = true;
+}
+#endif
@@ -0,0 +1,33 @@
+#pragma once
+#include <cstdint>
+#include "MotorController/StepTimerSchedule.h"
+
+// TC0 drives the step interrupt on the SAMD51. Host builds get the same calls
+// on a register model instead, which a test steps through itself.
+#if defined(__SAMD51__)
+#define STEP_TIMER_TC0
+#endif
+
+// Starts TC0 in MFRQ mode with the overflow interrupt calling
+// MotorController::OnTimer()
+void init_timer();
+
+// Sets the period straight away, waiting for the register to sync
+void SetTimerIntervalUs(unsigned long interval_us);
+
+// Queues the next period through CCBUF0, see StepTimerSchedule
+void LoadTimerPeriod(uint16_t period);
+
+#ifndef STEP_TIMER_TC0
+// The TC0 registers the firmware writes, in timer ticks. At each overflow the
+// counter starts over and takes CCBUF0 into CC0 if it was written since.
+struct HostStepTimer
+{
+    uint16_t cc0;
+    uint16_t ccbuf0;
+    bool ccbuf0_valid;
+    bool running;
+};
+
+HostStepTimer &GetHostStepTimer();
+#endif
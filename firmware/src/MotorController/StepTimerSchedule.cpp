@@ -0,0 +1,100 @@
+#include "StepTimerSchedule.h"
+
+// Shortest period ever loaded, leaves the interrupt time to write CCBUF0
+// before the overflow that picks it up
+#define STEP_TIMER_MIN_PERIOD_US 8
+
+// A deadline at most this far past an overflow is stepped on that overflow,
+// inside ACCELSTEPPER_SCHEDULE_SLACK_US
+#define STEP_TIMER_STEP_WINDOW_US 2
+
+// The stepper's time to the next step is short by the interrupt latency. A
+// deadline followed in ticks that is this much later than it has drifted.
+#define STEP_TIMER_RESYNC_US 5
+
+// Longest deadline followed, about three minutes at 6 ticks/us
+#define STEP_TIMER_MAX_TICKS 0x40000000
+
+StepTimerSchedule::StepTimerSchedule(uint32_t ticks_per_us, unsigned long idle_period_us)
+    : ticks_per_us_(ticks_per_us),
+      idle_period_((uint16_t)(idle_period_us * ticks_per_us)),
+      carry_(0),
+      pending_(0),
+      running_(idle_period_),
+      stopped_(true)
+{
+}
+
+void StepTimerSchedule::Reset()
+{
+  carry_ = 0;
+  pending_ = 0;
+  running_ = idle_period_;
+  stopped_ = true;
+}
+
+int32_t StepTimerSchedule::Ticks(unsigned long interval_us, uint8_t interval_frac, uint32_t &carry)
+{
+  uint64_t ticks_q8 = ((uint64_t)interval_us * 256 + interval_frac) * ticks_per_us_ + carry;
+  carry = (uint32_t)(ticks_q8 & 0xFF);
+  return (ticks_q8 >> 8) > STEP_TIMER_MAX_TICKS ? STEP_TIMER_MAX_TICKS : (int32_t)(ticks_q8 >> 8);
+}
+
+uint16_t StepTimerSchedule::Split(int32_t ticks)
+{
+  // Longer than one timer period, split what is left so the last partial
+  // period is never very short
+  if (ticks > 2 * 0xFFFF)
+    ticks = 0xFFFF;
+  else if (ticks > 0xFFFF)
+    ticks /= 2;
+  if (ticks < (int32_t)(STEP_TIMER_MIN_PERIOD_US * ticks_per_us_))
+    ticks = STEP_TIMER_MIN_PERIOD_US * ticks_per_us_;
+  return (uint16_t)ticks;
+}
+
+uint16_t StepTimerSchedule::Next(bool stepped, unsigned long interval_us, uint8_t interval_frac,
+                                 unsigned long next_us, uint8_t next_frac, unsigned long time_to_step_us)
+{
+  if (interval_us == 0)
+  {
+    // Stopped, poll at the idle rate
+    Reset();
+    return idle_period_;
+  }
+
+  // Ticks from the current overflow to the next deadline
+  int32_t deadline = stepped ? pending_ + Ticks(interval_us, interval_frac, carry_) : pending_;
+  int64_t measured = (int64_t)time_to_step_us * ticks_per_us_;
+  if (measured > STEP_TIMER_MAX_TICKS)
+    measured = STEP_TIMER_MAX_TICKS;
+  if (deadline + (int64_t)ticks_per_us_ < measured || deadline > measured + STEP_TIMER_RESYNC_US * ticks_per_us_)
+  {
+    deadline = (int32_t)measured;
+    carry_ = 0;
+  }
+
+  // The same from the coming overflow, where the period loaded now starts
+  int32_t left = deadline - running_;
+  uint16_t period;
+  if (left > (int32_t)(STEP_TIMER_STEP_WINDOW_US * ticks_per_us_))
+  {
+    period = Split(left);
+  }
+  else if (next_us == 0)
+  {
+    // The motor stops on the coming overflow
+    period = idle_period_;
+  }
+  else
+  {
+    // The coming overflow steps, run on to the deadline after that
+    uint32_t carry = carry_;
+    period = Split(left + Ticks(next_us, next_frac, carry));
+  }
+
+  pending_ = left;
+  running_ = period;
+  stopped_ = false;
+  return period;
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <cstdint>
+
+// Works out the TC0 periods for absolute step scheduling.
+//
+// The timer runs in MFRQ mode so each period is timed by the hardware from
+// the previous overflow, independent of interrupt latency. Periods only ever
+// go into CCBUF0, which the timer takes into CC0 at the next overflow without
+// any synchronization wait. The period running while the interrupt executes
+// is already fixed, so each interrupt plans the one after it: up to the next
+// step deadline, or when that deadline falls on the coming overflow, up to
+// the deadline of the step after it.
+//
+// Deadlines are followed in timer ticks from overflow to overflow, with the
+// fractional part of the intervals carried forward so the average rate is
+// exact. Intervals too long for 16 bits are split into partial periods. The
+// stepper's own time to the next step puts the schedule back on track when it
+// moves the deadline by itself (start from rest, new speed, late step).
+class StepTimerSchedule
+{
+public:
+    StepTimerSchedule(uint32_t ticks_per_us, unsigned long idle_period_us);
+
+    // Returns the period in timer ticks to load into CCBUF0.
+    //
+    // stepped: a step was taken in this interrupt.
+    // interval_us/interval_frac: interval from the last step to the next one,
+    // in microseconds plus 1/256us, 0 when stopped.
+    // next_us/next_frac: interval that will follow the next step, 0 if the
+    // motor stops there.
+    // time_to_step_us: time left until the next step deadline, measured from
+    // the start of the interrupt.
+    uint16_t Next(bool stepped, unsigned long interval_us, uint8_t interval_frac,
+                  unsigned long next_us, uint8_t next_frac, unsigned long time_to_step_us);
+
+    void Reset();
+
+    // Last period handed out was the idle one
+    bool Stopped() { return stopped_; }
+
+private:
+    uint32_t ticks_per_us_;
+    uint16_t idle_period_;
+    uint32_t carry_;
+    int32_t pending_;  // ticks from the current overflow to the next deadline
+    uint16_t running_; // the period in CC0, from the current overflow
+    bool stopped_;
+
+    int32_t Ticks(unsigned long interval_us, uint8_t interval_frac, uint32_t &carry);
+    uint16_t Split(int32_t ticks);
+};
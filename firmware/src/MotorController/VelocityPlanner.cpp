@@ -0,0 +1,179 @@
+#include "VelocityPlanner.h"
+#include <cmath>
+
+// Relative to the squared speed, a few float roundings
+#define VELOCITY_PLANNER_BRAKE_SLACK 1.0e-5f
+
+VelocityPlanner::VelocityPlanner()
+    : acceleration_(1.0f),
+      max_speed_(1.0f),
+      depth_(VELOCITY_PLANNER_DEFAULT_DEPTH),
+      last_plan_length_(0)
+{
+  for (uint32_t i = 0; i < VELOCITY_STEP_QUEUE_SIZE; i++)
+    exit_speed_[i].store(0.0f, std::memory_order_relaxed);
+}
+
+void VelocityPlanner::SetAcceleration(float acceleration)
+{
+  if (acceleration < 0.0f)
+    acceleration = -acceleration;
+  if (acceleration == 0.0f)
+    return;
+  acceleration_ = acceleration;
+}
+
+void VelocityPlanner::SetMaxSpeed(float speed)
+{
+  if (speed < 0.0f)
+    speed = -speed;
+  if (speed == 0.0f)
+    return;
+  max_speed_ = speed;
+}
+
+bool VelocityPlanner::SetDepth(uint32_t depth)
+{
+  if (depth == 0 || depth > VELOCITY_STEP_QUEUE_SIZE)
+    return false;
+  depth_ = depth;
+  return true;
+}
+
+long VelocityPlanner::LastEnd(long idle_position)
+{
+  uint32_t head = ring_.HeadIndex();
+  if (head == ring_.TailIndex())
+    return idle_position;
+  return ring_.At(head - 1).end;
+}
+
+bool VelocityPlanner::Add(long start, long end, float speed)
+{
+  if (end == start)
+    return true; // nothing to step, the speed alone has no effect
+
+  if (speed < 0.0f)
+    speed = -speed;
+  if (speed > max_speed_)
+    speed = max_speed_;
+
+  Segment segment;
+  segment.end = end;
+  segment.forward = end > start;
+  segment.speed = speed;
+  segment.length = (float)(end > start ? end - start : start - end);
+  segment.max_entry = 0.0f;
+
+  uint32_t head = ring_.HeadIndex();
+  if (head != ring_.TailIndex())
+  {
+    // Keep going through the junction unless the direction reverses
+    const Segment &prev = ring_.At(head - 1);
+    if (prev.forward == segment.forward)
+      segment.max_entry = prev.speed < speed ? prev.speed : speed;
+  }
+
+  // When full the slot still belongs to the running segment. Otherwise only
+  // the consumer can change the depth, and only downwards.
+  if (ring_.Size() >= VELOCITY_STEP_QUEUE_SIZE)
+    return ring_.Push(segment); // counts the overflow
+
+  // The new segment ends at rest until another one follows it
+  exit_speed_[ring_.Slot(head)].store(0.0f, std::memory_order_relaxed);
+  ring_.Push(segment);
+  Replan();
+  return true;
+}
+
+void VelocityPlanner::Replan()
+{
+  uint32_t head = ring_.HeadIndex();
+  uint32_t queued = head - ring_.TailIndex();
+  uint32_t count = queued < depth_ ? queued : depth_;
+
+  // Walk back from the newest segment, which ends at rest. Each junction is
+  // as fast as its limit allows while the segment after it can still slow
+  // down to its own exit speed. Exit speeds only grow, once one comes out
+  // unchanged the rest of the queue is already planned.
+  float exit = 0.0f;
+  last_plan_length_ = 0;
+  for (uint32_t i = 1; i <= count; i++)
+  {
+    uint32_t index = head - i;
+    const Segment &segment = ring_.At(index);
+    last_plan_length_++;
+
+    float entry = sqrtf(exit * exit + 2.0f * acceleration_ * segment.length);
+    if (entry > segment.max_entry)
+      entry = segment.max_entry;
+    if (i == queued)
+      break; // nothing in front of the oldest segment
+
+    std::atomic<float> &prev_exit = exit_speed_[ring_.Slot(index - 1)];
+    if (prev_exit.load(std::memory_order_relaxed) == entry)
+      break;
+    prev_exit.store(entry, std::memory_order_relaxed);
+    exit = entry;
+  }
+}
+
+float VelocityPlanner::ExitSpeed()
+{
+  return exit_speed_[ring_.Slot(ring_.TailIndex())].load(std::memory_order_relaxed);
+}
+
+float VelocityPlanner::NextSpeed(float speed, uint32_t steps_left)
+{
+  const Segment *segment = ring_.Front();
+  float target = segment != nullptr ? segment->speed : 0.0f;
+  float exit = segment != nullptr ? ExitSpeed() : 0.0f;
+
+  // Squared speeds, one step at constant acceleration changes v^2 by 2a
+  float two_a = 2.0f * acceleration_;
+  float v2 = speed * speed;
+  float next2 = target * target;
+  if (v2 + two_a < next2)
+    next2 = v2 + two_a;
+  if (steps_left > 0)
+  {
+    float stop2 = exit * exit + two_a * (float)(steps_left - 1);
+    if (stop2 < next2)
+      next2 = stop2;
+  }
+  // Never brake harder than the acceleration either, even if that overshoots
+  // the planned exit speed (acceleration changed while running). The slack
+  // keeps rounding in the squares from taking this path on a planned stop.
+  float min2 = v2 - two_a - v2 * VELOCITY_PLANNER_BRAKE_SLACK;
+  if (next2 < min2)
+    next2 = min2;
+  return next2 > 0.0f ? sqrtf(next2) : 0.0f;
+}
+
+float VelocityPlanner::StepTime(float from, float to)
+{
+  float sum = from + to;
+  if (sum * sum < acceleration_ * 1.0e-6f)
+  {
+    // Rest to rest, half a step speeding up and half slowing down
+    return 2.0f / sqrtf(acceleration_);
+  }
+  // Constant acceleration covers the step at the mean of the two speeds
+  return 2.0f / sum;
+}
+
+void VelocityPlanner::NextInterval(float &speed, uint32_t steps_left, unsigned long &interval_us, uint8_t &interval_frac)
+{
+  float next = NextSpeed(speed, steps_left);
+  float interval = StepTime(speed, next);
+  speed = next;
+
+  uint32_t interval_q8 = interval < 16.0f ? (uint32_t)(interval * 256.0e6f + 0.5f) : 0xFFFFFFFF;
+  interval_us = interval_q8 >> 8;
+  interval_frac = interval_q8 & 0xFF;
+  if (interval_us == 0)
+  {
+    interval_us = 1;
+    interval_frac = 0;
+  }
+}
@@ -0,0 +1,98 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include "SpscRing/SpscRing.h"
+
+// Queued path segments, must be a power of two
+#define VELOCITY_STEP_QUEUE_SIZE 64
+
+// Segments planned back from the newest one on every Add()
+#define VELOCITY_PLANNER_DEFAULT_DEPTH 16
+
+// Look-ahead planner for the queued velocity step segments.
+//
+// Every segment runs at its own speed between two step positions. On each
+// Add() a reverse pass over the newest `depth` segments works out the fastest
+// speed each segment may leave at so that everything behind it can still
+// decelerate within acceleration(), ending at rest after the newest one. The
+// speed at a junction is also limited to the slower of the two segments and
+// is 0 where the direction reverses.
+//
+// Exit speeds only ever go up as segments are added, so the step interrupt
+// can keep running the current segment while it is replanned. Per step it
+// takes the highest speed that is within acceleration() of the previous one,
+// at most the segment's speed and still able to slow down to the planned exit
+// speed by the end of the segment.
+//
+// Add() is the producer and Current() / Finish() / NextInterval() the
+// consumer of the underlying SpscRing. A segment stays queued while it runs.
+class VelocityPlanner
+{
+public:
+    struct Segment
+    {
+        long end;        // step position the segment ends on
+        bool forward;    // towards higher step positions
+        float speed;     // steps per second, limited to the max speed
+        float length;    // steps
+        float max_entry; // junction limit with the segment before it
+    };
+
+    VelocityPlanner();
+
+    void SetAcceleration(float acceleration);
+    float Acceleration() { return acceleration_; }
+    void SetMaxSpeed(float speed);
+
+    // Segments replanned per Add(), 1 .. VELOCITY_STEP_QUEUE_SIZE
+    bool SetDepth(uint32_t depth);
+    uint32_t Depth() { return depth_; }
+
+    // Producer. End of the newest queued segment, or `idle_position` when the
+    // queue is empty.
+    long LastEnd(long idle_position);
+
+    // Producer. Queues a segment from `start` to `end` at `speed` and replans.
+    // Returns false when the queue is full.
+    bool Add(long start, long end, float speed);
+
+    // Producer. Segments visited by the last replan
+    uint32_t LastPlanLength() { return last_plan_length_; }
+
+    // Consumer. Running segment, nullptr when the queue is empty.
+    const Segment *Current() { return ring_.Front(); }
+
+    // Consumer. Done with the running segment.
+    void Finish() { ring_.Pop(); }
+
+    // Consumer. Planned speed at the end of the running segment.
+    float ExitSpeed();
+
+    // Consumer. Speed for the next step of the running segment, given the
+    // speed at the step just taken and the steps left to the end of the
+    // segment including the next one.
+    float NextSpeed(float speed, uint32_t steps_left);
+
+    // Seconds from a step at speed `from` to the next one at speed `to`
+    float StepTime(float from, float to);
+
+    // Consumer. NextSpeed() as an interval in microseconds plus 1/256us,
+    // `speed` is updated to the next step's speed.
+    void NextInterval(float &speed, uint32_t steps_left, unsigned long &interval_us, uint8_t &interval_frac);
+
+    uint32_t Size() { return ring_.Size(); }
+    static constexpr uint32_t GetCapacity() { return VELOCITY_STEP_QUEUE_SIZE; }
+    uint32_t HighWater() { return ring_.HighWater(); }
+    uint32_t Overflows() { return ring_.Overflows(); }
+
+private:
+    SpscRing<Segment, VELOCITY_STEP_QUEUE_SIZE> ring_;
+    std::atomic<float> exit_speed_[VELOCITY_STEP_QUEUE_SIZE];
+
+    float acceleration_;
+    float max_speed_;
+    uint32_t depth_;
+    uint32_t last_plan_length_;
+
+    void Replan();
+};
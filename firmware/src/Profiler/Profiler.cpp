@@ -0,0 +1,78 @@
+#include "Profiler.h"
+#include <cstring>
+
+namespace Profiler
+{
+    static ProfileStats stats_[(uint8_t)ProfileProbe::COUNT];
+
+    void Init()
+    {
+#ifdef PROFILER_DWT
+        CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+        DWT->CYCCNT = 0;
+        DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+        Reset();
+    }
+
+    uint8_t HistogramBin(uint32_t cycles)
+    {
+        uint32_t scaled = cycles >> PROFILER_HISTOGRAM_SHIFT;
+        if (scaled == 0)
+            return 0;
+        uint8_t bin = 32 - __builtin_clz(scaled);
+        return bin < PROFILER_HISTOGRAM_BINS ? bin : PROFILER_HISTOGRAM_BINS - 1;
+    }
+
+    void Record(ProfileProbe probe, uint32_t cycles)
+    {
+        if ((uint8_t)probe >= (uint8_t)ProfileProbe::COUNT)
+            return;
+        uint8_t bin = HistogramBin(cycles);
+
+        // Probes record from interrupts and from loop(), keep the update
+        // whole
+#ifdef PROFILER_DWT
+        uint32_t primask = __get_PRIMASK();
+        __disable_irq();
+#endif
+        ProfileStats &s = stats_[(uint8_t)probe];
+        if (s.count == 0 || cycles < s.min)
+            s.min = cycles;
+        if (cycles > s.max)
+            s.max = cycles;
+        s.count++;
+        s.total += cycles;
+        s.histogram[bin]++;
+#ifdef PROFILER_DWT
+        __set_PRIMASK(primask);
+#endif
+    }
+
+    bool Get(uint8_t probe, ProfileStats &stats)
+    {
+        if (probe >= (uint8_t)ProfileProbe::COUNT)
+            return false;
+#ifdef PROFILER_DWT
+        uint32_t primask = __get_PRIMASK();
+        __disable_irq();
+#endif
+        stats = stats_[probe];
+#ifdef PROFILER_DWT
+        __set_PRIMASK(primask);
+#endif
+        return true;
+    }
+
+    void Reset()
+    {
+#ifdef PROFILER_DWT
+        uint32_t primask = __get_PRIMASK();
+        __disable_irq();
+#endif
+        memset(stats_, 0, sizeof(stats_));
+#ifdef PROFILER_DWT
+        __set_PRIMASK(primask);
+#endif
+    }
+}
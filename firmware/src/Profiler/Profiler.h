@@ -0,0 +1,99 @@
+#pragma once
+
+#include <Arduino.h>
+#include <cstdint>
+
+// Cycle counts of the interrupt handlers, the message handler and every task,
+// read over the protocol with GetProfileId. A probe costs two cycle counter
+// reads and a few adds, cheap enough to stay on in release builds. Comment out
+// to compile the probes away.
+#define PROFILER
+
+// On the SAMD51 the probes read the DWT cycle counter, elsewhere they read 0
+#if defined(__SAMD51__)
+#define PROFILER_DWT
+#endif
+
+// Records STEP_LATENCY. Reading the TC0 count syncs it on every step
+// interrupt, which adds to the jitter it measures, so only for measuring.
+// #define PROFILER_STEP_LATENCY
+
+// Tasks that get a probe, in TaskManager::AddTask() order
+#define PROFILER_MAX_TASKS 8
+
+// Bin 0 counts runs shorter than 2^PROFILER_HISTOGRAM_SHIFT cycles, each bin
+// after it is twice as wide, the last one is open ended
+#define PROFILER_HISTOGRAM_BINS 16
+#define PROFILER_HISTOGRAM_SHIFT 6
+
+enum class ProfileProbe : uint8_t
+{
+    STEP_ISR = 0,     // TC0_Handler, i.e. MotorController::OnTimer()
+    ETHERNET_ISR = 1, // W5500 interrupt, only flags that packets arrived
+    MESSAGE = 2,      // MessageProcessor::HandleByteMsg()
+    TASK_0 = 3,       // ITask::Run() of the first task that did OnRun()
+    ENCODER_ANGLE = TASK_0 + PROFILER_MAX_TASKS, // FixedAtan2() and AngleTracker per sample
+    CHECKSUM,         // footer check of one received message
+    STEP_LATENCY,     // TC0 overflow to TC0_Handler, with PROFILER_STEP_LATENCY only
+    COUNT,
+    NONE = 0xFF,
+};
+
+struct ProfileStats
+{
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t total;
+    uint32_t histogram[PROFILER_HISTOGRAM_BINS];
+};
+
+namespace Profiler
+{
+    // Starts the cycle counter
+    void Init();
+
+    inline uint32_t Cycles()
+    {
+#ifdef PROFILER_DWT
+        return DWT->CYCCNT;
+#else
+        return 0;
+#endif
+    }
+
+    // Safe from any interrupt level
+    void Record(ProfileProbe probe, uint32_t cycles);
+
+    // Copy of one probe, consistent even while interrupts record into it.
+    // False for a probe that doesn't exist.
+    bool Get(uint8_t probe, ProfileStats &stats);
+
+    void Reset();
+
+    uint8_t HistogramBin(uint32_t cycles);
+}
+
+// Records the cycles from construction to destruction
+class ProfileScope
+{
+public:
+    ProfileScope(ProfileProbe probe) : probe_(probe), start_(Profiler::Cycles())
+    {
+    }
+
+    ~ProfileScope()
+    {
+        Profiler::Record(probe_, Profiler::Cycles() - start_);
+    }
+
+private:
+    ProfileProbe probe_;
+    uint32_t start_;
+};
+
+#ifdef PROFILER
+#define PROFILE_SCOPE(probe) ProfileScope profile_scope_(probe)
+#else
+#define PROFILE_SCOPE(probe)
+#endif
@@ -45,16 +45,44 @@ void SerialTextInterface::OnRun()
     int bytes_available = Serial.available();
 
     if(bytes_available == 0)
-    return;
+    {
+        // A frame that lost bytes would hold up the ones after it
+        if(frame_parser.Pending() > 0 && millis() - last_recv_ms > SERIAL_FRAME_TIMEOUT_MS)
+        {
+            frame_parser.Reset();
+            DispatchFrames();
+        }
+        return;
+    }
+    last_recv_ms = millis();
 
-    bytes_available = min(bytes_available, RECV_BUF_SIZE);
+    // Frames split across reads are put back together, each read's complete
+    // frames go to the processor in one batch
+    while(bytes_available > 0)
+    {
+        int bytes_read = Serial.readBytes(&recv_buf[0], min(bytes_available, RECV_BUF_SIZE));
+        if(bytes_read == 0)
+        return;
+        bytes_available -= bytes_read;
 
-    if(Serial.readBytes(&char_buf[0], bytes_available) == 0)
+        int bytes_pushed = 0;
+        while(bytes_pushed < bytes_read)
+        {
+            bytes_pushed += frame_parser.Push(&recv_buf[bytes_pushed], bytes_read - bytes_pushed);
+            DispatchFrames();
+        }
+    }
+}
+
+void SerialTextInterface::DispatchFrames()
+{
+    const uint8_t *frames;
+    uint16_t size = frame_parser.Peek(&frames);
+    if(size == 0)
     return;
 
-    HandleIncomingMsg((uint8_t*)&char_buf[0], bytes_available);
-    memset(&char_buf[0], 0, 256);
-    
+    HandleIncomingMsg((uint8_t*)frames, size);
+    frame_parser.Pop();
 }
 
 void SerialTextInterface::HandleIncomingMsg(uint8_t* recv_bytes, uint32_t recv_bytes_size = 0)
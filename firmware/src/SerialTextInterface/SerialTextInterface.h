@@ -4,6 +4,7 @@
 #include <Arduino.h>
 #include "Task/Task.h"
 #include "MessageProcessor/MessageProcessor.hpp"
+#include "MessageProcessor/FrameParser.h"
 #include <stdlib.h>
 #include <ArduinoJson.h>
 #include "DebugPrinter.h"
@@ -12,11 +13,16 @@
 #define LR 0x0A
 #define RECV_BUF_SIZE 256
 
+// Quiet time after which a partial frame is given up on
+#define SERIAL_FRAME_TIMEOUT_MS 20
+
 class SerialTextInterface : public ITask, public IExternalInterface{
 private:
-  char char_buf[RECV_BUF_SIZE];
   uint8_t recv_buf[RECV_BUF_SIZE];
-  int bytes_read = 0;
+  FrameParser frame_parser;
+  uint32_t last_recv_ms = 0;
+
+  void DispatchFrames();
 public:
     SerialTextInterface(uint32_t period){
       executionPeriod = period;
@@ -0,0 +1,124 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+// Keeps the producer and consumer indices on their own cache line. 64 bytes
+// covers the hosts the ring is tested on, the SAMD51 lines are smaller.
+#define SPSC_RING_ALIGN 64
+
+// Fixed capacity single producer / single consumer ring.
+//
+// One context pushes (e.g. the message handlers) and one pops (e.g. the step
+// interrupt). Each index is only ever written by its own side, so there are no
+// locks and no read-modify-write instructions; the release store of an index
+// publishes the slot behind it and the acquire load on the other side sees it
+// complete. The indices run freely and are masked on access, so all Capacity
+// slots are usable and Size() is a plain subtraction.
+//
+// HighWater() and Overflows() are kept by the producer.
+template <typename T, uint32_t Capacity>
+class SpscRing
+{
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "SpscRing capacity must be a power of two");
+
+public:
+    SpscRing() : head_(0), high_water_(0), overflows_(0), tail_(0)
+    {
+    }
+
+    // Producer. Returns false and counts an overflow when the ring is full.
+    bool Push(const T &item)
+    {
+        uint32_t head = head_.load(std::memory_order_relaxed);
+        uint32_t depth = head - tail_.load(std::memory_order_acquire);
+        if (depth >= Capacity)
+        {
+            overflows_++;
+            return false;
+        }
+        slots_[head & (Capacity - 1)] = item;
+        head_.store(head + 1, std::memory_order_release);
+        if (depth + 1 > high_water_)
+            high_water_ = depth + 1;
+        return true;
+    }
+
+    // Consumer. Oldest entry, or nullptr when empty. The entry stays valid
+    // until Pop().
+    const T *Front()
+    {
+        uint32_t tail = tail_.load(std::memory_order_relaxed);
+        if (head_.load(std::memory_order_acquire) == tail)
+            return nullptr;
+        return &slots_[tail & (Capacity - 1)];
+    }
+
+    // Consumer. Drops the entry returned by Front().
+    void Pop()
+    {
+        uint32_t tail = tail_.load(std::memory_order_relaxed);
+        if (head_.load(std::memory_order_acquire) == tail)
+            return;
+        tail_.store(tail + 1, std::memory_order_release);
+    }
+
+    // Consumer
+    bool Pop(T &item)
+    {
+        const T *front = Front();
+        if (front == nullptr)
+            return false;
+        item = *front;
+        Pop();
+        return true;
+    }
+
+    // Consumer. Drops everything pushed so far.
+    void Clear()
+    {
+        tail_.store(head_.load(std::memory_order_acquire), std::memory_order_release);
+    }
+
+    // Either side. Exact from the consumer, may be stale by the entries the
+    // consumer is taking at the same time when called from the producer.
+    uint32_t Size() const
+    {
+        return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+    }
+
+    bool Empty() const { return Size() == 0; }
+    static constexpr uint32_t GetCapacity() { return Capacity; }
+
+    // Either side. Running indices of the oldest entry and of the next one to
+    // be pushed, for data kept alongside the ring in arrays of Capacity
+    // entries indexed by Slot().
+    uint32_t TailIndex() const { return tail_.load(std::memory_order_acquire); }
+    uint32_t HeadIndex() const { return head_.load(std::memory_order_acquire); }
+    static constexpr uint32_t Slot(uint32_t index) { return index & (Capacity - 1); }
+
+    // Producer. Entry at a running index between TailIndex() and
+    // HeadIndex(). Entries don't change once pushed and their slots are only
+    // reused by the producer, so this stays readable even if the consumer
+    // pops the entry meanwhile.
+    const T &At(uint32_t index) const { return slots_[Slot(index)]; }
+
+    // Producer
+    uint32_t HighWater() const { return high_water_; }
+    uint32_t Overflows() const { return overflows_; }
+    void ResetStats()
+    {
+        high_water_ = Size();
+        overflows_ = 0;
+    }
+
+private:
+    // Written by the producer
+    alignas(SPSC_RING_ALIGN) std::atomic<uint32_t> head_;
+    uint32_t high_water_;
+    uint32_t overflows_;
+
+    // Written by the consumer
+    alignas(SPSC_RING_ALIGN) std::atomic<uint32_t> tail_;
+
+    alignas(SPSC_RING_ALIGN) T slots_[Capacity];
+};
@@ -5,6 +5,7 @@ void ITask::Run(){
         return;
     if(executionPeriod == 0 || millis()-lastExecutionTime>executionPeriod){
         lastExecutionTime = millis();
+        PROFILE_SCOPE(profileProbe);
         OnRun();
     }
 }
@@ -3,6 +3,7 @@
 #include <vector>
 #include <cstdint>
 #include <Arduino.h>
+#include "Profiler/Profiler.h"
 
 typedef void (*TaskPointer)();
 
@@ -10,6 +11,7 @@ class ITask {
 private:
     uint32_t lastExecutionTime = 0;
     bool isRunning = false;
+    ProfileProbe profileProbe = ProfileProbe::NONE;
 protected: 
     uint32_t executionPeriod = 0;
 public:
@@ -25,6 +27,9 @@ public:
     void Start();   // Pure virtual function
     void Stop();    // Pure virtual function
     void Run();     // Pure virtual function
+
+    // Probe that times OnRun(), see Profiler
+    void SetProfileProbe(ProfileProbe probe) { profileProbe = probe; }
 };
 
 class TaskManager {
@@ -34,6 +39,8 @@ private:
 public:
     // Add a task to the task manager
     void AddTask(ITask* task) {
+        if (tasks.size() < PROFILER_MAX_TASKS)
+            task->SetProfileProbe((ProfileProbe)((uint8_t)ProfileProbe::TASK_0 + tasks.size()));
         tasks.push_back(task);
     }
 
@@ -11,6 +11,7 @@
 #include "EthernetHAT/AxisEthernet.h"
 #include "EthernetHAT/AxisMqtt.h"
 #include "AxisMessages.h"
+#include "Profiler/Profiler.h"
 #include <cstdint>
 #include <cstdio>
 #include "Wire.h"
@@ -64,6 +65,7 @@ DeviceManager deviceManager(0xFFFFFFFF);
 
 void setup()
 {
+  Profiler::Init();
   DEBUG_BEGIN(115200);
   Serial.begin(115200);
 
@@ -0,0 +1,135 @@
+#pragma once
+
+// Minimal Arduino API for running firmware modules on the host with the
+// `native` PlatformIO environment. Time only moves when a test advances it.
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <string>
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define HIGH 0x1
+#define LOW 0x0
+
+#define INPUT 0x0
+#define OUTPUT 0x1
+
+// Board pins used by the motor controller, as in the axis_driver variant.h
+#define STAT_LED (7)
+#define USR_INPUT (30)
+#define MOTOR_EN (8)
+#define MOTOR_DIR (9)
+#define MOTOR_STEP (10)
+#define MOTOR_M1 (11)
+#define MOTOR_M0 (12)
+#define MOTOR_INDEX (13)
+#define MOTOR_DIAG (14)
+#define MOTOR_SPREAD (15)
+#define PIN_VUSB (28ul)
+#define PIN_VBUS (29ul)
+#define NATIVE_HAL_PINS 32
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+using std::max;
+using std::min;
+
+namespace NativeHal
+{
+    inline unsigned long &MicrosCounter()
+    {
+        static unsigned long now_us = 0;
+        return now_us;
+    }
+
+    inline void SetMicros(unsigned long us)
+    {
+        MicrosCounter() = us;
+    }
+
+    inline void AdvanceMicros(unsigned long us)
+    {
+        MicrosCounter() += us;
+    }
+
+    inline uint8_t *PinLevels()
+    {
+        static uint8_t levels[NATIVE_HAL_PINS] = {};
+        return levels;
+    }
+
+    // Called on every digitalWrite(), e.g. to timestamp STEP edges
+    typedef void (*PinWriteHook)(uint8_t pin, uint8_t value);
+
+    inline PinWriteHook &PinHook()
+    {
+        static PinWriteHook hook = nullptr;
+        return hook;
+    }
+
+    inline void SetPinHook(PinWriteHook hook)
+    {
+        PinHook() = hook;
+    }
+}
+
+typedef std::string String;
+
+// Serial ports only exist as a type for the driver to take
+class HardwareSerial
+{
+};
+
+inline HardwareSerial Serial1;
+
+// CPU clock, as CMSIS reports it on the SAMD51
+inline uint32_t SystemCoreClock = 120000000;
+
+inline unsigned long micros()
+{
+    return NativeHal::MicrosCounter();
+}
+
+inline unsigned long millis()
+{
+    return NativeHal::MicrosCounter() / 1000;
+}
+
+inline void delayMicroseconds(unsigned int us)
+{
+    (void)us;
+}
+
+inline void pinMode(uint8_t pin, uint8_t mode)
+{
+    (void)pin;
+    (void)mode;
+}
+
+inline void digitalWrite(uint8_t pin, uint8_t value)
+{
+    if (pin < NATIVE_HAL_PINS)
+        NativeHal::PinLevels()[pin] = value;
+    if (NativeHal::PinHook() != nullptr)
+        NativeHal::PinHook()(pin, value);
+}
+
+inline int digitalRead(uint8_t pin)
+{
+    return pin < NATIVE_HAL_PINS ? NativeHal::PinLevels()[pin] : LOW;
+}
+
+inline int analogRead(uint8_t pin)
+{
+    (void)pin;
+    return 0;
+}
+
+inline void yield()
+{
+}
@@ -0,0 +1,3 @@
+#pragma once
+
+// Host stand-in for ArduinoJson, JSON messages aren't handled yet
@@ -0,0 +1,54 @@
+#pragma once
+
+// Host stand-in for the TLV493D encoder, a shaft that never moves. Keeps the
+// observer settings and the calibration state the message handlers set.
+
+#include "EncoderController/EncoderCalibration.h"
+
+class EncoderController
+{
+public:
+    float GetVelocityDegreesPerSecond() { return 0.0f; }
+    float GetPositionDegrees() { return 0.0f; }
+    float GetUpdateRate() { return 0.0f; }
+
+    bool SetObserver(float alpha, float beta, bool feed_forward)
+    {
+        alpha_ = alpha;
+        beta_ = beta;
+        feed_forward_ = feed_forward;
+        return true;
+    }
+
+    void GetObserver(float &alpha, float &beta, bool &feed_forward)
+    {
+        alpha = alpha_;
+        beta = beta_;
+        feed_forward = feed_forward_;
+    }
+
+    void ClearCalibration() {}
+
+    EncoderCalibrationState GetCalibration(int16_t coefficients[ENCODER_CALIBRATION_HARMONICS][2], float &residual_degrees)
+    {
+        for (uint8_t i = 0; i < ENCODER_CALIBRATION_HARMONICS; i++)
+        {
+            coefficients[i][0] = 0;
+            coefficients[i][1] = 0;
+        }
+        residual_degrees = 0.0f;
+        return EncoderCalibrationState::NONE;
+    }
+
+    void GetBusStats(uint32_t &reads, uint32_t &errors, uint32_t &transfer_mean_us, uint32_t &transfer_max_us, uint32_t &foreground_mean_us)
+    {
+        reads = errors = transfer_mean_us = transfer_max_us = foreground_mean_us = 0;
+    }
+
+private:
+    float alpha_ = 0.5f;
+    float beta_ = 0.1f;
+    bool feed_forward_ = false;
+};
+
+inline EncoderController encoderController;
@@ -0,0 +1,3 @@
+#pragma once
+
+// Host stand-in for the Ethernet library, nothing the message handlers use
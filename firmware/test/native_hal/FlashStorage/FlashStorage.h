@@ -0,0 +1,49 @@
+#pragma once
+
+// Host stand-in for the settings in flash. Settings live in RAM and
+// WriteFlash() only counts the saves.
+
+#include <cstdint>
+
+struct EthernetSettingsStruct
+{
+    uint16_t port;
+    uint32_t ip_address;
+};
+
+struct I2CSettingsStruct
+{
+    uint8_t address;
+};
+
+namespace FlashStorage
+{
+    inline EthernetSettingsStruct *GetEthernetSettings()
+    {
+        static EthernetSettingsStruct settings = {};
+        return &settings;
+    }
+
+    inline I2CSettingsStruct *GetI2CSettings()
+    {
+        static I2CSettingsStruct settings = {};
+        return &settings;
+    }
+
+    inline uint8_t *GetMacAddress()
+    {
+        static uint8_t mac[6] = {};
+        return mac;
+    }
+
+    inline uint32_t &WriteCount()
+    {
+        static uint32_t writes = 0;
+        return writes;
+    }
+
+    inline void WriteFlash()
+    {
+        WriteCount()++;
+    }
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+// Host stand-in for the addressable LED, colours go nowhere but the last one
+// set can be read back
+
+#include <cstdint>
+
+struct CRGB
+{
+    enum HTMLColorCode : uint32_t
+    {
+        Black = 0x000000,
+        Blue = 0x0000FF,
+        Green = 0x008000,
+        Purple = 0x800080,
+        Red = 0xFF0000,
+    };
+
+    uint8_t r;
+    uint8_t g;
+    uint8_t b;
+
+    CRGB(uint32_t colorcode = 0) : r(colorcode >> 16), g(colorcode >> 8), b(colorcode)
+    {
+    }
+
+    CRGB(uint8_t red, uint8_t green, uint8_t blue) : r(red), g(green), b(blue)
+    {
+    }
+};
+
+class AddrLedController
+{
+public:
+    void AddLedStep(CRGB color, uint32_t duration)
+    {
+        (void)color;
+        (void)duration;
+    }
+
+    void SetLEDColor(CRGB color) { color_ = color; }
+    CRGB GetLedColor() { return color_; }
+
+private:
+    CRGB color_;
+};
+
+inline AddrLedController addrLedController;
@@ -0,0 +1,31 @@
+#pragma once
+
+// Host stand-in for the TC4/DMA step engine. Start() always declines, so every
+// move is stepped from OnTimer() where a test can see it.
+
+#include "MotorController/StepIntervalGenerator.h"
+
+class StepPulseEngine
+{
+public:
+    StepIntervalGenerator generator;
+
+    void Init(uint8_t step_pin) { (void)step_pin; }
+    bool Start(long steps)
+    {
+        (void)steps;
+        return false;
+    }
+    void Stop() {}
+    bool Retarget(long steps)
+    {
+        (void)steps;
+        return false;
+    }
+    void Abort() {}
+    void Service() {}
+
+    bool IsBusy() { return false; }
+    bool HadUnderrun() { return false; }
+    long StepsEmitted() { return 0; }
+};
@@ -0,0 +1,85 @@
+#pragma once
+
+// Host stand-in for the TMC2209 UART driver, takes every setting and talks to
+// nothing. Only what MotorController uses.
+
+#include <Arduino.h>
+
+class TMC2209base
+{
+public:
+    enum SerialAddress
+    {
+        SERIAL_ADDRESS_0 = 0,
+        SERIAL_ADDRESS_1 = 1,
+        SERIAL_ADDRESS_2 = 2,
+        SERIAL_ADDRESS_3 = 3,
+    };
+
+    enum StandstillMode
+    {
+        NORMAL = 0,
+        FREEWHEELING = 1,
+        STRONG_BRAKING = 2,
+        BRAKING = 3,
+    };
+
+    struct Status
+    {
+        uint32_t over_temperature_warning : 1;
+        uint32_t over_temperature_shutdown : 1;
+        uint32_t short_to_ground_a : 1;
+        uint32_t short_to_ground_b : 1;
+        uint32_t low_side_short_a : 1;
+        uint32_t low_side_short_b : 1;
+        uint32_t open_load_a : 1;
+        uint32_t open_load_b : 1;
+        uint32_t over_temperature_120c : 1;
+        uint32_t over_temperature_143c : 1;
+        uint32_t over_temperature_150c : 1;
+        uint32_t over_temperature_157c : 1;
+        uint32_t reserved0 : 4;
+        uint32_t current_scaling : 5;
+        uint32_t reserved1 : 9;
+        uint32_t stealth_chop_mode : 1;
+        uint32_t standstill : 1;
+    };
+
+    struct GlobalStatus
+    {
+        uint32_t reset : 1;
+        uint32_t drv_err : 1;
+        uint32_t uv_cp : 1;
+        uint32_t reserved : 29;
+    };
+
+    struct PwmConfig
+    {
+        uint32_t freewheel : 2;
+    };
+
+    PwmConfig pwm_config_ = {};
+
+    void setup(HardwareSerial &serial, long serial_baud_rate = 115200, SerialAddress serial_address = SERIAL_ADDRESS_0)
+    {
+        (void)serial;
+        (void)serial_baud_rate;
+        (void)serial_address;
+    }
+
+    void setRunCurrent(uint8_t percent) { (void)percent; }
+    void setAllCurrentValues(uint8_t run_current_percent, uint8_t hold_current_percent, uint8_t hold_delay_percent)
+    {
+        (void)run_current_percent;
+        (void)hold_current_percent;
+        (void)hold_delay_percent;
+    }
+    void setStandstillMode(StandstillMode mode) { pwm_config_.freewheel = mode; }
+    void setStallGuardThreshold(uint8_t stall_guard_threshold) { (void)stall_guard_threshold; }
+    Status getStatus() { return Status(); }
+    GlobalStatus getGlobalStatus() { return GlobalStatus(); }
+};
+
+class easyTMC2209 : public TMC2209base
+{
+};
@@ -0,0 +1,3 @@
+#pragma once
+
+// Host build: nothing to configure, pin multiplexing is SAMD only
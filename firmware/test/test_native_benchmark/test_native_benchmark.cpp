@@ -0,0 +1,358 @@
+#include <Arduino.h>
+#include <unity.h>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+#include "MotorController/MotorController.h"
+
+// Runs the real MotorController against a model of TC0: every overflow copies
+// CCBUF0 into CC0, moves the clock and calls OnTimer(), the next overflow is
+// CC0 + 1 ticks later. OnRun() gets called in between the way the task loop
+// does. STEP edges are taken off digitalWrite() at the timer tick they happen
+// on, so intervals are as exact as the hardware would make them.
+
+#define TEST_PI 3.14159265358979
+#define TEST_TICKS_PER_US STEP_TIMER_TICKS_PER_US
+
+#define TEST_SPEED 8000.0f        // steps per second
+#define TEST_ACCELERATION 32000.0f // steps per second^2
+#define TEST_JERK 320000.0f       // steps per second^3
+#define TEST_DISTANCE 16000L      // steps
+
+struct StepEdge
+{
+  uint64_t tick;
+  bool forward;
+};
+
+static uint64_t now_tick = 0;
+static std::vector<StepEdge> edges;
+
+static void RecordStep(uint8_t pin, uint8_t value)
+{
+  // DIR is inverted, see setPinsInverted() in MotorController::OnStart()
+  if (pin == MOTOR_STEP && value == HIGH)
+    edges.push_back({now_tick, NativeHal::PinLevels()[MOTOR_DIR] == LOW});
+}
+
+struct BenchResult
+{
+  uint64_t interrupts = 0;
+  double isr_ns = 0.0; // host time spent in OnTimer(), total
+};
+
+// Runs interrupts until `until_us` or until `done` says so, whichever is first
+template <typename Done>
+static BenchResult RunTimer(uint64_t until_us, Done done)
+{
+  BenchResult result;
+  HostStepTimer &timer = GetHostStepTimer();
+  while (now_tick < until_us * TEST_TICKS_PER_US)
+  {
+    if (timer.ccbuf0_valid)
+    {
+      timer.cc0 = timer.ccbuf0;
+      timer.ccbuf0_valid = false;
+    }
+    NativeHal::SetMicros((unsigned long)(now_tick / TEST_TICKS_PER_US));
+
+    auto start = std::chrono::steady_clock::now();
+    motorController.OnTimer();
+    result.isr_ns += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    result.interrupts++;
+
+    now_tick += (uint64_t)timer.cc0 + 1;
+    NativeHal::SetMicros((unsigned long)(now_tick / TEST_TICKS_PER_US));
+    motorController.OnRun();
+    if (done())
+      break;
+  }
+  return result;
+}
+
+static double NowUs()
+{
+  return now_tick / (double)TEST_TICKS_PER_US;
+}
+
+// Ideal time of step n (1..distance) of a rest to rest trapezoid started at
+// t = 0
+static double TrapezoidStepTime(long n, long distance, double v, double a)
+{
+  double ramp_steps = v * v / (2.0 * a);
+  if (2.0 * ramp_steps > distance)
+  {
+    ramp_steps = distance / 2.0;
+    v = sqrt(a * distance);
+  }
+  double ramp_time = v / a;
+  if (n <= ramp_steps)
+    return sqrt(2.0 * n / a);
+  if (n <= distance - ramp_steps)
+    return ramp_time + (n - ramp_steps) / v;
+  double total = 2.0 * ramp_time + (distance - 2.0 * ramp_steps) / v;
+  return total - sqrt(2.0 * (distance - n) / a);
+}
+
+struct EdgeStats
+{
+  double duration_us = 0.0; // first to last step
+  double max_error_us = 0.0; // against the ideal step times
+  double max_jitter_us = 0.0; // interval deviation where the speed is constant
+};
+
+static void PrintRun(const char *name, long steps, const BenchResult &r, const EdgeStats &s)
+{
+  printf("%-14s %6ld steps %8.1f ms  isr %6.0f ns/call %6.0f ns/step  timing error %7.2f us  cruise jitter %5.2f us\n",
+         name, steps, s.duration_us / 1000.0, r.isr_ns / r.interrupts, r.isr_ns / (steps ? steps : 1),
+         s.max_error_us, s.max_jitter_us);
+}
+
+static long NetSteps()
+{
+  long position = 0;
+  for (const StepEdge &e : edges)
+    position += e.forward ? 1 : -1;
+  return position;
+}
+
+static bool InState(MotorStates state)
+{
+  return motorController.GetMotorState() == state;
+}
+
+void setUp(void)
+{
+  NativeHal::SetPinHook(RecordStep);
+  motorController.SetMotorState(MotorStates::IDLE_ON);
+  motorController.SetMotionProfile(MotionProfile::TRAPEZOIDAL);
+  motorController.SetMaxSpeed(TEST_SPEED);
+  motorController.SetAcceleration(TEST_ACCELERATION);
+  motorController.SetPosition(0);
+  // Let the timer fall back to its idle period
+  RunTimer((uint64_t)NowUs() + 5000, []
+           { return false; });
+  edges.clear();
+}
+
+void tearDown(void)
+{
+  NativeHal::SetPinHook(nullptr);
+}
+
+static void RunProfileMove(const char *name, double ideal_duration_us, double max_error_us)
+{
+  motorController.SetPositionTarget(TEST_DISTANCE * 360.0 / 1600.0);
+  BenchResult r = RunTimer((uint64_t)NowUs() + 10000000, []
+                           { return InState(MotorStates::IDLE_ON); });
+
+  TEST_ASSERT_TRUE(InState(MotorStates::IDLE_ON));
+  TEST_ASSERT_EQUAL(TEST_DISTANCE, (long)edges.size());
+  TEST_ASSERT_EQUAL(TEST_DISTANCE, NetSteps());
+  TEST_ASSERT_EQUAL(TEST_DISTANCE, motorController.stepper.currentPosition());
+
+  EdgeStats s;
+  uint64_t first = edges.front().tick;
+  s.duration_us = (edges.back().tick - first) / (double)TEST_TICKS_PER_US;
+  double cruise_us = US_PER_SEC / TEST_SPEED;
+  for (size_t n = 0; n < edges.size(); n++)
+  {
+    double t = (edges[n].tick - first) / (double)TEST_TICKS_PER_US;
+    if (max_error_us > 0)
+    {
+      // Timed from the first step, like the move itself
+      double ideal = TrapezoidStepTime(n + 1, TEST_DISTANCE, TEST_SPEED, TEST_ACCELERATION) -
+                     TrapezoidStepTime(1, TEST_DISTANCE, TEST_SPEED, TEST_ACCELERATION);
+      s.max_error_us = fmax(s.max_error_us, fabs(t - 1e6 * ideal));
+    }
+    // The middle third cruises in both profiles
+    if (n > edges.size() / 3 && n < 2 * edges.size() / 3)
+      s.max_jitter_us = fmax(s.max_jitter_us, fabs((edges[n].tick - edges[n - 1].tick) / (double)TEST_TICKS_PER_US - cruise_us));
+  }
+  PrintRun(name, TEST_DISTANCE, r, s);
+
+  // Within 1% of the analytic duration, cruise within a timer tick and, unless
+  // max_error_us is 0, every step within max_error_us of its analytic time
+  TEST_ASSERT_TRUE(fabs(s.duration_us - ideal_duration_us) < ideal_duration_us * 0.01);
+  TEST_ASSERT_TRUE(s.max_jitter_us <= 1.0 / TEST_TICKS_PER_US + 1e-9);
+  if (max_error_us > 0)
+    TEST_ASSERT_TRUE(s.max_error_us < max_error_us);
+}
+
+void test_benchmark_trapezoid(void)
+{
+  double ideal = TrapezoidStepTime(TEST_DISTANCE, TEST_DISTANCE, TEST_SPEED, TEST_ACCELERATION) -
+                 TrapezoidStepTime(1, TEST_DISTANCE, TEST_SPEED, TEST_ACCELERATION);
+  // Equations 13 and 15 put steps up to about 2.7ms off the exact trapezoid,
+  // a little headroom over that still catches a real regression
+  RunProfileMove("trapezoid", 1e6 * ideal, 3000.0);
+}
+
+void test_benchmark_s_curve(void)
+{
+  TEST_ASSERT_TRUE(motorController.SetMotionProfile(MotionProfile::S_CURVE));
+  TEST_ASSERT_TRUE(motorController.SetJerk(TEST_JERK));
+  // Reaches full speed and acceleration: D / V + V / A + A / J. The first
+  // and last steps fall half a step in, which the jerk phase takes
+  // cbrt(6 * 0.5 / J) to cover.
+  double ideal = TEST_DISTANCE / TEST_SPEED + TEST_SPEED / TEST_ACCELERATION + TEST_ACCELERATION / TEST_JERK -
+                 2.0 * cbrt(3.0 / TEST_JERK);
+  RunProfileMove("s-curve", 1e6 * ideal, 0.0);
+}
+
+void test_benchmark_velocity(void)
+{
+  const double speed = 3000.0;
+  motorController.SetVelocityTarget(speed);
+  BenchResult r = RunTimer((uint64_t)NowUs() + 1000000, []
+                           { return false; });
+  motorController.SetVelocityTarget(0);
+
+  EdgeStats s;
+  s.duration_us = (edges.back().tick - edges.front().tick) / (double)TEST_TICKS_PER_US;
+  for (size_t n = 1; n < edges.size(); n++)
+    s.max_jitter_us = fmax(s.max_jitter_us, fabs((edges[n].tick - edges[n - 1].tick) / (double)TEST_TICKS_PER_US - US_PER_SEC / speed));
+  PrintRun("velocity", edges.size(), r, s);
+
+  // The first step waits for the idle period to end, the rate from there on
+  // is exact to the 1/256us the interval is kept to
+  TEST_ASSERT_TRUE(fabs(s.duration_us - (edges.size() - 1) * US_PER_SEC / speed) <= (edges.size() - 1) / 256.0 + 1.0);
+  TEST_ASSERT_TRUE(labs((long)edges.size() - (long)speed) <= 1 + (long)(speed * 2 * STEP_TIMER_IDLE_PERIOD_US / US_PER_SEC));
+  TEST_ASSERT_TRUE(s.max_jitter_us <= 1.0 / TEST_TICKS_PER_US + 1e-9);
+}
+
+void test_benchmark_velocity_steps(void)
+{
+  TEST_ASSERT_TRUE(motorController.AddVelocityStep(2000, 2000, (uint8_t)PositionMode::RELATIVE));
+  TEST_ASSERT_TRUE(motorController.AddVelocityStep(6000, 6000, (uint8_t)PositionMode::RELATIVE));
+  TEST_ASSERT_TRUE(motorController.AddVelocityStep(3000, -3000, (uint8_t)PositionMode::RELATIVE));
+  motorController.StartPath();
+  long steps = 2000 + 6000 + 3000;
+  BenchResult r = RunTimer((uint64_t)NowUs() + 10000000, [steps]
+                           { return (long)edges.size() >= steps && motorController.velocity_planner.Size() == 0; });
+
+  EdgeStats s;
+  s.duration_us = (edges.back().tick - edges.front().tick) / (double)TEST_TICKS_PER_US;
+  PrintRun("velocity step", edges.size(), r, s);
+
+  TEST_ASSERT_EQUAL(steps, (long)edges.size());
+  TEST_ASSERT_EQUAL(5000, NetSteps());
+  TEST_ASSERT_EQUAL(5000, motorController.stepper.currentPosition());
+}
+
+void test_benchmark_pvt_sine(void)
+{
+  const double amplitude = 400.0;
+  const double frequency = 1.0;
+  const uint32_t point_us = 10000;
+  const int points = 201;
+  auto sine = [&](double t)
+  { return amplitude * sin(2.0 * TEST_PI * frequency * t); };
+  auto sine_velocity = [&](double t)
+  { return amplitude * 2.0 * TEST_PI * frequency * cos(2.0 * TEST_PI * frequency * t); };
+
+  // Points arrive in real time, each one as its own time comes up
+  double start_us = NowUs();
+  int sent = 0;
+  BenchResult total;
+  while (sent < points || InState(MotorStates::PVT))
+  {
+    if (sent < points && NowUs() >= start_us + sent * (double)point_us)
+    {
+      double t = sent * point_us * 1e-6;
+      TEST_ASSERT_TRUE(motorController.AddPvtPoint(sent * point_us, lround(sine(t)), sine_velocity(t)));
+      sent++;
+    }
+    BenchResult r = RunTimer((uint64_t)NowUs() + 500, []
+                             { return true; });
+    total.interrupts += r.interrupts;
+    total.isr_ns += r.isr_ns;
+    if (sent == points && NowUs() > start_us + 1e6 * points * point_us * 1e-6 + 100000)
+      break;
+  }
+
+  // Playback starts one jitter buffer delay after the first point, give or
+  // take the interrupt the buffer ran out on
+  double play_us = edges.front().tick / (double)TEST_TICKS_PER_US;
+  double first_us = start_us + PVT_DEFAULT_DELAY_US;
+  long position = 0;
+  EdgeStats s;
+  for (const StepEdge &e : edges)
+  {
+    position += e.forward ? 1 : -1;
+    double t = (e.tick / (double)TEST_TICKS_PER_US - first_us) * 1e-6;
+    s.max_error_us = fmax(s.max_error_us, fabs(position - sine(t)));
+  }
+  s.duration_us = (edges.back().tick - edges.front().tick) / (double)TEST_TICKS_PER_US;
+  PrintRun("pvt sine", edges.size(), total, s);
+  printf("pvt sine: first step %.0f us after the first point, max position error %.2f steps\n",
+         play_us - start_us, s.max_error_us);
+
+  TEST_ASSERT_EQUAL(0, NetSteps());
+  TEST_ASSERT_EQUAL(0, motorController.stepper.currentPosition());
+  // Peak speed is 2500 steps/s, a couple of steps covers the playback start
+  // landing on the idle interrupt
+  TEST_ASSERT_TRUE(s.max_error_us < 4.0);
+}
+
+// Encoder that follows the motor exactly and keeps the calibration samples,
+// with the step count each one was taken at
+class CalibrationEncoder : public IEncoderInterface
+{
+public:
+  std::vector<std::pair<long, float>> samples;
+  long start = 0;
+  bool finished = false;
+
+  float GetVelocityDegreesPerSecond() override { return 0.0f; }
+  float GetPositionDegrees() override { return motorController.stepper.currentPosition() * 360.0f / (8 * 200); }
+  float GetUpdateRate() override { return 0.0f; }
+  void BeginCalibration() override { start = motorController.stepper.currentPosition(); }
+  void AddCalibrationSample(float reference_degrees) override
+  {
+    samples.push_back({motorController.stepper.currentPosition() - start, reference_degrees});
+  }
+  bool FinishCalibration() override
+  {
+    finished = true;
+    return true;
+  }
+};
+
+void test_calibration_references_follow_steps(void)
+{
+  CalibrationEncoder encoder;
+  motorController.setEncoderValueSource(&encoder);
+  TEST_ASSERT_TRUE(motorController.CalibrateEncoder());
+  RunTimer((uint64_t)NowUs() + 20000000, []
+           { return InState(MotorStates::IDLE_ON); });
+  motorController.setEncoderValueSource(nullptr);
+
+  TEST_ASSERT_TRUE(encoder.finished);
+  TEST_ASSERT_TRUE(encoder.samples.size() > 200);
+  // Every step after the lead-in is 0.225 degrees, not whole degrees
+  long fractional = 0;
+  for (const auto &sample : encoder.samples)
+  {
+    float expected = (sample.first - ENCODER_CALIBRATION_LEAD_IN) * 360.0f / (8 * 200);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4, expected, sample.second);
+    if (fabsf(sample.second - roundf(sample.second)) > 0.01f)
+      fractional++;
+  }
+  TEST_ASSERT_TRUE(fractional > (long)encoder.samples.size() / 2);
+  TEST_ASSERT_FLOAT_WITHIN(0.5, 360.0, encoder.samples.back().second);
+}
+
+int main(int argc, char **argv)
+{
+  motorController.OnStart();
+  UNITY_BEGIN();
+  RUN_TEST(test_benchmark_trapezoid);
+  RUN_TEST(test_benchmark_s_curve);
+  RUN_TEST(test_benchmark_velocity);
+  RUN_TEST(test_benchmark_velocity_steps);
+  RUN_TEST(test_benchmark_pvt_sine);
+  RUN_TEST(test_calibration_references_follow_steps);
+  return UNITY_END();
+}
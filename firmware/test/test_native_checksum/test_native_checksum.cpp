@@ -0,0 +1,99 @@
+#include <unity.h>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+#include "MessageProcessor/Checksum.h"
+
+// Bit at a time CRC-16/CCITT-FALSE, for comparison
+static uint16_t ReferenceCrc16(const uint8_t *data, uint32_t size)
+{
+  uint16_t crc = 0xFFFF;
+  for (uint32_t i = 0; i < size; i++)
+  {
+    crc ^= (uint16_t)(data[i] << 8);
+    for (int bit = 0; bit < 8; bit++)
+      crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+  }
+  return crc;
+}
+
+static std::vector<uint8_t> Pattern(size_t size)
+{
+  std::vector<uint8_t> data(size);
+  uint32_t x = 0x12345678;
+  for (size_t i = 0; i < size; i++)
+  {
+    x = x * 1664525 + 1013904223;
+    data[i] = (uint8_t)(x >> 24);
+  }
+  return data;
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+void test_checksum_crc16_check_value(void)
+{
+  const uint8_t check[] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+  TEST_ASSERT_EQUAL_HEX16(0x29B1, ChecksumCrc16(check, sizeof(check)));
+  TEST_ASSERT_EQUAL_HEX16(0xFFFF, ChecksumCrc16(check, 0));
+  TEST_ASSERT_EQUAL_HEX16(0x29B1, FrameChecksum(ChecksumMode::CRC16, check, sizeof(check)));
+  TEST_ASSERT_EQUAL_HEX16(0x01DD, FrameChecksum(ChecksumMode::SUM, check, sizeof(check)));
+}
+
+void test_checksum_crc16_table_matches_bitwise(void)
+{
+  std::vector<uint8_t> data = Pattern(1024);
+  for (uint32_t size : {1u, 2u, 7u, 64u, 255u, 1024u})
+    TEST_ASSERT_EQUAL_HEX16(ReferenceCrc16(data.data(), size), ChecksumCrc16(data.data(), size));
+}
+
+void test_checksum_crc16_catches_what_the_sum_misses(void)
+{
+  // A SetTargetPosition frame with two body bytes swapped, and with one byte
+  // up by one and the next down by one
+  std::vector<uint8_t> frame = {0x11, 0x03, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x56, 0x40};
+  std::vector<uint8_t> swapped = frame;
+  std::swap(swapped[9], swapped[10]);
+  std::vector<uint8_t> compensated = frame;
+  compensated[10]++;
+  compensated[11]--;
+
+  for (const std::vector<uint8_t> *bad : {&swapped, &compensated})
+  {
+    TEST_ASSERT_EQUAL_HEX16(ChecksumSum(frame.data(), frame.size()), ChecksumSum(bad->data(), bad->size()));
+    TEST_ASSERT_NOT_EQUAL(ChecksumCrc16(frame.data(), frame.size()), ChecksumCrc16(bad->data(), bad->size()));
+  }
+}
+
+void test_checksum_benchmark(void)
+{
+  // Host figures, the device's come from the CHECKSUM profiler probe, see
+  // examples/Python/ChecksumBenchmark.py
+  std::vector<uint8_t> data = Pattern(1024);
+  const int rounds = 20000;
+  for (ChecksumMode mode : {ChecksumMode::SUM, ChecksumMode::CRC16})
+  {
+    volatile uint16_t sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++)
+      sink = sink + FrameChecksum(mode, data.data(), data.size());
+    double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    printf("%-6s %8.1f bytes/us\n", mode == ChecksumMode::SUM ? "sum" : "crc16", rounds * data.size() / us);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_checksum_crc16_check_value);
+  RUN_TEST(test_checksum_crc16_table_matches_bitwise);
+  RUN_TEST(test_checksum_crc16_catches_what_the_sum_misses);
+  RUN_TEST(test_checksum_benchmark);
+  return UNITY_END();
+}
@@ -0,0 +1,189 @@
+#include <Arduino.h>
+#include <unity.h>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "MotorController/ClosedLoopCorrector.h"
+
+#define TEST_STEPS_PER_DEGREE ((200.0 * 8.0) / 360.0)
+#define TEST_ISR_US 100
+#define TEST_ENCODER_RESOLUTION 0.1 // degrees, as EncoderController rounds
+#define TEST_ENCODER_NOISE 0.1      // degrees peak
+#define TEST_ENCODER_HOME 1234.5    // encoder reading with the shaft at step 0
+
+struct SlipEvent
+{
+  double time;
+  long steps; // shaft falls behind the driver by this much
+};
+
+// Stepper with slip. The driver's electrical position is the commanded steps
+// plus the correction steps; the shaft follows it except for the steps it
+// loses. Time runs in step interrupts, the control loop runs every
+// CLOSED_LOOP_PERIOD_US and sees the shaft through a quantized, noisy encoder.
+struct SlipSimulation
+{
+  double speed = 400.0; // commanded steps per second
+  std::vector<SlipEvent> slips;
+  bool closed_loop = true;
+
+  long commanded = 0;
+  long slipped = 0;
+  double max_rate = 0.0;
+  std::vector<double> recovery; // seconds from each slip until back within a step
+
+  long Shaft(ClosedLoopCorrector &corrector) { return commanded + corrector.Offset() - slipped; }
+
+  double Encoder(long shaft)
+  {
+    double degrees = shaft / TEST_STEPS_PER_DEGREE + TEST_ENCODER_HOME;
+    degrees += TEST_ENCODER_NOISE * (2.0 * rand() / RAND_MAX - 1.0);
+    return round(degrees / TEST_ENCODER_RESOLUTION) * TEST_ENCODER_RESOLUTION;
+  }
+
+  void Run(ClosedLoopCorrector &corrector, double duration)
+  {
+    srand(1);
+    NativeHal::SetMicros(1000);
+    corrector.Reset(0.0f, Encoder(0) * TEST_STEPS_PER_DEGREE);
+    size_t next_slip = 0;
+    double slip_time = -1.0;
+    unsigned long next_control = micros();
+    long ticks = (long)(duration * 1e6 / TEST_ISR_US);
+    for (long i = 0; i < ticks; i++)
+    {
+      NativeHal::AdvanceMicros(TEST_ISR_US);
+      double t = i * TEST_ISR_US * 1e-6;
+      commanded = (long)floor(speed * t);
+
+      if (next_slip < slips.size() && t >= slips[next_slip].time)
+      {
+        slipped += slips[next_slip].steps;
+        slip_time = t;
+        next_slip++;
+      }
+
+      bool clockwise;
+      corrector.NextCorrectionStep(micros(), clockwise);
+
+      if (micros() - next_control < 0x80000000UL)
+      {
+        next_control += CLOSED_LOOP_PERIOD_US;
+        if (closed_loop)
+        {
+          float rate = corrector.Update(commanded, Encoder(Shaft(corrector)) * TEST_STEPS_PER_DEGREE);
+          max_rate = fmax(max_rate, fabs(rate));
+        }
+      }
+
+      if (slip_time >= 0.0 && labs(commanded - Shaft(corrector)) <= 1)
+      {
+        recovery.push_back(t - slip_time);
+        slip_time = -1.0;
+      }
+    }
+  }
+};
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+// Two lost electrical cycles while running at speed are pulled back in
+void test_closed_loop_recovers_slip(void)
+{
+  PIDController pid(10, 0.01, 0, 100000, 1000);
+  ClosedLoopCorrector corrector(pid);
+  SlipSimulation sim;
+  sim.slips = {{0.5, 32}, {1.5, 32}};
+  sim.Run(corrector, 3.0);
+
+  printf("recovered in %.3f s and %.3f s, correction %ld steps, max rate %.0f steps/s\n",
+         sim.recovery[0], sim.recovery[1], corrector.Offset(), sim.max_rate);
+  TEST_ASSERT_EQUAL(2, sim.recovery.size());
+  TEST_ASSERT_TRUE(sim.recovery[0] < 0.5);
+  TEST_ASSERT_TRUE(sim.recovery[1] < 0.5);
+  TEST_ASSERT_TRUE(labs(sim.commanded - sim.Shaft(corrector)) <= 1);
+  TEST_ASSERT_TRUE(labs(corrector.Offset() - 64) <= 1);
+  TEST_ASSERT_TRUE(sim.max_rate <= 1000.0);
+}
+
+// The same run open loop keeps the error
+void test_open_loop_keeps_slip(void)
+{
+  PIDController pid(10, 0.01, 0, 100000, 1000);
+  ClosedLoopCorrector corrector(pid);
+  SlipSimulation sim;
+  sim.slips = {{0.5, 32}, {1.5, 32}};
+  sim.closed_loop = false;
+  sim.Run(corrector, 3.0);
+  TEST_ASSERT_EQUAL(64, sim.commanded - sim.Shaft(corrector));
+  TEST_ASSERT_EQUAL(0, corrector.Offset());
+}
+
+// Encoder noise inside the deadband doesn't move the motor
+void test_closed_loop_ignores_noise(void)
+{
+  PIDController pid(10, 0.01, 0, 100000, 1000);
+  ClosedLoopCorrector corrector(pid);
+  SlipSimulation sim;
+  sim.Run(corrector, 2.0);
+  TEST_ASSERT_EQUAL(0, corrector.Offset());
+  // Whatever the odd noise spike left in the integral is far below a step
+  TEST_ASSERT_TRUE(fabsf(corrector.Rate()) < 0.1f);
+}
+
+// A disturbance at standstill, corrected no faster than the limit allows
+void test_closed_loop_limits_rate(void)
+{
+  PIDController pid(10, 0.01, 0, 100000, 200);
+  ClosedLoopCorrector corrector(pid);
+  SlipSimulation sim;
+  sim.speed = 0.0;
+  sim.slips = {{0.2, -100}};
+  sim.Run(corrector, 2.0);
+
+  printf("standstill: recovered in %.3f s, max rate %.0f steps/s\n", sim.recovery[0], sim.max_rate);
+  TEST_ASSERT_EQUAL(1, sim.recovery.size());
+  TEST_ASSERT_TRUE(sim.max_rate <= 200.0);
+  TEST_ASSERT_TRUE(sim.recovery[0] >= 99.0 / 200.0);
+  TEST_ASSERT_TRUE(labs(corrector.Offset() + 100) <= 1);
+}
+
+void test_closed_loop_reset_realigns(void)
+{
+  PIDController pid(10, 0.01, 0, 100000, 1000);
+  ClosedLoopCorrector corrector(pid);
+  NativeHal::SetMicros(0);
+  corrector.Reset(100.0f, 5000.0f);
+  bool clockwise;
+  TEST_ASSERT_FALSE(corrector.NextCorrectionStep(micros(), clockwise));
+  NativeHal::AdvanceMicros(CLOSED_LOOP_PERIOD_US);
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, corrector.Update(100.0f, 5000.0f));
+  NativeHal::AdvanceMicros(CLOSED_LOOP_PERIOD_US);
+  corrector.Update(100.0f, 4990.0f);
+  TEST_ASSERT_EQUAL_FLOAT(10.0f, corrector.Error());
+  TEST_ASSERT_TRUE(corrector.Rate() > 0.0f);
+
+  corrector.Reset(0.0f, 0.0f);
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, corrector.Rate());
+  NativeHal::AdvanceMicros(100);
+  TEST_ASSERT_FALSE(corrector.NextCorrectionStep(micros(), clockwise));
+  TEST_ASSERT_EQUAL(0, corrector.Offset());
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_closed_loop_recovers_slip);
+  RUN_TEST(test_open_loop_keeps_slip);
+  RUN_TEST(test_closed_loop_ignores_noise);
+  RUN_TEST(test_closed_loop_limits_rate);
+  RUN_TEST(test_closed_loop_reset_realigns);
+  return UNITY_END();
+}
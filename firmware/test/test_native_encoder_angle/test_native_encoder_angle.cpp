@@ -0,0 +1,181 @@
+#include <unity.h>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include "EncoderController/EncoderAngle.h"
+
+#define TEST_PI 3.14159265358979
+#define TEST_FIELD_MAX 2047 // 12 bit sensor
+
+// atan2() in angle units, 0 to 65536
+static double ReferenceUnits(int y, int x)
+{
+  double a = atan2((double)y, (double)x) * ANGLE_UNITS_PER_TURN / (2.0 * TEST_PI);
+  return a < 0.0 ? a + ANGLE_UNITS_PER_TURN : a;
+}
+
+// Signed distance the short way round
+static double UnitError(uint16_t angle, double reference)
+{
+  double e = angle - reference;
+  if (e > ANGLE_UNITS_PER_TURN / 2)
+    e -= ANGLE_UNITS_PER_TURN;
+  if (e < -ANGLE_UNITS_PER_TURN / 2)
+    e += ANGLE_UNITS_PER_TURN;
+  return e;
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+void test_axes_and_diagonals_are_exact(void)
+{
+  TEST_ASSERT_EQUAL_UINT16(0, FixedAtan2(0, 0));
+  TEST_ASSERT_EQUAL_UINT16(0, FixedAtan2(0, 100));
+  TEST_ASSERT_EQUAL_UINT16(16384, FixedAtan2(100, 0));
+  TEST_ASSERT_EQUAL_UINT16(32768, FixedAtan2(0, -100));
+  TEST_ASSERT_EQUAL_UINT16(49152, FixedAtan2(-100, 0));
+  TEST_ASSERT_EQUAL_UINT16(8192, FixedAtan2(100, 100));
+  TEST_ASSERT_EQUAL_UINT16(24576, FixedAtan2(100, -100));
+  TEST_ASSERT_EQUAL_UINT16(40960, FixedAtan2(-100, -100));
+  TEST_ASSERT_EQUAL_UINT16(57344, FixedAtan2(-100, 100));
+  TEST_ASSERT_EQUAL_UINT16(40960, FixedAtan2(-32768, -32768));
+}
+
+void test_matches_libm_over_the_sensor_range(void)
+{
+  // Every field the sensor can report, skipping the ones too weak to give an
+  // angle at all
+  double max_error = 0.0;
+  double total_error = 0.0;
+  long count = 0;
+  for (int y = -TEST_FIELD_MAX - 1; y <= TEST_FIELD_MAX; y++)
+  {
+    for (int x = -TEST_FIELD_MAX - 1; x <= TEST_FIELD_MAX; x++)
+    {
+      if (x * x + y * y < 16 * 16)
+        continue;
+      double e = fabs(UnitError(FixedAtan2(y, x), ReferenceUnits(y, x)));
+      if (e > max_error)
+        max_error = e;
+      total_error += e;
+      count++;
+    }
+  }
+  printf("FixedAtan2: %ld vectors, max error %.3f units (%.5f degrees), mean %.3f units\n",
+         count, max_error, max_error * 360.0 / ANGLE_UNITS_PER_TURN, total_error / count);
+  TEST_ASSERT_TRUE(max_error <= 1.0);
+}
+
+void test_full_scale_inputs(void)
+{
+  double max_error = 0.0;
+  for (int i = 0; i < 65536; i++)
+  {
+    double a = i * 2.0 * TEST_PI / 65536.0;
+    int16_t x = (int16_t)lround(32767.0 * cos(a));
+    int16_t y = (int16_t)lround(32767.0 * sin(a));
+    double e = fabs(UnitError(FixedAtan2(y, x), ReferenceUnits(y, x)));
+    if (e > max_error)
+      max_error = e;
+  }
+  TEST_ASSERT_TRUE(max_error <= 1.0);
+}
+
+void test_tracker_counts_turns(void)
+{
+  AngleTracker tracker;
+  // Ten turns forward and twelve back in 1 degree steps
+  double degrees = 123.0;
+  tracker.Update((uint16_t)lround(degrees / 360.0 * ANGLE_UNITS_PER_TURN));
+  for (int i = 0; i < 3600; i++)
+  {
+    degrees += 1.0;
+    tracker.Update((uint16_t)(lround(degrees / 360.0 * ANGLE_UNITS_PER_TURN) & 0xFFFF));
+  }
+  TEST_ASSERT_FLOAT_WITHIN(0.5, 3723.0, AngleUnitsToDegrees(tracker.Position()));
+  for (int i = 0; i < 4320; i++)
+  {
+    degrees -= 1.0;
+    tracker.Update((uint16_t)(lround(degrees / 360.0 * ANGLE_UNITS_PER_TURN) & 0xFFFF));
+  }
+  TEST_ASSERT_FLOAT_WITHIN(0.5, -597.0, AngleUnitsToDegrees(tracker.Position()));
+}
+
+void test_tracker_window_holds_still_through_noise(void)
+{
+  AngleTracker tracker;
+  const uint16_t center = 65500; // right at the wrap
+  srand(1);
+  tracker.Update(center);
+  int64_t lowest = tracker.Position(), highest = tracker.Position();
+  for (int i = 0; i < 10000; i++)
+  {
+    int noise = rand() % (2 * ANGLE_WINDOW_RADIUS + 1) - ANGLE_WINDOW_RADIUS;
+    tracker.Update((uint16_t)(center + noise));
+    if (tracker.Position() < lowest)
+      lowest = tracker.Position();
+    if (tracker.Position() > highest)
+      highest = tracker.Position();
+  }
+  // Stays on the first turn, within the noise
+  TEST_ASSERT_TRUE(lowest >= center - ANGLE_WINDOW_RADIUS);
+  TEST_ASSERT_TRUE(highest <= center + ANGLE_WINDOW_RADIUS);
+
+  tracker.Reset();
+  TEST_ASSERT_EQUAL(1000, (long)tracker.Update(1000));
+}
+
+// The float pipeline FixedAtan2() and AngleTracker replace
+static float FloatDegrees(int16_t y, int16_t x)
+{
+  float a = fmodf(atan2f(y, x) * (180.0f / (float)TEST_PI), 360.0f);
+  if (a < 0)
+    a += 360.0f;
+  return roundf(a * 10.0f) / 10.0f;
+}
+
+void test_benchmark(void)
+{
+  // Host times only show the relative cost, on the SAMD51 read the
+  // ENCODER_ANGLE probe with GetProfileId
+  const int n = 1 << 20;
+  static int16_t xs[1 << 10], ys[1 << 10];
+  for (int i = 0; i < 1 << 10; i++)
+  {
+    xs[i] = (int16_t)(rand() % 4096 - 2048);
+    ys[i] = (int16_t)(rand() % 4096 - 2048);
+  }
+
+  volatile uint32_t fixed_sink = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < n; i++)
+    fixed_sink = fixed_sink + FixedAtan2(ys[i & 1023], xs[i & 1023]);
+  double fixed_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / n;
+
+  volatile float float_sink = 0;
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < n; i++)
+    float_sink = float_sink + FloatDegrees(ys[i & 1023], xs[i & 1023]);
+  double float_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / n;
+
+  printf("FixedAtan2 %.1f ns/call, atan2f + degrees + fmodf + roundf %.1f ns/call\n", fixed_ns, float_ns);
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_axes_and_diagonals_are_exact);
+  RUN_TEST(test_matches_libm_over_the_sensor_range);
+  RUN_TEST(test_full_scale_inputs);
+  RUN_TEST(test_tracker_counts_turns);
+  RUN_TEST(test_tracker_window_holds_still_through_noise);
+  RUN_TEST(test_benchmark);
+  return UNITY_END();
+}
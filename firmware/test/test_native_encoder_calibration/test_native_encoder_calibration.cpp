@@ -0,0 +1,150 @@
+#include <unity.h>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include "EncoderController/EncoderAngle.h"
+#include "EncoderController/EncoderCalibration.h"
+
+// A turn of a misaligned magnet: the sensor angle is off by a once and a
+// twice per turn error plus noise, the reference is the step counter at 200
+// steps per turn and 8 microsteps, as MotorController::CalibrateEncoder() runs
+// it.
+
+#define TEST_PI 3.14159265358979
+#define TEST_STEPS_PER_TURN 1600
+#define TEST_FIRST_HARMONIC 1.5  // degrees
+#define TEST_SECOND_HARMONIC 0.7 // degrees
+#define TEST_NOISE 0.1           // degrees rms
+#define TEST_HOME 123.4          // sensor angle at step 0
+
+static double SensorError(double degrees)
+{
+  double a = degrees * TEST_PI / 180.0;
+  return TEST_FIRST_HARMONIC * sin(a + 0.4) + TEST_SECOND_HARMONIC * cos(2 * a - 1.1);
+}
+
+static uint16_t ToUnits(double degrees)
+{
+  return (uint16_t)(lround(degrees / 360.0 * ANGLE_UNITS_PER_TURN) & 0xFFFF);
+}
+
+static double UnitsError(uint16_t a, uint16_t b)
+{
+  return (int16_t)(a - b) * 360.0 / ANGLE_UNITS_PER_TURN;
+}
+
+// One turn sampled `per_step` times a step, `direction` the way the sensor
+// turns with the steps
+static void RunTurn(EncoderCalibration &calibration, int per_step, int direction)
+{
+  std::mt19937 rng(3);
+  std::normal_distribution<double> noise(0.0, TEST_NOISE);
+  calibration.BeginRun();
+  for (int i = 0; i < TEST_STEPS_PER_TURN * per_step; i++)
+  {
+    double step_degrees = i * 360.0 / (TEST_STEPS_PER_TURN * per_step);
+    double shaft = TEST_HOME + direction * step_degrees;
+    double sensor = shaft + SensorError(shaft) + noise(rng);
+    calibration.AddSample(ToUnits(sensor), ToUnits(step_degrees));
+  }
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+void test_fit_removes_the_harmonic_error(void)
+{
+  EncoderCalibration calibration;
+  RunTurn(calibration, 2, 1);
+  int16_t coefficients[ENCODER_CALIBRATION_HARMONICS][2];
+  TEST_ASSERT_TRUE(calibration.Fit(coefficients));
+  calibration.Load(coefficients);
+  TEST_ASSERT_TRUE(calibration.IsLoaded());
+
+  // Compare against the shaft over a turn, after taking out the constant
+  // offset the home position absorbs
+  double before = 0.0, after = 0.0, offset = 0.0;
+  const int n = 3600;
+  double errors[n];
+  for (int i = 0; i < n; i++)
+  {
+    double shaft = i * 0.1;
+    uint16_t raw = ToUnits(shaft + SensorError(shaft));
+    errors[i] = UnitsError(calibration.Correct(raw), ToUnits(shaft));
+    offset += errors[i] / n;
+    before = fmax(before, fabs(UnitsError(raw, ToUnits(shaft))));
+  }
+  for (int i = 0; i < n; i++)
+    after = fmax(after, fabs(errors[i] - offset));
+  printf("calibration: peak error %.3f degrees before, %.3f after, fit residual %.4f degrees\n",
+         before, after, calibration.Residual() * 360.0 / ANGLE_UNITS_PER_TURN);
+  TEST_ASSERT_TRUE(before > 1.5);
+  TEST_ASSERT_TRUE(after < 0.05);
+}
+
+void test_partial_turn_is_rejected(void)
+{
+  EncoderCalibration calibration;
+  calibration.BeginRun();
+  for (int i = 0; i < 1000; i++)
+    calibration.AddSample(ToUnits(i * 0.3), ToUnits(i * 0.3));
+  int16_t coefficients[ENCODER_CALIBRATION_HARMONICS][2] = {{7, 7}};
+  TEST_ASSERT_FALSE(calibration.Fit(coefficients));
+  TEST_ASSERT_EQUAL(7, coefficients[0][0]);
+}
+
+void test_reversed_sensor_is_rejected(void)
+{
+  // Sensor and steps turning opposite ways isn't a harmonic error
+  EncoderCalibration calibration;
+  RunTurn(calibration, 2, -1);
+  int16_t coefficients[ENCODER_CALIBRATION_HARMONICS][2];
+  TEST_ASSERT_FALSE(calibration.Fit(coefficients));
+}
+
+void test_correction_is_identity_until_loaded(void)
+{
+  EncoderCalibration calibration;
+  for (uint32_t raw = 0; raw < 65536; raw += 97)
+    TEST_ASSERT_EQUAL_UINT16(raw, calibration.Correct((uint16_t)raw));
+
+  int16_t coefficients[ENCODER_CALIBRATION_HARMONICS][2] = {{100, -50}, {20, 0}};
+  calibration.Load(coefficients);
+  TEST_ASSERT_TRUE(calibration.Correct(0) != 0);
+  calibration.Clear();
+  TEST_ASSERT_EQUAL_UINT16(1234, calibration.Correct(1234));
+}
+
+void test_storage_round_trip(void)
+{
+  int16_t coefficients[ENCODER_CALIBRATION_HARMONICS][2] = {{100, -50}, {20, 0}, {-3, 4}, {1, -1}};
+  EncoderCalibrationStruct stored;
+  EncoderCalibration::Pack(coefficients, stored);
+  int16_t loaded[ENCODER_CALIBRATION_HARMONICS][2] = {};
+  TEST_ASSERT_TRUE(EncoderCalibration::Unpack(stored, loaded));
+  TEST_ASSERT_EQUAL_MEMORY(coefficients, loaded, sizeof(coefficients));
+
+  // Blank EEPROM and a flipped bit
+  EncoderCalibrationStruct blank;
+  memset(&blank, 0xFF, sizeof(blank));
+  TEST_ASSERT_FALSE(EncoderCalibration::Unpack(blank, loaded));
+  stored.coefficients[2][1] ^= 0x10;
+  TEST_ASSERT_FALSE(EncoderCalibration::Unpack(stored, loaded));
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_fit_removes_the_harmonic_error);
+  RUN_TEST(test_partial_turn_is_rejected);
+  RUN_TEST(test_reversed_sensor_is_rejected);
+  RUN_TEST(test_correction_is_identity_until_loaded);
+  RUN_TEST(test_storage_round_trip);
+  return UNITY_END();
+}
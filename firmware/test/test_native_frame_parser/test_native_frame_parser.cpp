@@ -0,0 +1,170 @@
+#include <unity.h>
+#include <string.h>
+#include <vector>
+#include "MessageProcessor/FrameParser.h"
+#include "MessageProcessor/Checksum.h"
+
+// A frame of `type` with `body_size` bytes of body counting up from `seed`
+static std::vector<uint8_t> Frame(uint16_t type, uint16_t body_size, uint8_t seed = 0,
+                                  ChecksumMode mode = ChecksumMode::SUM)
+{
+  std::vector<uint8_t> frame(sizeof(Header) + body_size + sizeof(Footer));
+  memcpy(&frame[0], &type, 2);
+  memcpy(&frame[2], &body_size, 2);
+  for (uint16_t i = 0; i < body_size; i++)
+    frame[sizeof(Header) + i] = (uint8_t)(seed + i);
+  uint16_t checksum = FrameChecksum(mode, frame.data(), frame.size() - sizeof(Footer));
+  memcpy(&frame[frame.size() - sizeof(Footer)], &checksum, 2);
+  return frame;
+}
+
+static void Append(std::vector<uint8_t> &stream, const std::vector<uint8_t> &bytes)
+{
+  stream.insert(stream.end(), bytes.begin(), bytes.end());
+}
+
+// Feeds `stream` in pieces of `chunk` bytes and collects the batches
+static std::vector<uint8_t> Feed(FrameParser &parser, const std::vector<uint8_t> &stream, size_t chunk,
+                                 int *batches = nullptr)
+{
+  std::vector<uint8_t> out;
+  size_t offset = 0;
+  while (offset < stream.size())
+  {
+    size_t n = stream.size() - offset < chunk ? stream.size() - offset : chunk;
+    offset += parser.Push(&stream[offset], (uint16_t)n);
+    const uint8_t *frames;
+    uint16_t size = parser.Peek(&frames);
+    if (size > 0)
+    {
+      out.insert(out.end(), frames, frames + size);
+      parser.Pop();
+      if (batches != nullptr)
+        (*batches)++;
+    }
+  }
+  return out;
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+void test_frame_parser_reassembles_split_frames(void)
+{
+  FrameParser parser;
+  std::vector<uint8_t> stream;
+  for (int i = 0; i < 20; i++)
+    Append(stream, Frame(0x0311, 8, (uint8_t)i));
+  for (size_t chunk : {1, 3, 7, 64})
+  {
+    std::vector<uint8_t> out = Feed(parser, stream, chunk);
+    TEST_ASSERT_EQUAL(stream.size(), out.size());
+    TEST_ASSERT_EQUAL_MEMORY(stream.data(), out.data(), stream.size());
+    TEST_ASSERT_EQUAL_UINT16(0, parser.Pending());
+  }
+  TEST_ASSERT_EQUAL_UINT32(0, parser.Dropped());
+}
+
+void test_frame_parser_batches_pipelined_frames(void)
+{
+  // Hundreds of commands in a few reads come out a read at a time
+  FrameParser parser;
+  std::vector<uint8_t> stream;
+  for (int i = 0; i < 300; i++)
+    Append(stream, Frame(0x0308, 0));
+  int batches = 0;
+  std::vector<uint8_t> out = Feed(parser, stream, 256, &batches);
+  TEST_ASSERT_EQUAL(stream.size(), out.size());
+  TEST_ASSERT_EQUAL(8, batches);
+}
+
+void test_frame_parser_resyncs_after_noise(void)
+{
+  FrameParser parser;
+  std::vector<uint8_t> good = Frame(0x030B, 4, 9);
+  std::vector<uint8_t> corrupt = Frame(0x030B, 4, 9);
+  corrupt[6] ^= 0x40;
+  std::vector<uint8_t> stream = {0x55, 0x01, 0xFF, 0xFF}; // header of a frame too big for the buffer
+  Append(stream, good);
+  Append(stream, corrupt);
+  Append(stream, good);
+
+  // The corrupted frame's bytes can pass for the start of a long frame that
+  // hides the last one until the stream goes quiet
+  std::vector<uint8_t> out = Feed(parser, stream, 5);
+  parser.Reset();
+  const uint8_t *frames;
+  uint16_t size = parser.Peek(&frames);
+  out.insert(out.end(), frames, frames + size);
+  parser.Pop();
+
+  std::vector<uint8_t> expected = good;
+  Append(expected, good);
+  TEST_ASSERT_EQUAL(expected.size(), out.size());
+  TEST_ASSERT_EQUAL_MEMORY(expected.data(), out.data(), expected.size());
+  TEST_ASSERT_EQUAL_UINT32(4 + corrupt.size(), parser.Dropped());
+  TEST_ASSERT_EQUAL_UINT16(0, parser.Pending());
+}
+
+void test_frame_parser_takes_either_footer(void)
+{
+  FrameParser parser;
+  std::vector<uint8_t> stream = Frame(0x0311, 8, 1, ChecksumMode::CRC16);
+  Append(stream, Frame(0x0311, 8, 2, ChecksumMode::SUM));
+  std::vector<uint8_t> out = Feed(parser, stream, 3);
+  TEST_ASSERT_EQUAL(stream.size(), out.size());
+  TEST_ASSERT_EQUAL_UINT32(0, parser.Dropped());
+}
+
+void test_frame_parser_reset_drops_partial_frame(void)
+{
+  FrameParser parser;
+  std::vector<uint8_t> first = Frame(0x0311, 8, 1);
+  std::vector<uint8_t> good = Frame(0x0311, 8, 2);
+  std::vector<uint8_t> stream(first.begin(), first.begin() + 5);
+  TEST_ASSERT_EQUAL_UINT16(5, parser.Push(stream.data(), 5));
+  TEST_ASSERT_EQUAL_UINT16(5, parser.Pending());
+  parser.Reset();
+  const uint8_t *frames;
+  TEST_ASSERT_EQUAL_UINT16(0, parser.Peek(&frames));
+  TEST_ASSERT_EQUAL_UINT16(0, parser.Pending());
+  TEST_ASSERT_EQUAL_UINT32(5, parser.Dropped());
+
+  std::vector<uint8_t> out = Feed(parser, good, 4);
+  TEST_ASSERT_EQUAL_MEMORY(good.data(), out.data(), good.size());
+}
+
+void test_frame_parser_largest_frame(void)
+{
+  FrameParser parser;
+  std::vector<uint8_t> big = Frame(0x0311, FRAME_PARSER_SIZE - sizeof(Header) - sizeof(Footer), 3);
+  std::vector<uint8_t> stream = Frame(0x0308, 0);
+  Append(stream, big);
+  Append(stream, Frame(0x0308, 0));
+  std::vector<uint8_t> out = Feed(parser, stream, 100);
+  TEST_ASSERT_EQUAL(stream.size(), out.size());
+  TEST_ASSERT_EQUAL_MEMORY(stream.data(), out.data(), stream.size());
+
+  // Frames waiting for Pop() hold the bytes behind them back
+  TEST_ASSERT_EQUAL_UINT16(FRAME_PARSER_SIZE, parser.Push(big.data(), (uint16_t)big.size()));
+  TEST_ASSERT_EQUAL_UINT16(0, parser.Push(big.data(), 1));
+  parser.Pop();
+  TEST_ASSERT_EQUAL_UINT16(1, parser.Push(big.data(), 1));
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_frame_parser_reassembles_split_frames);
+  RUN_TEST(test_frame_parser_batches_pipelined_frames);
+  RUN_TEST(test_frame_parser_resyncs_after_noise);
+  RUN_TEST(test_frame_parser_takes_either_footer);
+  RUN_TEST(test_frame_parser_reset_drops_partial_frame);
+  RUN_TEST(test_frame_parser_largest_frame);
+  return UNITY_END();
+}
@@ -0,0 +1,167 @@
+#include <unity.h>
+#include <string.h>
+#include <vector>
+#include "MessageProcessor/MessageProcessor.hpp"
+#include "FlashStorage/FlashStorage.h"
+
+// Interface that keeps every frame sent to it. `sender` plays the host the
+// current message came from, as AxisEthernet's address and port would.
+class CaptureInterface : public IExternalInterface
+{
+public:
+  std::vector<std::vector<uint8_t>> sent;
+  uint64_t sender = 0;
+
+  void SendMsg(uint8_t *send_bytes, uint32_t send_bytes_size) override
+  {
+    sent.push_back(std::vector<uint8_t>(send_bytes, send_bytes + send_bytes_size));
+  }
+
+  uint64_t Sender() override { return sender; }
+};
+
+// A frame of `type` with `body`, and the request id after it if `has_id`
+static std::vector<uint8_t> Frame(MessageTypes type, const std::vector<uint8_t> &body,
+                                  bool has_id = false, uint16_t request_id = 0)
+{
+  Header hdr;
+  hdr.message_type = (uint16_t)type | (has_id ? REQUEST_ID_FLAG : 0);
+  hdr.body_size = body.size() + (has_id ? sizeof(uint16_t) : 0);
+  std::vector<uint8_t> frame(sizeof(Header) + hdr.body_size + sizeof(Footer));
+  memcpy(&frame[0], &hdr, sizeof(Header));
+  std::copy(body.begin(), body.end(), frame.begin() + sizeof(Header));
+  if (has_id)
+    memcpy(&frame[sizeof(Header) + body.size()], &request_id, sizeof(uint16_t));
+  uint16_t checksum = FrameChecksum(ChecksumMode::SUM, frame.data(), frame.size() - sizeof(Footer));
+  memcpy(&frame[frame.size() - sizeof(Footer)], &checksum, sizeof(Footer));
+  return frame;
+}
+
+static std::vector<uint8_t> U32Body(uint32_t value)
+{
+  return std::vector<uint8_t>((uint8_t *)&value, (uint8_t *)&value + sizeof(value));
+}
+
+static void Send(MessageProcessor &processor, CaptureInterface &host, std::vector<uint8_t> frame)
+{
+  processor.HandleIncomingMsg(frame.data(), frame.size(), &host);
+}
+
+struct Ack
+{
+  uint16_t acked_type;
+  StatusCodes status;
+  bool has_id;
+  uint16_t request_id;
+};
+
+// The last frame `host` got, which must be an ACK with a valid footer
+static void LastAck(CaptureInterface &host, Ack &ack)
+{
+  TEST_ASSERT_TRUE(host.sent.size() > 0);
+  const std::vector<uint8_t> &frame = host.sent.back();
+  Header hdr;
+  memcpy(&hdr, frame.data(), sizeof(Header));
+  TEST_ASSERT_EQUAL_UINT16((uint16_t)MessageTypes::AckId, hdr.message_type & ~REQUEST_ID_FLAG);
+  uint16_t checksum;
+  memcpy(&checksum, &frame[frame.size() - sizeof(Footer)], sizeof(Footer));
+  TEST_ASSERT_EQUAL_UINT16(FrameChecksum(ChecksumMode::SUM, frame.data(), frame.size() - sizeof(Footer)), checksum);
+
+  memcpy(&ack.acked_type, &frame[sizeof(Header)], sizeof(uint16_t));
+  ack.status = (StatusCodes)frame[sizeof(Header) + sizeof(uint16_t)];
+  ack.has_id = (hdr.message_type & REQUEST_ID_FLAG) != 0;
+  ack.request_id = 0;
+  if (ack.has_id)
+    memcpy(&ack.request_id, &frame[frame.size() - sizeof(Footer) - sizeof(uint16_t)], sizeof(uint16_t));
+}
+
+void setUp(void)
+{
+  FlashStorage::GetEthernetSettings()->port = 0;
+}
+
+void tearDown(void)
+{
+}
+
+void test_dispatch_runs_handler_and_acks(void)
+{
+  MessageProcessor processor(0);
+  CaptureInterface host;
+
+  Send(processor, host, Frame(MessageTypes::SetEthernetPortId, U32Body(8080)));
+  TEST_ASSERT_EQUAL_UINT16(8080, FlashStorage::GetEthernetSettings()->port);
+  Ack ack;
+  LastAck(host, ack);
+  TEST_ASSERT_EQUAL_UINT16((uint16_t)MessageTypes::SetEthernetPortId, ack.acked_type);
+  TEST_ASSERT_EQUAL_UINT8((uint8_t)StatusCodes::SUCCESS, (uint8_t)ack.status);
+  TEST_ASSERT_FALSE(ack.has_id);
+}
+
+void test_request_id_is_echoed(void)
+{
+  MessageProcessor processor(0);
+  CaptureInterface host;
+
+  Send(processor, host, Frame(MessageTypes::SetEthernetPortId, U32Body(8080), true, 0x1234));
+  Ack ack;
+  LastAck(host, ack);
+  TEST_ASSERT_TRUE(ack.has_id);
+  TEST_ASSERT_EQUAL_UINT16(0x1234, ack.request_id);
+  TEST_ASSERT_EQUAL_UINT16((uint16_t)MessageTypes::SetEthernetPortId, ack.acked_type);
+}
+
+void test_retry_is_answered_without_running(void)
+{
+  MessageProcessor processor(0);
+  CaptureInterface host;
+
+  Send(processor, host, Frame(MessageTypes::SetEthernetPortId, U32Body(100), true, 7));
+  TEST_ASSERT_EQUAL_UINT16(100, FlashStorage::GetEthernetSettings()->port);
+  FlashStorage::GetEthernetSettings()->port = 0;
+
+  // Same host, id, type and body: the kept ack, the port stays untouched
+  Send(processor, host, Frame(MessageTypes::SetEthernetPortId, U32Body(100), true, 7));
+  TEST_ASSERT_EQUAL_UINT16(0, FlashStorage::GetEthernetSettings()->port);
+  TEST_ASSERT_EQUAL_UINT32(2, host.sent.size());
+  Ack ack;
+  LastAck(host, ack);
+  TEST_ASSERT_EQUAL_UINT16(7, ack.request_id);
+  TEST_ASSERT_EQUAL_UINT8((uint8_t)StatusCodes::SUCCESS, (uint8_t)ack.status);
+}
+
+void test_reused_id_with_new_body_runs(void)
+{
+  MessageProcessor processor(0);
+  CaptureInterface host;
+
+  // A restarted host counting from the same id again
+  Send(processor, host, Frame(MessageTypes::SetEthernetPortId, U32Body(100), true, 0));
+  Send(processor, host, Frame(MessageTypes::SetEthernetPortId, U32Body(500), true, 0));
+  TEST_ASSERT_EQUAL_UINT16(500, FlashStorage::GetEthernetSettings()->port);
+}
+
+void test_same_id_from_other_host_runs(void)
+{
+  MessageProcessor processor(0);
+  CaptureInterface host;
+
+  host.sender = 1;
+  Send(processor, host, Frame(MessageTypes::SetEthernetPortId, U32Body(100), true, 3));
+  FlashStorage::GetEthernetSettings()->port = 0;
+  // Another host behind the same interface, same id, type and body
+  host.sender = 2;
+  Send(processor, host, Frame(MessageTypes::SetEthernetPortId, U32Body(100), true, 3));
+  TEST_ASSERT_EQUAL_UINT16(100, FlashStorage::GetEthernetSettings()->port);
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_dispatch_runs_handler_and_acks);
+  RUN_TEST(test_request_id_is_echoed);
+  RUN_TEST(test_retry_is_answered_without_running);
+  RUN_TEST(test_reused_id_with_new_body_runs);
+  RUN_TEST(test_same_id_from_other_host_runs);
+  return UNITY_END();
+}
@@ -0,0 +1,867 @@
+#include <Arduino.h>
+#include <unity.h>
+#include <chrono>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include "MotorController/AccelStepper.h"
+#include "MotorController/StepIntervalGenerator.h"
+#include "MotorController/StepTimerSchedule.h"
+#include "MotorController/SCurveProfile.h"
+
+#define TEST_TICK_HZ (48000000 / 16)
+#define TEST_TIMER_TICKS_PER_US 6 // TC0, 48MHz / 8
+
+struct MoveProfile
+{
+  float max_speed;
+  float acceleration;
+  long distance;
+};
+
+static const MoveProfile profiles[] = {
+    {800, 3200, 1600},     // firmware defaults, one revolution
+    {800, 3200, 50},       // never reaches cruise
+    {20000, 50000, 40000}, // fast move
+    {40000, 200000, 7},    // tiny move
+    {100, 400, 2},
+    {3000, 1000, 20000},   // long ramps
+};
+
+void setUp(void)
+{
+  NativeHal::SetMicros(1000000000UL);
+}
+
+void tearDown(void)
+{
+}
+
+// Run AccelStepper against a simulated clock and record the interval it
+// schedules after every step up to the target. AccelStepper's integer
+// stepsToStop can carry it a couple of steps past the target before it
+// reverses; the generator ends the move on the target step instead, so only
+// the intervals leading up to it are compared.
+static long RecordAccelStepperProfile(const MoveProfile &p, unsigned long *intervals, long max_len, bool integer_ramp = false)
+{
+  AccelStepper stepper(AccelStepper::DRIVER, 0, 1, 0, 0, false);
+  stepper.setIntegerRamp(integer_ramp);
+  stepper.setMaxSpeed(p.max_speed);
+  stepper.setAcceleration(p.acceleration);
+  stepper.moveTo(p.distance);
+
+  long count = 0;
+  while (count < max_len)
+  {
+    long before = stepper.currentPosition();
+    stepper.run();
+    if (stepper.currentPosition() != before + 1)
+      break; // the schedule did not produce a step when it said it would
+
+    if (stepper.currentPosition() == p.distance)
+      break;
+
+    unsigned long interval = stepper.GetStepIntervalUs();
+    intervals[count++] = interval;
+    if (interval == 0)
+      break;
+    NativeHal::AdvanceMicros(interval);
+  }
+  return count;
+}
+
+void test_generator_matches_accelstepper(void)
+{
+  static unsigned long expected[50000];
+
+  for (const MoveProfile &p : profiles)
+  {
+    long expected_len = RecordAccelStepperProfile(p, expected, 50000);
+    TEST_ASSERT_EQUAL(p.distance - 1, expected_len);
+
+    StepIntervalGenerator generator;
+    generator.SetMaxSpeed(p.max_speed);
+    generator.SetAcceleration(p.acceleration);
+    generator.Begin(p.distance);
+
+    for (long i = 0; i < expected_len; i++)
+    {
+      TEST_ASSERT_EQUAL_UINT32(expected[i], generator.NextIntervalUs());
+    }
+    TEST_ASSERT_EQUAL_UINT32(0, generator.NextIntervalUs());
+    TEST_ASSERT_TRUE(generator.Done());
+  }
+}
+
+void test_generator_tick_stream_does_not_drift(void)
+{
+  for (const MoveProfile &p : profiles)
+  {
+    StepIntervalGenerator reference;
+    reference.SetMaxSpeed(p.max_speed);
+    reference.SetAcceleration(p.acceleration);
+    reference.Begin(p.distance);
+
+    StepIntervalGenerator generator;
+    generator.SetTickFrequency(TEST_TICK_HZ);
+    generator.SetMaxSpeed(p.max_speed);
+    generator.SetAcceleration(p.acceleration);
+    generator.Begin(p.distance);
+    if (generator.FirstIntervalTicks() > 0xFFFF)
+      continue; // the step engine leaves these moves to the TC0 path
+
+    uint16_t buf[64];
+    uint64_t total_ticks = 0;
+    long total_intervals = 0;
+    uint32_t n;
+    while ((n = generator.Fill(buf, 64)) > 0)
+    {
+      for (uint32_t i = 0; i < n; i++)
+      {
+        TEST_ASSERT_GREATER_THAN_UINT16(0, buf[i]);
+        total_ticks += buf[i];
+      }
+      total_intervals += n;
+    }
+    TEST_ASSERT_EQUAL(p.distance - 1, total_intervals);
+
+    // The truncated microsecond stream loses up to 1us per step, the tick
+    // stream carries its remainder so it must never run shorter than it
+    double total_us = 0;
+    unsigned long us;
+    while ((us = reference.NextIntervalUs()) != 0)
+      total_us += us;
+    double tick_us = (double)total_ticks * 1000000.0 / TEST_TICK_HZ;
+    TEST_ASSERT_TRUE(tick_us >= total_us - 1.0);
+    TEST_ASSERT_TRUE(tick_us <= total_us + p.distance + 1.0);
+  }
+}
+
+void test_generator_stop_decelerates(void)
+{
+  StepIntervalGenerator generator;
+  generator.SetMaxSpeed(20000);
+  generator.SetAcceleration(50000);
+  generator.Begin(100000);
+
+  unsigned long last = 0;
+  for (int i = 0; i < 5000; i++)
+    last = generator.NextIntervalUs();
+
+  generator.Stop();
+  long remaining = generator.Distance() - generator.Generated();
+  TEST_ASSERT_TRUE(remaining < 100000 - 5000);
+  TEST_ASSERT_TRUE(generator.RemainingIntervals() >= 1);
+
+  // Every interval after the stop request is at least as long as the previous
+  unsigned long interval;
+  while ((interval = generator.NextIntervalUs()) != 0)
+  {
+    TEST_ASSERT_TRUE(interval >= last);
+    last = interval;
+  }
+  TEST_ASSERT_TRUE(generator.Done());
+}
+
+void test_integer_ramp_tracks_float_ramp(void)
+{
+  static unsigned long expected[50000];
+  static unsigned long actual[50000];
+
+  for (const MoveProfile &p : profiles)
+  {
+    long expected_len = RecordAccelStepperProfile(p, expected, 50000, false);
+    long actual_len = RecordAccelStepperProfile(p, actual, 50000, true);
+    TEST_ASSERT_EQUAL(expected_len, actual_len);
+
+    // Equation 16 rounds differently in float, which can move the start of
+    // the deceleration by a step. Compare when each step happens rather than
+    // the individual intervals: the two must never be more than 0.5% of the
+    // move time apart.
+    double total_us = 0;
+    for (long i = 0; i < expected_len; i++)
+      total_us += expected[i];
+
+    unsigned long min_interval = (unsigned long)(1000000.0 / p.max_speed);
+    double expected_us = 0;
+    double actual_us = 0;
+    for (long i = 0; i < actual_len; i++)
+    {
+      expected_us += expected[i];
+      actual_us += actual[i];
+      TEST_ASSERT_FLOAT_WITHIN(total_us * 0.005, expected_us, actual_us);
+      TEST_ASSERT_GREATER_OR_EQUAL(min_interval, actual[i]);
+    }
+  }
+}
+
+// Equation 16 in 32 bit integers against the exact floor(v^2 / 2a), from
+// crawling to full speed and over a wide range of accelerations
+void test_integer_ramp_steps_to_stop(void)
+{
+  const float accelerations[] = {1.0f, 50.0f, 32000.0f, 1.0e6f, 1.0e8f};
+  const unsigned long intervals[] = {1, 3, 50, 125, 999, 4096, 65535, 1000000, 4000000};
+  for (float a : accelerations)
+  {
+    for (unsigned long interval : intervals)
+    {
+      IntegerRamp ramp;
+      ramp.SetAcceleration(a);
+      ramp.Sync(interval);
+      double v = 1.0e6 / interval;
+      double expected = floor(v * v / (2.0 * a));
+      TEST_ASSERT_FLOAT_WITHIN(expected / 16384.0 + 1.0, expected, ramp.StepsToStop());
+    }
+  }
+}
+
+void test_generator_retarget_keeps_speed(void)
+{
+  const float jerks[] = {0, 500000};
+  for (float jerk : jerks)
+  {
+    StepIntervalGenerator generator;
+    generator.SetMaxSpeed(20000);
+    generator.SetAcceleration(50000);
+    generator.SetJerk(jerk);
+    generator.Begin(10000);
+
+    unsigned long last = 0;
+    for (int i = 0; i < 3000; i++)
+      last = generator.NextIntervalUs();
+
+    // Too close to stop in, and behind the move
+    TEST_ASSERT_FALSE(generator.Retarget(3100));
+    TEST_ASSERT_FALSE(generator.Retarget(1000));
+    TEST_ASSERT_EQUAL(10000, generator.Distance());
+
+    // Further on: no drop in speed, the move ends on the new target
+    TEST_ASSERT_TRUE(generator.Retarget(30000));
+    unsigned long interval = generator.NextIntervalUs();
+    TEST_ASSERT_TRUE(interval <= last + 1);
+    unsigned long longest = 0;
+    while ((interval = generator.NextIntervalUs()) != 0 && generator.Generated() < 20000)
+      longest = interval > longest ? interval : longest;
+    TEST_ASSERT_TRUE(longest <= last + 1);
+    while (generator.NextIntervalUs() != 0)
+      ;
+    TEST_ASSERT_EQUAL(30000, generator.Generated());
+  }
+}
+
+void test_generator_fill_stops_at_tick_budget(void)
+{
+  StepIntervalGenerator generator;
+  generator.SetTickFrequency(TEST_TICK_HZ);
+  generator.SetMaxSpeed(20000);
+  generator.SetAcceleration(50000);
+  generator.Begin(100000);
+
+  uint16_t buf[1024];
+  uint32_t n = generator.Fill(buf, 1024, TEST_TICK_HZ / 1000);
+  uint32_t ticks = 0;
+  for (uint32_t i = 0; i < n; i++)
+    ticks += buf[i];
+  // Up to the entry that reaches 1ms, never more
+  TEST_ASSERT_TRUE(n < 1024);
+  TEST_ASSERT_TRUE(ticks >= TEST_TICK_HZ / 1000);
+  TEST_ASSERT_TRUE(ticks - buf[n - 1] < TEST_TICK_HZ / 1000);
+}
+
+static uint64_t ReadCycles()
+{
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// Cost of one AccelStepper::run() step (runSpeed() + computeNewSpeed()), which
+// is what TC0_Handler does per step in POSITION mode
+static double MeasureCyclesPerStep(bool integer_ramp)
+{
+  const MoveProfile p = {20000, 50000, 40000};
+  const int repeats = 20;
+  uint64_t cycles = 0;
+  long steps = 0;
+
+  for (int r = 0; r < repeats; r++)
+  {
+    AccelStepper stepper(AccelStepper::DRIVER, 0, 1, 0, 0, false);
+    stepper.setIntegerRamp(integer_ramp);
+    stepper.setMaxSpeed(p.max_speed);
+    stepper.setAcceleration(p.acceleration);
+    stepper.moveTo(p.distance);
+
+    uint64_t start = ReadCycles();
+    while (stepper.run())
+    {
+      NativeHal::AdvanceMicros(stepper.GetStepIntervalUs() + 1);
+      steps++;
+    }
+    cycles += ReadCycles() - start;
+  }
+  return (double)cycles / steps;
+}
+
+void test_ramp_benchmark(void)
+{
+  double float_cycles = MeasureCyclesPerStep(false);
+  double integer_cycles = MeasureCyclesPerStep(true);
+#if defined(__x86_64__) || defined(__i386__)
+  printf("float ramp: %.1f cycles/step, integer ramp: %.1f cycles/step\n", float_cycles, integer_cycles);
+#else
+  printf("float ramp: %.1f ns/step, integer ramp: %.1f ns/step\n", float_cycles, integer_cycles);
+#endif
+  TEST_ASSERT_TRUE(float_cycles > 0 && integer_cycles > 0);
+}
+
+// Intervals are differences of single precision phase times, good to a few
+// hundredths of a microsecond
+#define SCURVE_TEST_NOISE_US 0.05
+
+struct SCurveCase
+{
+  float max_speed;
+  float acceleration;
+  float jerk;
+  long distance;
+};
+
+static const SCurveCase s_curve_cases[] = {
+    {800, 3200, 100000, 1600},           // firmware defaults
+    {800, 3200, 100000, 50},             // never reaches full acceleration
+    {20000, 50000, 1000000, 40000},      // fast move
+    {20000, 50000, 2000000, 3000},       // reaches full acceleration, not max speed
+    {40000, 200000, 10000000, 7},        // tiny move
+    {3000, 1000, 5000, 20000},           // long ramps
+    {40000, 100000, 2000000, 2000000},   // long cruise
+};
+
+// Double precision reference: the same phases, with the time of each step
+// found by bisection on the position instead of per phase closed forms
+struct RefProfile
+{
+  double duration[7];
+  double jerk[7];
+  int count;
+
+  void Add(double t, double j)
+  {
+    if (t > 0)
+    {
+      duration[count] = t;
+      jerk[count] = j;
+      count++;
+    }
+  }
+
+  void Ramp(double dv, double a, double j, double sign)
+  {
+    double tj = dv * j >= a * a ? a / j : sqrt(dv / j);
+    double ta = dv * j >= a * a ? dv / a - tj : 0;
+    Add(tj, sign * j);
+    Add(ta, 0);
+    Add(tj, -sign * j);
+  }
+
+  void Plan(const SCurveCase &c)
+  {
+    count = 0;
+    double a = c.acceleration, j = c.jerk, d = c.distance;
+    double peak = c.max_speed;
+    double tj = peak * j >= a * a ? a / j : sqrt(peak / j);
+    double ta = peak * j >= a * a ? peak / a - tj : 0;
+    if (peak * (2 * tj + ta) > d)
+    {
+      peak = 0.5 * a * (sqrt((a / j) * (a / j) + 4 * d / a) - a / j);
+      if (peak * j < a * a)
+        peak = cbrt(d * d * j / 4);
+      tj = peak * j >= a * a ? a / j : sqrt(peak / j);
+      ta = peak * j >= a * a ? peak / a - tj : 0;
+    }
+    Ramp(peak, a, j, 1);
+    double cruise = d - peak * (2 * tj + ta);
+    if (cruise > 0)
+      Add(cruise / peak, 0);
+    Ramp(peak, a, j, -1);
+  }
+
+  // Position, speed and acceleration at time t
+  void State(double t, double &x, double &v, double &acc)
+  {
+    x = v = acc = 0;
+    for (int i = 0; i < count && t > 0; i++)
+    {
+      double dt = t < duration[i] ? t : duration[i];
+      x += dt * (v + dt * (acc / 2 + dt * jerk[i] / 6));
+      v += dt * (acc + dt * jerk[i] / 2);
+      acc += dt * jerk[i];
+      t -= dt;
+    }
+  }
+
+  double Total()
+  {
+    double t = 0;
+    for (int i = 0; i < count; i++)
+      t += duration[i];
+    return t;
+  }
+
+  double TimeAt(double position)
+  {
+    double lo = 0, hi = Total();
+    for (int i = 0; i < 100; i++)
+    {
+      double mid = (lo + hi) / 2, x, v, acc;
+      State(mid, x, v, acc);
+      if (x < position)
+        lo = mid;
+      else
+        hi = mid;
+    }
+    return (lo + hi) / 2;
+  }
+};
+
+void test_scurve_matches_reference(void)
+{
+  for (const SCurveCase &c : s_curve_cases)
+  {
+    RefProfile ref;
+    ref.Plan(c);
+
+    // The reference itself must respect the limits
+    double max_acc = 0, max_speed = 0;
+    for (double t = 0; t < ref.Total(); t += ref.Total() / 10000)
+    {
+      double x, v, acc;
+      ref.State(t, x, v, acc);
+      max_acc = fmax(max_acc, fabs(acc));
+      max_speed = fmax(max_speed, v);
+    }
+    TEST_ASSERT_TRUE(max_acc <= c.acceleration * 1.0001);
+    TEST_ASSERT_TRUE(max_speed <= c.max_speed * 1.0001);
+
+    SCurveProfile profile;
+    profile.SetMaxSpeed(c.max_speed);
+    profile.SetAcceleration(c.acceleration);
+    profile.SetJerk(c.jerk);
+    profile.BeginMove(c.distance);
+    TEST_ASSERT_EQUAL(1, profile.Steps());
+
+    // Step k is due when the reference is at k - 0.5, timed from step 1.
+    // Every step must be close to that, the Q8 intervals add up to 1/512us
+    // of rounding each.
+    double first = ref.TimeAt(0.5);
+    double elapsed_us = 0;
+    double max_error_us = 0;
+    unsigned long interval_us;
+    uint8_t interval_frac;
+    long steps = 1;
+    long check_every = c.distance > 100000 ? 997 : 1;
+    while (profile.NextInterval(interval_us, interval_frac))
+    {
+      steps++;
+      elapsed_us += interval_us + interval_frac / 256.0;
+      if (steps % check_every == 0 || steps == c.distance)
+      {
+        double expected_us = (ref.TimeAt(steps - 0.5) - first) * 1e6;
+        max_error_us = fmax(max_error_us, fabs(elapsed_us - expected_us));
+        TEST_ASSERT_FLOAT_WITHIN(2.0 + expected_us * 1e-5, expected_us, elapsed_us);
+      }
+    }
+    printf("s-curve %ld steps: %.4f s, max timing error %.3f us\n", c.distance, elapsed_us / 1e6, max_error_us);
+    TEST_ASSERT_EQUAL(c.distance, steps);
+    TEST_ASSERT_TRUE(profile.Done());
+    // The last step is as far from the end as the first one from the start
+    TEST_ASSERT_FLOAT_WITHIN(2.0 + ref.Total() * 10, (ref.Total() - 2 * first) * 1e6, elapsed_us);
+  }
+}
+
+void test_scurve_velocity_change(void)
+{
+  SCurveProfile profile;
+  profile.SetMaxSpeed(20000);
+  profile.SetAcceleration(50000);
+  profile.SetJerk(1000000);
+
+  // Up from a standstill, the speed only ever rises and settles exactly
+  profile.BeginVelocity(0, 8000);
+  unsigned long interval_us;
+  uint8_t interval_frac;
+  double last_us = 1e12;
+  int steps = 0;
+  while (profile.Ramping())
+  {
+    TEST_ASSERT_TRUE(profile.NextInterval(interval_us, interval_frac));
+    double us = interval_us + interval_frac / 256.0;
+    TEST_ASSERT_TRUE(us <= last_us + SCURVE_TEST_NOISE_US);
+    last_us = us;
+    TEST_ASSERT_TRUE(++steps < 100000);
+  }
+  TEST_ASSERT_TRUE(profile.NextInterval(interval_us, interval_frac));
+  TEST_ASSERT_FLOAT_WITHIN(1.0 / 256.0, 125.0, interval_us + interval_frac / 256.0);
+  TEST_ASSERT_FLOAT_WITHIN(1.0, 8000, profile.Speed());
+
+  // Limited to the max speed
+  profile.BeginVelocity(8000, 50000);
+  while (profile.Ramping())
+    profile.NextInterval(interval_us, interval_frac);
+  TEST_ASSERT_FLOAT_WITHIN(1.0, 20000, profile.Speed());
+
+  // Down to rest ends the profile, roughly v^2 / 2a + v * a / 2j steps later
+  profile.BeginVelocity(20000, 0);
+  steps = 0;
+  last_us = 0;
+  while (profile.NextInterval(interval_us, interval_frac))
+  {
+    double us = interval_us + interval_frac / 256.0;
+    TEST_ASSERT_TRUE(us + SCURVE_TEST_NOISE_US >= last_us);
+    last_us = us;
+    steps++;
+  }
+  TEST_ASSERT_TRUE(profile.Done());
+  TEST_ASSERT_INT_WITHIN(20, 20000.0 * 20000.0 / (2 * 50000) + 20000.0 * 50000 / (2 * 1000000), steps);
+}
+
+void test_scurve_stop(void)
+{
+  SCurveProfile profile;
+  profile.SetMaxSpeed(20000);
+  profile.SetAcceleration(50000);
+  profile.SetJerk(1000000);
+  profile.BeginMove(100000);
+
+  unsigned long interval_us;
+  uint8_t interval_frac;
+  for (int i = 0; i < 5000; i++)
+    profile.NextInterval(interval_us, interval_frac);
+  double last_us = interval_us + interval_frac / 256.0;
+
+  profile.Stop();
+  TEST_ASSERT_TRUE(profile.Distance() < 100000);
+  TEST_ASSERT_TRUE(profile.Distance() > profile.Steps());
+
+  while (profile.NextInterval(interval_us, interval_frac))
+  {
+    double us = interval_us + interval_frac / 256.0;
+    TEST_ASSERT_TRUE(us + SCURVE_TEST_NOISE_US >= last_us);
+    last_us = us;
+  }
+  TEST_ASSERT_TRUE(profile.Done());
+  TEST_ASSERT_EQUAL(profile.Distance(), profile.Steps());
+}
+
+void test_generator_scurve_stream(void)
+{
+  for (const SCurveCase &c : s_curve_cases)
+  {
+    StepIntervalGenerator generator;
+    generator.SetTickFrequency(TEST_TICK_HZ);
+    generator.SetMaxSpeed(c.max_speed);
+    generator.SetAcceleration(c.acceleration);
+    generator.SetJerk(c.jerk);
+    if (generator.FirstIntervalTicks() > 0xFFFF)
+      continue;
+    generator.Begin(c.distance);
+
+    RefProfile ref;
+    ref.Plan(c);
+
+    uint16_t buf[64];
+    uint64_t total_ticks = 0;
+    long total_intervals = 0;
+    uint32_t n;
+    while ((n = generator.Fill(buf, 64)) > 0)
+    {
+      for (uint32_t i = 0; i < n; i++)
+        total_ticks += buf[i];
+      total_intervals += n;
+    }
+    TEST_ASSERT_EQUAL(c.distance - 1, total_intervals);
+    TEST_ASSERT_TRUE(generator.Done());
+
+    double expected_us = (ref.Total() - 2 * ref.TimeAt(0.5)) * 1e6;
+    double tick_us = (double)total_ticks * 1000000.0 / TEST_TICK_HZ;
+    TEST_ASSERT_FLOAT_WITHIN(2.0 + expected_us * 1e-5, expected_us, tick_us);
+  }
+}
+
+void test_scurve_benchmark(void)
+{
+  const SCurveCase c = {20000, 50000, 1000000, 40000};
+  const int repeats = 20;
+  uint64_t cycles = 0;
+  long steps = 0;
+  unsigned long interval_us;
+  uint8_t interval_frac;
+
+  for (int r = 0; r < repeats; r++)
+  {
+    SCurveProfile profile;
+    profile.SetMaxSpeed(c.max_speed);
+    profile.SetAcceleration(c.acceleration);
+    profile.SetJerk(c.jerk);
+    profile.BeginMove(c.distance);
+
+    uint64_t start = ReadCycles();
+    while (profile.NextInterval(interval_us, interval_frac))
+      steps++;
+    cycles += ReadCycles() - start;
+  }
+#if defined(__x86_64__) || defined(__i386__)
+  printf("s-curve: %.1f cycles/step\n", (double)cycles / steps);
+#else
+  printf("s-curve: %.1f ns/step\n", (double)cycles / steps);
+#endif
+  TEST_ASSERT_TRUE(cycles > 0);
+}
+
+struct StepTimingResult
+{
+  double achieved_hz;
+  double max_jitter_us; // largest distance of a step from the ideal grid
+};
+
+// Model of TC0 in MFRQ mode with CCBUF0 driving runSpeed() the way
+// MotorController::OnTimer() does with ABSOLUTE_STEP_SCHEDULING. Time is kept
+// in timer ticks, the interrupt starts 0-3us after each overflow and can only
+// load the period after the running one.
+static StepTimingResult MeasureStepTiming(float hz, long steps)
+{
+  AccelStepper stepper(AccelStepper::DRIVER, 0, 1, 0, 0, false);
+  stepper.setMaxSpeed(100000);
+  stepper.setAbsoluteScheduling(true);
+  stepper.setSpeed(hz);
+  StepTimerSchedule schedule(TEST_TIMER_TICKS_PER_US, 1000);
+
+  uint32_t cc0 = 1000 * TEST_TIMER_TICKS_PER_US - 1;
+  uint32_t ccbuf = cc0;
+  uint64_t overflow_tick = 0;
+  uint32_t lcg = 12345;
+
+  uint64_t first_step = 0;
+  uint64_t last_step = 0;
+  long step_count = 0;
+  double max_jitter = 0;
+  // Jitter is measured against the interval as AccelStepper stores it
+  double ideal_period = TEST_TIMER_TICKS_PER_US * (stepper.GetStepIntervalUs() + stepper.GetStepIntervalFrac() / 256.0);
+
+  while (step_count < steps)
+  {
+    overflow_tick += cc0 + 1;
+    cc0 = ccbuf;
+
+    lcg = lcg * 1103515245 + 12345;
+    uint64_t isr_tick = overflow_tick + 1 + (lcg >> 16) % (3 * TEST_TIMER_TICKS_PER_US);
+    NativeHal::SetMicros((unsigned long)(isr_tick / TEST_TIMER_TICKS_PER_US));
+    unsigned long isr_time = micros();
+    if (schedule.Stopped())
+    {
+      // The first step waits for the overflow after the idle period
+      stepper.resetStepTime(isr_time);
+      ccbuf = schedule.Next(false, stepper.GetStepIntervalUs(), stepper.GetStepIntervalFrac(),
+                            stepper.GetStepIntervalUs(), stepper.GetStepIntervalFrac(), 1000) - 1;
+      continue;
+    }
+
+    bool stepped = stepper.runSpeed();
+    if (stepped)
+    {
+      if (step_count == 0)
+        first_step = isr_tick;
+      last_step = isr_tick;
+      double jitter = fabs((double)(isr_tick - first_step) - step_count * ideal_period) / TEST_TIMER_TICKS_PER_US;
+      if (jitter > max_jitter)
+        max_jitter = jitter;
+      step_count++;
+    }
+
+    ccbuf = schedule.Next(stepped, stepper.GetStepIntervalUs(), stepper.GetStepIntervalFrac(),
+                          stepper.GetStepIntervalUs(), stepper.GetStepIntervalFrac(),
+                          stepper.timeToNextStepUs(isr_time)) - 1;
+  }
+
+  StepTimingResult result;
+  result.achieved_hz = (step_count - 1) * (TEST_TIMER_TICKS_PER_US * 1000000.0) / (double)(last_step - first_step);
+  result.max_jitter_us = max_jitter;
+  return result;
+}
+
+void test_absolute_scheduling_step_rate(void)
+{
+  const float rates[] = {1, 3, 10, 91, 100, 1000, 7000, 10000, 33333, 50000};
+
+  for (float hz : rates)
+  {
+    long steps = hz < 10 ? 6 : (hz < 1000 ? 200 : 20000);
+    StepTimingResult result = MeasureStepTiming(hz, steps);
+    printf("commanded %.0f Hz, achieved %.4f Hz, max jitter %.2f us\n", hz, result.achieved_hz, result.max_jitter_us);
+
+    // The interval is kept to 1/256us, and the first and last step can each
+    // be off by the interrupt latency
+    double interval_us = 1000000.0 / hz;
+    double duration_us = (steps - 1) * interval_us;
+    TEST_ASSERT_FLOAT_WITHIN(hz * ((1.0 / 256.0) / interval_us + 4.0 / duration_us), hz, result.achieved_hz);
+    // Interrupt latency varies by 3us, nothing else may add to it while the
+    // interval fits one timer period. Longer intervals are split into partial
+    // periods timed from micros(), which adds its resolution and the latency
+    // of the interrupt that programmed the last part.
+    bool single_period = interval_us * TEST_TIMER_TICKS_PER_US <= 0xFFFF;
+    TEST_ASSERT_TRUE(result.max_jitter_us < (single_period ? 4.0 : 8.0));
+  }
+}
+
+// Largest distance, in us, between the overflow a run() step is taken on and
+// its deadline during a rest to rest trapezoid on the same timer model.
+// Deadlines follow the intervals AccelStepper hands out after the first step.
+static double MeasureRampTiming(float speed, float acceleration, long distance)
+{
+  AccelStepper stepper(AccelStepper::DRIVER, 0, 1, 0, 0, false);
+  stepper.setMaxSpeed(speed);
+  stepper.setAcceleration(acceleration);
+  stepper.setAbsoluteScheduling(true);
+  StepTimerSchedule schedule(TEST_TIMER_TICKS_PER_US, 1000);
+
+  uint32_t cc0 = 1000 * TEST_TIMER_TICKS_PER_US - 1;
+  uint32_t ccbuf = cc0;
+  uint64_t overflow_tick = 0;
+  uint32_t lcg = 54321;
+  uint64_t deadline_q8 = 0;
+  double max_error = 0;
+  long steps = 0;
+
+  stepper.moveTo(distance);
+  while (stepper.currentPosition() != distance || stepper.GetStepIntervalUs() != 0)
+  {
+    overflow_tick += cc0 + 1;
+    cc0 = ccbuf;
+    lcg = lcg * 1103515245 + 12345;
+    uint64_t isr_tick = overflow_tick + 1 + (lcg >> 16) % (3 * TEST_TIMER_TICKS_PER_US);
+    NativeHal::SetMicros((unsigned long)(isr_tick / TEST_TIMER_TICKS_PER_US));
+    unsigned long isr_time = micros();
+    uint8_t next_frac;
+    unsigned long next_us = stepper.intervalAfterNextStepUs(next_frac);
+    if (schedule.Stopped())
+    {
+      stepper.resetStepTime(isr_time);
+      ccbuf = schedule.Next(false, stepper.GetStepIntervalUs(), stepper.GetStepIntervalFrac(),
+                            next_us, next_frac, 1000) - 1;
+      continue;
+    }
+
+    long position = stepper.currentPosition();
+    stepper.run();
+    bool stepped = stepper.currentPosition() != position;
+    if (stepped)
+    {
+      // Taken from AccelStepper once, then followed interval by interval
+      if (steps == 0)
+      {
+        deadline_q8 = (uint64_t)(isr_time + stepper.timeToNextStepUs(isr_time)) * TEST_TIMER_TICKS_PER_US * 256;
+      }
+      else
+      {
+        max_error = fmax(max_error, fabs((double)overflow_tick - deadline_q8 / 256.0) / TEST_TIMER_TICKS_PER_US);
+        deadline_q8 += ((uint64_t)stepper.GetStepIntervalUs() * 256 + stepper.GetStepIntervalFrac()) * TEST_TIMER_TICKS_PER_US;
+      }
+      steps++;
+    }
+
+    next_us = stepper.intervalAfterNextStepUs(next_frac);
+    ccbuf = schedule.Next(stepped, stepper.GetStepIntervalUs(), stepper.GetStepIntervalFrac(),
+                          next_us, next_frac, stepper.timeToNextStepUs(isr_time)) - 1;
+    if (steps > distance)
+      return 1e9;
+  }
+  return max_error;
+}
+
+void test_absolute_scheduling_ramp(void)
+{
+  // Ramps whose intervals change every step, down to 20us at full speed
+  const float speeds[] = {1000, 10000, 50000};
+  for (float speed : speeds)
+  {
+    double error = MeasureRampTiming(speed, 4 * speed, (long)(speed / 2));
+    printf("ramp to %.0f Hz, max step error %.2f us\n", speed, error);
+    // Every period was loaded ahead of time. The schedule picks the deadlines
+    // up from micros() at the start, which is off by the interrupt latency
+    // and its 1us resolution.
+    TEST_ASSERT_TRUE(error < 4.0);
+  }
+}
+
+// The look-ahead is kept and taken over by the step it was worked out for.
+// A run that asks for it before every step must step exactly like one that
+// doesn't, and get told each interval a step early, also across a new target.
+void test_lookahead_matches_run(void)
+{
+  const bool integer_ramps[] = {false, true};
+  for (bool integer_ramp : integer_ramps)
+  {
+    AccelStepper plain(AccelStepper::DRIVER, 0, 1, 0, 0, false);
+    AccelStepper ahead(AccelStepper::DRIVER, 0, 1, 0, 0, false);
+    AccelStepper *steppers[] = {&plain, &ahead};
+    for (AccelStepper *stepper : steppers)
+    {
+      stepper->setIntegerRamp(integer_ramp);
+      stepper->setMaxSpeed(5000);
+      stepper->setAcceleration(20000);
+      stepper->moveTo(2000);
+    }
+
+    long steps = 0;
+    while (plain.GetStepIntervalUs() != 0 && steps < 10000)
+    {
+      uint8_t next_frac;
+      unsigned long next_us = ahead.intervalAfterNextStepUs(next_frac);
+      TEST_ASSERT_EQUAL(next_us, ahead.intervalAfterNextStepUs(next_frac));
+
+      NativeHal::AdvanceMicros(plain.GetStepIntervalUs() + 1);
+      plain.run();
+      ahead.run();
+      steps++;
+      TEST_ASSERT_EQUAL(plain.currentPosition(), ahead.currentPosition());
+      TEST_ASSERT_EQUAL(plain.GetStepIntervalUs(), ahead.GetStepIntervalUs());
+      TEST_ASSERT_EQUAL(plain.GetStepIntervalFrac(), ahead.GetStepIntervalFrac());
+      TEST_ASSERT_EQUAL(next_us, ahead.GetStepIntervalUs());
+      TEST_ASSERT_EQUAL(next_frac, ahead.GetStepIntervalFrac());
+
+      if (steps == 600)
+      {
+        // Turn back while at speed, after the look-ahead for the next step
+        ahead.intervalAfterNextStepUs(next_frac);
+        plain.moveTo(-500);
+        ahead.moveTo(-500);
+      }
+    }
+    TEST_ASSERT_EQUAL(-500, plain.currentPosition());
+    TEST_ASSERT_EQUAL(0, ahead.GetStepIntervalUs());
+  }
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_generator_matches_accelstepper);
+  RUN_TEST(test_generator_tick_stream_does_not_drift);
+  RUN_TEST(test_generator_stop_decelerates);
+  RUN_TEST(test_generator_retarget_keeps_speed);
+  RUN_TEST(test_generator_fill_stops_at_tick_budget);
+  RUN_TEST(test_integer_ramp_tracks_float_ramp);
+  RUN_TEST(test_integer_ramp_steps_to_stop);
+  RUN_TEST(test_ramp_benchmark);
+  RUN_TEST(test_absolute_scheduling_step_rate);
+  RUN_TEST(test_absolute_scheduling_ramp);
+  RUN_TEST(test_lookahead_matches_run);
+  RUN_TEST(test_scurve_matches_reference);
+  RUN_TEST(test_scurve_velocity_change);
+  RUN_TEST(test_scurve_stop);
+  RUN_TEST(test_generator_scurve_stream);
+  RUN_TEST(test_scurve_benchmark);
+  return UNITY_END();
+}
@@ -0,0 +1,276 @@
+#include <unity.h>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include "EncoderController/EncoderAngle.h"
+#include "EncoderController/PositionObserver.h"
+
+// Synthetic TLV493D traces: the field of a diametric magnet on the shaft,
+// with gaussian noise on each axis, sampled at the FASTMODE rate with some
+// jitter and put through FixedAtan2() the way EncoderController does. The
+// observer is compared against the truth and against the filter it replaces,
+// the sliding window with a windowed EMA velocity.
+
+#define TEST_SAMPLE_US 300        // FASTMODE, about 3.3kHz
+#define TEST_FIELD 1000.0         // LSB
+#define TEST_NOISE 2.0            // LSB rms per axis, about 0.11 degrees
+#define TEST_SPEED 1800.0         // degrees/s, 8000 steps/s
+#define TEST_ACCELERATION 18000.0 // degrees/s^2
+#define TEST_OLD_WINDOW_US 10000  // the replaced filter's velocity window
+#define TEST_OLD_ALPHA 0.1        // and its EMA
+
+static double DegreesToUnits(double degrees)
+{
+  return degrees / 360.0 * ANGLE_UNITS_PER_TURN;
+}
+
+static double UnitsToDegrees(double units)
+{
+  return units * 360.0 / ANGLE_UNITS_PER_TURN;
+}
+
+// Shaft motion: a position and the velocity it was commanded with
+struct Motion
+{
+  virtual ~Motion() {}
+  virtual double Position(double t) = 0; // degrees
+  virtual double Commanded(double t) = 0; // degrees/s
+};
+
+// 0.1s at rest, trapezoid up to TEST_SPEED, cruise, back down
+struct Trapezoid : Motion
+{
+  double Velocity(double t)
+  {
+    const double ramp = TEST_SPEED / TEST_ACCELERATION;
+    t -= 0.1;
+    if (t < 0.0)
+      return 0.0;
+    if (t < ramp)
+      return TEST_ACCELERATION * t;
+    if (t < ramp + 0.3)
+      return TEST_SPEED;
+    if (t < 2 * ramp + 0.3)
+      return TEST_SPEED - TEST_ACCELERATION * (t - ramp - 0.3);
+    return 0.0;
+  }
+  double Position(double t) override
+  {
+    // Fine enough for the trace
+    double p = 0.0;
+    for (double s = 0.0; s < t; s += 1e-5)
+      p += Velocity(s) * 1e-5;
+    return 37.0 + p;
+  }
+  double Commanded(double t) override { return Velocity(t); }
+};
+
+// Cruises at TEST_SPEED and jams at `jam` while the command carries on
+struct Jam : Motion
+{
+  double jam;
+  explicit Jam(double jam_time) : jam(jam_time) {}
+  double Position(double t) override { return 200.0 + TEST_SPEED * (t < jam ? t : jam); }
+  double Commanded(double t) override { return TEST_SPEED; }
+};
+
+struct Trace
+{
+  std::vector<double> t, truth, true_velocity, velocity, position, old_velocity;
+};
+
+// Runs the observer and the old filter over `duration` seconds of `motion`
+static Trace Run(Motion &motion, double duration, PositionObserver &observer, bool tabulate_position = false)
+{
+  std::mt19937 rng(7);
+  std::normal_distribution<double> noise(0.0, TEST_NOISE);
+  std::uniform_int_distribution<int> jitter(-20, 20);
+
+  AngleTracker unwrap(0, 0);
+  AngleTracker window;
+  int64_t old_anchor = 0;
+  double old_velocity = 0.0;
+  uint32_t old_anchor_us = 0;
+
+  observer.Reset();
+  Trace trace;
+  uint32_t now_us = 0, last_us = 0;
+  std::vector<double> positions;
+  while (now_us < duration * 1e6)
+  {
+    double t = now_us * 1e-6;
+    double a = motion.Position(t) * M_PI / 180.0;
+    int16_t x = (int16_t)lround(TEST_FIELD * cos(a) + noise(rng));
+    int16_t y = (int16_t)lround(TEST_FIELD * sin(a) + noise(rng));
+    uint16_t angle = FixedAtan2(y, x);
+
+    observer.SetCommandedVelocity(DegreesToUnits(motion.Commanded(t)));
+    observer.Update(unwrap.Update(angle), now_us - last_us);
+
+    int64_t windowed = window.Update(angle);
+    if (now_us - old_anchor_us >= TEST_OLD_WINDOW_US)
+    {
+      double v = UnitsToDegrees(windowed - old_anchor) / ((now_us - old_anchor_us) * 1e-6);
+      old_velocity = v * TEST_OLD_ALPHA + old_velocity * (1 - TEST_OLD_ALPHA);
+      old_anchor = windowed;
+      old_anchor_us = now_us;
+    }
+
+    trace.t.push_back(t);
+    trace.truth.push_back(motion.Position(t));
+    trace.true_velocity.push_back((motion.Position(t + 1e-5) - motion.Position(t - 1e-5)) / 2e-5);
+    trace.velocity.push_back(UnitsToDegrees(observer.Velocity()));
+    trace.position.push_back(UnitsToDegrees((double)observer.Position()));
+    trace.old_velocity.push_back(old_velocity);
+
+    last_us = now_us;
+    now_us += TEST_SAMPLE_US + jitter(rng);
+  }
+  return trace;
+}
+
+static double Rms(const std::vector<double> &a, const std::vector<double> &b, const Trace &trace, double from, double to)
+{
+  double sum = 0.0;
+  long n = 0;
+  for (size_t i = 0; i < a.size(); i++)
+  {
+    if (trace.t[i] < from || trace.t[i] >= to)
+      continue;
+    sum += (a[i] - b[i]) * (a[i] - b[i]);
+    n++;
+  }
+  return sqrt(sum / n);
+}
+
+static double MaxError(const std::vector<double> &a, const std::vector<double> &b, const Trace &trace, double from, double to)
+{
+  double worst = 0.0;
+  for (size_t i = 0; i < a.size(); i++)
+  {
+    if (trace.t[i] >= from && trace.t[i] < to && fabs(a[i] - b[i]) > worst)
+      worst = fabs(a[i] - b[i]);
+  }
+  return worst;
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+void test_gains_outside_the_stable_region_are_rejected(void)
+{
+  PositionObserver observer;
+  TEST_ASSERT_FALSE(observer.SetGains(0.0f, 0.01f));
+  TEST_ASSERT_FALSE(observer.SetGains(2.0f, 0.01f));
+  TEST_ASSERT_FALSE(observer.SetGains(0.5f, 0.0f));
+  TEST_ASSERT_FALSE(observer.SetGains(1.5f, 1.0f));
+  float alpha, beta;
+  observer.GetGains(alpha, beta);
+  TEST_ASSERT_EQUAL_FLOAT(OBSERVER_DEFAULT_ALPHA, alpha);
+  TEST_ASSERT_EQUAL_FLOAT(OBSERVER_DEFAULT_BETA, beta);
+  TEST_ASSERT_TRUE(observer.SetGains(0.5f, 0.1f));
+}
+
+void test_still_shaft_is_quiet(void)
+{
+  // Homing waits for the velocity to drop below 1 degree/s at rest
+  PositionObserver observer;
+  Trapezoid motion;
+  Trace trace = Run(motion, 0.1, observer);
+  double noise = Rms(trace.velocity, trace.true_velocity, trace, 0.05, 0.1);
+  double position = Rms(trace.position, trace.truth, trace, 0.05, 0.1);
+  printf("still: velocity noise %.2f degrees/s rms, position %.3f degrees rms\n", noise, position);
+  TEST_ASSERT_TRUE(noise < 0.5);
+  TEST_ASSERT_TRUE(position < 0.05);
+}
+
+void test_feed_forward_follows_ramps_without_lag(void)
+{
+  PositionObserver observer;
+  Trapezoid motion;
+  Trace with = Run(motion, 0.7, observer);
+  observer.SetFeedForward(false);
+  Trace without = Run(motion, 0.7, observer);
+
+  // Acceleration, cruise and deceleration
+  double ff = MaxError(with.velocity, with.true_velocity, with, 0.1, 0.6);
+  double plain = MaxError(without.velocity, without.true_velocity, without, 0.1, 0.6);
+  double old = MaxError(with.old_velocity, with.true_velocity, with, 0.1, 0.6);
+  double ff_position = MaxError(with.position, with.truth, with, 0.1, 0.6);
+  double plain_position = MaxError(without.position, without.truth, without, 0.1, 0.6);
+  printf("trapezoid: max velocity error feed-forward %.1f, observer alone %.1f, old filter %.1f degrees/s\n",
+         ff, plain, old);
+  printf("trapezoid: max position error feed-forward %.3f, observer alone %.3f degrees\n", ff_position, plain_position);
+
+  TEST_ASSERT_TRUE(ff < 0.02 * TEST_SPEED);
+  TEST_ASSERT_TRUE(plain < old / 2);
+  TEST_ASSERT_TRUE(ff_position < 0.1);
+}
+
+// Time from the jam until the velocity reads below half the commanded
+static double JamResponse(const std::vector<double> &velocity, const Trace &trace, double jam)
+{
+  for (size_t i = 0; i < velocity.size(); i++)
+  {
+    if (trace.t[i] >= jam && velocity[i] < TEST_SPEED / 2)
+      return trace.t[i] - jam;
+  }
+  return -1.0;
+}
+
+void test_jam_shows_through_the_feed_forward(void)
+{
+  // The command carries on, the measurement has to pull the estimate down
+  PositionObserver observer;
+  Jam motion(0.3);
+  Trace with = Run(motion, 0.6, observer);
+  observer.SetFeedForward(false);
+  Trace without = Run(motion, 0.6, observer);
+
+  double ff = JamResponse(with.velocity, with, motion.jam);
+  double plain = JamResponse(without.velocity, without, motion.jam);
+  double old = JamResponse(with.old_velocity, with, motion.jam);
+  printf("jam: below half speed after feed-forward %.1f ms, observer alone %.1f ms, old filter %.1f ms\n",
+         ff * 1e3, plain * 1e3, old * 1e3);
+  TEST_ASSERT_TRUE(ff > 0.0 && ff < 0.05);
+  TEST_ASSERT_TRUE(plain > 0.0 && plain < old);
+  // Settles at rest again
+  TEST_ASSERT_TRUE(fabs(with.velocity.back()) < 5.0);
+}
+
+void test_position_stays_exact_over_many_turns(void)
+{
+  // 50 turns/s a million turns out, where a float has no fraction left
+  const int64_t per_ms = ANGLE_UNITS_PER_TURN * 50 / 1000;
+  PositionObserver observer;
+  observer.SetCommandedVelocity(per_ms * 1000.0f);
+  int64_t position = (int64_t)ANGLE_UNITS_PER_TURN * 1000000;
+  observer.Update(position, 0);
+  for (int i = 0; i < 100000; i++)
+  {
+    position += per_ms;
+    observer.Update(position, 1000);
+  }
+  TEST_ASSERT_TRUE(llabs(observer.Position() - position) <= 1);
+  TEST_ASSERT_FLOAT_WITHIN(1.0f, per_ms * 1000.0f, observer.Velocity());
+
+  // A gap restarts from the sample
+  observer.Update(12345, OBSERVER_MAX_GAP_US + 1);
+  TEST_ASSERT_EQUAL(12345, (long)observer.Position());
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_gains_outside_the_stable_region_are_rejected);
+  RUN_TEST(test_still_shaft_is_quiet);
+  RUN_TEST(test_feed_forward_follows_ramps_without_lag);
+  RUN_TEST(test_jam_shows_through_the_feed_forward);
+  RUN_TEST(test_position_stays_exact_over_many_turns);
+  return UNITY_END();
+}
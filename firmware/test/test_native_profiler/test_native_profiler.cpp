@@ -0,0 +1,81 @@
+#include <unity.h>
+#include "Profiler/Profiler.h"
+
+void setUp(void)
+{
+  Profiler::Reset();
+}
+
+void tearDown(void)
+{
+}
+
+void test_profiler_histogram_bins(void)
+{
+  TEST_ASSERT_EQUAL(0, Profiler::HistogramBin(0));
+  TEST_ASSERT_EQUAL(0, Profiler::HistogramBin(63));
+  TEST_ASSERT_EQUAL(1, Profiler::HistogramBin(64));
+  TEST_ASSERT_EQUAL(1, Profiler::HistogramBin(127));
+  TEST_ASSERT_EQUAL(2, Profiler::HistogramBin(128));
+  TEST_ASSERT_EQUAL(8, Profiler::HistogramBin(10000));
+  TEST_ASSERT_EQUAL(PROFILER_HISTOGRAM_BINS - 1, Profiler::HistogramBin(0xFFFFFFFF));
+}
+
+void test_profiler_statistics(void)
+{
+  Profiler::Record(ProfileProbe::STEP_ISR, 300);
+  Profiler::Record(ProfileProbe::STEP_ISR, 100);
+  Profiler::Record(ProfileProbe::STEP_ISR, 200);
+  Profiler::Record(ProfileProbe::MESSAGE, 5000);
+
+  ProfileStats stats;
+  TEST_ASSERT_TRUE(Profiler::Get((uint8_t)ProfileProbe::STEP_ISR, stats));
+  TEST_ASSERT_EQUAL_UINT32(3, stats.count);
+  TEST_ASSERT_EQUAL_UINT32(100, stats.min);
+  TEST_ASSERT_EQUAL_UINT32(300, stats.max);
+  TEST_ASSERT_EQUAL_UINT32(600, (uint32_t)stats.total);
+  TEST_ASSERT_EQUAL_UINT32(1, stats.histogram[1]);
+  TEST_ASSERT_EQUAL_UINT32(1, stats.histogram[2]);
+  TEST_ASSERT_EQUAL_UINT32(1, stats.histogram[3]);
+
+  TEST_ASSERT_TRUE(Profiler::Get((uint8_t)ProfileProbe::MESSAGE, stats));
+  TEST_ASSERT_EQUAL_UINT32(1, stats.count);
+  TEST_ASSERT_EQUAL_UINT32(5000, stats.min);
+
+  TEST_ASSERT_TRUE(Profiler::Get((uint8_t)ProfileProbe::ETHERNET_ISR, stats));
+  TEST_ASSERT_EQUAL_UINT32(0, stats.count);
+}
+
+void test_profiler_probes(void)
+{
+  ProfileStats stats;
+  TEST_ASSERT_TRUE(Profiler::Get((uint8_t)ProfileProbe::COUNT - 1, stats));
+  TEST_ASSERT_FALSE(Profiler::Get((uint8_t)ProfileProbe::COUNT, stats));
+
+  // Tasks past PROFILER_MAX_TASKS have no probe
+  Profiler::Record(ProfileProbe::NONE, 100);
+  for (uint8_t probe = 0; probe < (uint8_t)ProfileProbe::COUNT; probe++)
+  {
+    Profiler::Get(probe, stats);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.count);
+  }
+
+  {
+    PROFILE_SCOPE(ProfileProbe::TASK_0);
+  }
+  Profiler::Get((uint8_t)ProfileProbe::TASK_0, stats);
+  TEST_ASSERT_EQUAL_UINT32(1, stats.count);
+
+  Profiler::Reset();
+  Profiler::Get((uint8_t)ProfileProbe::TASK_0, stats);
+  TEST_ASSERT_EQUAL_UINT32(0, stats.count);
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_profiler_histogram_bins);
+  RUN_TEST(test_profiler_statistics);
+  RUN_TEST(test_profiler_probes);
+  return UNITY_END();
+}
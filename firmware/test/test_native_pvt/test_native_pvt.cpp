@@ -0,0 +1,224 @@
+#include <unity.h>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+#include "MotorController/PvtInterpolator.h"
+
+#define TEST_PI 3.14159265358979
+
+// Sine trajectory streamed at a fixed point rate
+#define TEST_AMPLITUDE 400.0
+#define TEST_FREQUENCY 1.0
+#define TEST_POINT_US 10000
+#define TEST_POINTS 201
+
+struct StepEvent
+{
+  uint64_t time_q8;
+  long position; // after the step
+  bool forward;
+};
+
+// Takes every step NextStep() hands out, the way the step interrupt does
+static void RunSteps(PvtInterpolator &pvt, long &position, std::vector<StepEvent> &steps)
+{
+  uint64_t time_q8;
+  bool forward;
+  while (pvt.NextStep(position, time_q8, forward))
+  {
+    position += forward ? 1 : -1;
+    steps.push_back({time_q8, position, forward});
+  }
+}
+
+static double SinePosition(double t)
+{
+  return TEST_AMPLITUDE * sin(2.0 * TEST_PI * TEST_FREQUENCY * t);
+}
+
+static double SineVelocity(double t)
+{
+  return TEST_AMPLITUDE * 2.0 * TEST_PI * TEST_FREQUENCY * cos(2.0 * TEST_PI * TEST_FREQUENCY * t);
+}
+
+// Motor position at a time from the start of the stream
+static long PositionAt(const std::vector<StepEvent> &steps, long start, uint64_t time_q8)
+{
+  long position = start;
+  for (const StepEvent &s : steps)
+  {
+    if (s.time_q8 > time_q8)
+      break;
+    position = s.position;
+  }
+  return position;
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+// The motor stays on the nearest whole step of the streamed sine, both at
+// the points and in between them
+void test_pvt_follows_sine(void)
+{
+  PvtInterpolator pvt;
+  const uint32_t t0 = 123456;
+  int added = 0;
+  for (; added < 4; added++)
+  {
+    double t = added * TEST_POINT_US * 1.0e-6;
+    TEST_ASSERT_TRUE(pvt.Add(t0 + added * TEST_POINT_US, lround(SinePosition(t)), SineVelocity(t)));
+  }
+  long position = 0;
+  std::vector<StepEvent> steps;
+  TEST_ASSERT_TRUE(pvt.Start(position));
+
+  // Stream the rest while stepping, a few points ahead
+  while (added < TEST_POINTS)
+  {
+    RunSteps(pvt, position, steps);
+    double t = added * TEST_POINT_US * 1.0e-6;
+    TEST_ASSERT_TRUE(pvt.Add(t0 + added * TEST_POINT_US, lround(SinePosition(t)), SineVelocity(t)));
+    added++;
+  }
+  RunSteps(pvt, position, steps);
+  TEST_ASSERT_EQUAL(0, pvt.Size());
+  TEST_ASSERT_EQUAL((TEST_POINTS - 1) * TEST_POINT_US, pvt.EndTimeUs());
+
+  double worst = 0.0;
+  long reversals = 0;
+  for (size_t i = 0; i < steps.size(); i++)
+  {
+    if (i > 0)
+    {
+      TEST_ASSERT_TRUE(steps[i].time_q8 >= steps[i - 1].time_q8);
+      if (steps[i].forward != steps[i - 1].forward)
+        reversals++;
+    }
+    // Each step lands where the sine crosses the half step in between
+    double t = steps[i].time_q8 / 256.0e6;
+    double level = steps[i].position + (steps[i].forward ? -0.5 : 0.5);
+    worst = fmax(worst, fabs(SinePosition(t) - level));
+  }
+  printf("sine: %u steps, %ld reversals, worst error %.4f steps\n", (unsigned)steps.size(), reversals, worst);
+  // Points carry whole steps, which puts the spline up to half a step off the
+  // sine and can add a step back and forth around the turning points
+  TEST_ASSERT_TRUE(worst < 0.55);
+  TEST_ASSERT_TRUE(reversals >= 2 && reversals <= 6);
+
+  for (int i = 0; i < TEST_POINTS; i++)
+  {
+    // Points rounded to whole steps, plus the rounding of the motor itself
+    uint64_t time_q8 = (uint64_t)i * TEST_POINT_US * 256;
+    double expected = SinePosition(i * TEST_POINT_US * 1.0e-6);
+    TEST_ASSERT_TRUE(fabs(PositionAt(steps, 0, time_q8) - expected) <= 1.0);
+  }
+  TEST_ASSERT_EQUAL(lround(SinePosition((TEST_POINTS - 1) * TEST_POINT_US * 1.0e-6)), position);
+}
+
+// Running out of points pauses the interpolation at the last one, later
+// points carry on from there
+void test_pvt_waits_for_points(void)
+{
+  PvtInterpolator pvt;
+  TEST_ASSERT_TRUE(pvt.Add(1000, 0, 0.0f));
+  long position = 0;
+  std::vector<StepEvent> steps;
+  TEST_ASSERT_TRUE(pvt.Start(position));
+  RunSteps(pvt, position, steps);
+  TEST_ASSERT_EQUAL(0, steps.size());
+  TEST_ASSERT_EQUAL(0, pvt.EndTimeUs());
+
+  TEST_ASSERT_TRUE(pvt.Add(101000, 100, 1000.0f));
+  RunSteps(pvt, position, steps);
+  TEST_ASSERT_EQUAL(100, position);
+  TEST_ASSERT_EQUAL(100000, pvt.EndTimeUs());
+  TEST_ASSERT_EQUAL_FLOAT(1000.0f, pvt.EndVelocity());
+
+  TEST_ASSERT_TRUE(pvt.Add(201000, 150, 0.0f));
+  RunSteps(pvt, position, steps);
+  TEST_ASSERT_EQUAL(150, position);
+  TEST_ASSERT_EQUAL(200000, pvt.EndTimeUs());
+  for (const StepEvent &s : steps)
+    TEST_ASSERT_TRUE(s.forward);
+  // The velocity carries through the point, no gap around it
+  TEST_ASSERT_TRUE(steps[100].time_q8 - steps[99].time_q8 < 2 * 256 * 1000);
+}
+
+// The first point only sets the time origin, the motor starts from where it is
+void test_pvt_starts_from_motor(void)
+{
+  PvtInterpolator pvt;
+  TEST_ASSERT_TRUE(pvt.Add(5000, 0, 0.0f));
+  TEST_ASSERT_TRUE(pvt.Add(105000, 100, 0.0f));
+  long position = 50;
+  std::vector<StepEvent> steps;
+  TEST_ASSERT_TRUE(pvt.Start(position));
+  RunSteps(pvt, position, steps);
+  TEST_ASSERT_EQUAL(100, position);
+  TEST_ASSERT_EQUAL(50, steps.size());
+  TEST_ASSERT_TRUE(steps.back().time_q8 <= 100000ull * 256);
+}
+
+// Holds, reversals inside a segment and overshoot all end on the last point
+void test_pvt_holds_and_reverses(void)
+{
+  PvtInterpolator pvt;
+  TEST_ASSERT_TRUE(pvt.Add(0, 0, 0.0f));
+  TEST_ASSERT_TRUE(pvt.Add(100000, 100, 0.0f));
+  TEST_ASSERT_TRUE(pvt.Add(200000, 100, 0.0f));   // hold
+  TEST_ASSERT_TRUE(pvt.Add(250000, 90, -3000.0f)); // overshoots 90 going backwards
+  TEST_ASSERT_TRUE(pvt.Add(350000, 80, 0.0f));     // so comes back forwards first
+  long position = 0;
+  std::vector<StepEvent> steps;
+  TEST_ASSERT_TRUE(pvt.Start(position));
+  RunSteps(pvt, position, steps);
+  TEST_ASSERT_EQUAL(80, position);
+
+  long lowest = position;
+  for (const StepEvent &s : steps)
+  {
+    // Nothing while holding
+    TEST_ASSERT_FALSE(s.time_q8 > 100000ull * 256 && s.time_q8 < 200000ull * 256);
+    if (s.time_q8 > 250000ull * 256)
+      lowest = s.position < lowest ? s.position : lowest;
+  }
+  TEST_ASSERT_TRUE(lowest < 80);
+}
+
+void test_pvt_rejects_points(void)
+{
+  PvtInterpolator pvt;
+  TEST_ASSERT_TRUE(pvt.Add(0xFFFFFF00, 0, 0.0f));
+  // Timestamps wrap
+  TEST_ASSERT_TRUE(pvt.Add(0x00000100, 10, 0.0f));
+  TEST_ASSERT_FALSE(pvt.Add(0x00000100, 20, 0.0f));
+  TEST_ASSERT_FALSE(pvt.Add(0x00000080, 20, 0.0f));
+  TEST_ASSERT_EQUAL(2, pvt.Size());
+
+  for (uint32_t i = 2; i < PVT_QUEUE_SIZE; i++)
+    TEST_ASSERT_TRUE(pvt.Add(0x100 + i * 1000, 10, 0.0f));
+  TEST_ASSERT_FALSE(pvt.Add(0x100 + PVT_QUEUE_SIZE * 1000, 10, 0.0f));
+  TEST_ASSERT_EQUAL_UINT32(1, pvt.Overflows());
+
+  // A new stream may start anywhere
+  pvt.Clear();
+  TEST_ASSERT_EQUAL(0, pvt.Size());
+  TEST_ASSERT_TRUE(pvt.Add(5, 0, 0.0f));
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_pvt_follows_sine);
+  RUN_TEST(test_pvt_waits_for_points);
+  RUN_TEST(test_pvt_starts_from_motor);
+  RUN_TEST(test_pvt_holds_and_reverses);
+  RUN_TEST(test_pvt_rejects_points);
+  return UNITY_END();
+}
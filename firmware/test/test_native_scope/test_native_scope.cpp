@@ -0,0 +1,161 @@
+#include <unity.h>
+#include "MotorController/ScopeCapture.h"
+
+// Runs the capture from an interrupt every `isr_us` with a move ramping up
+// from `move_start_us`, until it is DONE or `duration_us` has passed
+static void Run(ScopeCapture &scope, uint32_t isr_us, uint32_t move_start_us, uint32_t duration_us)
+{
+  bool was_moving = false;
+  for (uint32_t now = 0; now < duration_us && scope.State() != ScopeState::DONE; now += isr_us)
+  {
+    if (!scope.Due(now))
+      continue;
+    ScopeSample sample = {};
+    sample.time_us = now;
+    bool moving = now >= move_start_us;
+    if (moving)
+    {
+      float t = (now - move_start_us) * 1e-6f;
+      sample.commanded_velocity = 10000.0f * t;
+      sample.commanded_position = (int32_t)(5000.0f * t * t);
+      sample.encoder_position = sample.commanded_position - 3.0f;
+      sample.status = (uint16_t)MotorStates::POSITION;
+    }
+    else
+    {
+      sample.status = (uint16_t)MotorStates::IDLE_ON;
+    }
+    scope.Record(sample, moving && !was_moving);
+    was_moving = moving;
+  }
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+void test_scope_rejects_bad_settings(void)
+{
+  ScopeCapture scope;
+  TEST_ASSERT_FALSE(scope.Arm(SCOPE_MIN_PERIOD_US - 1, ScopeTrigger::IMMEDIATE, ScopeChannel::COMMANDED_POSITION, 0.0f, 0));
+  TEST_ASSERT_FALSE(scope.Arm(1000, (ScopeTrigger)7, ScopeChannel::COMMANDED_POSITION, 0.0f, 0));
+  TEST_ASSERT_FALSE(scope.Arm(1000, ScopeTrigger::IMMEDIATE, (ScopeChannel)7, 0.0f, 0));
+  TEST_ASSERT_FALSE(scope.Arm(1000, ScopeTrigger::IMMEDIATE, ScopeChannel::COMMANDED_POSITION, 0.0f, SCOPE_DEPTH));
+  TEST_ASSERT_EQUAL(ScopeState::IDLE, scope.State());
+  TEST_ASSERT_FALSE(scope.Due(0));
+}
+
+void test_scope_immediate_fills_ring(void)
+{
+  ScopeCapture scope;
+  TEST_ASSERT_TRUE(scope.Arm(250, ScopeTrigger::IMMEDIATE, ScopeChannel::COMMANDED_POSITION, 0.0f, 0));
+  Run(scope, 50, 0, 1000000);
+  TEST_ASSERT_EQUAL(ScopeState::DONE, scope.State());
+  TEST_ASSERT_EQUAL_UINT16(SCOPE_DEPTH, scope.Count());
+  TEST_ASSERT_EQUAL_UINT16(0, scope.TriggerIndex());
+
+  // Evenly spaced at the period from the first interrupt
+  ScopeSample chunk[SCOPE_CHUNK_SAMPLES];
+  uint32_t expected = 0;
+  for (uint16_t first = 0; first < scope.Count(); first += SCOPE_CHUNK_SAMPLES)
+  {
+    uint16_t n = scope.Read(first, chunk, SCOPE_CHUNK_SAMPLES);
+    TEST_ASSERT_EQUAL_UINT16(SCOPE_CHUNK_SAMPLES, n);
+    for (uint16_t i = 0; i < n; i++, expected += 250)
+      TEST_ASSERT_EQUAL_UINT32(expected, chunk[i].time_us);
+  }
+  TEST_ASSERT_EQUAL_UINT16(0, scope.Read(SCOPE_DEPTH, chunk, SCOPE_CHUNK_SAMPLES));
+}
+
+void test_scope_slow_interrupt_skips_samples(void)
+{
+  // Interrupts 1ms apart can't keep a 300us period, the samples come at the
+  // interrupt rate instead of bunching up afterwards
+  ScopeCapture scope;
+  TEST_ASSERT_TRUE(scope.Arm(300, ScopeTrigger::IMMEDIATE, ScopeChannel::COMMANDED_POSITION, 0.0f, 0));
+  Run(scope, 1000, 0, 10000);
+  TEST_ASSERT_EQUAL(ScopeState::TRIGGERED, scope.State());
+  scope.Stop();
+  TEST_ASSERT_EQUAL(ScopeState::IDLE, scope.State());
+  TEST_ASSERT_EQUAL_UINT16(0, scope.Count());
+
+  TEST_ASSERT_TRUE(scope.Arm(300, ScopeTrigger::IMMEDIATE, ScopeChannel::COMMANDED_POSITION, 0.0f, 0));
+  Run(scope, 1000, 0, 2000000);
+  ScopeSample chunk[2];
+  TEST_ASSERT_EQUAL_UINT16(2, scope.Read(100, chunk, 2));
+  TEST_ASSERT_EQUAL_UINT32(1000, chunk[1].time_us - chunk[0].time_us);
+}
+
+void test_scope_move_start_keeps_pre_trigger(void)
+{
+  ScopeCapture scope;
+  TEST_ASSERT_TRUE(scope.Arm(100, ScopeTrigger::MOVE_START, ScopeChannel::COMMANDED_POSITION, 0.0f, 64));
+  Run(scope, 10, 200000, 1000000);
+  TEST_ASSERT_EQUAL(ScopeState::DONE, scope.State());
+  TEST_ASSERT_EQUAL_UINT16(SCOPE_DEPTH, scope.Count());
+  TEST_ASSERT_EQUAL_UINT16(64, scope.TriggerIndex());
+
+  ScopeSample chunk[2];
+  TEST_ASSERT_EQUAL_UINT16(2, scope.Read(63, chunk, 2));
+  TEST_ASSERT_EQUAL_UINT32(200000 - 100, chunk[0].time_us);
+  TEST_ASSERT_EQUAL_UINT16((uint16_t)MotorStates::IDLE_ON, chunk[0].status & SCOPE_STATUS_STATE_MASK);
+  TEST_ASSERT_EQUAL_UINT32(200000, chunk[1].time_us);
+  TEST_ASSERT_EQUAL_UINT16((uint16_t)MotorStates::POSITION, chunk[1].status & SCOPE_STATUS_STATE_MASK);
+}
+
+void test_scope_short_pre_trigger(void)
+{
+  // Triggered before the pre-trigger part could fill, the capture is shorter
+  ScopeCapture scope;
+  TEST_ASSERT_TRUE(scope.Arm(100, ScopeTrigger::MOVE_START, ScopeChannel::COMMANDED_POSITION, 0.0f, 256));
+  Run(scope, 10, 1000, 1000000);
+  TEST_ASSERT_EQUAL(ScopeState::DONE, scope.State());
+  TEST_ASSERT_EQUAL_UINT16(10, scope.TriggerIndex());
+  TEST_ASSERT_EQUAL_UINT16(10 + SCOPE_DEPTH - 256, scope.Count());
+  ScopeSample sample;
+  TEST_ASSERT_EQUAL_UINT16(1, scope.Read(0, &sample, 1));
+  TEST_ASSERT_EQUAL_UINT32(0, sample.time_us);
+}
+
+void test_scope_threshold_and_error(void)
+{
+  ScopeCapture scope;
+  TEST_ASSERT_TRUE(scope.Arm(100, ScopeTrigger::RISING, ScopeChannel::COMMANDED_VELOCITY, 1996.5f, 10));
+  Run(scope, 10, 0, 1000000);
+  TEST_ASSERT_EQUAL(ScopeState::DONE, scope.State());
+  ScopeSample sample;
+  scope.Read(scope.TriggerIndex(), &sample, 1);
+  TEST_ASSERT_EQUAL_UINT32(199700, sample.time_us);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6f, 3.0f, ScopeCapture::ChannelValue(sample, ScopeChannel::FOLLOWING_ERROR));
+
+  // An error already set when armed isn't an edge
+  TEST_ASSERT_TRUE(scope.Arm(100, ScopeTrigger::ERROR, ScopeChannel::COMMANDED_POSITION, 0.0f, 1));
+  ScopeSample error = {};
+  error.status = 1 << SCOPE_STATUS_ERROR_SHIFT;
+  ScopeSample clear = {};
+  uint32_t now = 0;
+  const ScopeSample *sequence[] = {&error, &error, &clear, &error};
+  for (const ScopeSample *s : sequence)
+  {
+    TEST_ASSERT_TRUE(scope.Due(now));
+    scope.Record(*s, false);
+    now += 100;
+  }
+  TEST_ASSERT_EQUAL(ScopeState::TRIGGERED, scope.State());
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_scope_rejects_bad_settings);
+  RUN_TEST(test_scope_immediate_fills_ring);
+  RUN_TEST(test_scope_slow_interrupt_skips_samples);
+  RUN_TEST(test_scope_move_start_keeps_pre_trigger);
+  RUN_TEST(test_scope_short_pre_trigger);
+  RUN_TEST(test_scope_threshold_and_error);
+  return UNITY_END();
+}
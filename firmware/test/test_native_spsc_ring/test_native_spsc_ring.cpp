@@ -0,0 +1,161 @@
+#include <unity.h>
+#include <thread>
+#include "SpscRing/SpscRing.h"
+
+#define TEST_RING_SIZE 8
+#define TEST_STRESS_ITEMS 1000000UL
+
+// Two copies of the sequence number so a slot that was read while it was
+// still being written shows up as a mismatch
+struct TestItem
+{
+  uint32_t seq;
+  uint32_t check;
+  uint32_t pad[2];
+};
+
+static TestItem MakeItem(uint32_t seq)
+{
+  TestItem item = {seq, ~seq, {seq, seq}};
+  return item;
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+void test_ring_fifo_and_overflow(void)
+{
+  SpscRing<TestItem, TEST_RING_SIZE> ring;
+  TestItem item;
+
+  TEST_ASSERT_TRUE(ring.Empty());
+  TEST_ASSERT_NULL(ring.Front());
+  TEST_ASSERT_FALSE(ring.Pop(item));
+
+  for (uint32_t i = 0; i < TEST_RING_SIZE; i++)
+  {
+    TEST_ASSERT_TRUE(ring.Push(MakeItem(i)));
+  }
+  TEST_ASSERT_EQUAL_UINT32(TEST_RING_SIZE, ring.Size());
+  TEST_ASSERT_FALSE(ring.Push(MakeItem(99)));
+  TEST_ASSERT_FALSE(ring.Push(MakeItem(99)));
+  TEST_ASSERT_EQUAL_UINT32(2, ring.Overflows());
+  TEST_ASSERT_EQUAL_UINT32(TEST_RING_SIZE, ring.HighWater());
+
+  for (uint32_t i = 0; i < TEST_RING_SIZE; i++)
+  {
+    const TestItem *front = ring.Front();
+    TEST_ASSERT_NOT_NULL(front);
+    TEST_ASSERT_EQUAL_UINT32(i, front->seq);
+    ring.Pop();
+  }
+  TEST_ASSERT_TRUE(ring.Empty());
+
+  // Popping an empty ring must not move the consumer past the producer
+  ring.Pop();
+  TEST_ASSERT_EQUAL_UINT32(0, ring.Size());
+  TEST_ASSERT_TRUE(ring.Push(MakeItem(7)));
+  TEST_ASSERT_EQUAL_UINT32(1, ring.Size());
+}
+
+void test_ring_wraps_and_clears(void)
+{
+  SpscRing<TestItem, TEST_RING_SIZE> ring;
+  TestItem item;
+  uint32_t next_push = 0;
+  uint32_t next_pop = 0;
+
+  // Walk the indices around the ring many times at varying depths
+  for (uint32_t round = 0; round < 1000; round++)
+  {
+    uint32_t pushes = round % (TEST_RING_SIZE + 1);
+    for (uint32_t i = 0; i < pushes; i++)
+    {
+      if (ring.Push(MakeItem(next_push)))
+        next_push++;
+    }
+    uint32_t pops = (round * 7) % (TEST_RING_SIZE + 1);
+    for (uint32_t i = 0; i < pops && ring.Pop(item); i++)
+    {
+      TEST_ASSERT_EQUAL_UINT32(next_pop, item.seq);
+      next_pop++;
+    }
+    TEST_ASSERT_EQUAL_UINT32(next_push - next_pop, ring.Size());
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(TEST_RING_SIZE, ring.Size());
+  }
+
+  ring.Clear();
+  TEST_ASSERT_TRUE(ring.Empty());
+  TEST_ASSERT_TRUE(ring.Push(MakeItem(1234)));
+  TEST_ASSERT_TRUE(ring.Pop(item));
+  TEST_ASSERT_EQUAL_UINT32(1234, item.seq);
+
+  ring.ResetStats();
+  TEST_ASSERT_EQUAL_UINT32(0, ring.Overflows());
+  TEST_ASSERT_EQUAL_UINT32(0, ring.HighWater());
+}
+
+// A producer thread pushes a sequence as fast as it can while the consumer
+// pops it. Every item must arrive exactly once, in order and complete, the
+// depth must never go past the capacity and every push that failed must show
+// up in the overflow count. Both sides yield when they have to wait so the
+// test also makes progress on a single core host.
+void test_ring_concurrent_producer_consumer(void)
+{
+  static SpscRing<TestItem, TEST_RING_SIZE> ring;
+  uint32_t failed_pushes = 0;
+
+  std::thread producer([&failed_pushes]() {
+    uint32_t seq = 0;
+    while (seq < TEST_STRESS_ITEMS)
+    {
+      if (ring.Push(MakeItem(seq)))
+        seq++;
+      else
+      {
+        failed_pushes++;
+        std::this_thread::yield();
+      }
+    }
+  });
+
+  uint32_t expected = 0;
+  uint32_t errors = 0;
+  uint32_t max_depth = 0;
+  TestItem item;
+  while (expected < TEST_STRESS_ITEMS)
+  {
+    uint32_t depth = ring.Size();
+    if (depth > max_depth)
+      max_depth = depth;
+    if (!ring.Pop(item))
+    {
+      std::this_thread::yield();
+      continue;
+    }
+    if (item.seq != expected || item.check != ~expected || item.pad[0] != expected || item.pad[1] != expected)
+      errors++;
+    expected = item.seq + 1;
+  }
+  producer.join();
+
+  TEST_ASSERT_EQUAL_UINT32(0, errors);
+  TEST_ASSERT_TRUE(ring.Empty());
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(TEST_RING_SIZE, max_depth);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(TEST_RING_SIZE, ring.HighWater());
+  TEST_ASSERT_EQUAL_UINT32(failed_pushes, ring.Overflows());
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_ring_fifo_and_overflow);
+  RUN_TEST(test_ring_wraps_and_clears);
+  RUN_TEST(test_ring_concurrent_producer_consumer);
+  return UNITY_END();
+}
@@ -0,0 +1,142 @@
+#include <unity.h>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include "MotorController/StallDetector.h"
+
+#define TEST_STEPS_PER_DEGREE ((200.0 * 8.0) / 360.0)
+#define TEST_ENCODER_RESOLUTION 0.1 // degrees, as EncoderController rounds
+#define TEST_ENCODER_NOISE 0.1      // degrees peak
+#define TEST_ENCODER_LAG_US 3000    // encoder filter and update delay
+#define TEST_ENCODER_HOME 87.3      // encoder reading with the shaft at step 0
+
+// Encoder reading of a shaft position, in steps
+static float Encoder(double shaft_steps)
+{
+  double degrees = shaft_steps / TEST_STEPS_PER_DEGREE + TEST_ENCODER_HOME;
+  degrees += TEST_ENCODER_NOISE * (2.0 * rand() / RAND_MAX - 1.0);
+  return round(degrees / TEST_ENCODER_RESOLUTION) * TEST_ENCODER_RESOLUTION * TEST_STEPS_PER_DEGREE;
+}
+
+struct JamRun
+{
+  double trip_time = -1.0; // seconds, -1 when it never tripped
+  double lost_steps = 0.0; // commanded minus shaft at the trip
+};
+
+// Accelerates to `speed` steps/s and jams the shaft at `jam_time`, checking
+// every STALL_CHECK_PERIOD_US against a lagging, noisy encoder
+static JamRun RunJam(StallDetector &detector, double speed, double jam_time, double duration)
+{
+  const double acceleration = 20000.0;
+  srand(1);
+  detector.Reset(0.0f, Encoder(0.0));
+
+  JamRun run;
+  double jam_position = -1.0;
+  for (long us = STALL_CHECK_PERIOD_US; us <= duration * 1e6; us += STALL_CHECK_PERIOD_US)
+  {
+    double t = us * 1e-6;
+    double ramp = speed / acceleration;
+    double commanded = t < ramp ? 0.5 * acceleration * t * t : 0.5 * speed * ramp + speed * (t - ramp);
+
+    double seen = fmax(0.0, t - TEST_ENCODER_LAG_US * 1e-6);
+    double shaft = seen < ramp ? 0.5 * acceleration * seen * seen : 0.5 * speed * ramp + speed * (seen - ramp);
+    if (jam_time >= 0.0 && t >= jam_time && jam_position < 0.0)
+      jam_position = commanded;
+    if (jam_position >= 0.0)
+      shaft = fmin(shaft, jam_position);
+
+    if (detector.Update(floor(commanded), Encoder(shaft)) && run.trip_time < 0.0)
+    {
+      run.trip_time = t;
+      run.lost_steps = commanded - jam_position;
+    }
+  }
+  return run;
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+// A jam at full speed trips within a few checks of the error leaving the
+// window, long before a revolution (1600 steps) is lost
+void test_stall_detects_jam(void)
+{
+  StallDetector detector;
+  const double speed = 4000.0;
+  JamRun run = RunJam(detector, speed, 0.5, 1.0);
+
+  double window_time = STALL_DEFAULT_WINDOW_STEPS / speed;
+  double latency = run.trip_time - 0.5 - window_time;
+  printf("jam: tripped %.1f ms after leaving the window, %.0f steps lost\n", latency * 1e3, run.lost_steps);
+  TEST_ASSERT_TRUE(run.trip_time > 0.5);
+  TEST_ASSERT_TRUE(latency <= (STALL_CONFIRM_SAMPLES * STALL_CHECK_PERIOD_US + TEST_ENCODER_LAG_US) * 1e-6);
+  TEST_ASSERT_TRUE(run.lost_steps < STALL_DEFAULT_WINDOW_STEPS + 30);
+  TEST_ASSERT_EQUAL_UINT32(1, detector.Stalls());
+}
+
+// Encoder lag and noise on a healthy move stay inside the window
+void test_stall_ignores_healthy_move(void)
+{
+  StallDetector detector;
+  JamRun run = RunJam(detector, 6000.0, -1.0, 2.0);
+  printf("healthy: peak following error %.1f steps\n", detector.PeakError());
+  TEST_ASSERT_TRUE(run.trip_time < 0.0);
+  TEST_ASSERT_TRUE(detector.PeakError() < STALL_DEFAULT_WINDOW_STEPS / 2);
+  TEST_ASSERT_EQUAL_UINT32(0, detector.Stalls());
+}
+
+// One bad reading doesn't count, a stall is reported once until re-armed
+void test_stall_confirms_and_rearms(void)
+{
+  StallDetector detector;
+  detector.SetWindow(10);
+  detector.Reset(1000.0f, 50.0f);
+  TEST_ASSERT_FALSE(detector.Update(1000.0f, 55.0f));
+  TEST_ASSERT_EQUAL_FLOAT(-5.0f, detector.Error());
+  TEST_ASSERT_FALSE(detector.Update(1000.0f, 80.0f));
+  TEST_ASSERT_FALSE(detector.Update(1000.0f, 50.0f));
+
+  for (int i = 1; i < STALL_CONFIRM_SAMPLES; i++)
+    TEST_ASSERT_FALSE(detector.Update(1100.0f, 50.0f));
+  TEST_ASSERT_TRUE(detector.Update(1100.0f, 50.0f));
+  TEST_ASSERT_FALSE(detector.Update(1100.0f, 50.0f));
+  TEST_ASSERT_EQUAL_UINT32(1, detector.Stalls());
+  TEST_ASSERT_EQUAL_FLOAT(100.0f, detector.PeakError());
+
+  // Re-sync: the commanded position takes the encoder's
+  detector.Reset(1000.0f, 50.0f);
+  TEST_ASSERT_FALSE(detector.Update(1000.0f, 50.0f));
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, detector.Error());
+
+  detector.ClearStatistics();
+  TEST_ASSERT_EQUAL_UINT32(0, detector.Stalls());
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, detector.PeakError());
+}
+
+void test_stall_window_zero_disables(void)
+{
+  StallDetector detector;
+  detector.SetWindow(0);
+  detector.Reset(0.0f, 0.0f);
+  for (int i = 0; i < 10; i++)
+    TEST_ASSERT_FALSE(detector.Update(10000.0f, 0.0f));
+  TEST_ASSERT_EQUAL_FLOAT(10000.0f, detector.PeakError());
+  TEST_ASSERT_EQUAL_UINT32(0, detector.Stalls());
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_stall_detects_jam);
+  RUN_TEST(test_stall_ignores_healthy_move);
+  RUN_TEST(test_stall_confirms_and_rearms);
+  RUN_TEST(test_stall_window_zero_disables);
+  return UNITY_END();
+}
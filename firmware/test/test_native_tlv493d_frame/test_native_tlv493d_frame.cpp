@@ -0,0 +1,88 @@
+#include <unity.h>
+#include <cmath>
+#include "EncoderController/Tlv493dFrame.h"
+
+// Tlv493d::concatResults() as the library has it, for comparison
+static int16_t LibraryConcat(uint8_t upperByte, uint8_t lowerByte, bool upperFull)
+{
+  int16_t value = 0x0000;
+  if (upperFull)
+  {
+    value = upperByte << 8;
+    value |= (lowerByte & 0x0F) << 4;
+  }
+  else
+  {
+    value = (upperByte & 0x0F) << 12;
+    value |= lowerByte << 4;
+  }
+  value >>= 4;
+  return value;
+}
+
+static void Encode(uint8_t *frame, int16_t x, int16_t y, int16_t z, uint8_t channel)
+{
+  frame[0] = (uint8_t)(x >> 4);
+  frame[1] = (uint8_t)(y >> 4);
+  frame[2] = (uint8_t)(z >> 4);
+  frame[3] = 0xA0 | (channel & 0x03); // temperature and frame counter bits set
+  frame[4] = (uint8_t)((x & 0x0F) << 4) | (y & 0x0F);
+  frame[5] = 0x50 | (z & 0x0F);       // power down flag and reserved bits set
+  frame[6] = 0x3C;
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+// Every 12 bit value and nibble matches the library
+void test_frame_concat_matches_library(void)
+{
+  for (int upper = 0; upper < 256; upper++)
+  {
+    for (int nibble = 0; nibble < 16; nibble++)
+    {
+      TEST_ASSERT_EQUAL(LibraryConcat(upper, nibble, true), Tlv493dConcat(upper, nibble));
+    }
+  }
+}
+
+void test_frame_decodes_axes(void)
+{
+  const int16_t values[][3] = {{0, 0, 0}, {2047, -2048, -1}, {-1234, 567, 89}, {1, -1, 2047}};
+  for (auto &v : values)
+  {
+    uint8_t frame[TLV493D_FRAME_LENGTH];
+    Encode(frame, v[0], v[1], v[2], 0);
+    Tlv493dField field;
+    TEST_ASSERT_TRUE(Tlv493dDecodeFrame(frame, field));
+    TEST_ASSERT_EQUAL(v[0], field.x);
+    TEST_ASSERT_EQUAL(v[1], field.y);
+    TEST_ASSERT_EQUAL(v[2], field.z);
+  }
+}
+
+// A frame whose axes come from different conversions still decodes
+void test_frame_reports_channel(void)
+{
+  uint8_t frame[TLV493D_FRAME_LENGTH];
+  Encode(frame, 100, -200, 300, 2);
+  Tlv493dField field;
+  TEST_ASSERT_FALSE(Tlv493dDecodeFrame(frame, field));
+  TEST_ASSERT_EQUAL(100, field.x);
+  TEST_ASSERT_EQUAL(-200, field.y);
+  TEST_ASSERT_EQUAL(300, field.z);
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_frame_concat_matches_library);
+  RUN_TEST(test_frame_decodes_axes);
+  RUN_TEST(test_frame_reports_channel);
+  return UNITY_END();
+}
@@ -0,0 +1,265 @@
+#include <unity.h>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+#include "MotorController/VelocityPlanner.h"
+
+#define TEST_ACCELERATION 3200.0f
+#define TEST_MAX_SPEED 800.0f
+
+// Relative accelerations above acceleration() this small are float noise
+#define TEST_ACCEL_TOLERANCE 1.0e-3
+
+struct TestSegment
+{
+  long steps;
+  float speed;
+};
+
+// Runs the queue the way MotorController::OnTimer() does in VELOCITY_STEP
+// mode and keeps the worst case of every step
+struct PathRunner
+{
+  long pos = 0;
+  long end = 0;
+  bool active = false;
+  bool forward = true;
+  float speed = 0.0f;
+  float nominal = 0.0f;
+  double time = 0.0;
+  long steps = 0;
+
+  // Signed mean speed over the last interval, for the acceleration estimate
+  double last_dt = 0.0;
+  double last_mean = 0.0;
+
+  double max_accel = 0.0;     // from consecutive step intervals
+  double max_accel_sq = 0.0;  // from the squared speeds of consecutive steps
+  double max_overspeed = 0.0; // above the running segment's speed
+  double max_reversal_speed = 0.0;
+  std::vector<float> junction_speeds;
+
+  // One step, false once the queue has drained
+  bool Step(VelocityPlanner &planner)
+  {
+    if (!active || pos == end)
+    {
+      if (active)
+      {
+        planner.Finish();
+        active = false;
+      }
+      const VelocityPlanner::Segment *segment = planner.Current();
+      if (segment == nullptr)
+        return false;
+      if (steps > 0)
+        junction_speeds.push_back(speed);
+      active = true;
+      end = segment->end;
+      bool fwd = end > pos;
+      if (fwd != forward)
+      {
+        max_reversal_speed = fmax(max_reversal_speed, speed);
+        speed = 0.0f;
+      }
+      forward = fwd;
+      nominal = segment->speed;
+    }
+
+    uint32_t steps_left = end > pos ? end - pos : pos - end;
+    float next = planner.NextSpeed(speed, steps_left);
+    double dt = planner.StepTime(speed, next);
+
+    double accel_sq = fabs((double)next * next - (double)speed * speed) / 2.0;
+    max_accel_sq = fmax(max_accel_sq, accel_sq);
+    if (speed <= nominal)
+      max_overspeed = fmax(max_overspeed, next - nominal);
+
+    double mean = (forward ? 1.0 : -1.0) / dt;
+    if (last_dt > 0.0)
+      max_accel = fmax(max_accel, fabs(mean - last_mean) / ((dt + last_dt) / 2.0));
+    last_dt = dt;
+    last_mean = mean;
+
+    pos += forward ? 1 : -1;
+    speed = next;
+    time += dt;
+    steps++;
+    return true;
+  }
+};
+
+static void SetupPlanner(VelocityPlanner &planner)
+{
+  planner.SetAcceleration(TEST_ACCELERATION);
+  planner.SetMaxSpeed(TEST_MAX_SPEED);
+}
+
+static void AddRelative(VelocityPlanner &planner, long steps, float speed)
+{
+  long start = planner.LastEnd(0);
+  TEST_ASSERT_TRUE(planner.Add(start, start + steps, speed));
+}
+
+static void CheckLimits(const PathRunner &run)
+{
+  TEST_ASSERT_TRUE(run.max_accel <= TEST_ACCELERATION * (1.0 + TEST_ACCEL_TOLERANCE));
+  TEST_ASSERT_TRUE(run.max_accel_sq <= TEST_ACCELERATION * (1.0 + TEST_ACCEL_TOLERANCE));
+  TEST_ASSERT_TRUE(run.max_overspeed <= 0.01);
+  TEST_ASSERT_TRUE(run.max_reversal_speed <= 0.01);
+  TEST_ASSERT_TRUE(run.speed <= 0.01f);
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+void test_planner_blends_junctions(void)
+{
+  static const TestSegment path[] = {
+      {1600, 800}, // reaches full speed
+      {800, 400},  // slower, entered at 400
+      {1600, 800}, // faster again, left at 400
+      {-400, 600}, // reversal, through 0
+      {100, 800},  // too short to reach 800
+  };
+  VelocityPlanner planner;
+  SetupPlanner(planner);
+  long distance = 0;
+  long travel = 0;
+  for (const TestSegment &s : path)
+  {
+    AddRelative(planner, s.steps, s.speed);
+    distance += s.steps;
+    travel += labs(s.steps);
+  }
+
+  PathRunner run;
+  while (run.Step(planner))
+  {
+  }
+  printf("path: %ld steps in %.3f s, max acceleration %.1f\n", run.steps, run.time, run.max_accel);
+
+  CheckLimits(run);
+  TEST_ASSERT_EQUAL(distance, run.pos);
+  TEST_ASSERT_EQUAL(travel, run.steps);
+  TEST_ASSERT_EQUAL(0, planner.Size());
+
+  // The speed at each junction: full blend into the slower segment, the
+  // slower one's speed out of it, a stop at the reversal
+  TEST_ASSERT_EQUAL(4, run.junction_speeds.size());
+  TEST_ASSERT_FLOAT_WITHIN(1.0f, 400.0f, run.junction_speeds[0]);
+  TEST_ASSERT_FLOAT_WITHIN(1.0f, 400.0f, run.junction_speeds[1]);
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, 0.0f, run.junction_speeds[2]);
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, 0.0f, run.junction_speeds[3]);
+}
+
+// Segments arrive while the path runs, a few ahead of the one running. The
+// motor must keep moving through every junction and still stop at the end.
+void test_planner_streaming(void)
+{
+  VelocityPlanner planner;
+  SetupPlanner(planner);
+  const int segments = 40;
+  int added = 0;
+  long distance = 0;
+  for (; added < 3; added++)
+  {
+    AddRelative(planner, 200, added % 2 ? 600 : 800);
+    distance += 200;
+  }
+
+  PathRunner run;
+  while (run.Step(planner))
+  {
+    if (added < segments && planner.Size() < 3)
+    {
+      AddRelative(planner, 200, added % 2 ? 600 : 800);
+      distance += 200;
+      added++;
+    }
+  }
+
+  CheckLimits(run);
+  TEST_ASSERT_EQUAL(distance, run.pos);
+  TEST_ASSERT_EQUAL(segments - 1, run.junction_speeds.size());
+  float min_junction = TEST_MAX_SPEED;
+  for (float v : run.junction_speeds)
+    min_junction = fmin(min_junction, v);
+  printf("streaming: slowest junction %.1f steps/s\n", min_junction);
+  TEST_ASSERT_TRUE(min_junction > 500.0f);
+}
+
+// Every Add() visits at most `depth` segments. A shorter look-ahead plans
+// more cautiously but stays within the acceleration.
+void test_planner_depth_bounds_work(void)
+{
+  float peak[2];
+  uint32_t depths[2] = {4, VELOCITY_STEP_QUEUE_SIZE};
+  for (int d = 0; d < 2; d++)
+  {
+    VelocityPlanner planner;
+    SetupPlanner(planner);
+    TEST_ASSERT_TRUE(planner.SetDepth(depths[d]));
+    for (int i = 0; i < 60; i++)
+    {
+      AddRelative(planner, 5, 800);
+      TEST_ASSERT_LESS_OR_EQUAL_UINT32(depths[d], planner.LastPlanLength());
+    }
+
+    PathRunner run;
+    peak[d] = 0.0f;
+    while (run.Step(planner))
+      peak[d] = fmax(peak[d], run.speed);
+    CheckLimits(run);
+    TEST_ASSERT_EQUAL(300, run.pos);
+  }
+  printf("peak speed with depth %u: %.1f, depth %u: %.1f\n", (unsigned)depths[0], peak[0], (unsigned)depths[1], peak[1]);
+  TEST_ASSERT_TRUE(peak[0] < peak[1]);
+
+  VelocityPlanner planner;
+  TEST_ASSERT_FALSE(planner.SetDepth(0));
+  TEST_ASSERT_FALSE(planner.SetDepth(VELOCITY_STEP_QUEUE_SIZE + 1));
+  TEST_ASSERT_EQUAL(VELOCITY_PLANNER_DEFAULT_DEPTH, planner.Depth());
+}
+
+// A rejected segment must not disturb the plan of the running one
+void test_planner_queue_full(void)
+{
+  VelocityPlanner planner;
+  SetupPlanner(planner);
+  for (uint32_t i = 0; i < VELOCITY_STEP_QUEUE_SIZE; i++)
+    AddRelative(planner, 100, 800);
+
+  float exit = planner.ExitSpeed();
+  TEST_ASSERT_TRUE(exit > 0.0f);
+  long start = planner.LastEnd(0);
+  TEST_ASSERT_FALSE(planner.Add(start, start + 100, 800));
+  TEST_ASSERT_EQUAL_UINT32(1, planner.Overflows());
+  TEST_ASSERT_EQUAL_FLOAT(exit, planner.ExitSpeed());
+
+  // Segments without steps are dropped, not queued
+  TEST_ASSERT_TRUE(planner.Add(start, start, 800));
+  TEST_ASSERT_EQUAL_UINT32(VELOCITY_STEP_QUEUE_SIZE, planner.Size());
+
+  PathRunner run;
+  while (run.Step(planner))
+  {
+  }
+  CheckLimits(run);
+  TEST_ASSERT_EQUAL(100 * VELOCITY_STEP_QUEUE_SIZE, run.pos);
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_planner_blends_junctions);
+  RUN_TEST(test_planner_streaming);
+  RUN_TEST(test_planner_depth_bounds_work);
+  RUN_TEST(test_planner_queue_full);
+  return UNITY_END();
+}
@@ -39,6 +39,47 @@ const MESSAGE_TYPES = {
   SetRelativeTargetPositionId: 0x0401,
   SetVelocityId: 0x0313,
   GetVelocityId: 0x0314,
+  GetMotionQueueStatusId: 0x0315,
+  SetMotionProfileId: 0x0316,
+  GetMotionProfileId: 0x0317,
+  SetJerkId: 0x0318,
+  GetJerkId: 0x0319,
+  SetPlannerDepthId: 0x031A,
+  GetPlannerDepthId: 0x031B,
+  AddPvtPointId: 0x031C,
+  SetPvtDelayId: 0x031D,
+  GetPvtDelayId: 0x031E,
+  GetPvtStatusId: 0x031F,
+  SetClosedLoopId: 0x0320,
+  GetClosedLoopId: 0x0321,
+  SetClosedLoopGainsId: 0x0322,
+  GetClosedLoopGainsId: 0x0323,
+  GetClosedLoopStatusId: 0x0324,
+  SetStallWindowId: 0x0325,
+  GetStallWindowId: 0x0326,
+  SetStallActionId: 0x0327,
+  GetStallActionId: 0x0328,
+  GetFollowingErrorId: 0x0329,
+  GetMotorErrorsId: 0x032A,
+  ClearMotorErrorsId: 0x032B,
+  GetProfileId: 0x032C,
+  ResetProfileId: 0x032D,
+  GetEncoderBusStatsId: 0x032E,
+  SetEncoderObserverId: 0x032F,
+  GetEncoderObserverId: 0x0330,
+  CalibrateEncoderId: 0x0331,
+  GetEncoderCalibrationId: 0x0332,
+  ClearEncoderCalibrationId: 0x0333,
+  ArmScopeId: 0x0334,
+  StopScopeId: 0x0335,
+  GetScopeStatusId: 0x0336,
+  GetScopeDataId: 0x0337,
+  SubscribeTelemetryId: 0x0338,
+  TelemetryId: 0x0339,
+  SetChecksumModeId: 0x033A,
+  GetChecksumModeId: 0x033B,
+  GetRejectedFramesId: 0x033C,
+  BatchId: 0x033D,
   SetVelocityAndStepsId: 0x0402,
   StartPathId: 0x0403,
 };
@@ -68,6 +109,8 @@ const MOTOR_STATES = {
   VELOCITY_STEP: 0x3,
   IDLE_ON: 0x4,
   HOME: 0x5,
+  PVT: 0x6,
+  CALIBRATE: 0x7,
 };
 
 // Motor Brake Modes
@@ -90,8 +133,119 @@ const POSITION_MODE = {
   RELATIVE: 0x1,
 };
 
-// Calculate checksum (16-bit sum of header + body)
-function calculateChecksum(data) {
+// Motion Profile
+const MOTION_PROFILE = {
+  TRAPEZOIDAL: 0x0,
+  S_CURVE: 0x1,
+};
+
+// Stall Action
+const STALL_ACTION = {
+  REPORT: 0x0,
+  STOP: 0x1,
+  RESYNC: 0x2,
+};
+
+// Telemetry frame fields, values follow in bit order
+const TELEMETRY_FIELDS = {
+  POSITION: 0x001,
+  TARGET_POSITION: 0x002,
+  VELOCITY: 0x004,
+  MOTOR_STATE: 0x008,
+  HOMED: 0x010,
+  ENCODER_POSITION: 0x020,
+  ENCODER_VELOCITY: 0x040,
+  FOLLOWING_ERROR: 0x080,
+  ERRORS: 0x100,
+  ALL: 0x1FF,
+};
+
+// Scope capture trigger
+const SCOPE_TRIGGER = {
+  IMMEDIATE: 0x0,
+  MOVE_START: 0x1,
+  ERROR: 0x2,
+  RISING: 0x3,
+  FALLING: 0x4,
+};
+
+// Scope channel, for the RISING and FALLING triggers
+const SCOPE_CHANNEL = {
+  COMMANDED_POSITION: 0x0,
+  ENCODER_POSITION: 0x1,
+  FOLLOWING_ERROR: 0x2,
+  COMMANDED_VELOCITY: 0x3,
+  ENCODER_VELOCITY: 0x4,
+};
+
+// Scope capture state
+const SCOPE_STATE = {
+  IDLE: 0x0,
+  ARMED: 0x1,
+  TRIGGERED: 0x2,
+  DONE: 0x3,
+};
+
+// Footer checksum, negotiated per interface with buildSetChecksumMode
+const CHECKSUM_MODE = {
+  SUM: 0x0,
+  CRC16: 0x1,
+};
+
+// Motor Error bits
+const MOTOR_ERRORS = {
+  LOST_POWER: 0x1,
+  TMC_LOST_COMMS: 0x2,
+  STALL: 0x4,
+};
+
+// Profiler probes, tasks follow TASK_0 in the order they were added
+const PROFILE_PROBE = {
+  STEP_ISR: 0,
+  ETHERNET_ISR: 1,
+  MESSAGE: 2,
+  TASK_0: 3,
+  ENCODER_ANGLE: 11,
+  CHECKSUM: 12,
+  STEP_LATENCY: 13,
+};
+
+// CRC-16/CCITT-FALSE lookup, polynomial 0x1021
+const CRC16_TABLE = (() => {
+  const table = new Uint16Array(256);
+  for (let byte = 0; byte < 256; byte++) {
+    let crc = byte << 8;
+    for (let bit = 0; bit < 8; bit++) {
+      crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+    table[byte] = crc & 0xFFFF;
+  }
+  return table;
+})();
+
+// Footer used by buildMessage and verifyChecksum
+let checksumMode = CHECKSUM_MODE.SUM;
+
+// Call once the device has acknowledged buildSetChecksumMode(mode)
+function setChecksumMode(mode) {
+  checksumMode = mode;
+}
+
+function getChecksumMode() {
+  return checksumMode;
+}
+
+function crc16Ccitt(data) {
+  let crc = 0xFFFF;
+  for (let i = 0; i < data.length; i++) {
+    crc = ((crc << 8) & 0xFFFF) ^ CRC16_TABLE[(crc >> 8) ^ data[i]];
+  }
+  return crc;
+}
+
+// Calculate checksum of header + body, 16-bit sum or CRC-16 by mode
+function calculateChecksum(data, mode = checksumMode) {
+  if (mode === CHECKSUM_MODE.CRC16) return crc16Ccitt(data);
   let sum = 0;
   for (let i = 0; i < data.length; i++) {
     sum += data[i];
@@ -336,6 +490,256 @@ function buildStartPath(pathId) {
   return buildMessage(MESSAGE_TYPES.StartPathId, body);
 }
 
+function buildGetMotionQueueStatus() {
+  return buildMessage(MESSAGE_TYPES.GetMotionQueueStatusId, new Uint8Array(0));
+}
+
+function buildSetMotionProfile(profile) {
+  const body = new Uint8Array([profile]);
+  return buildMessage(MESSAGE_TYPES.SetMotionProfileId, body);
+}
+
+function buildGetMotionProfile() {
+  return buildMessage(MESSAGE_TYPES.GetMotionProfileId, new Uint8Array(0));
+}
+
+function buildSetJerk(jerk) {
+  const body = new ArrayBuffer(4);
+  const view = new DataView(body);
+  view.setUint32(0, jerk, true);
+  return buildMessage(MESSAGE_TYPES.SetJerkId, new Uint8Array(body));
+}
+
+function buildGetJerk() {
+  return buildMessage(MESSAGE_TYPES.GetJerkId, new Uint8Array(0));
+}
+
+function buildSetPlannerDepth(depth) {
+  const body = new Uint8Array([depth]);
+  return buildMessage(MESSAGE_TYPES.SetPlannerDepthId, body);
+}
+
+function buildGetPlannerDepth() {
+  return buildMessage(MESSAGE_TYPES.GetPlannerDepthId, new Uint8Array(0));
+}
+
+function buildAddPvtPoint(timeUs, position, velocity) {
+  const body = new ArrayBuffer(12);
+  const view = new DataView(body);
+  view.setUint32(0, timeUs >>> 0, true);
+  view.setInt32(4, position, true);
+  view.setInt32(8, velocity, true);
+  return buildMessage(MESSAGE_TYPES.AddPvtPointId, new Uint8Array(body));
+}
+
+function buildSetPvtDelay(delayUs) {
+  const body = new ArrayBuffer(4);
+  const view = new DataView(body);
+  view.setUint32(0, delayUs, true);
+  return buildMessage(MESSAGE_TYPES.SetPvtDelayId, new Uint8Array(body));
+}
+
+function buildGetPvtDelay() {
+  return buildMessage(MESSAGE_TYPES.GetPvtDelayId, new Uint8Array(0));
+}
+
+function buildGetPvtStatus() {
+  return buildMessage(MESSAGE_TYPES.GetPvtStatusId, new Uint8Array(0));
+}
+
+function buildSetClosedLoop(enabled) {
+  const body = new Uint8Array([enabled ? 1 : 0]);
+  return buildMessage(MESSAGE_TYPES.SetClosedLoopId, body);
+}
+
+function buildGetClosedLoop() {
+  return buildMessage(MESSAGE_TYPES.GetClosedLoopId, new Uint8Array(0));
+}
+
+function buildSetClosedLoopGains(p, i, d, limit) {
+  const body = new ArrayBuffer(16);
+  const view = new DataView(body);
+  view.setFloat32(0, p, true);
+  view.setFloat32(4, i, true);
+  view.setFloat32(8, d, true);
+  view.setFloat32(12, limit, true);
+  return buildMessage(MESSAGE_TYPES.SetClosedLoopGainsId, new Uint8Array(body));
+}
+
+function buildGetClosedLoopGains() {
+  return buildMessage(MESSAGE_TYPES.GetClosedLoopGainsId, new Uint8Array(0));
+}
+
+function buildGetClosedLoopStatus() {
+  return buildMessage(MESSAGE_TYPES.GetClosedLoopStatusId, new Uint8Array(0));
+}
+
+function buildSetStallWindow(window) {
+  const body = new ArrayBuffer(4);
+  const view = new DataView(body);
+  view.setUint32(0, window, true);
+  return buildMessage(MESSAGE_TYPES.SetStallWindowId, new Uint8Array(body));
+}
+
+function buildGetStallWindow() {
+  return buildMessage(MESSAGE_TYPES.GetStallWindowId, new Uint8Array(0));
+}
+
+function buildSetStallAction(action) {
+  const body = new Uint8Array([action]);
+  return buildMessage(MESSAGE_TYPES.SetStallActionId, body);
+}
+
+function buildGetStallAction() {
+  return buildMessage(MESSAGE_TYPES.GetStallActionId, new Uint8Array(0));
+}
+
+function buildGetFollowingError() {
+  return buildMessage(MESSAGE_TYPES.GetFollowingErrorId, new Uint8Array(0));
+}
+
+function buildGetMotorErrors() {
+  return buildMessage(MESSAGE_TYPES.GetMotorErrorsId, new Uint8Array(0));
+}
+
+function buildClearMotorErrors() {
+  return buildMessage(MESSAGE_TYPES.ClearMotorErrorsId, new Uint8Array(0));
+}
+
+function buildGetProfile(probe) {
+  const body = new Uint8Array([probe]);
+  return buildMessage(MESSAGE_TYPES.GetProfileId, body);
+}
+
+function buildResetProfile() {
+  return buildMessage(MESSAGE_TYPES.ResetProfileId, new Uint8Array(0));
+}
+
+function buildGetEncoderBusStats() {
+  return buildMessage(MESSAGE_TYPES.GetEncoderBusStatsId, new Uint8Array(0));
+}
+
+function buildSetEncoderObserver(alpha, beta, feedForward) {
+  const body = new ArrayBuffer(9);
+  const view = new DataView(body);
+  view.setFloat32(0, alpha, true);
+  view.setFloat32(4, beta, true);
+  view.setUint8(8, feedForward ? 1 : 0);
+  return buildMessage(MESSAGE_TYPES.SetEncoderObserverId, new Uint8Array(body));
+}
+
+function buildGetEncoderObserver() {
+  return buildMessage(MESSAGE_TYPES.GetEncoderObserverId, new Uint8Array(0));
+}
+
+function buildCalibrateEncoder() {
+  return buildMessage(MESSAGE_TYPES.CalibrateEncoderId, new Uint8Array(0));
+}
+
+function buildGetEncoderCalibration() {
+  return buildMessage(MESSAGE_TYPES.GetEncoderCalibrationId, new Uint8Array(0));
+}
+
+function buildClearEncoderCalibration() {
+  return buildMessage(MESSAGE_TYPES.ClearEncoderCalibrationId, new Uint8Array(0));
+}
+
+function buildArmScope(periodUs, trigger, channel = SCOPE_CHANNEL.COMMANDED_POSITION, level = 0, preTrigger = 0) {
+  const body = new ArrayBuffer(12);
+  const view = new DataView(body);
+  view.setUint32(0, periodUs, true);
+  view.setUint8(4, trigger);
+  view.setUint8(5, channel);
+  view.setFloat32(6, level, true);
+  view.setUint16(10, preTrigger, true);
+  return buildMessage(MESSAGE_TYPES.ArmScopeId, new Uint8Array(body));
+}
+
+function buildStopScope() {
+  return buildMessage(MESSAGE_TYPES.StopScopeId, new Uint8Array(0));
+}
+
+function buildGetScopeStatus() {
+  return buildMessage(MESSAGE_TYPES.GetScopeStatusId, new Uint8Array(0));
+}
+
+function buildSubscribeTelemetry(fields, periodMs) {
+  const body = new ArrayBuffer(4);
+  const view = new DataView(body);
+  view.setUint16(0, fields, true);
+  view.setUint16(2, periodMs, true);
+  return buildMessage(MESSAGE_TYPES.SubscribeTelemetryId, new Uint8Array(body));
+}
+
+// Built and acknowledged in the current mode, switch with setChecksumMode after the ACK
+function buildSetChecksumMode(mode) {
+  return buildMessage(MESSAGE_TYPES.SetChecksumModeId, new Uint8Array([mode]));
+}
+
+function buildGetChecksumMode() {
+  return buildMessage(MESSAGE_TYPES.GetChecksumModeId, new Uint8Array(0));
+}
+
+function buildGetRejectedFrames() {
+  return buildMessage(MESSAGE_TYPES.GetRejectedFramesId, new Uint8Array(0));
+}
+
+// Commands in one Batch message
+const BATCH_MAX_COMMANDS = 16;
+
+// Set in message_type when a request id follows the body
+const REQUEST_ID_FLAG = 0x8000;
+
+// Replies the device keeps for retries, more requests in flight than this
+// may run twice when retried
+const REQUEST_HISTORY = 8;
+
+// Adds a request id to a built message, replies to it carry the same id
+function withRequestId(msg, requestId) {
+  const view = new DataView(msg.buffer, msg.byteOffset);
+  const type = view.getUint16(0, true);
+  const body = new Uint8Array(msg.length - 4);
+  body.set(msg.subarray(4, msg.length - 2), 0);
+  new DataView(body.buffer).setUint16(body.length - 2, requestId, true);
+  return buildMessage(type | REQUEST_ID_FLAG, body);
+}
+
+// Separates the request id from a reply, for the parsers below. requestId
+// is null for a message without one.
+function splitRequestId(data) {
+  const { messageType, bodySize } = parseMessageHeader(data);
+  if (!(messageType & REQUEST_ID_FLAG)) return { requestId: null, message: data };
+  if (!verifyChecksum(data) || bodySize < 2 || data.length !== bodySize + 6) {
+    throw new Error('Invalid message with a request id');
+  }
+  const requestId = new DataView(data.buffer, data.byteOffset + data.length - 4).getUint16(0, true);
+  const message = buildMessage(messageType & ~REQUEST_ID_FLAG, data.slice(4, data.length - 4));
+  return { requestId, message };
+}
+
+// Runs `messages`, built with the functions above, in order with one
+// response. Only ones the device answers with an ACK can be batched.
+function buildBatch(messages) {
+  if (messages.length === 0 || messages.length > BATCH_MAX_COMMANDS) {
+    throw new Error(`A batch holds 1 to ${BATCH_MAX_COMMANDS} commands`);
+  }
+  // The batch footer covers the commands
+  const commands = messages.map(msg => msg.subarray(0, msg.length - 2));
+  const body = new Uint8Array(commands.reduce((size, c) => size + c.length, 0));
+  let offset = 0;
+  for (const c of commands) {
+    body.set(c, offset);
+    offset += c.length;
+  }
+  return buildMessage(MESSAGE_TYPES.BatchId, body);
+}
+
+function buildGetScopeData(first) {
+  const body = new ArrayBuffer(2);
+  new DataView(body).setUint16(0, first, true);
+  return buildMessage(MESSAGE_TYPES.GetScopeDataId, new Uint8Array(body));
+}
+
 // Message parsers
 
 function parseAck(data) {
@@ -470,6 +874,259 @@ function parseGetVelocity(data) {
   return { velocity };
 }
 
+function parseGetMotionQueueStatus(data) {
+  if (data.length !== 16) throw new Error('Invalid Get Motion Queue Status response length');
+  const view = new DataView(data.buffer, data.byteOffset + 4);
+  const depth = view.getUint16(0, true);
+  const capacity = view.getUint16(2, true);
+  const highWater = view.getUint16(4, true);
+  const overflows = view.getUint32(6, true);
+  return { depth, capacity, highWater, overflows };
+}
+
+function parseGetMotionProfile(data) {
+  if (data.length !== 7) throw new Error('Invalid Get Motion Profile response length');
+  const view = new DataView(data.buffer, data.byteOffset + 4);
+  const profile = view.getUint8(0);
+  return { profile };
+}
+
+function parseGetJerk(data) {
+  if (data.length !== 10) throw new Error('Invalid Get Jerk response length');
+  const view = new DataView(data.buffer, data.byteOffset + 4);
+  const jerk = view.getUint32(0, true);
+  return { jerk };
+}
+
+function parseGetPlannerDepth(data) {
+  if (data.length !== 7) throw new Error('Invalid Get Planner Depth response length');
+  const view = new DataView(data.buffer, data.byteOffset + 4);
+  const depth = view.getUint8(0);
+  return { depth };
+}
+
+function parseGetPvtDelay(data) {
+  if (data.length !== 10) throw new Error('Invalid Get PVT Delay response length');
+  const view = new DataView(data.buffer, data.byteOffset + 4);
+  const delayUs = view.getUint32(0, true);
+  return { delayUs };
+}
+
+function parseGetPvtStatus(data) {
+  if (data.length !== 18) throw new Error('Invalid Get PVT Status response length');
+  const view = new DataView(data.buffer, data.byteOffset + 4);
+  const buffered = view.getUint16(0, true);
+  const capacity = view.getUint16(2, true);
+  const underruns = view.getUint32(4, true);
+  const overflows = view.getUint32(8, true);
+  return { buffered, capacity, underruns, overflows };
+}
+
+function parseGetClosedLoop(data) {
+  if (data.length !== 7) throw new Error('Invalid Get Closed Loop response length');
+  const view = new DataView(data.buffer, data.byteOffset + 4);
+  const enabled = view.getUint8(0) !== 0;
+  return { enabled };
+}
+
+function parseGetClosedLoopGains(data) {
+  if (data.length !== 22) throw new Error('Invalid Get Closed Loop Gains response length');
+  const view = new DataView(data.buffer, data.byteOffset + 4);
+  const p = view.getFloat32(0, true);
+  const i = view.getFloat32(4, true);
+  const d = view.getFloat32(8, true);
+  const limit = view.getFloat32(12, true);
+  return { p, i, d, limit };
+}
+
+function parseGetClosedLoopStatus(data) {
+  if (data.length !== 18) throw new Error('Invalid Get Closed Loop Status response length');
+  const view = new DataView(data.buffer, data.byteOffset + 4);
+  const error = view.getFloat32(0, true);
+  const correction = view.getFloat32(4, true);
+  const offset = view.getInt32(8, true);
+  return { error, correction, offset };
+}
+
+function parseGetStallWindow(data) {
+  if (data.length !== 10) throw new Error('Invalid Get Stall Window response length');
+  const view = new DataView(data.buffer, data.byteOffset + 4);
+  const window = view.getUint32(0, true);
+  return { window };
+}
+
+function parseGetStallAction(data) {
+  if (data.length !== 7) throw new Error('Invalid Get Stall Action response length');
+  const view = new DataView(data.buffer, data.byteOffset + 4);
+  const action = view.getUint8(0);
+  return { action };
+}
+
+function parseGetFollowingError(data) {
+  if (data.length !== 18) throw new Error('Invalid Get Following Error response length');
+  const view = new DataView(data.buffer, data.byteOffset + 4);
+  const error = view.getFloat32(0, true);
+  const peak = view.getFloat32(4, true);
+  const stalls = view.getUint32(8, true);
+  return { error, peak, stalls };
+}
+
+function parseGetMotorErrors(data) {
+  if (data.length !== 10) throw new Error('Invalid Get Motor Errors response length');
+  const view = new DataView(data.buffer, data.byteOffset + 4);
+  const errors = view.getUint32(0, true);
+  return { errors };
+}
+
+function parseGetProfile(data) {
+  if (data.length !== 91) throw new Error('Invalid Get Profile response length');
+  const view = new DataView(data.buffer, data.byteOffset + 4);
+  const probe = view.getUint8(0);
+  const clockHz = view.getUint32(1, true);
+  const count = view.getUint32(5, true);
+  const min = view.getUint32(9, true);
+  const max = view.getUint32(13, true);
+  const mean = view.getUint32(17, true);
+  const histogram = [];
+  for (let i = 0; i < 16; i++) {
+    histogram.push(view.getUint32(21 + i * 4, true));
+  }
+  return { probe, clockHz, count, min, max, mean, histogram };
+}
+
+function parseGetEncoderBusStats(data) {
+  if (data.length !== 26) throw new Error('Invalid Get Encoder Bus Stats response length');
+  const view = new DataView(data.buffer, data.byteOffset + 4);
+  const reads = view.getUint32(0, true);
+  const errors = view.getUint32(4, true);
+  const transferMeanUs = view.getUint32(8, true);
+  const transferMaxUs = view.getUint32(12, true);
+  const foregroundMeanUs = view.getUint32(16, true);
+  return { reads, errors, transferMeanUs, transferMaxUs, foregroundMeanUs };
+}
+
+function parseGetEncoderObserver(data) {
+  if (data.length !== 15) throw new Error('Invalid Get Encoder Observer response length');
+  const view = new DataView(data.buffer, data.byteOffset + 4);
+  const alpha = view.getFloat32(0, true);
+  const beta = view.getFloat32(4, true);
+  const feedForward = view.getUint8(8) !== 0;
+  return { alpha, beta, feedForward };
+}
+
+function parseGetEncoderCalibration(data) {
+  if (data.length !== 27) throw new Error('Invalid Get Encoder Calibration response length');
+  const view = new DataView(data.buffer, data.byteOffset + 4);
+  const state = view.getUint8(0);
+  const coefficients = [];
+  for (let n = 0; n < 4; n++) {
+    coefficients.push({ cos: view.getInt16(1 + n * 4, true), sin: view.getInt16(3 + n * 4, true) });
+  }
+  const residual = view.getFloat32(17, true);
+  return { state, coefficients, residual };
+}
+
+function parseGetScopeStatus(data) {
+  if (data.length !== 15) throw new Error('Invalid Get Scope Status response length');
+  const view = new DataView(data.buffer, data.byteOffset + 4);
+  return {
+    state: view.getUint8(0),
+    count: view.getUint16(1, true),
+    triggerIndex: view.getUint16(3, true),
+    periodUs: view.getUint32(5, true),
+  };
+}
+
+// Field values in bit order, see TELEMETRY_FIELDS
+const TELEMETRY_FIELD_TYPES = [
+  ['POSITION', 'float32'],
+  ['TARGET_POSITION', 'float32'],
+  ['VELOCITY', 'float32'],
+  ['MOTOR_STATE', 'uint8'],
+  ['HOMED', 'uint8'],
+  ['ENCODER_POSITION', 'float32'],
+  ['ENCODER_VELOCITY', 'float32'],
+  ['FOLLOWING_ERROR', 'float32'],
+  ['ERRORS', 'uint32'],
+];
+
+function parseTelemetry(data) {
+  if (data.length < 16) throw new Error('Invalid Telemetry frame length');
+  const view = new DataView(data.buffer, data.byteOffset);
+  const sequence = view.getUint32(4, true);
+  const timeMs = view.getUint32(8, true);
+  const fields = view.getUint16(12, true);
+  const values = {};
+  let offset = 14;
+  for (const [name, type] of TELEMETRY_FIELD_TYPES) {
+    if (!(fields & TELEMETRY_FIELDS[name])) continue;
+    if (type === 'float32') {
+      values[name] = view.getFloat32(offset, true);
+      offset += 4;
+    } else if (type === 'uint32') {
+      values[name] = view.getUint32(offset, true);
+      offset += 4;
+    } else {
+      values[name] = view.getUint8(offset);
+      offset += 1;
+    }
+  }
+  if (offset + 2 !== data.length) throw new Error('Invalid Telemetry frame length');
+  return { sequence, timeMs, fields, values };
+}
+
+// Samples are 22 bytes: time, commanded position, encoder position,
+// commanded and encoder velocity, status
+function parseGetScopeData(data) {
+  if (data.length !== 713) throw new Error('Invalid Get Scope Data response length');
+  const view = new DataView(data.buffer, data.byteOffset + 4);
+  const first = view.getUint16(0, true);
+  const count = view.getUint8(2);
+  const samples = [];
+  for (let i = 0; i < count && i < 32; i++) {
+    const offset = 3 + i * 22;
+    const status = view.getUint16(offset + 20, true);
+    samples.push({
+      timeUs: view.getUint32(offset, true),
+      commandedPosition: view.getInt32(offset + 4, true),
+      encoderPosition: view.getFloat32(offset + 8, true),
+      commandedVelocity: view.getFloat32(offset + 12, true),
+      encoderVelocity: view.getFloat32(offset + 16, true),
+      motorState: status & 0x0F,
+      stepEngine: (status & 0x10) !== 0,
+      closedLoop: (status & 0x20) !== 0,
+      errors: status >> 8,
+    });
+  }
+  return { first, samples };
+}
+
+// Status of each command run, commands past the end didn't run
+function parseBatch(data) {
+  if (data.length !== 23) throw new Error('Invalid Batch response length');
+  const count = data[4];
+  if (count > BATCH_MAX_COMMANDS) throw new Error('Invalid Batch response format');
+  const statuses = Array.from(data.subarray(5, 5 + count));
+  return { statuses };
+}
+
+function parseGetChecksumMode(data) {
+  if (data.length !== 7) throw new Error('Invalid Get Checksum Mode response length');
+  const mode = data[4];
+  return { mode };
+}
+
+// Counts since power up, by reason
+function parseGetRejectedFrames(data) {
+  if (data.length !== 22) throw new Error('Invalid Get Rejected Frames response length');
+  const view = new DataView(data.buffer, data.byteOffset + 4);
+  const truncated = view.getUint32(0, true);
+  const checksum = view.getUint32(4, true);
+  const unknownType = view.getUint32(8, true);
+  const bodySize = view.getUint32(12, true);
+  return { truncated, checksum, unknownType, bodySize };
+}
+
 // Utility functions
 
 function parseMessageHeader(data) {
@@ -508,6 +1165,18 @@ if (typeof module !== 'undefined' && module.exports) {
     MOTOR_BRAKE,
     HOME_DIRECTION,
     POSITION_MODE,
+    MOTION_PROFILE,
+    STALL_ACTION,
+    TELEMETRY_FIELDS,
+    SCOPE_TRIGGER,
+    SCOPE_CHANNEL,
+    SCOPE_STATE,
+    CHECKSUM_MODE,
+    MOTOR_ERRORS,
+    PROFILE_PROBE,
+    BATCH_MAX_COMMANDS,
+    REQUEST_ID_FLAG,
+    REQUEST_HISTORY,
     buildMessage,
     // Builders
     buildAckMessage,
@@ -548,6 +1217,46 @@ if (typeof module !== 'undefined' && module.exports) {
     buildGetVelocity,
     buildSetVelocityAndSteps,
     buildStartPath,
+    buildGetMotionQueueStatus,
+    buildSetMotionProfile,
+    buildGetMotionProfile,
+    buildSetJerk,
+    buildGetJerk,
+    buildSetPlannerDepth,
+    buildGetPlannerDepth,
+    buildAddPvtPoint,
+    buildSetPvtDelay,
+    buildGetPvtDelay,
+    buildGetPvtStatus,
+    buildSetClosedLoop,
+    buildGetClosedLoop,
+    buildSetClosedLoopGains,
+    buildGetClosedLoopGains,
+    buildGetClosedLoopStatus,
+    buildSetStallWindow,
+    buildGetStallWindow,
+    buildSetStallAction,
+    buildGetStallAction,
+    buildGetFollowingError,
+    buildGetMotorErrors,
+    buildClearMotorErrors,
+    buildGetProfile,
+    buildResetProfile,
+    buildGetEncoderBusStats,
+    buildSetEncoderObserver,
+    buildGetEncoderObserver,
+    buildCalibrateEncoder,
+    buildGetEncoderCalibration,
+    buildClearEncoderCalibration,
+    buildArmScope,
+    buildStopScope,
+    buildGetScopeStatus,
+    buildGetScopeData,
+    buildSubscribeTelemetry,
+    buildSetChecksumMode,
+    buildGetChecksumMode,
+    buildGetRejectedFrames,
+    buildBatch,
     // Parsers
     parseAck,
     parseGetVersion,
@@ -567,8 +1276,36 @@ if (typeof module !== 'undefined' && module.exports) {
     parseGetCurrentPosition,
     parseGetTargetPosition,
     parseGetVelocity,
+    parseGetMotionQueueStatus,
+    parseGetMotionProfile,
+    parseGetJerk,
+    parseGetPlannerDepth,
+    parseGetPvtDelay,
+    parseGetPvtStatus,
+    parseGetClosedLoop,
+    parseGetClosedLoopGains,
+    parseGetClosedLoopStatus,
+    parseGetStallWindow,
+    parseGetStallAction,
+    parseGetFollowingError,
+    parseGetMotorErrors,
+    parseGetProfile,
+    parseGetEncoderBusStats,
+    parseGetEncoderObserver,
+    parseGetEncoderCalibration,
+    parseGetScopeStatus,
+    parseGetScopeData,
+    parseTelemetry,
+    parseGetChecksumMode,
+    parseGetRejectedFrames,
+    parseBatch,
     // Utilities
     parseMessageHeader,
+    calculateChecksum,
+    withRequestId,
+    splitRequestId,
+    setChecksumMode,
+    getChecksumMode,
     verifyChecksum,
     formatMessageBytes,
   };
@@ -395,7 +395,7 @@ function handleMessage(msg) {
             break;
         case MESSAGE_TYPES.GetMotorStateId:
             const mstate = parseGetMotorState(msg);
-            const stateNames = ['OFF', 'POSITION', 'VELOCITY', 'VELOCITY_STEP', 'IDLE_ON', 'HOME'];
+            const stateNames = ['OFF', 'POSITION', 'VELOCITY', 'VELOCITY_STEP', 'IDLE_ON', 'HOME', 'PVT'];
             // Update the select field with current value
             document.getElementById('motorState').value = mstate.motorState;
             console.log(`[PROTOCOL] Current Motor State: ${stateNames[mstate.motorState] || 'UNKNOWN'} (${mstate.motorState})`);